@@ -0,0 +1,199 @@
+/**
+ * @file arena.h
+ * @author Rafael Diolatzis
+ * @brief An arena of 64 byte aligned sample buffers backed by huge pages
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Buffers are carved out of large anonymous mappings, the regions. A region is mapped with MAP_HUGETLB when the
+ * system has reserved huge pages and otherwise with normal pages and madvise(MADV_HUGEPAGE), so that transparent huge
+ * pages back it. Either way a multi-megabyte buffer costs a handful of page faults and TLB entries instead of one per
+ * 4 KB page.
+ *
+ * Every buffer is rounded up to a power of two size class and is preceded by a 64 byte header that records its class.
+ * A released buffer goes on the free list of its class and the next request of that class gets it back, so a command
+ * that works block by block, or a library context that runs job after job, keeps reusing pages that are already
+ * faulted in. Buffers larger than half a region get a mapping of their own. These are kept for reuse as well, until
+ * ARENA_CACHE_LIMIT bytes of them are idle, after which they are unmapped when released.
+ *
+ * An arena is not thread-safe, every thread that allocates needs its own.
+ */
+
+#pragma once
+
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<sys/mman.h>
+
+#define ARENA_ALIGNMENT 64
+#define ARENA_HUGE_PAGE ((size_t)2 << 20)
+#define ARENA_REGION_SIZE ((size_t)16 << 20)
+#define ARENA_CACHE_LIMIT ((size_t)1 << 30)
+#define ARENA_MIN_CLASS 7
+#define ARENA_CLASSES 48
+
+/**
+ * @brief An anonymous mapping that buffers are carved from
+ */
+struct arena_region {
+    char* base;
+    size_t size;
+    size_t used;
+    short huge;
+    short dedicated;
+    struct arena_region* next;
+};
+
+/**
+ * @brief The header in front of every buffer. It takes ARENA_ALIGNMENT bytes so the buffer stays aligned
+ */
+struct arena_block {
+    struct arena_region* region;
+    struct arena_block* next;
+    uint32_t size_class;
+};
+
+/**
+ * @brief The regions and free lists of an arena. A zeroed struct is an empty arena
+ */
+struct sample_arena {
+    struct arena_region* regions;
+    struct arena_block* free_list[ARENA_CLASSES];
+    size_t mapped;
+    size_t idle_dedicated;
+    uint64_t allocations;
+    uint64_t reuses;
+    uint32_t huge_regions;
+};
+
+/**
+ * @brief Maps a region of at least size bytes and adds it to the arena
+ *
+ * @returns the region or NULL if the memory could not be mapped
+ */
+struct arena_region* arena_Map(struct sample_arena* arena, size_t size, short dedicated){
+    size = (size + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);
+    struct arena_region* region = calloc(1, sizeof(struct arena_region));
+    if(region == NULL) return NULL;
+
+    void* base = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    region->huge = base != MAP_FAILED;
+#endif
+    if(base == MAP_FAILED){
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(base == MAP_FAILED){
+            free(region);
+            return NULL;
+        }
+#if defined(MADV_HUGEPAGE)
+        madvise(base, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    region->base = base;
+    region->size = size;
+    region->dedicated = dedicated;
+    region->next = arena->regions;
+    arena->regions = region;
+    arena->mapped += size;
+    arena->huge_regions += region->huge;
+    return region;
+}
+
+/**
+ * @brief Unmaps a region and removes it from the arena
+ */
+void arena_Unmap(struct sample_arena* arena, struct arena_region* region){
+    struct arena_region** link = &arena->regions;
+    while(*link != region) link = &(*link)->next;
+    *link = region->next;
+    arena->mapped -= region->size;
+    arena->huge_regions -= region->huge;
+    munmap(region->base, region->size);
+    free(region);
+}
+
+/**
+ * @brief Returns the first region that contains an address, or NULL if the address is not in the arena
+ */
+struct arena_region* arena_Find(const struct sample_arena* arena, const void* data){
+    for(struct arena_region* region = arena->regions; region != NULL; region = region->next){
+        if((const char*)data >= region->base && (const char*)data < region->base + region->size) return region;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Allocates a buffer from the arena
+ *
+ * @param size the size of the buffer in bytes
+ *
+ * @returns a buffer aligned to ARENA_ALIGNMENT bytes, or NULL if the memory could not be mapped
+ */
+void* arena_Alloc(struct sample_arena* arena, size_t size){
+    uint32_t size_class = ARENA_MIN_CLASS;
+    while(size_class < ARENA_CLASSES && ((size_t)1 << size_class) - ARENA_ALIGNMENT < size) size_class++;
+    if(size_class >= ARENA_CLASSES) return NULL;
+    const size_t class_size = (size_t)1 << size_class;
+
+    arena->allocations++;
+    struct arena_block* block = arena->free_list[size_class];
+    if(block != NULL){
+        arena->free_list[size_class] = block->next;
+        if(block->region->dedicated) arena->idle_dedicated -= class_size;
+        arena->reuses++;
+        return (char*)block + ARENA_ALIGNMENT;
+    }
+
+    struct arena_region* region;
+    if(class_size > ARENA_REGION_SIZE / 2){
+        region = arena_Map(arena, class_size, 1);
+    } else{
+        // only the newest shared region has room left, the older ones were filled before it was mapped
+        region = arena->regions;
+        while(region != NULL && region->dedicated) region = region->next;
+        if(region == NULL || region->size - region->used < class_size) region = arena_Map(arena, ARENA_REGION_SIZE, 0);
+    }
+    if(region == NULL) return NULL;
+
+    block = (struct arena_block*)(region->base + region->used);
+    region->used += class_size;
+    block->region = region;
+    block->next = NULL;
+    block->size_class = size_class;
+    return (char*)block + ARENA_ALIGNMENT;
+}
+
+/**
+ * @brief Returns a buffer to the arena
+ *
+ * @returns 1 if the buffer belongs to the arena, 0 if it does not and was left untouched
+ */
+short arena_Free(struct sample_arena* arena, void* data){
+    if(arena_Find(arena, data) == NULL) return 0;
+    struct arena_block* block = (struct arena_block*)((char*)data - ARENA_ALIGNMENT);
+    const size_t class_size = (size_t)1 << block->size_class;
+    if(block->region->dedicated){
+        if(arena->idle_dedicated + class_size > ARENA_CACHE_LIMIT){
+            arena_Unmap(arena, block->region);
+            return 1;
+        }
+        arena->idle_dedicated += class_size;
+    }
+    block->next = arena->free_list[block->size_class];
+    arena->free_list[block->size_class] = block;
+    return 1;
+}
+
+/**
+ * @brief Unmaps every region of the arena and leaves it empty
+ */
+void arena_Release(struct sample_arena* arena){
+    while(arena->regions != NULL) arena_Unmap(arena, arena->regions);
+    memset(arena, 0, sizeof(struct sample_arena));
+}
@@ -0,0 +1,789 @@
+/**
+ * @file batch.h
+ * @author Rafael Diolatzis
+ * @brief Runs a command on every WAV file of a directory with the file I/O overlapped with the processing
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * A file is read whole into memory, the command runs on it in-process with IO_IN and IO_OUT pointed at memory
+ * streams, and the result is written to a file of the same name in the output directory. There are three ways to
+ * move the files:
+ *
+ * - uring: one thread drives an io_uring. Every file in flight (up to the depth) is a small state machine of
+ *   open, read, close, compute, open, write and close. Only the compute step leaves the ring: it is queued to a pool
+ *   of compute threads, which signal an eventfd that has a read pending in the same ring, so the driver thread only
+ *   ever waits in io_uring_enter(). Opens, reads, writes and closes of many files are submitted together, and small
+ *   files cost a fraction of a system call each.
+ * - threads: used when io_uring is not available (old kernels, or seccomp filters that block it). epoll cannot wait
+ *   for regular files, so the fallback is a pool of depth threads that each open, pread, compute, pwrite and close
+ *   one file at a time. The blocking calls of one thread overlap with the work of the others.
+ * - naive: the plain loop that reads, processes and writes one file after the other with stdio. It is here to
+ *   measure the other two against.
+ *
+ * The io_uring is set up with raw system calls, so there is no dependency on liburing.
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<inttypes.h>
+#include<string.h>
+#include<strings.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<dirent.h>
+#include<limits.h>
+#include<pthread.h>
+#include<time.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<sys/syscall.h>
+#include<sys/eventfd.h>
+#include<linux/io_uring.h>
+#include"utils.h"
+
+#define BATCH_IO_AUTO 0
+#define BATCH_IO_URING 1
+#define BATCH_IO_THREADS 2
+#define BATCH_IO_NAIVE 3
+
+#define BATCH_DEFAULT_DEPTH 64
+#define BATCH_MAX_DEPTH 1024
+#define BATCH_READ_SIZE 65536
+#define BATCH_EVENT UINT64_MAX
+
+#define BATCH_OPEN_IN 0
+#define BATCH_READ 1
+#define BATCH_CLOSE_IN 2
+#define BATCH_COMPUTE 3
+#define BATCH_OPEN_OUT 4
+#define BATCH_WRITE 5
+#define BATCH_CLOSE_OUT 6
+
+/**
+ * @brief Runs one command line, the same way as main() does
+ */
+typedef int (*batch_Runner)(int argc, char* argv[]);
+
+/**
+ * @brief A file in flight. The buffer of the input is kept from file to file
+ */
+struct batch_job {
+    uint32_t file;
+    int fd;
+    short stage;
+    int status;
+    char* data;
+    size_t size;
+    size_t capacity;
+    size_t requested;
+    char* out;
+    size_t out_size;
+    size_t written;
+    char path[PATH_MAX];
+    struct batch_job* next;
+};
+
+/**
+ * @brief The files, the command and the queues shared by the driver and the worker threads
+ */
+struct batch {
+    char** files;
+    uint32_t count;
+    const char* in_dir;
+    const char* out_dir;
+    int argc;
+    char** argv;
+    batch_Runner run;
+
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    struct batch_job* todo;     // waiting for a compute thread
+    struct batch_job* done;     // computed, waiting for the driver
+    int event;                  // signalled when a job is added to done
+    short stop;
+    uint32_t next_file;         // the next file of the threads backend
+
+    uint32_t failed;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+};
+
+/**
+ * @brief The mapped rings of an io_uring
+ */
+struct batch_ring {
+    int fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned entries;
+    unsigned queued;            // entries added since the last io_uring_enter()
+};
+
+/**
+ * @brief Parses the name of an I/O backend
+ *
+ * @returns one of the BATCH_IO_* values or -1 if the name is unknown
+ */
+int batch_ParseIo(const char* name){
+    if(strcmp(name, "auto") == 0) return BATCH_IO_AUTO;
+    if(strcmp(name, "uring") == 0) return BATCH_IO_URING;
+    if(strcmp(name, "threads") == 0) return BATCH_IO_THREADS;
+    if(strcmp(name, "naive") == 0) return BATCH_IO_NAIVE;
+    return -1;
+}
+
+/**
+ * @brief Returns a monotonic timestamp in seconds
+ */
+double batch_Now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Orders two file names for qsort()
+ */
+int batch_CompareNames(const void* a, const void* b){
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * @brief Lists the .wav files of a directory in name order
+ *
+ * @returns the number of files, or -1 if the directory cannot be read. The names must be released with free()
+ */
+int batch_List(const char* dir, char*** files){
+    DIR* d = opendir(dir);
+    if(d == NULL) return -1;
+    uint32_t count = 0, capacity = 256;
+    char** names = malloc(capacity * sizeof(char*));
+    struct dirent* entry;
+    while(names != NULL && (entry = readdir(d)) != NULL){
+        size_t length = strlen(entry->d_name);
+        if(length < 5 || strcasecmp(entry->d_name + length - 4, ".wav") != 0) continue;
+        if(count == capacity){
+            char** grown = realloc(names, 2 * capacity * sizeof(char*));
+            if(grown == NULL) break;
+            names = grown;
+            capacity *= 2;
+        }
+        if((names[count] = strdup(entry->d_name)) == NULL) break;
+        count++;
+    }
+    closedir(d);
+    if(names == NULL) return -1;
+    qsort(names, count, sizeof(char*), batch_CompareNames);
+    *files = names;
+    return (int)count;
+}
+
+/**
+ * @brief Writes the input or output path of a file into the path buffer of a job
+ */
+short batch_Path(const struct batch* b, struct batch_job* job, short output){
+    int length = snprintf(job->path, sizeof(job->path), "%s/%s", output ? b->out_dir : b->in_dir, b->files[job->file]);
+    if(length > 0 && (size_t)length < sizeof(job->path)) return 1;
+    errno = ENAMETOOLONG;
+    return 0;
+}
+
+/**
+ * @brief Makes room for at least size bytes of input
+ */
+short batch_Reserve(struct batch_job* job, size_t size){
+    if(size <= job->capacity) return 1;
+    size_t capacity = job->capacity > 0 ? job->capacity : BATCH_READ_SIZE;
+    while(capacity < size) capacity *= 2;
+    char* data = realloc(job->data, capacity);
+    if(data == NULL) return 0;
+    job->data = data;
+    job->capacity = capacity;
+    return 1;
+}
+
+/**
+ * @brief Runs the command on the input of a job and keeps its output in memory
+ *
+ * @returns the exit status of the command
+ */
+int batch_Compute(const struct batch* b, struct batch_job* job){
+    job->out = NULL;
+    job->out_size = 0;
+    job->written = 0;
+    FILE* in = job->size > 0 ? fmemopen(job->data, job->size, "rb") : fopen("/dev/null", "rb");
+    FILE* out = open_memstream(&job->out, &job->out_size);
+    if(in == NULL || out == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        if(in != NULL) fclose(in);
+        if(out != NULL) fclose(out);
+        return 1;
+    }
+
+    FILE* saved_in = io_input;
+    FILE* saved_out = io_output;
+    io_input = in;
+    io_output = out;
+    int status = b->run(b->argc, b->argv);
+    io_input = saved_in;
+    io_output = saved_out;
+
+    fclose(in);
+    if(fclose(out) != 0) status = 1;
+    return status;
+}
+
+/**
+ * @brief Counts a finished file and releases its output
+ */
+void batch_Finish(struct batch* b, struct batch_job* job, const char* error, int code){
+    pthread_mutex_lock(&b->lock);
+    if(error != NULL || job->status != 0){
+        b->failed++;
+    } else{
+        b->bytes_in += job->size;
+        b->bytes_out += job->out_size;
+    }
+    pthread_mutex_unlock(&b->lock);
+    if(error != NULL) fprintf(stderr, "Error! %s %s: %s\n", error, b->files[job->file], strerror(code));
+    else if(job->status != 0) fprintf(stderr, "Error! the command failed on %s\n", b->files[job->file]);
+    free(job->out);
+    job->out = NULL;
+}
+
+/**
+ * @brief Sets up an io_uring with room for entries submissions and checks that it supports the operations of a batch
+ *
+ * @returns 0 on success, otherwise the ring is unusable
+ */
+int batch_ring_Setup(struct batch_ring* ring, unsigned entries){
+    memset(ring, 0, sizeof(struct batch_ring));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if(ring->fd < 0) return -1;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP){
+        if(ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ring == MAP_FAILED){
+        close(ring->fd);
+        return -1;
+    }
+    ring->cq_ring = ring->sq_ring;
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP)){
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED){
+        if(ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+        if(ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    char* sq = ring->sq_ring;
+    char* cq = ring->cq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    ring->entries = params.sq_entries;
+
+    // the opcodes used here appeared in Linux 5.6, an older kernel accepts the ring but fails every request
+    const uint8_t needed[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE};
+    const unsigned ops = 256;
+    struct io_uring_probe* probe = calloc(1, sizeof(struct io_uring_probe) + ops * sizeof(struct io_uring_probe_op));
+    short supported = probe != NULL && syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, ops) == 0;
+    for(size_t i = 0; supported && i < sizeof(needed); i++){
+        supported = needed[i] <= probe->last_op && (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    if(!supported){
+        if(ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+        munmap(ring->sqes, ring->sqes_size);
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        return -1;
+    }
+    return 0;
+}
+
+void batch_ring_Destroy(struct batch_ring* ring){
+    if(ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+/**
+ * @brief Adds a request to the submission queue. The caller keeps fewer requests in flight than the ring has entries
+ */
+void batch_ring_Push(struct batch_ring* ring, uint8_t opcode, int fd, const void* addr, uint32_t len, uint64_t offset, uint64_t user_data){
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->queued++;
+}
+
+/**
+ * @brief Submits the queued requests and waits until at least one completion is available
+ */
+int batch_ring_Enter(struct batch_ring* ring){
+    for(;;){
+        long submitted = syscall(__NR_io_uring_enter, ring->fd, ring->queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if(submitted >= 0){
+            ring->queued -= (unsigned)submitted;
+            return 0;
+        }
+        if(errno != EINTR && errno != EAGAIN && errno != EBUSY) return -1;
+    }
+}
+
+/**
+ * @brief Takes the next completion off the completion queue
+ *
+ * @returns 1 if a completion was taken, 0 if the queue is empty
+ */
+short batch_ring_Pop(struct batch_ring* ring, uint64_t* user_data, int* result){
+    unsigned head = *ring->cq_head;
+    if(head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+    struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+    *user_data = cqe->user_data;
+    *result = cqe->res;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/**
+ * @brief A compute thread of the uring backend
+ */
+void* batch_ComputeWorker(void* arg){
+    struct batch* b = arg;
+    struct sample_arena arena;
+    memset(&arena, 0, sizeof(arena));
+    io_arena = &arena;
+
+    pthread_mutex_lock(&b->lock);
+    for(;;){
+        while(b->todo == NULL && !b->stop) pthread_cond_wait(&b->ready, &b->lock);
+        if(b->todo == NULL) break;
+        struct batch_job* job = b->todo;
+        b->todo = job->next;
+        pthread_mutex_unlock(&b->lock);
+
+        job->status = batch_Compute(b, job);
+
+        pthread_mutex_lock(&b->lock);
+        job->next = b->done;
+        b->done = job;
+        uint64_t one = 1;
+        if(write(b->event, &one, sizeof(one)) < 0) perror("eventfd");
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    io_arena = NULL;
+    arena_Release(&arena);
+    return NULL;
+}
+
+/**
+ * @brief Moves a job of the uring backend to its next stage after a completion
+ *
+ * @returns 1 when the job is finished and its slot can take the next file
+ */
+short batch_uring_Step(struct batch* b, struct batch_ring* ring, struct batch_job* job, uint64_t slot, int result){
+    if(result < 0){
+        static const char* actions[] = {"unable to open", "unable to read", "unable to close", "", "unable to create", "unable to write", "unable to close"};
+        if(job->stage == BATCH_READ || job->stage == BATCH_WRITE) close(job->fd);
+        batch_Finish(b, job, actions[job->stage], -result);
+        return 1;
+    }
+
+    switch(job->stage){
+    case BATCH_OPEN_IN:
+        job->fd = result;
+        job->size = 0;
+        job->stage = BATCH_READ;
+        job->requested = job->capacity;
+        batch_ring_Push(ring, IORING_OP_READ, job->fd, job->data, (uint32_t)job->requested, 0, slot);
+        return 0;
+    case BATCH_READ:
+        job->size += (size_t)result;
+        // a short read of a regular file means the end of the file, a full buffer needs another read
+        if((size_t)result == job->requested && result > 0){
+            if(!batch_Reserve(job, 2 * job->capacity)){
+                close(job->fd);
+                batch_Finish(b, job, "unable to read", ENOMEM);
+                return 1;
+            }
+            job->requested = job->capacity - job->size;
+            batch_ring_Push(ring, IORING_OP_READ, job->fd, job->data + job->size, (uint32_t)job->requested, job->size, slot);
+            return 0;
+        }
+        job->stage = BATCH_CLOSE_IN;
+        batch_ring_Push(ring, IORING_OP_CLOSE, job->fd, NULL, 0, 0, slot);
+        return 0;
+    case BATCH_CLOSE_IN:
+        job->stage = BATCH_COMPUTE;
+        pthread_mutex_lock(&b->lock);
+        job->next = b->todo;
+        b->todo = job;
+        pthread_cond_signal(&b->ready);
+        pthread_mutex_unlock(&b->lock);
+        return 0;
+    case BATCH_OPEN_OUT:
+        job->fd = result;
+        job->stage = BATCH_WRITE;
+        job->requested = job->out_size;
+        batch_ring_Push(ring, IORING_OP_WRITE, job->fd, job->out, (uint32_t)job->requested, 0, slot);
+        return 0;
+    case BATCH_WRITE:
+        job->written += (size_t)result;
+        if(job->written < job->out_size && result > 0){
+            job->requested = job->out_size - job->written;
+            batch_ring_Push(ring, IORING_OP_WRITE, job->fd, job->out + job->written, (uint32_t)job->requested, job->written, slot);
+            return 0;
+        }
+        if(job->written < job->out_size){
+            close(job->fd);
+            batch_Finish(b, job, "unable to write", EIO);
+            return 1;
+        }
+        // the file is opened without O_TRUNC, see batch_WriteFile()
+        if(ftruncate(job->fd, (off_t)job->out_size) != 0){
+            int code = errno;
+            close(job->fd);
+            batch_Finish(b, job, "unable to write", code);
+            return 1;
+        }
+        job->stage = BATCH_CLOSE_OUT;
+        batch_ring_Push(ring, IORING_OP_CLOSE, job->fd, NULL, 0, 0, slot);
+        return 0;
+    default:
+        batch_Finish(b, job, NULL, 0);
+        return 1;
+    }
+}
+
+/**
+ * @brief Processes the files with an io_uring driven by the calling thread and threads compute threads
+ *
+ * @returns 0 on success, -1 if the ring could not be set up (nothing has been processed then)
+ */
+int batch_Uring(struct batch* b, struct batch_job* jobs, uint32_t depth, int threads){
+    struct batch_ring ring;
+    if(batch_ring_Setup(&ring, depth + 1) != 0) return -1;
+    b->event = eventfd(0, EFD_CLOEXEC);
+    pthread_t* ids = malloc(threads * sizeof(pthread_t));
+    uint32_t* idle = malloc(depth * sizeof(uint32_t));
+    if(b->event < 0 || ids == NULL || idle == NULL){
+        if(b->event >= 0) close(b->event);
+        free(ids);
+        free(idle);
+        batch_ring_Destroy(&ring);
+        return -1;
+    }
+    int started = 0;
+    for(; started < threads; started++){
+        if(pthread_create(&ids[started], NULL, batch_ComputeWorker, b) != 0) break;
+    }
+
+    uint32_t idle_count = depth, finished = 0, next = 0;
+    for(uint32_t i = 0; i < depth; i++) idle[i] = depth - 1 - i;
+    uint64_t events = 0;
+    batch_ring_Push(&ring, IORING_OP_READ, b->event, &events, sizeof(events), (uint64_t)-1, BATCH_EVENT);
+
+    while(finished < b->count && started > 0){
+        while(idle_count > 0 && next < b->count){
+            uint32_t slot = idle[--idle_count];
+            struct batch_job* job = &jobs[slot];
+            job->file = next++;
+            job->status = 0;
+            job->stage = BATCH_OPEN_IN;
+            if(!batch_Path(b, job, 0) || !batch_Reserve(job, BATCH_READ_SIZE)){
+                batch_Finish(b, job, "unable to open", ENAMETOOLONG);
+                idle[idle_count++] = slot;
+                finished++;
+                continue;
+            }
+            batch_ring_Push(&ring, IORING_OP_OPENAT, AT_FDCWD, job->path, 0, 0, slot);
+            ring.sqes[(*ring.sq_tail - 1) & *ring.sq_mask].open_flags = O_RDONLY | O_CLOEXEC;
+        }
+        if(batch_ring_Enter(&ring) != 0){
+            perror("io_uring_enter");
+            break;
+        }
+
+        uint64_t slot;
+        int result;
+        while(batch_ring_Pop(&ring, &slot, &result)){
+            if(slot == BATCH_EVENT){
+                pthread_mutex_lock(&b->lock);
+                struct batch_job* done = b->done;
+                b->done = NULL;
+                pthread_mutex_unlock(&b->lock);
+                for(; done != NULL; done = done->next){
+                    if(done->status != 0 || !batch_Path(b, done, 1)){
+                        batch_Finish(b, done, NULL, 0);
+                        idle[idle_count++] = (uint32_t)(done - jobs);
+                        finished++;
+                        continue;
+                    }
+                    done->stage = BATCH_OPEN_OUT;
+                    batch_ring_Push(&ring, IORING_OP_OPENAT, AT_FDCWD, done->path, 0644, 0, (uint64_t)(done - jobs));
+                    ring.sqes[(*ring.sq_tail - 1) & *ring.sq_mask].open_flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+                }
+                batch_ring_Push(&ring, IORING_OP_READ, b->event, &events, sizeof(events), (uint64_t)-1, BATCH_EVENT);
+                continue;
+            }
+            if(batch_uring_Step(b, &ring, &jobs[slot], slot, result)){
+                idle[idle_count++] = (uint32_t)slot;
+                finished++;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&b->lock);
+    b->stop = 1;
+    pthread_cond_broadcast(&b->ready);
+    pthread_mutex_unlock(&b->lock);
+    for(int i = 0; i < started; i++) pthread_join(ids[i], NULL);
+    b->failed += b->count - finished;
+
+    close(b->event);
+    batch_ring_Destroy(&ring);
+    free(ids);
+    free(idle);
+    return 0;
+}
+
+/**
+ * @brief Reads a whole file into the buffer of a job with pread()
+ */
+short batch_ReadFile(struct batch_job* job){
+    int fd = open(job->path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return 0;
+    struct stat st;
+    short ok = fstat(fd, &st) == 0 && batch_Reserve(job, (size_t)st.st_size + 1);
+    job->size = 0;
+    while(ok){
+        ssize_t n = pread(fd, job->data + job->size, job->capacity - job->size, (off_t)job->size);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0){
+            ok = n == 0;
+            break;
+        }
+        job->size += (size_t)n;
+        if(job->size == job->capacity) ok = batch_Reserve(job, 2 * job->capacity);
+    }
+    close(fd);
+    return ok;
+}
+
+/**
+ * @brief Writes the output of a job to a file with pwrite()
+ * 
+ * An existing file is overwritten in place and then cut to the new length. Truncating it to zero bytes first, as
+ * O_TRUNC does, makes ext4 flush the new data to the disk when the file is closed (auto_da_alloc), and the next
+ * truncation of the same file waits for that write back, which turns a rerun over the same directory into a
+ * disk-bound crawl.
+ */
+short batch_WriteFile(struct batch_job* job){
+    int fd = open(job->path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if(fd < 0) return 0;
+    for(job->written = 0; job->written < job->out_size;){
+        ssize_t n = pwrite(fd, job->out + job->written, job->out_size - job->written, (off_t)job->written);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0){
+            close(fd);
+            return 0;
+        }
+        job->written += (size_t)n;
+    }
+    if(ftruncate(fd, (off_t)job->out_size) != 0){
+        close(fd);
+        return 0;
+    }
+    return close(fd) == 0;
+}
+
+/**
+ * @brief A thread of the threads backend, it processes one file at a time until there are none left
+ */
+void* batch_ThreadWorker(void* arg){
+    struct batch* b = arg;
+    struct batch_job job;
+    memset(&job, 0, sizeof(job));
+    struct sample_arena arena;
+    memset(&arena, 0, sizeof(arena));
+    io_arena = &arena;
+
+    for(;;){
+        pthread_mutex_lock(&b->lock);
+        job.file = b->next_file++;
+        pthread_mutex_unlock(&b->lock);
+        if(job.file >= b->count) break;
+
+        if(!batch_Path(b, &job, 0) || !batch_ReadFile(&job)){
+            batch_Finish(b, &job, "unable to read", errno);
+            continue;
+        }
+        job.status = batch_Compute(b, &job);
+        if(job.status == 0 && (!batch_Path(b, &job, 1) || !batch_WriteFile(&job))){
+            batch_Finish(b, &job, "unable to write", errno);
+            continue;
+        }
+        batch_Finish(b, &job, NULL, 0);
+    }
+
+    io_arena = NULL;
+    arena_Release(&arena);
+    free(job.data);
+    return NULL;
+}
+
+/**
+ * @brief Processes the files on the calling thread, one after the other with stdio
+ */
+void batch_Naive(struct batch* b, struct batch_job* job){
+    for(job->file = 0; job->file < b->count; job->file++){
+        FILE* file = batch_Path(b, job, 0) ? fopen(job->path, "rb") : NULL;
+        if(file == NULL){
+            batch_Finish(b, job, "unable to read", errno);
+            continue;
+        }
+        job->size = 0;
+        size_t n;
+        while(batch_Reserve(job, job->size + BATCH_READ_SIZE) && (n = fread(job->data + job->size, 1, job->capacity - job->size, file)) > 0){
+            job->size += n;
+        }
+        fclose(file);
+
+        job->status = batch_Compute(b, job);
+        if(job->status == 0){
+            file = batch_Path(b, job, 1) ? fopen(job->path, "wb") : NULL;
+            if(file == NULL || fwrite(job->out, 1, job->out_size, file) != job->out_size || fclose(file) != 0){
+                batch_Finish(b, job, "unable to write", errno);
+                continue;
+            }
+        }
+        batch_Finish(b, job, NULL, 0);
+    }
+}
+
+/**
+ * @brief Runs a command line on every .wav file of a directory and writes the results to another directory
+ *
+ * @param in_dir the directory of the input files
+ * @param out_dir the directory of the output files, which must exist and may be the input directory
+ * @param io one of the BATCH_IO_* values. BATCH_IO_AUTO uses io_uring when the kernel allows it, threads otherwise
+ * @param depth the number of files in flight
+ * @param threads the number of compute threads of the uring backend
+ * @param run runs a command line on IO_IN and IO_OUT
+ * @param argc the number of words of the command line, argv[0] being the program name
+ * @param argv the command line
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void batch_command(const char* in_dir, const char* out_dir, int io, uint32_t depth, int threads,
+                   batch_Runner run, int argc, char* argv[], short* flag){
+    *flag = 1;
+    struct batch b;
+    memset(&b, 0, sizeof(b));
+    b.in_dir = in_dir;
+    b.out_dir = out_dir;
+    b.argc = argc;
+    b.argv = argv;
+    b.run = run;
+    depth = depth < 1 ? 1 : (depth > BATCH_MAX_DEPTH ? BATCH_MAX_DEPTH : depth);
+    threads = threads < 1 ? 1 : threads;
+
+    int count = batch_List(in_dir, &b.files);
+    if(count < 0){
+        fprintf(stderr, "Error! unable to read the directory %s: %s\n", in_dir, strerror(errno));
+        return;
+    }
+    b.count = (uint32_t)count;
+    struct batch_job* jobs = calloc(depth, sizeof(struct batch_job));
+    if(jobs == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        for(uint32_t i = 0; i < b.count; i++) free(b.files[i]);
+        free(b.files);
+        return;
+    }
+    pthread_mutex_init(&b.lock, NULL);
+    pthread_cond_init(&b.ready, NULL);
+
+    const char* backend = "naive";
+    double begin = batch_Now();
+    if(io == BATCH_IO_NAIVE){
+        batch_Naive(&b, jobs);
+    } else{
+        backend = "uring";
+        if(io == BATCH_IO_THREADS || batch_Uring(&b, jobs, depth, threads) != 0){
+            if(io == BATCH_IO_URING) fprintf(stderr, "Warning: io_uring is not available, using the threads backend\n");
+            backend = "threads";
+            pthread_t* ids = malloc(depth * sizeof(pthread_t));
+            uint32_t started = 0;
+            for(; ids != NULL && started < depth; started++){
+                if(pthread_create(&ids[started], NULL, batch_ThreadWorker, &b) != 0) break;
+            }
+            if(started == 0) batch_ThreadWorker(&b);
+            for(uint32_t i = 0; i < started; i++) pthread_join(ids[i], NULL);
+            free(ids);
+        }
+    }
+    double elapsed = batch_Now() - begin;
+    if(elapsed <= 0) elapsed = 1e-9;
+
+    fprintf(IO_OUT, "batch: %" PRIu32 " files, %" PRIu32 " failed, %.3f s, %.0f files/s, %.1f MB/s read, %.1f MB/s written (%s",
+            b.count, b.failed, elapsed, b.count / elapsed, b.bytes_in / elapsed / 1e6, b.bytes_out / elapsed / 1e6, backend);
+    if(io != BATCH_IO_NAIVE) fprintf(IO_OUT, ", depth %" PRIu32, depth);
+    if(strcmp(backend, "uring") == 0) fprintf(IO_OUT, ", %d compute threads", threads);
+    fprintf(IO_OUT, ")\n");
+
+    for(uint32_t i = 0; i < depth; i++) free(jobs[i].data);
+    free(jobs);
+    for(uint32_t i = 0; i < b.count; i++) free(b.files[i]);
+    free(b.files);
+    pthread_mutex_destroy(&b.lock);
+    pthread_cond_destroy(&b.ready);
+    *flag = b.failed != 0;
+}
@@ -0,0 +1,553 @@
+/**
+ * @file beat.h
+ * @author Rafael Diolatzis
+ * @brief Tempo and beat positions of WAV files from a spectral flux onset envelope and a comb filterbank
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * A file is downmixed, resampled to 11025 Hz and cut into frames of 512 samples every 128 samples (11.6 ms). The onset
+ * envelope is the spectral flux of the frames, the sum of the increases of the log magnitude of every bin, less its
+ * mean over the last 32 frames and rectified, so it has a peak at every note or drum hit whatever its loudness.
+ *
+ * The envelope goes through a bank of comb filters, one every 0.05% of tempo from 60 to 200 BPM. Each filter adds
+ * every envelope value to a histogram of the phase of its beat period, one bin per frame of the period, so when the
+ * period is the period of the music the onsets pile up in one phase, and when it is not they spread over all of them.
+ * A filter scores the peak of its histogram over the mean. The bins have the same width at every tempo, so an onset,
+ * which lasts a few frames, peaks as high in the histogram of a slow tempo as in the histogram of a fast one.
+ *
+ * Off-beat notes score the double of a tempo almost as high as the tempo itself. Music also repeats at the half of its
+ * tempo, the double of its beat period, and its double tempo does not, so the bank goes down an octave further, to
+ * 30 BPM, and a tempo adds half the score of its half tempo. The sum is weighted by a prior centered at 120 BPM that
+ * chooses between the octaves that remain. A tempo above 170 BPM (120 times the square root of 2) is further from the
+ * center than its half, and the two score about the same, so music from 170 to 200 BPM is reported at half its tempo,
+ * e.g. 87 for drum and bass at 174. Off-beat onsets do not tell the two apart: the envelope sums every band, so a hi-hat
+ * between two kicks counts as much as the kick of a beat. The best filter gives the tempo and its peak the phase of
+ * the beats. The first beat is the first one of that phase at the first strong onset of the file, or after it, and
+ * the other beats follow at every period.
+ *
+ * The analysis reads the file once as a stream and holds a frame and the histograms, so its memory does not depend on
+ * the length of the file. The result of a file is stored next to it in <file>.bpm and read back while the file is older.
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include<unistd.h>
+#include<pthread.h>
+#include<sys/stat.h>
+#include"utils.h"
+#include"fft.h"
+#include"codec.h"
+#include"flac.h"
+#include"fingerprint.h"
+
+#define BEAT_RATE 11025
+#define BEAT_FFT 512
+#define BEAT_HOP 128
+#define BEAT_BINS (BEAT_FFT / 2)
+#define BEAT_COMPRESSION 1000.0f        // log(1 + C * magnitude) of the magnitude of a full scale sine at 1
+#define BEAT_MEAN_FRAMES 32
+#define BEAT_BLOCK 256                  // envelope values added to the filters at once
+#define BEAT_MIN_BPM 60.0
+#define BEAT_MAX_BPM 200.0
+#define BEAT_RATIO 1.0005               // between the tempos of two filters
+#define BEAT_PRIOR_BPM 120.0
+#define BEAT_PRIOR_OCTAVES 1.0          // standard deviation of the prior, in octaves of tempo
+#define BEAT_HALF_WEIGHT 0.5f           // of the score of the half tempo in the score of a tempo
+#define BEAT_LATENCY 256                // samples from the start of a frame to the onset it reports first
+#define BEAT_OPENING_FRAMES 2048        // envelope values kept from the start of the file to find its first onset, 24 s
+#define BEAT_ONSET_LEVEL 0.5f           // of the mean envelope on the beats, for an onset to count as the first one
+#define BEAT_ONSET_SLACK 0.25           // of the period, that the first beat may come before the first onset
+
+#define BEAT_SIDECAR_MAGIC "soundwave-bpm"
+#define BEAT_SIDECAR_VERSION 2
+
+/**
+ * @brief The tempo of one file
+ */
+struct beat_result {
+    double bpm;                     // 0 when no tempo was found
+    double first;                   // seconds to the first beat, the others follow every 60 / bpm seconds
+    double confidence;              // 0 to 1, how much of the onset strength falls on the beats
+    double duration;                // seconds
+    short cached;                   // read from the sidecar
+};
+
+/**
+ * @brief The streaming analysis of one file
+ */
+struct beat_state {
+    const struct fft_plan* plan;
+    float* scratch;
+    float window[BEAT_FFT];
+    float frame[BEAT_FFT];
+    float re[BEAT_FFT / 2 + 1];
+    float im[BEAT_FFT / 2 + 1];
+    float previous[BEAT_BINS];      // log magnitude of the last frame
+    float flux[BEAT_MEAN_FRAMES];   // the last values of the flux, for their running mean
+    float flux_sum;
+    uint32_t fill;                  // samples in frame
+    uint32_t frames;                // frames analyzed
+    uint64_t samples;               // samples fed
+    float envelope[BEAT_BLOCK];     // values not yet added to the filters
+    float opening[BEAT_OPENING_FRAMES]; // the first values
+    uint32_t pending;
+    uint32_t filters;
+    double* period;                 // beat period of every filter, in frames
+    double* phase;                  // position of the current frame in the period of every filter
+    uint32_t* bins;                 // bins of the histogram of every filter, the period rounded up
+    size_t* start;                  // first bin of every filter in sums and counts
+    float* sums;                    // envelope sums of the bins
+    uint32_t* counts;               // and the frames added to each of them
+};
+
+/**
+ * @brief Returns the number of filters in an octave of tempo, which is also the first filter at BEAT_MIN_BPM
+ */
+uint32_t beat_Octave(){
+    return (uint32_t)lround(log(2.0) / log(BEAT_RATIO));
+}
+
+/**
+ * @brief Returns the number of filters of the bank, from an octave below BEAT_MIN_BPM to BEAT_MAX_BPM
+ */
+uint32_t beat_Filters(){
+    return beat_Octave() + (uint32_t)ceil(log(BEAT_MAX_BPM / BEAT_MIN_BPM) / log(BEAT_RATIO)) + 1;
+}
+
+/**
+ * @brief Returns the tempo of a filter of the bank, possibly a fractional filter
+ */
+double beat_Bpm(double filter){
+    return BEAT_MIN_BPM * pow(BEAT_RATIO, filter - beat_Octave());
+}
+
+void beat_state_Destroy(struct beat_state* st){
+    if(st == NULL) return;
+    free_Aligned(st->scratch);
+    free(st->period);
+    free(st->phase);
+    free(st->bins);
+    free(st->start);
+    free(st->sums);
+    free(st->counts);
+    free(st);
+}
+
+/**
+ * @brief Creates the state of the analysis of a file
+ *
+ * @param plan a plan of BEAT_FFT points, shared between threads
+ *
+ * @returns the state or NULL if memory could not be allocated
+ */
+struct beat_state* beat_state_Create(const struct fft_plan* plan){
+    struct beat_state* st = calloc(1, sizeof(struct beat_state));
+    if(st == NULL) return NULL;
+    st->plan = plan;
+    st->filters = beat_Filters();
+    st->scratch = alloc_Aligned(fft_ScratchSize(plan) * sizeof(float));
+    st->period = malloc(st->filters * sizeof(double));
+    st->phase = calloc(st->filters, sizeof(double));
+    st->bins = malloc(st->filters * sizeof(uint32_t));
+    st->start = malloc(st->filters * sizeof(size_t));
+    if(st->scratch == NULL || st->period == NULL || st->phase == NULL || st->bins == NULL || st->start == NULL){
+        beat_state_Destroy(st);
+        return NULL;
+    }
+    size_t total = 0;
+    for(uint32_t k = 0; k < st->filters; k++){
+        st->period[k] = 60.0 * BEAT_RATE / BEAT_HOP / beat_Bpm(k);
+        st->bins[k] = (uint32_t)ceil(st->period[k]);
+        st->start[k] = total;
+        total += st->bins[k];
+    }
+    st->sums = calloc(total, sizeof(float));
+    st->counts = calloc(total, sizeof(uint32_t));
+    if(st->sums == NULL || st->counts == NULL){
+        beat_state_Destroy(st);
+        return NULL;
+    }
+    // the window is normalized so a full scale sine has a magnitude of 1
+    double gain = 0.0;
+    for(uint32_t i = 0; i < BEAT_FFT; i++){
+        st->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / BEAT_FFT));
+        gain += st->window[i];
+    }
+    for(uint32_t i = 0; i < BEAT_FFT; i++) st->window[i] *= (float)(2.0 / gain);
+    return st;
+}
+
+/**
+ * @brief Adds the pending envelope values to every filter of the bank. A block goes through one filter after the
+ * other, so the histogram of a filter stays in the cache for the whole block instead of the histograms of all the
+ * filters, a few MB, being touched at every frame
+ */
+static void beat_Comb(struct beat_state* st){
+    const float* envelope = st->envelope;
+    const uint32_t pending = st->pending;
+    for(uint32_t k = 0; k < st->filters; k++){
+        const double period = st->period[k];
+        double phase = st->phase[k];
+        float* sums = st->sums + st->start[k];
+        uint32_t* counts = st->counts + st->start[k];
+        // within a period the frames fall in consecutive bins, so a block is a few runs of vector adds
+        for(uint32_t i = 0; i < pending;){
+            const uint32_t bin = (uint32_t)phase;
+            const uint32_t left = (uint32_t)ceil(period - phase);
+            const uint32_t run = left < pending - i ? left : pending - i;
+            float* sum = sums + bin;
+            uint32_t* count = counts + bin;
+            const float* value = envelope + i;
+            for(uint32_t j = 0; j < run; j++){
+                sum[j] += value[j];
+                count[j]++;
+            }
+            i += run;
+            phase += run;
+            if(phase >= period) phase -= period;
+        }
+        st->phase[k] = phase;
+    }
+    st->pending = 0;
+}
+
+static void beat_Analyze(struct beat_state* st){
+    for(uint32_t i = 0; i < BEAT_FFT; i++) st->frame[i] *= st->window[i];
+    fft_Forward(st->plan, st->frame, st->re, st->im, st->scratch);
+    float flux = 0.0f;
+    for(uint32_t k = 0; k < BEAT_BINS; k++){
+        const float magnitude = sqrtf(st->re[k] * st->re[k] + st->im[k] * st->im[k]);
+        const float level = logf(1.0f + BEAT_COMPRESSION * magnitude);
+        if(st->frames > 0 && level > st->previous[k]) flux += level - st->previous[k];
+        st->previous[k] = level;
+    }
+    const uint32_t slot = st->frames % BEAT_MEAN_FRAMES;
+    st->flux_sum += flux - st->flux[slot];
+    st->flux[slot] = flux;
+    const uint32_t filled = st->frames + 1 < BEAT_MEAN_FRAMES ? st->frames + 1 : BEAT_MEAN_FRAMES;
+    const float onset = flux - st->flux_sum / (float)filled;
+    st->envelope[st->pending++] = onset > 0.0f ? onset : 0.0f;
+    if(st->frames < BEAT_OPENING_FRAMES) st->opening[st->frames] = onset > 0.0f ? onset : 0.0f;
+    if(st->pending == BEAT_BLOCK) beat_Comb(st);
+    st->frames++;
+    // the running sum drifts with rounding, so it is summed again once per round of the ring
+    if(slot == BEAT_MEAN_FRAMES - 1){
+        st->flux_sum = 0.0f;
+        for(uint32_t i = 0; i < BEAT_MEAN_FRAMES; i++) st->flux_sum += st->flux[i];
+    }
+}
+
+/**
+ * @brief Adds mono samples at BEAT_RATE
+ */
+void beat_Feed(struct beat_state* st, const float* samples, uint32_t n){
+    st->samples += n;
+    for(uint32_t i = 0; i < n; i++){
+        st->frame[st->fill++] = samples[i];
+        if(st->fill < BEAT_FFT) continue;
+        float saved[BEAT_FFT - BEAT_HOP];
+        memcpy(saved, st->frame + BEAT_HOP, sizeof(saved));
+        beat_Analyze(st);
+        memcpy(st->frame, saved, sizeof(saved));
+        st->fill = BEAT_FFT - BEAT_HOP;
+    }
+}
+
+/**
+ * @brief Returns the mean envelope of every bin of the histogram of a filter, smoothed over the neighbor bins
+ *
+ * @param out receives st->bins[filter] values
+ *
+ * @returns the mean of the smoothed histogram
+ */
+static float beat_Histogram(const struct beat_state* st, uint32_t filter, float* out){
+    const float* sums = st->sums + st->start[filter];
+    const uint32_t* counts = st->counts + st->start[filter];
+    const uint32_t n = st->bins[filter];
+    float total = 0.0f;
+    for(uint32_t p = 0; p < n; p++){
+        float smoothed = 0.0f;
+        for(uint32_t d = 0; d < 3; d++){
+            const uint32_t q = (p + n - 1 + d) % n;
+            if(counts[q] > 0) smoothed += (d == 1 ? 0.5f : 0.25f) * sums[q] / (float)counts[q];
+        }
+        out[p] = smoothed;
+        total += smoothed;
+    }
+    return total / (float)n;
+}
+
+/**
+ * @brief Returns the position of the peak of three values around the middle one, from -0.5 to 0.5
+ */
+static double beat_Parabola(double left, double middle, double right){
+    const double curve = left - 2.0 * middle + right;
+    if(curve >= 0.0) return 0.0;
+    const double offset = 0.5 * (left - right) / curve;
+    return offset < -0.5 ? -0.5 : offset > 0.5 ? 0.5 : offset;
+}
+
+/**
+ * @brief Chooses the tempo and the first beat from the filters
+ *
+ * The peak of the histogram only gives the phase of the beats. A tempo detected at the half of the tempo of the music
+ * has beats on every other onset, and the phase can fall in the silence before the music starts, so the first beat is
+ * moved to the first onset of the file, allowing for a beat a little before it.
+ */
+void beat_Finish(struct beat_state* st, struct beat_result* out){
+    memset(out, 0, sizeof(struct beat_result));
+    beat_Comb(st);
+    out->duration = (double)st->samples / BEAT_RATE;
+    const uint32_t octave = beat_Octave();
+    // two periods of the slowest tempo are needed to compare the phases
+    if(st->frames < 2 * st->period[octave]) return;
+    // the slowest filter has the most bins
+    float* histogram = malloc(st->bins[0] * sizeof(float));
+    float* strength = malloc(st->filters * sizeof(float));
+    if(histogram == NULL || strength == NULL){
+        free(histogram);
+        free(strength);
+        return;
+    }
+    for(uint32_t k = 0; k < st->filters; k++){
+        const float mean = beat_Histogram(st, k, histogram);
+        float peak = 0.0f;
+        for(uint32_t p = 0; p < st->bins[k]; p++) peak = fmaxf(peak, histogram[p]);
+        strength[k] = peak - mean;
+    }
+    // the scores of the tempos are kept in the filters of the octave below, which are no longer needed
+    float* scores = strength;
+    uint32_t best = octave;
+    double best_score = 0.0;
+    for(uint32_t k = octave; k < st->filters; k++){
+        const double octaves = log2(beat_Bpm(k) / BEAT_PRIOR_BPM) / BEAT_PRIOR_OCTAVES;
+        const float score = (float)((strength[k] + BEAT_HALF_WEIGHT * strength[k - octave]) * exp(-0.5 * octaves * octaves));
+        scores[k - octave] = score;
+        if(score > best_score){
+            best = k;
+            best_score = score;
+        }
+    }
+    double filter = best;
+    if(best > octave && best + 1 < st->filters){
+        filter += beat_Parabola(scores[best - 1 - octave], scores[best - octave], scores[best + 1 - octave]);
+    }
+    free(strength);
+    if(best_score <= 0.0){
+        free(histogram);
+        return;
+    }
+
+    const uint32_t n = st->bins[best];
+    const float mean = beat_Histogram(st, best, histogram);
+    uint32_t top = 0;
+    for(uint32_t p = 1; p < n; p++){
+        if(histogram[p] > histogram[top]) top = p;
+    }
+    const double offset = beat_Parabola(histogram[(top + n - 1) % n], histogram[top], histogram[(top + 1) % n]);
+    const float peak = histogram[top];
+    free(histogram);
+    const double period = st->period[best];
+    double first = top + 0.5 + offset;
+    // the frame of an onset is the frame that first includes it, which starts before it
+    first += (double)BEAT_LATENCY / BEAT_HOP;
+    while(first >= period) first -= period;
+    const uint32_t opening = st->frames < BEAT_OPENING_FRAMES ? st->frames : BEAT_OPENING_FRAMES;
+    for(uint32_t f = 0; f < opening; f++){
+        if(st->opening[f] < BEAT_ONSET_LEVEL * peak) continue;
+        const double onset = f + 0.5 + (double)BEAT_LATENCY / BEAT_HOP;
+        while(first < onset - BEAT_ONSET_SLACK * period) first += period;
+        break;
+    }
+    out->bpm = beat_Bpm(filter);
+    out->first = first * BEAT_HOP / BEAT_RATE;
+    out->confidence = 1.0 - mean / peak;
+}
+
+/**
+ * @brief Detects the tempo of the WAV file of a stream, PCM or float samples of any size and a header of any chunks
+ *
+ * @returns 0 on success, -1 with an error reported
+ */
+short beat_Stream(FILE* in, const struct fft_plan* plan, struct beat_result* out){
+    memset(out, 0, sizeof(struct beat_result));
+    struct codec_mono mono;
+    if(codec_MonoOpen(in, &mono, BEAT_RATE) != 0) return -1;
+    struct beat_state* st = beat_state_Create(plan);
+    if(st == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        codec_MonoClose(&mono);
+        return -1;
+    }
+    const float* samples;
+    for(uint32_t n = codec_MonoRead(in, &mono, &samples); n > 0; n = codec_MonoRead(in, &mono, &samples)){
+        beat_Feed(st, samples, n);
+    }
+    beat_Finish(st, out);
+    beat_state_Destroy(st);
+    codec_MonoClose(&mono);
+    return 0;
+}
+
+/**
+ * @brief Returns the path of the sidecar of a file. It must be released with free()
+ */
+char* beat_SidecarPath(const char* path){
+    size_t length = strlen(path) + sizeof(".bpm");
+    char* sidecar = malloc(length);
+    if(sidecar != NULL) snprintf(sidecar, length, "%s.bpm", path);
+    return sidecar;
+}
+
+/**
+ * @brief Reads the result of a file from its sidecar, if the sidecar is not older than the file
+ *
+ * @returns 1 if the result was read, 0 otherwise
+ */
+short beat_SidecarRead(const char* path, struct beat_result* out){
+    char* sidecar = beat_SidecarPath(path);
+    struct stat file_stat, sidecar_stat;
+    if(sidecar == NULL || stat(path, &file_stat) != 0 || stat(sidecar, &sidecar_stat) != 0 ||
+       sidecar_stat.st_mtim.tv_sec < file_stat.st_mtim.tv_sec ||
+       (sidecar_stat.st_mtim.tv_sec == file_stat.st_mtim.tv_sec && sidecar_stat.st_mtim.tv_nsec < file_stat.st_mtim.tv_nsec)){
+        free(sidecar);
+        return 0;
+    }
+    FILE* file = fopen(sidecar, "r");
+    free(sidecar);
+    if(file == NULL) return 0;
+    char magic[32];
+    int version = 0;
+    struct beat_result r;
+    memset(&r, 0, sizeof(r));
+    const int fields = fscanf(file, "%31s %d %lf %lf %lf %lf", magic, &version, &r.bpm, &r.first, &r.confidence, &r.duration);
+    fclose(file);
+    if(fields != 6 || strcmp(magic, BEAT_SIDECAR_MAGIC) != 0 || version != BEAT_SIDECAR_VERSION) return 0;
+    r.cached = 1;
+    *out = r;
+    return 1;
+}
+
+/**
+ * @brief Stores the result of a file in its sidecar. The sidecar is written under another name and renamed, so a
+ * reader never sees half of it. A file in a directory that cannot be written simply has no sidecar
+ *
+ * The old sidecar is removed before the rename: ext4 flushes the data of a file renamed over another one to the disk,
+ * tens of milliseconds per file, and a reader that finds no sidecar only analyzes the file again.
+ */
+void beat_SidecarWrite(const char* path, const struct beat_result* r){
+    char* sidecar = beat_SidecarPath(path);
+    if(sidecar == NULL) return;
+    size_t length = strlen(sidecar) + sizeof(".tmp");
+    char* temporary = malloc(length);
+    FILE* file = NULL;
+    if(temporary != NULL){
+        snprintf(temporary, length, "%s.tmp", sidecar);
+        file = fopen(temporary, "w");
+    }
+    if(file != NULL){
+        int written = fprintf(file, "%s %d %.6f %.6f %.6f %.6f\n", BEAT_SIDECAR_MAGIC, BEAT_SIDECAR_VERSION,
+                              r->bpm, r->first, r->confidence, r->duration);
+        const short complete = fclose(file) == 0 && written >= 0;
+        if(complete) remove(sidecar);
+        if(!complete || rename(temporary, sidecar) != 0) remove(temporary);
+    }
+    free(temporary);
+    free(sidecar);
+}
+
+/**
+ * @brief Detects the tempo of a file of any format the commands read, from its sidecar when it has a valid one
+ *
+ * @param refresh analyze the file even if it has a sidecar
+ *
+ * @returns 0 on success, -1 with an error reported
+ */
+short beat_File(const char* path, const struct fft_plan* plan, short refresh, struct beat_result* out){
+    if(!refresh && beat_SidecarRead(path, out)) return 0;
+    FILE* file = fopen(path, "rb");
+    if(file == NULL){
+        fprintf(stderr, "Error! unable to open %s\n", path);
+        return -1;
+    }
+    struct codec_stream stream;
+    FILE* in = flac_Open(file, &stream);
+    short status = in != NULL ? beat_Stream(in, plan, out) : -1;
+    if(in != NULL && codec_StreamClose(&stream) == 1) status = -1;
+    fclose(file);
+    if(status != 0){
+        fprintf(stderr, "Error! unable to detect the tempo of %s\n", path);
+        return -1;
+    }
+    beat_SidecarWrite(path, out);
+    return 0;
+}
+
+struct beat_job {
+    char* const* paths;
+    uint32_t count;
+    uint32_t* next;                 // the next file to take, shared by the jobs
+    const struct fft_plan* plan;
+    short refresh;
+    struct beat_result* results;
+    short* failed;
+    short threaded;
+};
+
+/**
+ * @brief Thread entry point that analyzes files until none are left
+ */
+void* beat_Worker(void* arg){
+    struct beat_job* job = arg;
+    for(uint32_t i = __atomic_fetch_add(job->next, 1, __ATOMIC_RELAXED); i < job->count;
+        i = __atomic_fetch_add(job->next, 1, __ATOMIC_RELAXED)){
+        job->failed[i] = beat_File(job->paths[i], job->plan, job->refresh, &job->results[i]) != 0;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Detects the tempo of files on several threads, each thread taking the next file when it is done with one
+ *
+ * @param results receives the result of every file
+ * @param failed set to 1 for the files that could not be analyzed
+ *
+ * @returns 0 on success, -1 if the threads could not be set up
+ */
+short beat_Files(char* const* paths, uint32_t count, int threads, short refresh, struct beat_result* results, short* failed){
+    struct fft_plan* plan = fft_plan_Create(BEAT_FFT);
+    if(threads < 1) threads = 1;
+    if((uint32_t)threads > count) threads = count > 0 ? (int)count : 1;
+    pthread_t* ids = malloc(threads * sizeof(pthread_t));
+    struct beat_job* jobs = malloc(threads * sizeof(struct beat_job));
+    if(plan == NULL || ids == NULL || jobs == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        fft_plan_Destroy(plan);
+        free(ids);
+        free(jobs);
+        return -1;
+    }
+    uint32_t next = 0;
+    for(int t = 0; t < threads; t++){
+        jobs[t] = (struct beat_job){paths, count, &next, plan, refresh, results, failed, 0};
+        if(t < threads - 1 && pthread_create(&ids[t], NULL, beat_Worker, &jobs[t]) == 0){
+            jobs[t].threaded = 1;
+        } else{
+            beat_Worker(&jobs[t]);
+        }
+    }
+    for(int t = 0; t < threads; t++){
+        if(jobs[t].threaded) pthread_join(ids[t], NULL);
+    }
+    fft_plan_Destroy(plan);
+    free(ids);
+    free(jobs);
+    return 0;
+}
@@ -0,0 +1,348 @@
+/**
+ * @file bench.c
+ * @author Rafael Diolatzis
+ * @brief Benchmarks of the soundwave processing engines
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2025
+ * 
+ */
+
+#include"soundman.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<inttypes.h>
+#include<time.h>
+#include<dirent.h>
+#include<fcntl.h>
+#include<sys/stat.h>
+#include<sys/wait.h>
+
+/**
+ * @brief Returns a monotonic timestamp in seconds
+ */
+double bench_Now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Fills a buffer with uniform noise in [-0.5, 0.5)
+ */
+void bench_Noise(float* buffer, uint32_t count, uint32_t seed){
+    for(uint32_t i = 0; i < count; i++){
+        seed = seed * 1664525u + 1013904223u;
+        buffer[i] = (seed >> 8) * (1.0f / 16777216.0f) - 0.5f;
+    }
+}
+
+/**
+ * @brief Measures the cost per output sample of the partitioned convolution for growing impulse responses
+ * 
+ * Direct convolution is measured on the shorter impulse responses for comparison, its cost grows linearly with the length.
+ */
+void bench_Convolve(){
+    const uint32_t sample_rate = 48000;
+    const uint32_t lengths[] = {1024, 4096, 16384, 65536, 262144, 524288};
+    const uint32_t input_frames = 10 * sample_rate;
+
+    printf("convolve: cost per output sample of one channel (%" PRIu32 " input frames)\n", input_frames);
+    printf("  %-12s%-10s%-12s%-16s%-16s\n", "ir length", "block", "partitions", "ns/sample", "direct ns/sample");
+
+    float* input = alloc_Aligned((size_t)input_frames * sizeof(float));
+    float* output = alloc_Aligned(16384 * sizeof(float));
+    float* ir = alloc_Aligned(lengths[sizeof(lengths) / sizeof(lengths[0]) - 1] * sizeof(float));
+    if(input == NULL || output == NULL || ir == NULL){
+        fprintf(stderr, "Error: unable to allocate memory\n");
+        return;
+    }
+    bench_Noise(input, input_frames, 1);
+    bench_Noise(ir, lengths[sizeof(lengths) / sizeof(lengths[0]) - 1], 2);
+
+    for(uint32_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++){
+        uint32_t length = lengths[l];
+        uint32_t block = conv_DefaultBlock(length);
+        struct conv_ir* partitioned = conv_ir_Create(ir, length, block, 1.0f);
+        struct conv_state* state = partitioned ? conv_state_Create(partitioned) : NULL;
+        if(state == NULL){
+            fprintf(stderr, "Error: unable to allocate memory\n");
+            conv_ir_Destroy(partitioned);
+            break;
+        }
+
+        double begin = bench_Now();
+        for(uint32_t i = 0; i + block <= input_frames; i += block){
+            conv_state_Process(state, input + i, output);
+        }
+        double elapsed = bench_Now() - begin;
+        double ns = elapsed * 1e9 / (input_frames / block * block);
+
+        char direct[32] = "-";
+        if(length <= 16384){
+            // a few thousand output samples are enough to measure a cost that does not depend on the position
+            const uint32_t count = 4096;
+            volatile float sink = 0.0f;
+            begin = bench_Now();
+            for(uint32_t n = length; n < length + count; n++){
+                float acc = 0.0f;
+                for(uint32_t k = 0; k < length; k++){
+                    acc += input[n - k] * ir[k];
+                }
+                sink += acc;
+            }
+            snprintf(direct, sizeof(direct), "%.1f", (bench_Now() - begin) * 1e9 / count);
+        }
+
+        printf("  %-12" PRIu32 "%-10" PRIu32 "%-12" PRIu32 "%-16.1f%-16s\n", length, block, partitioned->partitions, ns, direct);
+        conv_state_Destroy(state);
+        conv_ir_Destroy(partitioned);
+    }
+
+    free(input);
+    free(output);
+    free(ir);
+}
+
+/**
+ * @brief Measures the throughput of the convert command kernels for every pair of sample formats
+ * 
+ * Every pair runs the same steps as the command: decode to float, TPDF dither when the bit depth is reduced, encode.
+ */
+void bench_Convert(){
+    const char* names[] = {"8", "16", "24", "32", "32f"};
+    const uint16_t bits[] = {8, 16, 24, 32, 32};
+    const uint16_t formats[] = {WAVE_FORMAT_PCM, WAVE_FORMAT_PCM, WAVE_FORMAT_PCM, WAVE_FORMAT_PCM, WAVE_FORMAT_IEEE_FLOAT};
+    const uint32_t samples = STREAM_BLOCK_FRAMES * 2;
+    const uint32_t rounds = 2000;
+
+    printf("convert: throughput per conversion pair (%" PRIu32 " sample blocks, stereo)\n", samples);
+    printf("  %-8s%-8s%-10s%-16s%-16s\n", "from", "to", "dither", "Msamples/s", "input MB/s");
+
+    float* reference = alloc_Aligned(samples * sizeof(float));
+    float* work = alloc_Aligned(samples * sizeof(float));
+    float* noise = alloc_Aligned(samples * sizeof(float));
+    char* in = malloc(samples * 4);
+    char* out = malloc(samples * 4);
+    if(reference == NULL || work == NULL || noise == NULL || in == NULL || out == NULL){
+        fprintf(stderr, "Error: unable to allocate memory\n");
+        return;
+    }
+    bench_Noise(reference, samples, 3);
+
+    for(uint32_t from = 0; from < 5; from++){
+        pcm_FromFloat(reference, in, samples, formats[from], bits[from]);
+        uint16_t precision = formats[from] == WAVE_FORMAT_IEEE_FLOAT ? 24 : bits[from];
+        for(uint32_t to = 0; to < 5; to++){
+            if(from == to) continue;
+            short dither = formats[to] == WAVE_FORMAT_PCM && bits[to] < precision;
+            struct dither_state state;
+            dither_Init(&state, 1, 0);
+
+            double begin = bench_Now();
+            for(uint32_t r = 0; r < rounds; r++){
+                pcm_ToFloat(in, work, samples, formats[from], bits[from]);
+                if(dither) dither_Apply(&state, work, noise, samples / 2, 2, bits[to]);
+                pcm_FromFloat(work, out, samples, formats[to], bits[to]);
+            }
+            double elapsed = bench_Now() - begin;
+            double rate = (double)samples * rounds / elapsed;
+            printf("  %-8s%-8s%-10s%-16.1f%-16.1f\n", names[from], names[to], dither ? "tpdf" : "none",
+                   rate / 1e6, rate * (bits[from] / 8) / 1e6);
+        }
+    }
+
+    free(reference);
+    free(work);
+    free(noise);
+    free(in);
+    free(out);
+}
+
+/**
+ * @brief Runs the soundwave program with the given arguments and waits for it
+ * 
+ * @param in the file to use as STDIN, NULL to keep the one of the benchmark
+ * @param out the file to use as STDOUT, overwritten in place, NULL to keep the one of the benchmark
+ * 
+ * @returns the exit status of the program, or -1 if it could not be started
+ */
+int bench_Run(char* const args[], const char* in, const char* out){
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid < 0) return -1;
+    if(pid == 0){
+        if(in != NULL && freopen(in, "rb", stdin) == NULL) _exit(127);
+        // not truncated: truncating a file that is being written back makes the file system flush it first
+        int fd = out != NULL ? open(out, O_WRONLY | O_CREAT, 0644) : -1;
+        if(out != NULL && (fd < 0 || dup2(fd, STDOUT_FILENO) < 0)) _exit(127);
+        execv(args[0], args);
+        _exit(127);
+    }
+    int status;
+    if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) return -1;
+    return WEXITSTATUS(status);
+}
+
+/**
+ * @brief Removes the files of a directory and the directory
+ */
+void bench_RemoveDir(const char* path){
+    DIR* dir = opendir(path);
+    if(dir != NULL){
+        char name[4096];
+        struct dirent* entry;
+        while((entry = readdir(dir)) != NULL){
+            if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            snprintf(name, sizeof(name), "%s/%s", path, entry->d_name);
+            unlink(name);
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+}
+
+/**
+ * @brief Measures the batch command on a corpus of small files with every I/O backend
+ * 
+ * The corpus is written to a temporary directory. By default it is in the page cache for every run, so the numbers
+ * compare the system call and scheduling overhead of the backends rather than the speed of the disk. With cold set
+ * the page cache is dropped before every run, which needs root.
+ * 
+ * @param count the number of files of the corpus
+ * @param cold drop the page cache before every run
+ */
+void bench_Batch(uint32_t count, short cold){
+    const uint32_t frames = 2048;
+    char root[] = "/tmp/soundwave-batch-XXXXXX";
+    if(mkdtemp(root) == NULL){
+        fprintf(stderr, "Error: unable to create a temporary directory\n");
+        return;
+    }
+    char in[sizeof(root) + 8], out[sizeof(root) + 8], name[sizeof(root) + 32];
+    snprintf(in, sizeof(in), "%s/in", root);
+    snprintf(out, sizeof(out), "%s/out", root);
+    mkdir(in, 0755);
+    mkdir(out, 0755);
+
+    struct wav_header header = {SIZE_OF_WAVE_HEADER + frames * 2, 16, WAVE_FORMAT_PCM, 1, 48000, 96000, 2, 16, frames * 2};
+    int16_t samples[2048];
+    uint32_t seed = 1;
+    for(uint32_t i = 0; i < frames; i++){
+        seed = seed * 1664525u + 1013904223u;
+        samples[i] = (int16_t)(seed >> 18);
+    }
+    uint32_t created = 0;
+    for(; created < count; created++){
+        snprintf(name, sizeof(name), "%s/%07" PRIu32 ".wav", in, created);
+        FILE* file = fopen(name, "wb");
+        if(file == NULL) break;
+        fwrite_WavHeader(file, &header);
+        fwrite(samples, sizeof(int16_t), frames, file);
+        fclose(file);
+    }
+
+    printf("batch: volume 0.5 on %" PRIu32 " files of %" PRIu32 " bytes%s\n", created, header.size_of_file + 8, cold ? ", cold page cache" : "");
+    const char* backends[] = {"naive", "threads", "uring"};
+    for(uint32_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++){
+        // every backend starts from an empty output directory
+        bench_RemoveDir(out);
+        mkdir(out, 0755);
+        if(cold){
+            sync();
+            FILE* drop = fopen("/proc/sys/vm/drop_caches", "w");
+            short dropped = drop != NULL && fputs("3\n", drop) != EOF;
+            if(drop != NULL && fclose(drop) != 0) dropped = 0;
+            if(!dropped){
+                fprintf(stderr, "Error: unable to drop the page cache, the cold runs need root\n");
+            }
+        }
+        char* const args[] = {"./soundwave", "batch", "--in", in, "--out", out, "--io", (char*)backends[i], "volume", "0.5", NULL};
+        if(bench_Run(args, NULL, NULL) != 0) fprintf(stderr, "Error: ./soundwave batch --io %s failed, run make first\n", backends[i]);
+    }
+
+    bench_RemoveDir(in);
+    bench_RemoveDir(out);
+    rmdir(root);
+}
+
+/**
+ * @brief Measures how the volume command scales with the number of threads on one large file
+ * 
+ * The input and output are regular files, so the command processes ranges of the data chunk on its threads. Both
+ * stay in the page cache, and the output is overwritten in place by every run.
+ * 
+ * @param megabytes the size of the data chunk of the file
+ */
+void bench_Chunked(uint32_t megabytes){
+    if(megabytes < 1 || megabytes > 4000) megabytes = 512; // the data chunk of a WAV file is below 4GB
+    char in[] = "/tmp/soundwave-chunked-in-XXXXXX", out[] = "/tmp/soundwave-chunked-out-XXXXXX";
+    int in_fd = mkstemp(in), out_fd = mkstemp(out);
+    if(in_fd < 0 || out_fd < 0){
+        fprintf(stderr, "Error: unable to create a temporary file\n");
+        if(in_fd >= 0){ close(in_fd); unlink(in); }
+        if(out_fd >= 0){ close(out_fd); unlink(out); }
+        return;
+    }
+    close(out_fd);
+
+    const uint32_t frames = (uint32_t)((uint64_t)megabytes * (1 << 20) / 4);
+    struct wav_header header = {SIZE_OF_WAVE_HEADER + frames * 4, 16, WAVE_FORMAT_PCM, 2, 48000, 192000, 4, 16, frames * 4};
+    FILE* file = fdopen(in_fd, "wb");
+    fwrite_WavHeader(file, &header);
+    int16_t samples[8192];
+    uint32_t seed = 1;
+    for(uint32_t i = 0; i < 8192; i++){
+        seed = seed * 1664525u + 1013904223u;
+        samples[i] = (int16_t)(seed >> 18);
+    }
+    for(uint32_t done = 0; done < frames; done += 4096){
+        fwrite(samples, 4, frames - done < 4096 ? frames - done : 4096, file);
+    }
+    fclose(file);
+
+    printf("chunked: volume 0.5 on a %" PRIu32 " MB stereo file\n", megabytes);
+    printf("%8s %10s %10s %10s\n", "threads", "seconds", "GB/s", "speedup");
+    double base = 0;
+    const char* counts[] = {"1", "2", "4", "8", "16", "32"};
+    for(uint32_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++){
+        char* const args[] = {"./soundwave", "volume", "0.5", "--threads", (char*)counts[i], NULL};
+        // the first run warms the page cache and the output file, the second one is measured
+        double best = 0;
+        for(int run = 0; run < 2; run++){
+            double start = bench_Now();
+            if(bench_Run(args, in, out) != 0){
+                fprintf(stderr, "Error: ./soundwave volume failed, run make first\n");
+                unlink(in);
+                unlink(out);
+                return;
+            }
+            double elapsed = bench_Now() - start;
+            best = run == 0 || elapsed < best ? elapsed : best;
+        }
+        if(i == 0) base = best;
+        printf("%8s %10.3f %10.2f %9.2fx\n", counts[i], best, header.data_segment_size / best / 1e9, base / best);
+    }
+    unlink(in);
+    unlink(out);
+}
+
+int main(int argc, char* argv[]){
+    const char* only = argc > 1 ? argv[1] : NULL;
+
+    if(only == NULL || strcmp(only, "convolve") == 0){
+        bench_Convolve();
+    }
+    if(only == NULL || strcmp(only, "convert") == 0){
+        bench_Convert();
+    }
+    if(only == NULL || strcmp(only, "batch") == 0){
+        bench_Batch(argc > 2 ? (uint32_t)atoi(argv[2]) : 100000, argc > 3 && strcmp(argv[3], "cold") == 0);
+    }
+    if(only == NULL || strcmp(only, "chunked") == 0){
+        bench_Chunked(argc > 2 ? (uint32_t)atoi(argv[2]) : 512);
+    }
+    return 0;
+}
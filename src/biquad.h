@@ -0,0 +1,433 @@
+/**
+ * @file biquad.h
+ * @author Rafael Diolatzis
+ * @brief Cascaded biquad filters that process interleaved blocks of samples
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Every section is a transposed direct form II biquad. The channels of a frame are mapped to the lanes of a
+ * 4 wide SSE register, so up to four channels are filtered with one set of instructions. Files with more than
+ * four channels are processed as several groups of lanes. A mono stream would use one lane only, so its sections
+ * are mapped to the lanes instead and run as a pipeline, each lane a sample behind the one before. The filter state
+ * lives in the chain, so a stream can be fed block by block and the output is identical to filtering the whole file
+ * at once.
+ */
+
+#pragma once
+
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include"utils.h"
+
+#if defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+#define BIQUAD_LANES 4
+
+#define BIQUAD_LOWPASS 0
+#define BIQUAD_HIGHPASS 1
+#define BIQUAD_BANDPASS 2
+#define BIQUAD_NOTCH 3
+#define BIQUAD_LOWSHELF 4
+#define BIQUAD_HIGHSHELF 5
+#define BIQUAD_PEAKING 6
+
+/**
+ * @brief The coefficients of one section, repeated for every lane. The feedback coefficients are stored negated
+ */
+struct biquad_section {
+    float b0[BIQUAD_LANES];
+    float b1[BIQUAD_LANES];
+    float b2[BIQUAD_LANES];
+    float na1[BIQUAD_LANES];
+    float na2[BIQUAD_LANES];
+};
+
+/**
+ * @brief The two delay elements of one section for one group of lanes
+ */
+struct biquad_state {
+    float z1[BIQUAD_LANES];
+    float z2[BIQUAD_LANES];
+};
+
+/**
+ * @brief A cascade of biquad sections applied to every channel of a stream
+ */
+struct biquad_chain {
+    uint32_t channels;
+    uint32_t groups;                    // number of groups of BIQUAD_LANES channels
+    uint32_t sections;
+    struct biquad_section* coeffs;      // [sections]
+    struct biquad_state* state;         // [groups][sections]
+};
+
+/**
+ * @brief The user facing description of one section
+ */
+struct biquad_spec {
+    int type;
+    double frequency;
+    double q;
+    double gain_db;
+};
+
+/**
+ * @brief Parses the name of a filter type
+ *
+ * @returns one of the BIQUAD_* values or -1 if the name is unknown
+ */
+int biquad_ParseType(const char* name){
+    if(strcmp(name, "lowpass") == 0) return BIQUAD_LOWPASS;
+    if(strcmp(name, "highpass") == 0) return BIQUAD_HIGHPASS;
+    if(strcmp(name, "bandpass") == 0) return BIQUAD_BANDPASS;
+    if(strcmp(name, "notch") == 0) return BIQUAD_NOTCH;
+    if(strcmp(name, "lowshelf") == 0) return BIQUAD_LOWSHELF;
+    if(strcmp(name, "highshelf") == 0) return BIQUAD_HIGHSHELF;
+    if(strcmp(name, "peaking") == 0) return BIQUAD_PEAKING;
+    return -1;
+}
+
+/**
+ * @brief Parses a section written as <type>:<frequency>[:<q>[:<gain dB>]], e.g. "highpass:80" or "peaking:1000:1.4:-3"
+ *
+ * @param text the text to parse
+ * @param spec receives the section. Q defaults to 0.7071 and gain to 0 dB
+ *
+ * @returns 0 on success or -1 if the text is not a valid section
+ */
+int biquad_ParseSpec(const char* text, struct biquad_spec* spec){
+    char name[16];
+    size_t length = strcspn(text, ":");
+    if(length == 0 || length >= sizeof(name) || text[length] != ':') return -1;
+    memcpy(name, text, length);
+    name[length] = '\0';
+
+    spec->type = biquad_ParseType(name);
+    if(spec->type < 0) return -1;
+    spec->q = M_SQRT1_2;
+    spec->gain_db = 0.0;
+
+    char* end;
+    const char* ptr = text + length + 1;
+    spec->frequency = strtod(ptr, &end);
+    if(end == ptr) return -1;
+    if(*end == ':'){
+        ptr = end + 1;
+        spec->q = strtod(ptr, &end);
+        if(end == ptr) return -1;
+        if(*end == ':'){
+            ptr = end + 1;
+            spec->gain_db = strtod(ptr, &end);
+            if(end == ptr) return -1;
+        }
+    }
+    return *end == '\0' ? 0 : -1;
+}
+
+/**
+ * @brief Computes the normalized coefficients of a biquad with the formulas of the Audio EQ Cookbook (R. Bristow-Johnson)
+ *
+ * @param type one of the BIQUAD_* values
+ * @param frequency the cutoff, center or corner frequency in Hz
+ * @param q the quality factor. For shelves it is used as the shelf slope
+ * @param gain_db the gain of peaking and shelf filters in dB. Ignored by the other types
+ * @param sample_rate the sample rate in Hz
+ * @param c receives b0, b1, b2, a1, a2 (a0 is normalized to 1)
+ *
+ * @returns 0 on success or -1 if the parameters are out of range
+ */
+int biquad_Design(int type, double frequency, double q, double gain_db, double sample_rate, double c[5]){
+    if(sample_rate <= 0 || frequency <= 0 || frequency >= sample_rate / 2 || q <= 0) return -1;
+
+    double A = pow(10.0, gain_db / 40.0);
+    double w0 = 2.0 * M_PI * frequency / sample_rate;
+    double cw = cos(w0);
+    double sw = sin(w0);
+    double alpha = sw / (2.0 * q);
+    double b0, b1, b2, a0, a1, a2;
+
+    switch(type){
+        case BIQUAD_LOWPASS:
+            b0 = (1 - cw) / 2; b1 = 1 - cw; b2 = (1 - cw) / 2;
+            a0 = 1 + alpha; a1 = -2 * cw; a2 = 1 - alpha;
+            break;
+        case BIQUAD_HIGHPASS:
+            b0 = (1 + cw) / 2; b1 = -(1 + cw); b2 = (1 + cw) / 2;
+            a0 = 1 + alpha; a1 = -2 * cw; a2 = 1 - alpha;
+            break;
+        case BIQUAD_BANDPASS:
+            b0 = alpha; b1 = 0; b2 = -alpha;
+            a0 = 1 + alpha; a1 = -2 * cw; a2 = 1 - alpha;
+            break;
+        case BIQUAD_NOTCH:
+            b0 = 1; b1 = -2 * cw; b2 = 1;
+            a0 = 1 + alpha; a1 = -2 * cw; a2 = 1 - alpha;
+            break;
+        case BIQUAD_PEAKING:
+            b0 = 1 + alpha * A; b1 = -2 * cw; b2 = 1 - alpha * A;
+            a0 = 1 + alpha / A; a1 = -2 * cw; a2 = 1 - alpha / A;
+            break;
+        case BIQUAD_LOWSHELF:
+        case BIQUAD_HIGHSHELF: {
+            double shelf_alpha = sw / 2 * sqrt((A + 1 / A) * (1 / q - 1) + 2);
+            double k = 2 * sqrt(A) * shelf_alpha;
+            if(type == BIQUAD_LOWSHELF){
+                b0 = A * ((A + 1) - (A - 1) * cw + k);
+                b1 = 2 * A * ((A - 1) - (A + 1) * cw);
+                b2 = A * ((A + 1) - (A - 1) * cw - k);
+                a0 = (A + 1) + (A - 1) * cw + k;
+                a1 = -2 * ((A - 1) + (A + 1) * cw);
+                a2 = (A + 1) + (A - 1) * cw - k;
+            } else{
+                b0 = A * ((A + 1) + (A - 1) * cw + k);
+                b1 = -2 * A * ((A - 1) + (A + 1) * cw);
+                b2 = A * ((A + 1) + (A - 1) * cw - k);
+                a0 = (A + 1) - (A - 1) * cw + k;
+                a1 = 2 * ((A - 1) - (A + 1) * cw);
+                a2 = (A + 1) - (A - 1) * cw - k;
+            }
+            break;
+        }
+        default:
+            return -1;
+    }
+
+    c[0] = b0 / a0;
+    c[1] = b1 / a0;
+    c[2] = b2 / a0;
+    c[3] = a1 / a0;
+    c[4] = a2 / a0;
+    return 0;
+}
+
+/**
+ * @brief Sets the coefficients of a section for all channels
+ *
+ * @param chain the chain
+ * @param section the index of the section
+ * @param c b0, b1, b2, a1, a2 as produced by biquad_Design
+ */
+void biquad_chain_SetSection(struct biquad_chain* chain, uint32_t section, const double c[5]){
+    for(uint32_t lane = 0; lane < BIQUAD_LANES; lane++){
+        chain->coeffs[section].b0[lane] = (float)c[0];
+        chain->coeffs[section].b1[lane] = (float)c[1];
+        chain->coeffs[section].b2[lane] = (float)c[2];
+        chain->coeffs[section].na1[lane] = (float)-c[3];
+        chain->coeffs[section].na2[lane] = (float)-c[4];
+    }
+}
+
+/**
+ * @brief Creates a chain of pass-through sections with a zeroed state
+ *
+ * @param channels the number of interleaved channels of the stream
+ * @param sections the number of cascaded sections
+ *
+ * @returns the chain or NULL on failure
+ */
+struct biquad_chain* biquad_chain_Create(uint32_t channels, uint32_t sections){
+    if(channels == 0 || sections == 0) return NULL;
+
+    struct biquad_chain* chain = malloc(sizeof(struct biquad_chain));
+    if(chain == NULL) return NULL;
+
+    chain->channels = channels;
+    chain->groups = (channels + BIQUAD_LANES - 1) / BIQUAD_LANES;
+    chain->sections = sections;
+    chain->coeffs = alloc_Aligned(sections * sizeof(struct biquad_section));
+    chain->state = alloc_Aligned(chain->groups * sections * sizeof(struct biquad_state));
+    if(chain->coeffs == NULL || chain->state == NULL){
+        free_Aligned(chain->coeffs);
+        free_Aligned(chain->state);
+        free(chain);
+        return NULL;
+    }
+
+    const double identity[5] = {1, 0, 0, 0, 0};
+    for(uint32_t s = 0; s < sections; s++){
+        biquad_chain_SetSection(chain, s, identity);
+    }
+    memset(chain->state, 0, chain->groups * sections * sizeof(struct biquad_state));
+    return chain;
+}
+
+/**
+ * @brief Releases a chain created with biquad_chain_Create
+ */
+void biquad_chain_Destroy(struct biquad_chain* chain){
+    if(chain == NULL) return;
+    free_Aligned(chain->coeffs);
+    free_Aligned(chain->state);
+    free(chain);
+}
+
+/**
+ * @brief Clears the delay elements of every section, as if the stream started again
+ */
+void biquad_chain_Reset(struct biquad_chain* chain){
+    memset(chain->state, 0, chain->groups * chain->sections * sizeof(struct biquad_state));
+}
+
+/**
+ * @brief Filters one group of up to BIQUAD_LANES channels of an interleaved block in place
+ *
+ * @param chain the chain
+ * @param group the index of the group of lanes
+ * @param data the interleaved samples of the block
+ * @param frames the number of frames in the block
+ */
+void biquad_chain_ProcessGroup(struct biquad_chain* chain, uint32_t group, float* data, uint32_t frames){
+    const uint32_t channels = chain->channels;
+    const uint32_t first = group * BIQUAD_LANES;
+    const uint32_t lanes = channels - first < BIQUAD_LANES ? channels - first : BIQUAD_LANES;
+    struct biquad_state* state = chain->state + group * chain->sections;
+
+#if defined(__SSE2__)
+    __m128 z1[chain->sections];
+    __m128 z2[chain->sections];
+    for(uint32_t s = 0; s < chain->sections; s++){
+        z1[s] = _mm_loadu_ps(state[s].z1);
+        z2[s] = _mm_loadu_ps(state[s].z2);
+    }
+
+    float lane_in[BIQUAD_LANES] = {0};
+    float lane_out[BIQUAD_LANES];
+    for(uint32_t i = 0; i < frames; i++){
+        float* frame = data + (size_t)i * channels + first;
+        __m128 x;
+        if(lanes == BIQUAD_LANES){
+            x = _mm_loadu_ps(frame);
+        } else{
+            for(uint32_t lane = 0; lane < lanes; lane++) lane_in[lane] = frame[lane];
+            x = _mm_loadu_ps(lane_in);
+        }
+
+        for(uint32_t s = 0; s < chain->sections; s++){
+            const struct biquad_section* c = &chain->coeffs[s];
+            __m128 y = _mm_add_ps(_mm_mul_ps(_mm_load_ps(c->b0), x), z1[s]);
+            z1[s] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(c->b1), x), _mm_mul_ps(_mm_load_ps(c->na1), y)), z2[s]);
+            z2[s] = _mm_add_ps(_mm_mul_ps(_mm_load_ps(c->b2), x), _mm_mul_ps(_mm_load_ps(c->na2), y));
+            x = y;
+        }
+
+        if(lanes == BIQUAD_LANES){
+            _mm_storeu_ps(frame, x);
+        } else{
+            _mm_storeu_ps(lane_out, x);
+            for(uint32_t lane = 0; lane < lanes; lane++) frame[lane] = lane_out[lane];
+        }
+    }
+
+    for(uint32_t s = 0; s < chain->sections; s++){
+        _mm_storeu_ps(state[s].z1, z1[s]);
+        _mm_storeu_ps(state[s].z2, z2[s]);
+    }
+#else
+    for(uint32_t i = 0; i < frames; i++){
+        float* frame = data + (size_t)i * channels + first;
+        for(uint32_t lane = 0; lane < lanes; lane++){
+            float x = frame[lane];
+            for(uint32_t s = 0; s < chain->sections; s++){
+                const struct biquad_section* c = &chain->coeffs[s];
+                float y = c->b0[lane] * x + state[s].z1[lane];
+                state[s].z1[lane] = c->b1[lane] * x + c->na1[lane] * y + state[s].z2[lane];
+                state[s].z2[lane] = c->b2[lane] * x + c->na2[lane] * y;
+                x = y;
+            }
+            frame[lane] = x;
+        }
+    }
+#endif
+}
+
+#if defined(__SSE2__)
+/**
+ * @brief Filters a mono block in place with up to BIQUAD_LANES sections in the lanes of one register
+ *
+ * At step t lane s runs its section on sample t - s, the output lane s computed at step t - 1, so the sections of
+ * a sample no longer wait for each other. The sections are taken BIQUAD_LANES at a time and a smaller last group
+ * is padded with pass-through lanes in front. The first and last steps of a block leave the state of the lanes
+ * that have no sample untouched, so nothing is in flight between two blocks.
+ */
+void biquad_chain_ProcessMono(struct biquad_chain* chain, float* data, uint32_t frames){
+    for(uint32_t first = 0; first < chain->sections; first += BIQUAD_LANES){
+        const uint32_t count = chain->sections - first < BIQUAD_LANES ? chain->sections - first : BIQUAD_LANES;
+        const uint32_t pad = BIQUAD_LANES - count;
+        float b0[BIQUAD_LANES] = {1.0f, 1.0f, 1.0f, 1.0f};
+        float b1[BIQUAD_LANES] = {0}, b2[BIQUAD_LANES] = {0}, na1[BIQUAD_LANES] = {0}, na2[BIQUAD_LANES] = {0};
+        float z1_in[BIQUAD_LANES] = {0}, z2_in[BIQUAD_LANES] = {0};
+        for(uint32_t lane = pad; lane < BIQUAD_LANES; lane++){
+            const struct biquad_section* c = &chain->coeffs[first + lane - pad];
+            b0[lane] = c->b0[0];
+            b1[lane] = c->b1[0];
+            b2[lane] = c->b2[0];
+            na1[lane] = c->na1[0];
+            na2[lane] = c->na2[0];
+            z1_in[lane] = chain->state[first + lane - pad].z1[0];
+            z2_in[lane] = chain->state[first + lane - pad].z2[0];
+        }
+        const __m128 vb0 = _mm_loadu_ps(b0), vb1 = _mm_loadu_ps(b1), vb2 = _mm_loadu_ps(b2);
+        const __m128 vna1 = _mm_loadu_ps(na1), vna2 = _mm_loadu_ps(na2);
+        __m128 z1 = _mm_loadu_ps(z1_in);
+        __m128 z2 = _mm_loadu_ps(z2_in);
+        __m128 y = _mm_setzero_ps();
+
+        for(uint32_t t = 0; t < frames + BIQUAD_LANES - 1; t++){
+            __m128 x = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(y), 4));
+            x = _mm_move_ss(x, _mm_set_ss(t < frames ? data[t] : 0.0f));
+            y = _mm_add_ps(_mm_mul_ps(vb0, x), z1);
+            __m128 next1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vb1, x), _mm_mul_ps(vna1, y)), z2);
+            __m128 next2 = _mm_add_ps(_mm_mul_ps(vb2, x), _mm_mul_ps(vna2, y));
+            if(t >= BIQUAD_LANES - 1 && t < frames){
+                z1 = next1;
+                z2 = next2;
+            } else{
+                // filling or draining the pipeline: only the lanes with a sample of the block move on
+                uint32_t valid[BIQUAD_LANES];
+                for(uint32_t lane = 0; lane < BIQUAD_LANES; lane++){
+                    valid[lane] = t >= lane && t - lane < frames ? 0xFFFFFFFFu : 0;
+                }
+                const __m128 mask = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)valid));
+                z1 = _mm_or_ps(_mm_and_ps(mask, next1), _mm_andnot_ps(mask, z1));
+                z2 = _mm_or_ps(_mm_and_ps(mask, next2), _mm_andnot_ps(mask, z2));
+            }
+            if(t >= BIQUAD_LANES - 1){
+                data[t - (BIQUAD_LANES - 1)] = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+        }
+
+        _mm_storeu_ps(z1_in, z1);
+        _mm_storeu_ps(z2_in, z2);
+        for(uint32_t lane = pad; lane < BIQUAD_LANES; lane++){
+            chain->state[first + lane - pad].z1[0] = z1_in[lane];
+            chain->state[first + lane - pad].z2[0] = z2_in[lane];
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Filters an interleaved block of samples in place. The state is kept for the next block
+ *
+ * @param chain the chain
+ * @param data the interleaved samples of the block
+ * @param frames the number of frames in the block
+ */
+void biquad_chain_Process(struct biquad_chain* chain, float* data, uint32_t frames){
+#if defined(__SSE2__)
+    // a single section is bound by its own recursion, it gains nothing from the pipeline
+    if(chain->channels == 1 && chain->sections > 1){
+        biquad_chain_ProcessMono(chain, data, frames);
+        return;
+    }
+#endif
+    for(uint32_t group = 0; group < chain->groups; group++){
+        biquad_chain_ProcessGroup(chain, group, data, frames);
+    }
+}
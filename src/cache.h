@@ -0,0 +1,304 @@
+/**
+ * @file cache.h
+ * @author Rafael Diolatzis
+ * @brief An on-disk cache of command outputs, keyed by a hash of the input and of the command line
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * With --cache <dir> the output of a cacheable command is stored in <dir> under the name <input hash><command hash>.wav.
+ * The input hash covers every byte of STDIN from its current position, so the format and the data are both part of the
+ * key, and the command hash covers the command and its parameters. When the same input meets the same command again
+ * the stored file is sent to STDOUT instead of running the command. Between two files the copy happens in the kernel:
+ * a reflink (FICLONE) when STDOUT is empty and the file system shares extents (btrfs, XFS), copy_file_range() otherwise.
+ *
+ * Only commands whose output depends on nothing but STDIN and their parameters are cached, and only when STDIN is a
+ * regular file, so it can be hashed and then read again by the command. Other commands run as usual.
+ *
+ * The cache is limited in size. A hit sets the modification time of the file, and after every new entry the entries
+ * that were used least recently are deleted until the total size is within the limit.
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<inttypes.h>
+#include<string.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<dirent.h>
+#include<unistd.h>
+#include<sys/stat.h>
+#include<sys/ioctl.h>
+#include"utils.h"
+#include"chunked.h"
+
+#if defined(__linux__)
+#include<linux/fs.h>
+#endif
+
+#define CACHE_DEFAULT_LIMIT_MB 1024
+#define CACHE_BUFFER_SIZE (1 << 20)
+
+#define CACHE_PRIME1 0x9E3779B185EBCA87ull
+#define CACHE_PRIME2 0xC2B2AE3D27D4EB4Full
+#define CACHE_PRIME3 0x165667B19E3779F9ull
+#define CACHE_PRIME4 0x85EBCA77C2B2AE63ull
+#define CACHE_PRIME5 0x27D4EB2F165667C5ull
+
+static inline uint64_t cache_Rotate(uint64_t x, int bits){
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static inline uint64_t cache_Round(uint64_t acc, uint64_t word){
+    return cache_Rotate(acc + word * CACHE_PRIME2, 31) * CACHE_PRIME1;
+}
+
+/**
+ * @brief Hashes a buffer with four independent lanes of 64 bit multiply-rotate rounds (the XXH64 construction),
+ * several GB/s on one core. Long inputs are hashed in pieces, each piece seeded with the hash of the ones before it
+ *
+ * @param seed 0 or the hash of the previous piece
+ */
+uint64_t cache_Hash(const void* data, size_t size, uint64_t seed){
+    const uint8_t* p = data;
+    const uint8_t* end = p + size;
+    uint64_t h;
+    if(size >= 32){
+        uint64_t v[4] = {seed + CACHE_PRIME1 + CACHE_PRIME2, seed + CACHE_PRIME2, seed, seed - CACHE_PRIME1};
+        for(; p + 32 <= end; p += 32){
+            uint64_t w[4];
+            memcpy(w, p, 32);
+            for(int i = 0; i < 4; i++) v[i] = cache_Round(v[i], w[i]);
+        }
+        h = cache_Rotate(v[0], 1) + cache_Rotate(v[1], 7) + cache_Rotate(v[2], 12) + cache_Rotate(v[3], 18);
+        for(int i = 0; i < 4; i++) h = (h ^ cache_Round(0, v[i])) * CACHE_PRIME1 + CACHE_PRIME4;
+    } else{
+        h = seed + CACHE_PRIME5;
+    }
+    h += size;
+    for(; p + 8 <= end; p += 8){
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = cache_Rotate(h ^ cache_Round(0, w), 27) * CACHE_PRIME1 + CACHE_PRIME4;
+    }
+    for(; p < end; p++){
+        h = cache_Rotate(h ^ (*p * CACHE_PRIME5), 11) * CACHE_PRIME1;
+    }
+    h ^= h >> 33;
+    h *= CACHE_PRIME2;
+    h ^= h >> 29;
+    h *= CACHE_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * @brief Returns 1 for the commands whose output depends only on STDIN and their parameters
+ */
+short cache_Cacheable(const char* command){
+    static const char* const commands[] = {"rate", "channel", "remix", "volume", "convert", "filter", "fade", "tempo", "spectrum"};
+    for(size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++){
+        if(strcmp(command, commands[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Hashes a range of a file
+ *
+ * @returns 0 on success or an errno value
+ */
+int cache_HashFile(int fd, off_t offset, off_t size, char* buffer, uint64_t* hash){
+    uint64_t h = 0;
+    while(size > 0){
+        size_t n = size < CACHE_BUFFER_SIZE ? (size_t)size : CACHE_BUFFER_SIZE;
+        int error = chunked_Read(fd, buffer, n, offset);
+        if(error != 0) return error;
+        h = cache_Hash(buffer, n, h);
+        offset += (off_t)n;
+        size -= (off_t)n;
+    }
+    *hash = h;
+    return 0;
+}
+
+/**
+ * @brief Sends a cached file to STDOUT, in the kernel when STDOUT is a regular file
+ *
+ * @param count 1 to count the bytes as output of the run, 0 when the command already counted them
+ *
+ * @returns 0 on success or an errno value
+ */
+int cache_Send(int fd, off_t size, char* buffer, short count){
+    FILE* out = IO_OUT;
+    fflush(out);
+    double start = stats_Begin();
+    int error = 0;
+    struct stat st;
+    int out_fd = fileno(out);
+    off_t offset = out_fd >= 0 && fstat(out_fd, &st) == 0 && S_ISREG(st.st_mode) ? ftello(out) : -1;
+    if(offset >= 0){
+        short cloned = 0;
+#if defined(FICLONE)
+        // a reflink shares the extents of the cached file, it needs the output to start at the start of the file
+        cloned = offset == 0 && st.st_size == 0 && ioctl(out_fd, FICLONE, fd) == 0;
+#endif
+        if(!cloned) error = chunked_Copy(fd, 0, out_fd, offset, (size_t)size, buffer, CACHE_BUFFER_SIZE);
+        if(error == 0) fseeko(out, offset + size, SEEK_SET);
+    } else{
+        for(off_t done = 0; error == 0 && done < size;){
+            size_t n = size - done < CACHE_BUFFER_SIZE ? (size_t)(size - done) : CACHE_BUFFER_SIZE;
+            error = chunked_Read(fd, buffer, n, done);
+            if(error == 0 && fwrite(buffer, 1, n, out) != n) error = EIO;
+            done += (off_t)n;
+        }
+    }
+    stats_End(STATS_WRITE, start, count && error == 0 ? (uint64_t)size : 0);
+    return error;
+}
+
+struct cache_entry {
+    char name[40];
+    double used;                    // modification time, set by every hit
+    off_t size;
+};
+
+int cache_CompareUse(const void* a, const void* b){
+    const struct cache_entry* x = a;
+    const struct cache_entry* y = b;
+    return (x->used > y->used) - (x->used < y->used);
+}
+
+/**
+ * @brief Deletes the least recently used entries of a cache until its size is within a limit
+ */
+void cache_Trim(const char* dir, uint64_t limit){
+    DIR* d = opendir(dir);
+    if(d == NULL) return;
+    struct cache_entry* entries = NULL;
+    size_t count = 0, capacity = 0;
+    uint64_t total = 0;
+    char path[4096];
+    for(struct dirent* e = readdir(d); e != NULL; e = readdir(d)){
+        size_t length = strlen(e->d_name);
+        if(length != 36 || strcmp(e->d_name + 32, ".wav") != 0) continue;
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        if(stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        if(count == capacity){
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            struct cache_entry* grown = realloc(entries, capacity * sizeof(struct cache_entry));
+            if(grown == NULL) break;
+            entries = grown;
+        }
+        snprintf(entries[count].name, sizeof(entries[count].name), "%s", e->d_name);
+        entries[count].used = st.st_mtim.tv_sec + st.st_mtim.tv_nsec * 1e-9;
+        entries[count].size = st.st_size;
+        total += (uint64_t)st.st_size;
+        count++;
+    }
+    closedir(d);
+
+    if(total > limit){
+        qsort(entries, count, sizeof(struct cache_entry), cache_CompareUse);
+        for(size_t i = 0; i < count && total > limit; i++){
+            snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+            if(unlink(path) == 0) total -= (uint64_t)entries[i].size;
+        }
+    }
+    free(entries);
+}
+
+/**
+ * @brief Runs a command line through the cache
+ *
+ * @param dir the directory of the cache, created if it does not exist
+ * @param limit the size limit of the cache in bytes
+ * @param run the function that runs the command line
+ *
+ * @returns the status of the command
+ */
+int cache_Run(const char* dir, uint64_t limit, int (*run)(int, char*[]), int argc, char* argv[]){
+    struct stat st;
+    int in_fd = fileno(IO_IN);
+    if(argc < 2 || !cache_Cacheable(argv[1]) || in_fd < 0 || fstat(in_fd, &st) != 0 || !S_ISREG(st.st_mode)){
+        return run(argc, argv);
+    }
+    off_t base = ftello(IO_IN);
+    if(base < 0 || base > st.st_size) return run(argc, argv);
+    if(mkdir(dir, 0777) != 0 && errno != EEXIST){
+        fprintf(stderr, "Error! unable to create the cache directory %s\n", dir);
+        return 1;
+    }
+    char* buffer = malloc(CACHE_BUFFER_SIZE);
+    if(buffer == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        return 1;
+    }
+
+    // the command reads the input again, so hashing only counts as time
+    double start = stats_Begin();
+    uint64_t input = 0;
+    int error = cache_HashFile(in_fd, base, st.st_size - base, buffer, &input);
+    stats_End(STATS_READ, start, 0);
+    if(error != 0){
+        free(buffer);
+        return run(argc, argv);
+    }
+    uint64_t command = 0;
+    for(int i = 1; i < argc; i++) command = cache_Hash(argv[i], strlen(argv[i]) + 1, command);
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%016" PRIx64 "%016" PRIx64 ".wav", dir, input, command);
+    int fd = open(path, O_RDONLY);
+    if(fd >= 0 && fstat(fd, &st) == 0){
+        stats_Cache(1);
+        uint16_t bits;
+        if(chunked_Read(fd, (char*)&bits, sizeof(bits), 34) == 0) stats_Format(1, bits);
+        futimens(fd, NULL);
+        error = cache_Send(fd, st.st_size, buffer, 1);
+        close(fd);
+        free(buffer);
+        if(error != 0){
+            fprintf(stderr, "Error! unable to write the cached output: %s\n", strerror(error));
+            return 1;
+        }
+        return 0;
+    }
+    stats_Cache(0);
+
+    // the command writes to a temporary file of the cache, which becomes the entry if the command succeeds
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s/.tmp-XXXXXX", dir);
+    fd = mkstemp(temporary);
+    FILE* stream = fd >= 0 ? fdopen(fd, "w+b") : NULL;
+    if(stream == NULL){
+        if(fd >= 0){
+            close(fd);
+            unlink(temporary);
+        }
+        free(buffer);
+        return run(argc, argv);
+    }
+    FILE* previous = io_output;
+    io_output = stream;
+    int status = run(argc, argv);
+    short written = fflush(stream) == 0 && !ferror(stream);
+    io_output = previous;
+
+    off_t size = ftello(stream);
+    error = cache_Send(fd, size, buffer, 0);
+    if(status == 0 && written && error == 0 && rename(temporary, path) == 0) cache_Trim(dir, limit);
+    else unlink(temporary);
+    fclose(stream);
+    free(buffer);
+    if(error != 0){
+        fprintf(stderr, "Error! unable to write the output: %s\n", strerror(error));
+        return 1;
+    }
+    return status;
+}
@@ -12,7 +12,9 @@
 #pragma once
 
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sound/asound.h>
 #include <stdio.h>
 #include <string.h>
@@ -51,16 +53,32 @@ int caudio_open_device() {
 
 #define MASK_COUNT (SNDRV_PCM_HW_PARAM_LAST_MASK - SNDRV_PCM_HW_PARAM_FIRST_MASK + 1)
 #define INTR_COUNT (SNDRV_PCM_HW_PARAM_LAST_INTERVAL - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL + 1)
+/**
+ * @brief The buffer geometry the device agreed to
+ */
+struct caudio_latency {
+    unsigned int period_size;       // frames
+    unsigned int buffer_size;       // frames
+    unsigned int start_threshold;   // frames queued before playback starts
+    unsigned int sample_rate;
+};
+
 /**
  * @brief Setups the specified audio device
  * 
+ * The device may round the period and the buffer. The software parameters are derived from the sizes it agreed to:
+ * playback starts once the buffer is full, so a slow start cannot underrun, and stops on an underrun, which
+ * caudio_write_data_to_device() recovers from.
+ * 
  * @param fd file descriptor
  * @param hw 
  * @param sw 
  * @param channels
  * @param bits_per_sample 
  * @param sample_rate 
- * @param segment_size 
+ * @param segment_size the period size in frames
+ * @param periods the number of periods of the buffer
+ * @param latency receives the negotiated sizes
  * @return int upon success zero is returned. Otherwise a negative value is returned.
  */
 int caudio_setup_params(int fd,
@@ -69,7 +87,9 @@ int caudio_setup_params(int fd,
                         unsigned channels,
                         int16_t bits_per_sample,
                         unsigned int sample_rate,
-                        unsigned int segment_size) {
+                        unsigned int segment_size,
+                        unsigned int periods,
+                        struct caudio_latency *latency) {
     int ret;
 
     /* ------------------ HARDWARE PARAM STRUCT INIT --------------------- */
@@ -121,7 +141,7 @@ int caudio_setup_params(int fd,
     ps->integer = 1;
 
     struct snd_interval *bs = &hw->intervals[SNDRV_PCM_HW_PARAM_BUFFER_SIZE - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL];
-    unsigned int buffer_size = segment_size * 4;
+    unsigned int buffer_size = segment_size * periods;
     if (buffer_size < bs->min)
         buffer_size = bs->min;
     if (buffer_size > bs->max)
@@ -156,9 +176,9 @@ int caudio_setup_params(int fd,
     ps->min = ps->max = segment_size;
     ps->integer = 1;
 
-    /* buffer size is set to 4× period */
+    /* buffer size */
     bs = &hw->intervals[SNDRV_PCM_HW_PARAM_BUFFER_SIZE - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL];
-    bs->min = bs->max = segment_size * 4;
+    bs->min = bs->max = buffer_size;
     bs->integer = 1;
 
     /* -------------------------- APPLY HW PARAMS ------------------------ */
@@ -168,17 +188,23 @@ int caudio_setup_params(int fd,
         return -2;
     }
 
+    /* the refined intervals hold the values the device chose */
+    latency->period_size = hw->intervals[SNDRV_PCM_HW_PARAM_PERIOD_SIZE - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL].min;
+    latency->buffer_size = hw->intervals[SNDRV_PCM_HW_PARAM_BUFFER_SIZE - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL].min;
+    latency->sample_rate = hw->intervals[SNDRV_PCM_HW_PARAM_RATE - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL].min;
+    latency->start_threshold = latency->buffer_size;
+
     /* ------------------------- SOFTWARE PARAMS ------------------------ */
 
     memset(sw, 0, sizeof(*sw));
 
     sw->period_step = 1;
-    sw->start_threshold = 1;
-    sw->stop_threshold = ~0U;
+    sw->start_threshold = latency->start_threshold;
+    sw->stop_threshold = latency->buffer_size;
     sw->silence_threshold = 0;
     sw->silence_size = 0;
     sw->boundary = 0x7FFFFFFF;
-    sw->avail_min = segment_size;
+    sw->avail_min = latency->period_size;
 
     ret = ioctl(fd, SNDRV_PCM_IOCTL_SW_PARAMS, sw);
     if (ret < 0) {
@@ -217,20 +243,33 @@ int caudio_stop_playback(int fd) {
 /**
  * @brief Writes audio data to the specified audio device
  * 
+ * Waits in poll() while the buffer is full. After an underrun the device is prepared again and the write continues,
+ * playback starts again once the start threshold is queued.
+ * 
  * @param fd file descriptor
  * @param buffer contains the data
  * @param n size of the buffer
+ * @param underruns incremented for every underrun
  * @return int Upon success zero is returned. Otherwise -1 is returned.
  */
-int caudio_write_data_to_device(int fd, void *buffer, uint32_t n) {
+int caudio_write_data_to_device(int fd, void *buffer, uint32_t n, unsigned int *underruns) {
     uint8_t *ptr = buffer;
     uint32_t left = n;
     int ret;
     while (left > 0) {
         ret = write(fd, ptr, left);
         if (ret < 0) {
-            if (errno == EAGAIN)
+            if (errno == EAGAIN) {
+                struct pollfd p = {fd, POLLOUT, 0};
+                poll(&p, 1, -1);
+                continue;
+            }
+            if (errno == EPIPE) {
+                (*underruns)++;
+                if (ioctl(fd, SNDRV_PCM_IOCTL_PREPARE) < 0)
+                    return -1;
                 continue;
+            }
             return -1;
         }
         ptr += ret;
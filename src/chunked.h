@@ -0,0 +1,465 @@
+/**
+ * @file chunked.h
+ * @author Rafael Diolatzis
+ * @brief Processes one large WAV file on many threads when the input and the output are seekable files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Commands whose output frame depends only on the input frame at the same position (volume, channel, rate and
+ * convert without noise shaping) do not need to see the data in order. When STDIN and STDOUT are regular files the
+ * data chunk is split into one range per thread, aligned to STREAM_BLOCK_FRAMES frames. Every thread reads its range
+ * with pread(), processes it a few blocks at a time and writes it with pwrite() at the offset the frames have in the
+ * output. The bytes after the data chunk are copied next and the header is written last, so a run that fails half way
+ * never leaves a file that looks complete.
+ *
+ * The input is checked up front with the same rules as the command and has to end exactly where its header says.
+ * Anything else, including pipes, is left to the streaming code of the command, which reports the error. Nothing is
+ * read through IO_IN before that decision, so falling back costs nothing.
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<pthread.h>
+#include<unistd.h>
+#include<sys/stat.h>
+#include<sys/syscall.h>
+#include"utils.h"
+#include"dither.h"
+
+#define CHUNKED_PIECE_BLOCKS 16
+#define CHUNKED_MAX_THREADS 256
+
+/**
+ * @brief Processes frames frames of a range, the first of which is frame first of the file
+ *
+ * @param scratch the per-thread scratch memory of the job, scratch_size bytes
+ */
+typedef void (*chunked_Kernel)(const char* in, char* out, uint32_t frames, uint64_t first, const void* arg, void* scratch);
+
+/**
+ * @brief The input and output files of a chunked run and the header of the input
+ */
+struct chunked_file {
+    int in_fd;
+    int out_fd;
+    off_t in_base;              // offset of the RIFF tag in the input
+    off_t out_base;             // offset where the output starts
+    struct wav_header header;
+};
+
+/**
+ * @brief A chunked run: the files, the kernel and the per-thread ranges
+ */
+struct chunked_job {
+    const struct chunked_file* file;
+    chunked_Kernel kernel;      // NULL copies the data unchanged
+    const void* arg;
+    size_t scratch_size;
+    uint16_t out_align;
+    uint32_t first;             // the range of one thread
+    uint32_t frames;
+    double read_seconds;        // time in pread() and pwrite(), for --stats
+    double write_seconds;
+    int error;                  // errno of the first failure, 0 on success
+};
+
+/**
+ * @brief Checks whether the input and output of the calling command are regular files that can be processed in ranges
+ *
+ * @param file receives the descriptors, the offsets and the header
+ * @param legacy 1 to accept only 8 and 16 bit PCM, like the volume, channel and rate commands
+ *
+ * @returns 1 if the file can be processed in ranges, 0 if the command has to stream it
+ */
+short chunked_Open(struct chunked_file* file, short legacy){
+    file->in_fd = fileno(IO_IN);
+    file->out_fd = fileno(IO_OUT);
+    if(file->in_fd < 0 || file->out_fd < 0) return 0;
+
+    struct stat in_st, out_st;
+    if(fstat(file->in_fd, &in_st) != 0 || fstat(file->out_fd, &out_st) != 0) return 0;
+    if(!S_ISREG(in_st.st_mode) || !S_ISREG(out_st.st_mode)) return 0;
+    if(in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino) return 0;
+    int out_flags = fcntl(file->out_fd, F_GETFL);
+    if(out_flags < 0 || (out_flags & O_APPEND)) return 0; // pwrite() ignores the offset on O_APPEND descriptors
+    if(fflush(IO_OUT) != 0) return 0;
+    // ftello() rather than the descriptor offset, the stream may have read ahead of its position
+    file->in_base = ftello(IO_IN);
+    file->out_base = ftello(IO_OUT);
+    if(file->in_base < 0 || file->out_base < 0) return 0;
+
+    uint8_t b[SIZE_OF_WAVE_HEADER + 8];
+    if(pread(file->in_fd, b, sizeof(b), file->in_base) != (ssize_t)sizeof(b)) return 0;
+    if(memcmp(b, "RIFF", 4) != 0 || memcmp(b + 8, "WAVEfmt ", 8) != 0 || memcmp(b + 36, "data", 4) != 0) return 0;
+
+    struct wav_header* h = &file->header;
+    h->size_of_file = b[4] | b[5] << 8 | b[6] << 16 | (uint32_t)b[7] << 24;
+    h->format_chunk = b[16] | b[17] << 8 | b[18] << 16 | (uint32_t)b[19] << 24;
+    h->wave_format = b[20] | b[21] << 8;
+    h->mono_stereo = b[22] | b[23] << 8;
+    h->sample_rate = b[24] | b[25] << 8 | b[26] << 16 | (uint32_t)b[27] << 24;
+    h->bytes_per_sec = b[28] | b[29] << 8 | b[30] << 16 | (uint32_t)b[31] << 24;
+    h->block_align = b[32] | b[33] << 8;
+    h->bits_per_sample = b[34] | b[35] << 8;
+    h->data_segment_size = b[40] | b[41] << 8 | b[42] << 16 | (uint32_t)b[43] << 24;
+
+    if(h->format_chunk != 16 || (h->mono_stereo != 1 && h->mono_stereo != 2)) return 0;
+    if(legacy){
+        if(h->wave_format != WAVE_FORMAT_PCM || (h->bits_per_sample != 8 && h->bits_per_sample != 16)) return 0;
+    } else{
+        if(h->wave_format != WAVE_FORMAT_PCM && h->wave_format != WAVE_FORMAT_IEEE_FLOAT) return 0;
+        if(h->bits_per_sample != 8 && h->bits_per_sample != 16 && h->bits_per_sample != 24 && h->bits_per_sample != 32) return 0;
+        if(h->wave_format == WAVE_FORMAT_IEEE_FLOAT && h->bits_per_sample != 32) return 0;
+    }
+    if(h->block_align != (h->bits_per_sample / 8) * h->mono_stereo) return 0;
+    if(h->bytes_per_sec != h->sample_rate * h->block_align) return 0;
+    if(h->data_segment_size % h->block_align != 0) return 0;
+    if(h->size_of_file < SIZE_OF_WAVE_HEADER + h->data_segment_size) return 0;
+    return in_st.st_size == file->in_base + 8 + (off_t)h->size_of_file;
+}
+
+/**
+ * @brief Reads exactly size bytes at an offset
+ *
+ * @returns 0 on success or an errno value
+ */
+int chunked_Read(int fd, char* buffer, size_t size, off_t offset){
+    while(size > 0){
+        ssize_t n = pread(fd, buffer, size, offset);
+        if(n < 0 && errno == EINTR) continue;
+        if(n < 0) return errno;
+        if(n == 0) return EIO;
+        buffer += n;
+        size -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes exactly size bytes at an offset
+ *
+ * @returns 0 on success or an errno value
+ */
+int chunked_Write(int fd, const char* buffer, size_t size, off_t offset){
+    while(size > 0){
+        ssize_t n = pwrite(fd, buffer, size, offset);
+        if(n < 0 && errno == EINTR) continue;
+        if(n < 0) return errno;
+        if(n == 0) return EIO;
+        buffer += n;
+        size -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies size bytes between offsets of two files, in the kernel when the file systems allow it
+ *
+ * @returns 0 on success or an errno value
+ */
+int chunked_Copy(int in_fd, off_t in_offset, int out_fd, off_t out_offset, size_t size, char* buffer, size_t buffer_size){
+    while(size > 0){
+        // through syscall() like the io_uring calls of batch.h, the libc wrapper needs _GNU_SOURCE
+        off_t from = in_offset, to = out_offset;
+        long n = syscall(__NR_copy_file_range, in_fd, &from, out_fd, &to, size, 0u);
+        if(n <= 0) break;
+        in_offset += n;
+        out_offset += n;
+        size -= (size_t)n;
+    }
+    while(size > 0){
+        size_t n = size < buffer_size ? size : buffer_size;
+        int error = chunked_Read(in_fd, buffer, n, in_offset);
+        if(error == 0) error = chunked_Write(out_fd, buffer, n, out_offset);
+        if(error != 0) return error;
+        in_offset += n;
+        out_offset += n;
+        size -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Processes the range of one thread
+ */
+void* chunked_Worker(void* arg){
+    struct chunked_job* job = arg;
+    const struct chunked_file* file = job->file;
+    const uint16_t in_align = file->header.block_align;
+    const uint32_t piece = CHUNKED_PIECE_BLOCKS * STREAM_BLOCK_FRAMES;
+    const off_t in_data = file->in_base + SIZE_OF_WAVE_HEADER + 8;
+    const off_t out_data = file->out_base + SIZE_OF_WAVE_HEADER + 8;
+
+    char* in = alloc_Aligned((size_t)piece * in_align);
+    char* out = job->kernel != NULL ? alloc_Aligned((size_t)piece * job->out_align) : NULL;
+    void* scratch = job->scratch_size > 0 ? alloc_Aligned(job->scratch_size) : NULL;
+    if(in == NULL || (job->kernel != NULL && out == NULL) || (job->scratch_size > 0 && scratch == NULL)){
+        job->error = ENOMEM;
+    } else if(job->kernel == NULL){
+        double start = stats_Now();
+        job->error = chunked_Copy(file->in_fd, in_data + (off_t)job->first * in_align, file->out_fd,
+                                  out_data + (off_t)job->first * in_align, (size_t)job->frames * in_align, in, (size_t)piece * in_align);
+        job->write_seconds = stats_Now() - start;
+    } else{
+        for(uint32_t done = 0; done < job->frames && job->error == 0; done += piece){
+            uint32_t frames = job->frames - done < piece ? job->frames - done : piece;
+            uint64_t first = (uint64_t)job->first + done;
+            double start = stats_Now();
+            job->error = chunked_Read(file->in_fd, in, (size_t)frames * in_align, in_data + (off_t)first * in_align);
+            double read = stats_Now();
+            job->read_seconds += read - start;
+            if(job->error != 0) break;
+            job->kernel(in, out, frames, first, job->arg, scratch);
+            double write = stats_Now();
+            job->error = chunked_Write(file->out_fd, out, (size_t)frames * job->out_align, out_data + (off_t)first * job->out_align);
+            job->write_seconds += stats_Now() - write;
+        }
+    }
+    free_Aligned(in);
+    free_Aligned(out);
+    free_Aligned(scratch);
+    return NULL;
+}
+
+/**
+ * @brief Processes the data chunk of a file on threads threads, copies the bytes after it and writes the header
+ *
+ * @param file a file accepted by chunked_Open()
+ * @param out_header the header of the output, whose data chunk has as many frames as the input
+ * @param kernel the processing of a range, NULL to copy the data unchanged
+ * @param arg the argument of the kernel
+ * @param scratch_size the per-thread scratch memory of the kernel in bytes, for a piece of CHUNKED_PIECE_BLOCKS blocks
+ * @param threads the number of threads
+ * @param keep_other copy the chunks after the data chunk, as the streaming command does, and count them in
+ * out_header->size_of_file
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void chunked_Run(const struct chunked_file* file, const struct wav_header* out_header, chunked_Kernel kernel, const void* arg,
+                 size_t scratch_size, int threads, short keep_other, short* flag){
+    *flag = 1;
+    stats_Format(0, file->header.bits_per_sample);
+    stats_Format(1, out_header->bits_per_sample);
+    stats_Header();
+    const uint32_t frames = file->header.data_segment_size / file->header.block_align;
+    const uint32_t blocks = (frames + STREAM_BLOCK_FRAMES - 1) / STREAM_BLOCK_FRAMES;
+    threads = threads < 1 ? 1 : (threads > CHUNKED_MAX_THREADS ? CHUNKED_MAX_THREADS : threads);
+    if((uint32_t)threads > blocks) threads = blocks > 0 ? (int)blocks : 1;
+
+    struct chunked_job jobs[CHUNKED_MAX_THREADS];
+    pthread_t ids[CHUNKED_MAX_THREADS];
+    short started[CHUNKED_MAX_THREADS];
+    for(int t = 0; t < threads; t++){
+        // ranges are whole blocks so block-based state such as the dither seeds lines up with the streaming code
+        uint64_t begin = (uint64_t)blocks * t / threads * STREAM_BLOCK_FRAMES;
+        uint64_t end = (uint64_t)blocks * (t + 1) / threads * STREAM_BLOCK_FRAMES;
+        if(end > frames) end = frames;
+        jobs[t] = (struct chunked_job){file, kernel, arg, scratch_size, out_header->block_align, (uint32_t)begin, (uint32_t)(end - begin), 0, 0, 0};
+        started[t] = t > 0 && pthread_create(&ids[t], NULL, chunked_Worker, &jobs[t]) == 0;
+    }
+    chunked_Worker(&jobs[0]);
+    for(int t = 1; t < threads; t++){
+        if(started[t]) pthread_join(ids[t], NULL);
+        else chunked_Worker(&jobs[t]);
+    }
+
+    int error = 0;
+    double read_seconds = 0, write_seconds = 0;
+    for(int t = 0; t < threads; t++){
+        if(error == 0) error = jobs[t].error;
+        read_seconds += jobs[t].read_seconds;
+        write_seconds += jobs[t].write_seconds;
+    }
+    // the threads overlap, their I/O is reported as the time of an average thread
+    stats_Add(STATS_READ, read_seconds / threads, (uint64_t)file->header.data_segment_size);
+    stats_Add(STATS_WRITE, write_seconds / threads, (uint64_t)out_header->data_segment_size + SIZE_OF_WAVE_HEADER + 8);
+
+    const uint32_t other = keep_other ? file->header.size_of_file - SIZE_OF_WAVE_HEADER - file->header.data_segment_size : 0;
+    const off_t out_end = file->out_base + SIZE_OF_WAVE_HEADER + 8 + out_header->data_segment_size;
+    if(error == 0 && other > 0){
+        char buffer[65536];
+        stats_Bytes(STATS_READ, other);
+        stats_Bytes(STATS_WRITE, other);
+        error = chunked_Copy(file->in_fd, file->in_base + SIZE_OF_WAVE_HEADER + 8 + file->header.data_segment_size,
+                             file->out_fd, out_end, other, buffer, sizeof(buffer));
+    }
+    if(error == 0){
+        uint8_t b[SIZE_OF_WAVE_HEADER + 8];
+        format_WavHeader(out_header, b);
+        error = chunked_Write(file->out_fd, (const char*)b, sizeof(b), file->out_base);
+    }
+    if(error != 0){
+        fprintf(stderr, "Error! %s\n", strerror(error));
+        return;
+    }
+
+    // leave both streams where the streaming code would have left them
+    fseeko(IO_IN, file->in_base + 8 + file->header.size_of_file, SEEK_SET);
+    fseeko(IO_OUT, out_end + other, SEEK_SET);
+    *flag = 0;
+}
+
+/**
+ * @brief The volume of the data chunk, with the kernels of set_Volume()
+ */
+struct chunked_volume {
+    uint16_t bits_per_sample;
+    uint16_t channels;
+    double gains[1024];
+};
+
+void chunked_VolumeKernel(const char* in, char* out, uint32_t frames, uint64_t first, const void* arg, void* scratch){
+    (void)first;
+    (void)scratch;
+    const struct chunked_volume* v = arg;
+    const uint32_t samples = frames * v->channels;
+    for(uint32_t i = 0; i < samples; i += 1024){
+        uint32_t n = samples - i < 1024 ? samples - i : 1024;
+        if(v->bits_per_sample == 8) gain_Apply8bit(in + i, out + i, n, v->gains);
+        else gain_Apply16bit(in + 2*i, out + 2*i, n, v->gains);
+    }
+}
+
+/**
+ * @brief One channel of stereo 8 or 16 bit data, like read_Channel_8bit() and read_Channel_16bit()
+ */
+struct chunked_channel {
+    uint16_t bytes_per_sample;
+    uint16_t channel;
+};
+
+void chunked_ChannelKernel(const char* in, char* out, uint32_t frames, uint64_t first, const void* arg, void* scratch){
+    (void)first;
+    (void)scratch;
+    const struct chunked_channel* c = arg;
+    if(c->bytes_per_sample == 1){
+        for(uint32_t i = 0; i < frames; i++) out[i] = in[2*i + c->channel];
+    } else{
+        for(uint32_t i = 0; i < frames; i++){
+            out[2*i] = in[4*i + 2*c->channel];
+            out[2*i + 1] = in[4*i + 2*c->channel + 1];
+        }
+    }
+}
+
+/**
+ * @brief A bit depth conversion, the same steps as convert_command() without noise shaping
+ */
+struct chunked_convert {
+    struct wav_header in;
+    struct wav_header out;
+    short dither;
+};
+
+void chunked_ConvertKernel(const char* in, char* out, uint32_t frames, uint64_t first, const void* arg, void* scratch){
+    const struct chunked_convert* c = arg;
+    const uint32_t channels = c->in.mono_stereo;
+    float* samples = scratch;
+    float* noise = samples + (size_t)STREAM_BLOCK_FRAMES * channels;
+    for(uint32_t done = 0; done < frames; done += STREAM_BLOCK_FRAMES){
+        uint32_t n = frames - done < STREAM_BLOCK_FRAMES ? frames - done : STREAM_BLOCK_FRAMES;
+        pcm_ToFloat(in + (size_t)done * c->in.block_align, samples, n * channels, c->in.wave_format, c->in.bits_per_sample);
+        if(c->dither){
+            struct dither_state state;
+            dither_Init(&state, dither_BlockSeed((first + done) / STREAM_BLOCK_FRAMES), 0);
+            dither_Apply(&state, samples, noise, n, channels, c->out.bits_per_sample);
+        }
+        pcm_FromFloat(samples, out + (size_t)done * c->out.block_align, n * channels, c->out.wave_format, c->out.bits_per_sample);
+    }
+}
+
+/**
+ * @brief Runs the volume command in ranges if the input and output allow it
+ *
+ * @returns 1 if the command ran (flag tells how it went), 0 if it has to be run by svolume_command()
+ */
+short chunked_Volume(double volume, int threads, short* flag){
+    struct chunked_file file;
+    if(!chunked_Open(&file, 1)) return 0;
+    struct chunked_volume v;
+    v.bits_per_sample = file.header.bits_per_sample;
+    v.channels = file.header.mono_stereo;
+    for(uint32_t i = 0; i < 1024; i++) v.gains[i] = volume;
+    chunked_Run(&file, &file.header, chunked_VolumeKernel, &v, 0, threads, 1, flag);
+    return 1;
+}
+
+/**
+ * @brief Runs the channel command in ranges if the input and output allow it
+ *
+ * @returns 1 if the command ran (flag tells how it went), 0 if it has to be run by schannel_command()
+ */
+short chunked_Channel(short channel, int threads, short* flag){
+    struct chunked_file file;
+    if(!chunked_Open(&file, 1) || file.header.mono_stereo != 2) return 0;
+    struct chunked_channel c = {file.header.bits_per_sample / 8, channel != 0};
+    struct wav_header out = file.header;
+    out.mono_stereo = 1;
+    out.bytes_per_sec /= 2;
+    out.block_align /= 2;
+    out.data_segment_size /= 2;
+    // like schannel_command(), the chunks after the data chunk are dropped
+    out.size_of_file = SIZE_OF_WAVE_HEADER + out.data_segment_size;
+    chunked_Run(&file, &out, chunked_ChannelKernel, &c, 0, threads, 0, flag);
+    return 1;
+}
+
+/**
+ * @brief Runs the rate command in ranges if the input and output allow it. The data is copied unchanged
+ *
+ * @returns 1 if the command ran (flag tells how it went), 0 if it has to be run by srate_command()
+ */
+short chunked_Rate(double rate, int threads, short* flag){
+    struct chunked_file file;
+    if(!chunked_Open(&file, 1)) return 0;
+    struct wav_header out = file.header;
+    out.sample_rate = (uint32_t)(out.sample_rate * rate);
+    out.bytes_per_sec = (uint32_t)(out.bytes_per_sec * rate);
+    chunked_Run(&file, &out, NULL, NULL, 0, threads, 1, flag);
+    return 1;
+}
+
+/**
+ * @brief Runs the convert command in ranges if the input and output allow it. Noise shaping carries state from
+ * sample to sample and always streams
+ *
+ * @returns 1 if the command ran (flag tells how it went), 0 if it has to be run by convert_command()
+ */
+short chunked_Convert(uint16_t bits, short to_float, short dither, short shape, int threads, short* flag){
+    if(bits != 8 && bits != 16 && bits != 24 && bits != 32) return 0;
+    if(to_float && bits != 32) return 0;
+    struct chunked_file file;
+    if(!chunked_Open(&file, 0)) return 0;
+
+    struct chunked_convert c;
+    c.in = file.header;
+    c.out = file.header;
+    c.out.wave_format = to_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+    c.out.bits_per_sample = bits;
+    c.out.block_align = (bits / 8) * file.header.mono_stereo;
+    c.out.bytes_per_sec = file.header.sample_rate * c.out.block_align;
+    uint16_t in_precision = file.header.wave_format == WAVE_FORMAT_IEEE_FLOAT ? 24 : file.header.bits_per_sample;
+    c.dither = dither < 0 ? !to_float && bits < in_precision : dither;
+    if(to_float || bits == 32) c.dither = 0;
+    if(shape && c.dither) return 0;
+
+    const uint32_t frames = file.header.data_segment_size / file.header.block_align;
+    const uint32_t other = file.header.size_of_file - SIZE_OF_WAVE_HEADER - file.header.data_segment_size;
+    const uint64_t out_size = (uint64_t)frames * c.out.block_align;
+    if(out_size > UINT32_MAX - SIZE_OF_WAVE_HEADER - other) return 0;
+    c.out.data_segment_size = (uint32_t)out_size;
+    c.out.size_of_file = SIZE_OF_WAVE_HEADER + c.out.data_segment_size + other;
+
+    size_t scratch = 2 * (size_t)STREAM_BLOCK_FRAMES * file.header.mono_stereo * sizeof(float);
+    chunked_Run(&file, &c.out, chunked_ConvertKernel, &c, scratch, threads, 1, flag);
+    return 1;
+}
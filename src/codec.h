@@ -0,0 +1,811 @@
+/**
+ * @file codec.h
+ * @author Rafael Diolatzis
+ * @brief G.711 mu-law and A-law, and IMA ADPCM WAV files, decoded to 16 bit PCM as a stream for every command
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Telephony WAV files store 8 bit companded samples (format 7 for mu-law, 6 for A-law) or 4 bit IMA ADPCM codes
+ * (format 0x11) in blocks that each start with the predictor state of every channel. They also have a longer format
+ * chunk and a "fact" chunk, which the plain header of the commands does not accept.
+ *
+ * The commands never see these formats: before a command runs, codec_Run() reads the header of its input, and a
+ * thread decodes the data block by block into a pipe that the command reads as a 16 bit PCM WAV file. Companded
+ * samples are decoded with a 256 entry table and encoded with a table indexed by the top bits of the sample; ADPCM
+ * codes go through a table of the step of every (step index, code) pair.
+ *
+ * The same pipe carries the decoded FLAC streams of flac.h, see codec_PipeRun().
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdio_ext.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<signal.h>
+#include<unistd.h>
+#include<pthread.h>
+#include"utils.h"
+
+#define WAVE_FORMAT_ALAW 6
+#define WAVE_FORMAT_MULAW 7
+#define WAVE_FORMAT_IMA_ADPCM 0x11
+
+#define CODEC_MAX_CHANNELS 8
+#define CODEC_BUFFER_SIZE (1 << 16)
+#define CODEC_MAX_HEADER (1 << 20)      // the largest header, with its LIST and other chunks, that is read before the data
+
+/**
+ * @brief A decoder that reads the input of a command and writes a WAV file to a pipe
+ *
+ * @returns 0 on success, 1 on error (reported to STDERR), 2 if the command closed the pipe before the end
+ */
+typedef int (*codec_decoder)(FILE* in, FILE* out, void* arg);
+
+// 1 while the calling thread runs a command on a decoded stream, which is not decoded again
+static _Thread_local short codec_piped = 0;
+
+static int16_t codec_ulaw_table[256];
+static int16_t codec_alaw_table[256];
+static uint8_t codec_ulaw_encode[1 << 14];      // indexed by the top 14 bits of a 16 bit sample
+static uint8_t codec_alaw_encode[1 << 13];      // indexed by the top 13 bits
+static int32_t codec_ima_diff[89][16];          // the signed step of every code at every step index
+static uint8_t codec_ima_next[89][16];          // the step index that follows
+static pthread_once_t codec_tables_once = PTHREAD_ONCE_INIT;
+
+static const int16_t codec_ima_steps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107,
+    118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894,
+    6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+/**
+ * @brief G.711 mu-law expansion of one code
+ */
+static int16_t codec_UlawDecode(uint8_t u){
+    u = (uint8_t)~u;
+    int t = ((u & 0x0F) << 3) + 0x84;
+    t <<= (u & 0x70) >> 4;
+    return (int16_t)(u & 0x80 ? 0x84 - t : t - 0x84);
+}
+
+/**
+ * @brief G.711 A-law expansion of one code
+ */
+static int16_t codec_AlawDecode(uint8_t a){
+    a ^= 0x55;
+    int t = (a & 0x0F) << 4;
+    const int segment = (a & 0x70) >> 4;
+    if(segment == 0) t += 8;
+    else t = (t + 0x108) << (segment - 1);
+    return (int16_t)(a & 0x80 ? t : -t);
+}
+
+/**
+ * @brief G.711 mu-law compression of a 14 bit sample
+ */
+static uint8_t codec_UlawEncode(int v){
+    uint8_t mask = 0xFF;
+    if(v < 0){
+        v = -v;
+        mask = 0x7F;
+    }
+    if(v > 8159) v = 8159;
+    v += 0x21;
+    int segment = 0;
+    while(segment < 8 && v > (0x40 << segment) - 1) segment++;
+    if(segment >= 8) return (uint8_t)(0x7F ^ mask);
+    return (uint8_t)(((segment << 4) | ((v >> (segment + 1)) & 0x0F)) ^ mask);
+}
+
+/**
+ * @brief G.711 A-law compression of a 13 bit sample
+ */
+static uint8_t codec_AlawEncode(int v){
+    uint8_t mask = 0xD5;
+    if(v < 0){
+        v = -v - 1;
+        mask = 0x55;
+    }
+    int segment = 0;
+    while(segment < 8 && v > (0x20 << segment) - 1) segment++;
+    if(segment >= 8) return (uint8_t)(0x7F ^ mask);
+    int a = segment << 4;
+    a |= segment < 2 ? (v >> 1) & 0x0F : (v >> segment) & 0x0F;
+    return (uint8_t)(a ^ mask);
+}
+
+static void codec_InitTables(void){
+    for(int i = 0; i < 256; i++){
+        codec_ulaw_table[i] = codec_UlawDecode((uint8_t)i);
+        codec_alaw_table[i] = codec_AlawDecode((uint8_t)i);
+    }
+    for(int i = 0; i < (1 << 14); i++) codec_ulaw_encode[i] = codec_UlawEncode((int16_t)(i << 2) >> 2);
+    for(int i = 0; i < (1 << 13); i++) codec_alaw_encode[i] = codec_AlawEncode((int16_t)(i << 3) >> 3);
+    static const int8_t index_change[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+    for(int index = 0; index < 89; index++){
+        const int step = codec_ima_steps[index];
+        for(int code = 0; code < 16; code++){
+            int diff = step >> 3;
+            if(code & 4) diff += step;
+            if(code & 2) diff += step >> 1;
+            if(code & 1) diff += step >> 2;
+            codec_ima_diff[index][code] = code & 8 ? -diff : diff;
+            int next = index + index_change[code & 7];
+            codec_ima_next[index][code] = (uint8_t)(next < 0 ? 0 : next > 88 ? 88 : next);
+        }
+    }
+}
+
+void codec_UlawToPcm(const uint8_t* in, int16_t* out, size_t n){
+    for(size_t i = 0; i < n; i++) out[i] = codec_ulaw_table[in[i]];
+}
+
+void codec_AlawToPcm(const uint8_t* in, int16_t* out, size_t n){
+    for(size_t i = 0; i < n; i++) out[i] = codec_alaw_table[in[i]];
+}
+
+void codec_PcmToUlaw(const int16_t* in, uint8_t* out, size_t n){
+    for(size_t i = 0; i < n; i++) out[i] = codec_ulaw_encode[(uint16_t)in[i] >> 2];
+}
+
+void codec_PcmToAlaw(const int16_t* in, uint8_t* out, size_t n){
+    for(size_t i = 0; i < n; i++) out[i] = codec_alaw_encode[(uint16_t)in[i] >> 3];
+}
+
+/**
+ * @brief The predictor of one channel of an IMA ADPCM stream
+ */
+struct codec_adpcm_state {
+    int32_t predictor;
+    uint32_t index;
+};
+
+static inline int16_t codec_AdpcmStep(struct codec_adpcm_state* s, uint32_t code){
+    int32_t p = s->predictor + codec_ima_diff[s->index][code];
+    p = p < -32768 ? -32768 : p > 32767 ? 32767 : p;
+    s->predictor = p;
+    s->index = codec_ima_next[s->index][code];
+    return (int16_t)p;
+}
+
+/**
+ * @brief Returns the number of samples per channel in an IMA ADPCM block of `bytes` bytes: the sample of the block
+ * header and 8 samples for every 4 bytes of a channel
+ */
+uint32_t codec_AdpcmSamples(uint32_t bytes, uint32_t channels){
+    if(bytes < 4 * channels) return 0;
+    return 1 + (bytes - 4 * channels) / (4 * channels) * 8;
+}
+
+/**
+ * @brief Decodes one IMA ADPCM block to interleaved 16 bit samples
+ *
+ * @param frames the number of frames to write, at most codec_AdpcmSamples() of the block
+ */
+void codec_AdpcmDecodeBlock(const uint8_t* block, uint32_t channels, uint32_t frames, int16_t* out){
+    for(uint32_t c = 0; c < channels; c++){
+        const uint8_t* h = block + 4 * c;
+        struct codec_adpcm_state s = {(int16_t)(h[0] | h[1] << 8), h[2] > 88 ? 88u : h[2]};
+        if(frames > 0) out[c] = (int16_t)s.predictor;
+        // after the headers, 4 bytes (8 codes, low nibble first) of each channel in turn
+        const uint8_t* data = block + 4 * channels + 4 * c;
+        for(uint32_t i = 1; i < frames; data += 4 * channels){
+            for(uint32_t k = 0; k < 4 && i < frames; k++){
+                out[(size_t)i++ * channels + c] = codec_AdpcmStep(&s, data[k] & 0x0F);
+                if(i < frames) out[(size_t)i++ * channels + c] = codec_AdpcmStep(&s, data[k] >> 4);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Encodes interleaved 16 bit samples to one IMA ADPCM block. The step index carries over from the previous
+ * block, the predictor restarts at the first sample
+ *
+ * @param frames frames of input, at most the samples of a block. The last group of 8 codes is padded with the last sample
+ * @param states the predictor of every channel
+ * @param block receives 4 bytes per channel and 4 bytes per channel for every 8 frames after the first
+ *
+ * @returns the size of the block in bytes
+ */
+uint32_t codec_AdpcmEncodeBlock(const int16_t* in, uint32_t channels, uint32_t frames, struct codec_adpcm_state* states, uint8_t* block){
+    const uint32_t groups = frames > 1 ? (frames - 1 + 7) / 8 : 0;
+    for(uint32_t c = 0; c < channels; c++){
+        struct codec_adpcm_state* s = &states[c];
+        s->predictor = in[c];
+        uint8_t* h = block + 4 * c;
+        h[0] = (uint8_t)s->predictor;
+        h[1] = (uint8_t)(s->predictor >> 8);
+        h[2] = (uint8_t)s->index;
+        h[3] = 0;
+        uint8_t* data = block + 4 * channels + 4 * c;
+        for(uint32_t g = 0; g < groups; g++, data += 4 * channels){
+            for(uint32_t k = 0; k < 8; k++){
+                uint32_t i = 1 + g * 8 + k;
+                int32_t sample = in[(size_t)(i < frames ? i : frames - 1) * channels + c];
+                // the code whose step lands closest, found bit by bit like the decoder adds them
+                int32_t diff = sample - s->predictor;
+                uint32_t code = 0;
+                if(diff < 0){
+                    code = 8;
+                    diff = -diff;
+                }
+                int32_t step = codec_ima_steps[s->index];
+                if(diff >= step){ code |= 4; diff -= step; }
+                step >>= 1;
+                if(diff >= step){ code |= 2; diff -= step; }
+                step >>= 1;
+                if(diff >= step) code |= 1;
+                codec_AdpcmStep(s, code);
+                if(k % 2 == 0) data[k / 2] = (uint8_t)code;
+                else data[k / 2] |= (uint8_t)(code << 4);
+            }
+        }
+    }
+    return 4 * channels * (1 + groups);
+}
+
+/**
+ * @brief The block size of the IMA ADPCM files that the convert command writes, 256 bytes per channel up to 11025 Hz,
+ * 512 up to 22050 Hz and 1024 above, like the usual encoders
+ */
+uint32_t codec_AdpcmBlockAlign(uint32_t sample_rate, uint32_t channels){
+    return (sample_rate <= 11025 ? 256 : sample_rate <= 22050 ? 512 : 1024) * channels;
+}
+
+/**
+ * @brief The header of a WAV file of any format
+ */
+struct codec_wav {
+    uint16_t format;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    uint16_t samples_per_block;     // IMA ADPCM
+    uint32_t fact;                  // frames given by the fact chunk, UINT32_MAX if there is none
+    uint32_t data_size;
+};
+
+/**
+ * @brief The bytes of a header that were read from a stream that cannot seek back, replayed to the command
+ */
+struct codec_input {
+    struct codec_wav wav;
+    short decode;                   // 0 to pass the input through unchanged
+    uint8_t* prefix;
+    size_t prefix_size;
+    size_t prefix_capacity;
+};
+
+static short codec_Take(FILE* in, struct codec_input* input, size_t n, uint8_t* out){
+    if(input->prefix_size + n > CODEC_MAX_HEADER) return -1;
+    if(input->prefix_size + n > input->prefix_capacity){
+        size_t capacity = input->prefix_capacity == 0 ? 256 : input->prefix_capacity;
+        while(capacity < input->prefix_size + n) capacity *= 2;
+        uint8_t* grown = realloc(input->prefix, capacity);
+        if(grown == NULL) return -1;
+        input->prefix = grown;
+        input->prefix_capacity = capacity;
+    }
+    uint8_t* p = input->prefix + input->prefix_size;
+    size_t got = fread(p, 1, n, in);
+    input->prefix_size += got;
+    if(got != n) return -1;
+    if(out != NULL) memcpy(out, p, n);
+    return 0;
+}
+
+static uint32_t codec_U32(const uint8_t* b){
+    return b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+static uint16_t codec_U16(const uint8_t* b){
+    return (uint16_t)(b[0] | b[1] << 8);
+}
+
+/**
+ * @brief Reads the chunks of a WAV file up to the start of its data, keeping every byte read in input->prefix
+ *
+ * @returns 0 on success, -1 if the stream is not a WAV file this reader understands
+ */
+short codec_ReadHeader(FILE* in, struct codec_input* input){
+    struct codec_wav* w = &input->wav;
+    memset(w, 0, sizeof(struct codec_wav));
+    w->fact = UINT32_MAX;
+    uint8_t b[40];
+    if(codec_Take(in, input, 12, b) != 0 || memcmp(b, "RIFF", 4) != 0 || memcmp(b + 8, "WAVE", 4) != 0) return -1;
+    short have_format = 0;
+    for(;;){
+        if(codec_Take(in, input, 8, b) != 0) return -1;
+        const uint32_t size = codec_U32(b + 4);
+        if(memcmp(b, "data", 4) == 0){
+            w->data_size = size;
+            return have_format ? 0 : -1;
+        }
+        if(memcmp(b, "fmt ", 4) == 0 && size >= 16 && size <= sizeof(b)){
+            if(codec_Take(in, input, size + (size & 1), b) != 0) return -1;
+            w->format = codec_U16(b);
+            w->channels = codec_U16(b + 2);
+            w->sample_rate = codec_U32(b + 4);
+            w->block_align = codec_U16(b + 12);
+            w->bits_per_sample = codec_U16(b + 14);
+            if(size >= 20) w->samples_per_block = codec_U16(b + 18);
+            have_format = 1;
+        } else if(memcmp(b, "fact", 4) == 0 && size == 4){
+            if(codec_Take(in, input, 4, b) != 0) return -1;
+            w->fact = codec_U32(b);
+        } else{
+            // LIST and the other chunks before the data, chunks are padded to an even size
+            if(codec_Take(in, input, size + (size & 1), NULL) != 0) return -1;
+        }
+    }
+}
+
+/**
+ * @brief Returns 1 for the formats that codec_Decode() turns into 16 bit PCM
+ */
+short codec_Supported(uint16_t format){
+    return format == WAVE_FORMAT_MULAW || format == WAVE_FORMAT_ALAW || format == WAVE_FORMAT_IMA_ADPCM;
+}
+
+/**
+ * @brief Checks the fields of a compressed format and returns the number of frames of its data
+ *
+ * @returns 0 on success, -1 with an error reported if the header is invalid
+ */
+short codec_Frames(struct codec_wav* w, uint32_t* frames){
+    if(w->channels < 1 || w->channels > CODEC_MAX_CHANNELS || w->sample_rate == 0){
+        fprintf(stderr, "Error! the number of channels should be between 1 and %d\n", CODEC_MAX_CHANNELS);
+        return -1;
+    }
+    if(w->format == WAVE_FORMAT_IMA_ADPCM){
+        if(w->bits_per_sample != 4 || w->block_align < 4 * w->channels || w->block_align % (4 * w->channels) != 0){
+            fprintf(stderr, "Error! invalid IMA ADPCM block alignment %u\n", w->block_align);
+            return -1;
+        }
+        uint32_t per_block = codec_AdpcmSamples(w->block_align, w->channels);
+        if(w->samples_per_block == 0 || w->samples_per_block > per_block) w->samples_per_block = (uint16_t)per_block;
+        uint64_t n = (uint64_t)(w->data_size / w->block_align) * w->samples_per_block;
+        uint32_t last = codec_AdpcmSamples(w->data_size % w->block_align, w->channels);
+        n += last < w->samples_per_block ? last : w->samples_per_block;
+        *frames = n > UINT32_MAX ? UINT32_MAX : (uint32_t)n;
+    } else{
+        if(w->bits_per_sample != 8 || w->block_align != w->channels){
+            fprintf(stderr, "Error! companded samples should be 8 bits\n");
+            return -1;
+        }
+        *frames = w->data_size / w->channels;
+    }
+    if(w->fact < *frames) *frames = w->fact;
+    if((uint64_t)*frames * w->channels * 2 > UINT32_MAX - SIZE_OF_WAVE_HEADER){
+        fprintf(stderr, "Error! the decoded data would be larger than the 4GB limit of WAV files\n");
+        return -1;
+    }
+    return 0;
+}
+
+static short codec_Write(FILE* out, const void* data, size_t size){
+    return fwrite(data, 1, size, out) == size ? 0 : -1;
+}
+
+/**
+ * @brief The decoder of codec_Run(): writes a 16 bit PCM WAV file decoded from a mu-law, A-law or IMA ADPCM stream
+ * whose header has been read, or replays a header and copies the rest of a stream that needs no decoding
+ */
+int codec_Decode(FILE* in, FILE* out, void* arg){
+    struct codec_input* input = arg;
+    uint8_t* buffer = malloc(CODEC_BUFFER_SIZE * 3);
+    if(buffer == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        return 1;
+    }
+    if(!input->decode){
+        int status = input->prefix_size > 0 && codec_Write(out, input->prefix, input->prefix_size) != 0 ? 2 : 0;
+        for(size_t got; status == 0 && (got = fread(buffer, 1, CODEC_BUFFER_SIZE, in)) > 0;){
+            if(codec_Write(out, buffer, got) != 0) status = 2;
+        }
+        free(buffer);
+        return status;
+    }
+
+    pthread_once(&codec_tables_once, codec_InitTables);
+    struct codec_wav* w = &input->wav;
+    uint32_t frames;
+    if(codec_Frames(w, &frames) != 0){
+        free(buffer);
+        return 1;
+    }
+    const uint32_t channels = w->channels;
+    struct wav_header header;
+    header.format_chunk = 16;
+    header.wave_format = WAVE_FORMAT_PCM;
+    header.mono_stereo = (uint16_t)channels;
+    header.sample_rate = w->sample_rate;
+    header.block_align = (uint16_t)(2 * channels);
+    header.bytes_per_sec = header.sample_rate * header.block_align;
+    header.bits_per_sample = 16;
+    header.data_segment_size = frames * header.block_align;
+    header.size_of_file = SIZE_OF_WAVE_HEADER + header.data_segment_size;
+    fwrite_WavHeader(out, &header);
+
+    int status = 0;
+    int16_t* pcm = (int16_t*)(buffer + CODEC_BUFFER_SIZE);
+    if(w->format == WAVE_FORMAT_IMA_ADPCM){
+        // one block at a time, a block of 8 channels of 1024 bytes decodes to 16 KB
+        const uint32_t align = w->block_align;
+        for(uint32_t done = 0; status == 0 && done < frames;){
+            size_t got = fread(buffer, 1, align, in);
+            uint32_t n = codec_AdpcmSamples((uint32_t)got, channels);
+            if(n > w->samples_per_block) n = w->samples_per_block;
+            if(n > frames - done) n = frames - done;
+            if(n == 0){
+                fprintf(stderr, "Error! insufficient data\n");
+                status = 1;
+                break;
+            }
+            codec_AdpcmDecodeBlock(buffer, channels, n, pcm);
+            if(codec_Write(out, pcm, (size_t)n * channels * 2) != 0) status = 2;
+            done += n;
+        }
+    } else{
+        const uint32_t block = CODEC_BUFFER_SIZE / channels;
+        for(uint32_t done = 0; status == 0 && done < frames;){
+            uint32_t n = frames - done < block ? frames - done : block;
+            if(fread(buffer, 1, (size_t)n * channels, in) != (size_t)n * channels){
+                fprintf(stderr, "Error! insufficient data\n");
+                status = 1;
+                break;
+            }
+            if(w->format == WAVE_FORMAT_MULAW) codec_UlawToPcm(buffer, pcm, (size_t)n * channels);
+            else codec_AlawToPcm(buffer, pcm, (size_t)n * channels);
+            if(codec_Write(out, pcm, (size_t)n * channels * 2) != 0) status = 2;
+            done += n;
+        }
+    }
+    free(buffer);
+    return status;
+}
+
+/**
+ * @brief A stream that reads the output of a decoder thread through a pipe
+ */
+struct codec_stream {
+    codec_decoder decode;
+    void* arg;
+    FILE* in;
+    FILE* out;
+    FILE* reader;               // NULL when the stream reads the input directly
+    pthread_t decoder;
+    int locking;                // locking of the input, restored when the stream is closed
+    int status;
+    struct codec_input* input;  // the header read by codec_Open(), released when the stream is closed
+};
+
+/**
+ * @brief Thread entry point that runs a decoder into the write end of a pipe
+ */
+void* codec_StreamWorker(void* arg){
+    struct codec_stream* s = arg;
+    // a command that stops reading early closes the pipe, which must fail the write instead of killing the process
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    s->status = s->decode(s->in, s->out, s->arg);
+    fclose(s->out);
+    return NULL;
+}
+
+/**
+ * @brief Starts a decoder thread that reads a stream and writes a WAV file to a pipe
+ *
+ * @param s the stream, closed with codec_StreamClose()
+ *
+ * @returns the read end of the pipe, or NULL with an error reported
+ */
+FILE* codec_StreamOpen(struct codec_stream* s, codec_decoder decode, void* arg, FILE* in){
+    int fds[2];
+    if(pipe(fds) != 0){
+        fprintf(stderr, "Error! unable to create a pipe\n");
+        return NULL;
+    }
+    FILE* reader = fdopen(fds[0], "rb");
+    FILE* writer = fdopen(fds[1], "wb");
+    if(reader == NULL || writer == NULL){
+        fprintf(stderr, "Error! unable to create a pipe\n");
+        if(reader != NULL) fclose(reader);
+        else close(fds[0]);
+        if(writer != NULL) fclose(writer);
+        else close(fds[1]);
+        return NULL;
+    }
+    // every stream has one thread until the stream is closed, and the commands that read sample by sample would
+    // otherwise take the lock of the stream for every call once the decoder thread exists
+    setvbuf(reader, NULL, _IOFBF, CODEC_BUFFER_SIZE);
+    setvbuf(writer, NULL, _IOFBF, CODEC_BUFFER_SIZE);
+    __fsetlocking(reader, FSETLOCKING_BYCALLER);
+    __fsetlocking(writer, FSETLOCKING_BYCALLER);
+    s->decode = decode;
+    s->arg = arg;
+    s->in = in;
+    s->out = writer;
+    s->reader = reader;
+    s->status = 0;
+    s->locking = __fsetlocking(in, FSETLOCKING_BYCALLER);
+    if(pthread_create(&s->decoder, NULL, codec_StreamWorker, s) != 0){
+        fprintf(stderr, "Error! unable to start the decoder\n");
+        fclose(reader);
+        fclose(writer);
+        __fsetlocking(in, s->locking);
+        s->reader = NULL;
+        return NULL;
+    }
+    return reader;
+}
+
+/**
+ * @brief Closes a stream, waiting for its decoder thread
+ *
+ * @returns the status of the decoder, see codec_decoder
+ */
+int codec_StreamClose(struct codec_stream* s){
+    int status = 0;
+    if(s->reader != NULL){
+        fclose(s->reader);
+        pthread_join(s->decoder, NULL);
+        __fsetlocking(s->in, s->locking);
+        s->reader = NULL;
+        status = s->status;
+    }
+    if(s->input != NULL){
+        free(s->input->prefix);
+        free(s->input);
+        s->input = NULL;
+    }
+    return status;
+}
+
+/**
+ * @brief Runs a command line with its STDIN replaced by a pipe that a decoder thread fills from the original STDIN
+ *
+ * @param run the function that runs the command line
+ *
+ * @returns the status of the command, or 1 if the input could not be decoded
+ */
+int codec_PipeRun(codec_decoder decode, void* arg, int (*run)(int, char*[]), int argc, char* argv[]){
+    struct codec_stream s;
+    memset(&s, 0, sizeof(s));
+    FILE* reader = codec_StreamOpen(&s, decode, arg, IO_IN);
+    if(reader == NULL) return 1;
+    int locking = __fsetlocking(IO_OUT, FSETLOCKING_BYCALLER);
+    FILE* previous = io_input;
+    io_input = reader;
+    codec_piped = 1;
+    int status = run(argc, argv);
+    codec_piped = 0;
+    io_input = previous;
+    int decoded = codec_StreamClose(&s);
+    __fsetlocking(IO_OUT, locking);
+    return decoded == 1 ? 1 : status;
+}
+
+/**
+ * @brief Returns 1 if the input of a command has to go through codec_Run(): it is a mu-law, A-law or IMA ADPCM WAV
+ * file, or it is a stream that cannot seek back, whose format is only known once its header has been read. A terminal
+ * is never read here, so a command that only prints its usage does not wait for input
+ */
+short codec_Detect(FILE* in){
+    if(codec_piped || isatty(fileno(in))) return 0;
+    off_t start = ftello(in);
+    if(start < 0) return 1;
+    struct codec_input input;
+    memset(&input, 0, sizeof(input));
+    short found = codec_ReadHeader(in, &input) == 0 && codec_Supported(input.wav.format);
+    free(input.prefix);
+    clearerr(in);
+    if(fseeko(in, start, SEEK_SET) != 0){
+        fprintf(stderr, "Error! unable to seek back to the start of the input\n");
+        return 0;
+    }
+    return found;
+}
+
+/**
+ * @brief Runs a command line on its input decoded to 16 bit PCM, see codec_Detect()
+ *
+ * @param run the function that runs the command line
+ *
+ * @returns the status of the command, or 1 if the input could not be decoded
+ */
+int codec_Run(int (*run)(int, char*[]), int argc, char* argv[]){
+    struct codec_input input;
+    memset(&input, 0, sizeof(input));
+    // a stream that is not a WAV file, or a PCM one, reaches the command unchanged and the command reports it
+    input.decode = codec_ReadHeader(IO_IN, &input) == 0 && codec_Supported(input.wav.format);
+    int status = codec_PipeRun(codec_Decode, &input, run, argc, argv);
+    free(input.prefix);
+    return status;
+}
+
+/**
+ * @brief Opens a WAV file for reading: a mu-law, A-law or IMA ADPCM file is decoded to 16 bit PCM by a thread, any
+ * other file is read directly
+ *
+ * @param s the stream, closed with codec_StreamClose() once the file has been read
+ *
+ * @returns the stream to read, or NULL with an error reported
+ */
+FILE* codec_Open(FILE* in, struct codec_stream* s){
+    memset(s, 0, sizeof(struct codec_stream));
+    if(!codec_Detect(in)) return in;
+    s->input = calloc(1, sizeof(struct codec_input));
+    if(s->input == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        return NULL;
+    }
+    s->input->decode = codec_ReadHeader(in, s->input) == 0 && codec_Supported(s->input->wav.format);
+    FILE* reader = codec_StreamOpen(s, codec_Decode, s->input, in);
+    if(reader == NULL) codec_StreamClose(s);
+    return reader;
+}
+
+/**
+ * @brief Returns 1 if the data of a WAV file is PCM or float samples that pcm_ToFloat() converts
+ */
+short codec_Readable(const struct codec_wav* w){
+    const short pcm = w->format == WAVE_FORMAT_PCM && (w->bits_per_sample == 8 || w->bits_per_sample == 16 ||
+                                                      w->bits_per_sample == 24 || w->bits_per_sample == 32);
+    const short is_float = w->format == WAVE_FORMAT_IEEE_FLOAT && w->bits_per_sample == 32;
+    return (pcm || is_float) && w->channels > 0 && w->sample_rate > 0 && w->block_align == w->channels * w->bits_per_sample / 8;
+}
+
+/**
+ * @brief A WAV file of PCM or float samples read in blocks downmixed to mono and resampled
+ */
+struct codec_mono {
+    struct codec_wav wav;
+    uint32_t remaining;             // frames left in the data
+    char* raw;
+    float* samples;
+    float* out;
+    double step;                    // input samples per output sample
+    double phase;
+    float sum;
+    uint32_t summed;
+    float last;
+};
+
+/**
+ * @brief Reads the header of a WAV file of PCM or float samples, with any chunks before its data
+ *
+ * @param rate the sample rate of the blocks of codec_MonoRead(), 0 for the rate of the file
+ *
+ * @returns 0 on success, -1 with an error reported. On success the reader is released with codec_MonoClose()
+ */
+short codec_MonoOpen(FILE* in, struct codec_mono* m, uint32_t rate){
+    struct codec_input input;
+    memset(&input, 0, sizeof(input));
+    memset(m, 0, sizeof(struct codec_mono));
+    short status = codec_ReadHeader(in, &input);
+    free(input.prefix);
+    m->wav = input.wav;
+    const struct codec_wav* w = &m->wav;
+    if(status != 0){
+        fprintf(stderr, "Error! not a WAV file\n");
+        return -1;
+    }
+    if(!codec_Readable(w)){
+        fprintf(stderr, "Error! unsupported WAV format %u with %u bits/sample\n", w->format, w->bits_per_sample);
+        return -1;
+    }
+    m->remaining = w->data_size / w->block_align;
+    m->step = rate == 0 ? 1.0 : (double)w->sample_rate / rate;
+    m->raw = malloc((size_t)STREAM_BLOCK_FRAMES * w->block_align);
+    m->samples = malloc((size_t)STREAM_BLOCK_FRAMES * w->channels * sizeof(float));
+    m->out = malloc(((size_t)(STREAM_BLOCK_FRAMES / m->step) + 2) * sizeof(float));
+    if(m->raw == NULL || m->samples == NULL || m->out == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free(m->raw);
+        free(m->samples);
+        free(m->out);
+        return -1;
+    }
+    return 0;
+}
+
+void codec_MonoClose(struct codec_mono* m){
+    free(m->raw);
+    free(m->samples);
+    free(m->out);
+    memset(m, 0, sizeof(struct codec_mono));
+}
+
+/**
+ * @brief Reads the next block of a file. Each output sample is the mean of the input samples of its period, which is
+ * also the low pass filter of the resampling. A file cut short is read up to its end
+ *
+ * @param samples receives a pointer to the samples, valid until the next call
+ *
+ * @returns the number of samples, 0 at the end of the data
+ */
+uint32_t codec_MonoRead(FILE* in, struct codec_mono* m, const float** samples){
+    const struct codec_wav* w = &m->wav;
+    const uint32_t channels = w->channels;
+    uint32_t produced = 0;
+    while(produced == 0 && m->remaining > 0){
+        uint32_t frames = m->remaining < STREAM_BLOCK_FRAMES ? m->remaining : STREAM_BLOCK_FRAMES;
+        size_t got = fread(m->raw, w->block_align, frames, in);
+        if(got == 0){
+            m->remaining = 0;
+            break;
+        }
+        frames = (uint32_t)got;
+        m->remaining -= frames;
+        pcm_ToFloat(m->raw, m->samples, frames * channels, w->format, w->bits_per_sample);
+        if(m->step == 1.0 && channels == 1){
+            memcpy(m->out, m->samples, frames * sizeof(float));
+            produced = frames;
+            break;
+        }
+        for(uint32_t i = 0; i < frames; i++){
+            float x = 0.0f;
+            for(uint32_t c = 0; c < channels; c++) x += m->samples[i * channels + c];
+            m->sum += x / (float)channels;
+            m->summed++;
+            m->phase += 1.0;
+            while(m->phase >= m->step){
+                m->phase -= m->step;
+                if(m->summed > 0) m->last = m->sum / (float)m->summed;
+                m->sum = 0.0f;
+                m->summed = 0;
+                m->out[produced++] = m->last;
+            }
+        }
+    }
+    *samples = m->out;
+    return produced;
+}
+
+/**
+ * @brief Writes the header of a mu-law, A-law or IMA ADPCM WAV file: an extended format chunk, a fact chunk and the
+ * header of the data chunk
+ *
+ * @param frames the number of frames of the data
+ * @param data_size the size of the data in bytes
+ */
+void codec_WriteHeader(uint16_t format, uint16_t channels, uint32_t sample_rate, uint32_t frames, uint32_t data_size){
+    uint8_t b[60];
+    const uint32_t format_size = format == WAVE_FORMAT_IMA_ADPCM ? 20 : 18;
+    const uint32_t align = format == WAVE_FORMAT_IMA_ADPCM ? codec_AdpcmBlockAlign(sample_rate, channels) : channels;
+    const uint32_t per_block = format == WAVE_FORMAT_IMA_ADPCM ? codec_AdpcmSamples(align, channels) : 1;
+    const uint32_t bytes_per_sec = (uint32_t)((uint64_t)sample_rate * align / per_block);
+    const uint32_t header_size = 12 + 8 + format_size + 12 + 8;
+    const uint32_t u32[7] = {header_size - 8 + data_size, format_size, sample_rate, bytes_per_sec, 4, frames, data_size};
+    const uint32_t u32_at[7] = {4, 16, 24, 28, 24 + format_size, 28 + format_size, 36 + format_size};
+
+    memset(b, 0, sizeof(b));
+    memcpy(b, "RIFF", 4);
+    memcpy(b + 8, "WAVEfmt ", 8);
+    memcpy(b + 20 + format_size, "fact", 4);
+    memcpy(b + 32 + format_size, "data", 4);
+    for(uint32_t i = 0; i < 7; i++){
+        for(uint32_t k = 0; k < 4; k++) b[u32_at[i] + k] = (uint8_t)(u32[i] >> (8 * k));
+    }
+    const uint16_t u16[6] = {format, channels, (uint16_t)align, format == WAVE_FORMAT_IMA_ADPCM ? 4 : 8,
+                             (uint16_t)(format_size - 18), (uint16_t)per_block};
+    const uint32_t u16_at[6] = {20, 22, 32, 34, 36, 38};
+    for(uint32_t i = 0; i < (format == WAVE_FORMAT_IMA_ADPCM ? 6u : 5u); i++){
+        b[u16_at[i]] = (uint8_t)u16[i];
+        b[u16_at[i] + 1] = (uint8_t)(u16[i] >> 8);
+    }
+    stats_Format(1, u16[3]);
+    write_Block(b, header_size);
+}
@@ -0,0 +1,245 @@
+/**
+ * @file convolve.h
+ * @author Rafael Diolatzis
+ * @brief Uniformly partitioned overlap-save FFT convolution
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * The impulse response is cut into partitions of `block` samples and the spectrum of every partition is computed
+ * once with an FFT of 2 x block. Every block of input is transformed once and pushed into a frequency-domain delay
+ * line (FDL) that keeps the spectra of the last `partitions` input blocks. An output block is the inverse FFT of
+ * the sum of FDL[i] x IR[i] over all partitions, of which the last `block` samples are kept (overlap-save).
+ * The cost per output sample is two FFTs of 2 x block divided by block, plus one complex multiply-add per partition.
+ */
+
+#pragma once
+
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include"utils.h"
+#include"fft.h"
+
+#if defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+/**
+ * @brief The partitioned spectrum of an impulse response. It is read-only once created, so channels that use the same
+ * impulse response share it
+ */
+struct conv_ir {
+    struct fft_plan* plan;      // transform of 2 x block
+    uint32_t block;
+    uint32_t partitions;
+    uint32_t bins;              // block + 1
+    uint32_t stride;            // bins rounded up to a multiple of 4 floats
+    float* re;                  // [partitions][stride]
+    float* im;                  // [partitions][stride]
+};
+
+/**
+ * @brief The streaming state of one channel
+ */
+struct conv_state {
+    const struct conv_ir* ir;
+    uint32_t head;              // FDL slot of the most recent input block
+    float* fdl_re;              // [partitions][stride]
+    float* fdl_im;              // [partitions][stride]
+    float* input;               // previous block followed by the current block
+    float* acc_re;
+    float* acc_im;
+    float* time;
+    float* scratch;
+};
+
+/**
+ * @brief Picks a partition size for an impulse response when the user did not ask for one
+ *
+ * Offline processing has no latency budget, so partitions of about an eighth of the impulse response keep the
+ * number of multiply-adds per sample low while the FFTs stay a reasonable size.
+ */
+uint32_t conv_DefaultBlock(uint32_t ir_length){
+    uint32_t block = 256;
+    while(block < ir_length / 8 && block < 16384){
+        block *= 2;
+    }
+    return block;
+}
+
+/**
+ * @brief Releases an impulse response created with conv_ir_Create
+ */
+void conv_ir_Destroy(struct conv_ir* ir){
+    if(ir == NULL) return;
+    fft_plan_Destroy(ir->plan);
+    free_Aligned(ir->re);
+    free_Aligned(ir->im);
+    free(ir);
+}
+
+/**
+ * @brief Splits an impulse response in partitions and computes their spectra
+ *
+ * @param samples the impulse response
+ * @param length the number of samples of the impulse response
+ * @param block the partition size. Must be a power of two and at least 4
+ * @param gain a gain folded into the spectra
+ *
+ * @returns the impulse response or NULL on failure
+ */
+struct conv_ir* conv_ir_Create(const float* samples, uint32_t length, uint32_t block, float gain){
+    if(length == 0) return NULL;
+
+    struct conv_ir* ir = calloc(1, sizeof(struct conv_ir));
+    if(ir == NULL) return NULL;
+
+    ir->plan = fft_plan_Create(2 * block);
+    if(ir->plan == NULL){
+        free(ir);
+        return NULL;
+    }
+    ir->block = block;
+    ir->partitions = (length + block - 1) / block;
+    ir->bins = block + 1;
+    ir->stride = (ir->bins + 3) & ~3u;
+    ir->re = alloc_Aligned((size_t)ir->partitions * ir->stride * sizeof(float));
+    ir->im = alloc_Aligned((size_t)ir->partitions * ir->stride * sizeof(float));
+
+    float* padded = alloc_Aligned(2 * block * sizeof(float));
+    float* scratch = alloc_Aligned(fft_ScratchSize(ir->plan) * sizeof(float));
+    if(ir->re == NULL || ir->im == NULL || padded == NULL || scratch == NULL){
+        free_Aligned(padded);
+        free_Aligned(scratch);
+        conv_ir_Destroy(ir);
+        return NULL;
+    }
+
+    for(uint32_t p = 0; p < ir->partitions; p++){
+        uint32_t start = p * block;
+        uint32_t n = length - start < block ? length - start : block;
+        memset(padded, 0, 2 * block * sizeof(float));
+        for(uint32_t i = 0; i < n; i++){
+            padded[i] = samples[start + i] * gain;
+        }
+        float* re = ir->re + (size_t)p * ir->stride;
+        float* im = ir->im + (size_t)p * ir->stride;
+        fft_Forward(ir->plan, padded, re, im, scratch);
+        for(uint32_t k = ir->bins; k < ir->stride; k++){
+            re[k] = 0.0f;
+            im[k] = 0.0f;
+        }
+    }
+
+    free_Aligned(padded);
+    free_Aligned(scratch);
+    return ir;
+}
+
+/**
+ * @brief Releases a state created with conv_state_Create
+ */
+void conv_state_Destroy(struct conv_state* state){
+    if(state == NULL) return;
+    free_Aligned(state->fdl_re);
+    free_Aligned(state->fdl_im);
+    free_Aligned(state->input);
+    free_Aligned(state->acc_re);
+    free_Aligned(state->acc_im);
+    free_Aligned(state->time);
+    free_Aligned(state->scratch);
+    free(state);
+}
+
+/**
+ * @brief Creates the streaming state of one channel with an empty (silent) history
+ *
+ * @returns the state or NULL on failure
+ */
+struct conv_state* conv_state_Create(const struct conv_ir* ir){
+    struct conv_state* state = calloc(1, sizeof(struct conv_state));
+    if(state == NULL) return NULL;
+
+    size_t fdl_size = (size_t)ir->partitions * ir->stride * sizeof(float);
+    state->ir = ir;
+    state->fdl_re = alloc_Aligned(fdl_size);
+    state->fdl_im = alloc_Aligned(fdl_size);
+    state->input = alloc_Aligned(2 * ir->block * sizeof(float));
+    state->acc_re = alloc_Aligned(ir->stride * sizeof(float));
+    state->acc_im = alloc_Aligned(ir->stride * sizeof(float));
+    state->time = alloc_Aligned(2 * ir->block * sizeof(float));
+    state->scratch = alloc_Aligned(fft_ScratchSize(ir->plan) * sizeof(float));
+    if(state->fdl_re == NULL || state->fdl_im == NULL || state->input == NULL || state->acc_re == NULL ||
+       state->acc_im == NULL || state->time == NULL || state->scratch == NULL){
+        conv_state_Destroy(state);
+        return NULL;
+    }
+
+    memset(state->fdl_re, 0, fdl_size);
+    memset(state->fdl_im, 0, fdl_size);
+    memset(state->input, 0, 2 * ir->block * sizeof(float));
+    return state;
+}
+
+/**
+ * @brief Accumulates the complex product x * h of two split spectra into acc
+ */
+void conv_MultiplyAdd(const float* xr, const float* xi, const float* hr, const float* hi,
+                      float* acc_re, float* acc_im, uint32_t count){
+    uint32_t k = 0;
+#if defined(__SSE2__)
+    for(; k + 4 <= count; k += 4){
+        __m128 a = _mm_load_ps(xr + k), b = _mm_load_ps(xi + k);
+        __m128 c = _mm_load_ps(hr + k), d = _mm_load_ps(hi + k);
+        __m128 re = _mm_sub_ps(_mm_mul_ps(a, c), _mm_mul_ps(b, d));
+        __m128 im = _mm_add_ps(_mm_mul_ps(a, d), _mm_mul_ps(b, c));
+        _mm_store_ps(acc_re + k, _mm_add_ps(_mm_load_ps(acc_re + k), re));
+        _mm_store_ps(acc_im + k, _mm_add_ps(_mm_load_ps(acc_im + k), im));
+    }
+#endif
+    for(; k < count; k++){
+        acc_re[k] += xr[k] * hr[k] - xi[k] * hi[k];
+        acc_im[k] += xr[k] * hi[k] + xi[k] * hr[k];
+    }
+}
+
+/**
+ * @brief Convolves one block of a channel with the impulse response
+ *
+ * @param state the state of the channel
+ * @param in ir->block input samples
+ * @param out receives ir->block output samples. May be the same buffer as `in`
+ */
+void conv_state_Process(struct conv_state* state, const float* in, float* out){
+    const struct conv_ir* ir = state->ir;
+    const uint32_t block = ir->block;
+    const uint32_t stride = ir->stride;
+
+    // Slide the input window and transform it into the newest FDL slot
+    memcpy(state->input, state->input + block, block * sizeof(float));
+    memcpy(state->input + block, in, block * sizeof(float));
+
+    state->head = state->head + 1 < ir->partitions ? state->head + 1 : 0;
+    float* xr = state->fdl_re + (size_t)state->head * stride;
+    float* xi = state->fdl_im + (size_t)state->head * stride;
+    fft_Forward(ir->plan, state->input, xr, xi, state->scratch);
+    for(uint32_t k = ir->bins; k < stride; k++){
+        xr[k] = 0.0f;
+        xi[k] = 0.0f;
+    }
+
+    memset(state->acc_re, 0, stride * sizeof(float));
+    memset(state->acc_im, 0, stride * sizeof(float));
+    uint32_t slot = state->head;
+    for(uint32_t p = 0; p < ir->partitions; p++){
+        conv_MultiplyAdd(state->fdl_re + (size_t)slot * stride, state->fdl_im + (size_t)slot * stride,
+                         ir->re + (size_t)p * stride, ir->im + (size_t)p * stride,
+                         state->acc_re, state->acc_im, stride);
+        slot = slot == 0 ? ir->partitions - 1 : slot - 1;
+    }
+
+    fft_Inverse(ir->plan, state->acc_re, state->acc_im, state->time, state->scratch);
+    memcpy(out, state->time + block, block * sizeof(float));
+}
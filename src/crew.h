@@ -0,0 +1,146 @@
+/**
+ * @file crew.h
+ * @author Rafael Diolatzis
+ * @brief A fixed set of worker threads that run one job each per round, for commands that process a stream in blocks
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Commands that split every block of a stream between threads (the channels of convolve, the frames of spectrum)
+ * would otherwise create and join their threads once per block. A crew starts its threads once. Each worker owns one
+ * job of an array and keeps it, with whatever scratch memory the job holds, for the whole stream. crew_Start wakes
+ * the workers for a round, the caller runs the jobs that have no worker itself, and crew_Wait returns when every
+ * worker has finished its job of the round. A mutex and two condition variables hand the rounds over; a round is at
+ * least a block of the stream, so that costs little next to the work.
+ */
+
+#pragma once
+
+#include<stdlib.h>
+#include<stdint.h>
+#include<pthread.h>
+
+/**
+ * @brief The workers of a crew and the round they are in
+ */
+struct crew {
+    void* (*work)(void*);
+    char* jobs;                 // the job of worker i is at jobs + i * size
+    size_t size;
+    pthread_t* ids;
+    int count;                  // workers started
+    uint64_t round;             // rounds started so far
+    int pending;                // workers still running the current round
+    short stop;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+};
+
+/**
+ * @brief One worker of a crew
+ */
+struct crew_member {
+    struct crew* crew;
+    int index;
+};
+
+/**
+ * @brief Thread entry point of a worker: runs its job once per round until the crew stops
+ */
+void* crew_Member(void* arg){
+    struct crew_member* member = arg;
+    struct crew* crew = member->crew;
+    void* job = crew->jobs + (size_t)member->index * crew->size;
+    free(member);
+
+    uint64_t seen = 0;
+    pthread_mutex_lock(&crew->lock);
+    for(;;){
+        while(crew->round == seen && !crew->stop) pthread_cond_wait(&crew->start, &crew->lock);
+        if(crew->stop) break;
+        seen = crew->round;
+        pthread_mutex_unlock(&crew->lock);
+        crew->work(job);
+        pthread_mutex_lock(&crew->lock);
+        if(--crew->pending == 0) pthread_cond_signal(&crew->done);
+    }
+    pthread_mutex_unlock(&crew->lock);
+    return NULL;
+}
+
+/**
+ * @brief Starts up to workers threads, one for each of the first jobs of an array
+ *
+ * @param work the function run on a job every round
+ * @param jobs the array of jobs, which must outlive the crew
+ * @param size the size of one job
+ *
+ * @returns the number of workers started, fewer than asked when a thread could not be created. The caller runs the
+ * jobs from that index on itself
+ */
+int crew_Create(struct crew* crew, int workers, void* (*work)(void*), void* jobs, size_t size){
+    crew->work = work;
+    crew->jobs = jobs;
+    crew->size = size;
+    crew->count = 0;
+    crew->round = 0;
+    crew->pending = 0;
+    crew->stop = 0;
+    pthread_mutex_init(&crew->lock, NULL);
+    pthread_cond_init(&crew->start, NULL);
+    pthread_cond_init(&crew->done, NULL);
+    crew->ids = workers > 0 ? malloc(workers * sizeof(pthread_t)) : NULL;
+    if(crew->ids == NULL) return 0;
+
+    while(crew->count < workers){
+        struct crew_member* member = malloc(sizeof(struct crew_member));
+        if(member == NULL) break;
+        member->crew = crew;
+        member->index = crew->count;
+        if(pthread_create(&crew->ids[crew->count], NULL, crew_Member, member) != 0){
+            free(member);
+            break;
+        }
+        crew->count++;
+    }
+    return crew->count;
+}
+
+/**
+ * @brief Wakes every worker to run its job once
+ */
+void crew_Start(struct crew* crew){
+    pthread_mutex_lock(&crew->lock);
+    crew->round++;
+    crew->pending = crew->count;
+    pthread_cond_broadcast(&crew->start);
+    pthread_mutex_unlock(&crew->lock);
+}
+
+/**
+ * @brief Waits until every worker has finished the round started last
+ */
+void crew_Wait(struct crew* crew){
+    pthread_mutex_lock(&crew->lock);
+    while(crew->pending > 0) pthread_cond_wait(&crew->done, &crew->lock);
+    pthread_mutex_unlock(&crew->lock);
+}
+
+/**
+ * @brief Stops and joins the workers. The crew must not be in a round
+ */
+void crew_Destroy(struct crew* crew){
+    pthread_mutex_lock(&crew->lock);
+    crew->stop = 1;
+    pthread_cond_broadcast(&crew->start);
+    pthread_mutex_unlock(&crew->lock);
+    for(int i = 0; i < crew->count; i++) pthread_join(crew->ids[i], NULL);
+    free(crew->ids);
+    crew->ids = NULL;
+    crew->count = 0;
+    pthread_mutex_destroy(&crew->lock);
+    pthread_cond_destroy(&crew->start);
+    pthread_cond_destroy(&crew->done);
+}
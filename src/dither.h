@@ -0,0 +1,152 @@
+/**
+ * @file dither.h
+ * @author Rafael Diolatzis
+ * @brief TPDF dither and noise shaping for reducing the bit depth of samples
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * The dither is the difference of two uniform random numbers, which gives a triangular distribution of +-1 LSB.
+ * The random numbers come from 8 independent xorshift32 generators kept in two SSE registers, so one step of the
+ * generators produces the dither of 4 samples. Without noise shaping the dither is simply added before rounding,
+ * which is a vectorizable pass over the block. With noise shaping the quantization error of every channel is fed
+ * back through a second order filter, (1 - z^-1)^2, which moves the noise towards high frequencies.
+ */
+
+#pragma once
+
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include"utils.h"
+
+#if defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+#define DITHER_MAX_CHANNELS 8
+
+/**
+ * @brief The state of a dithering stream
+ */
+struct dither_state {
+    uint32_t rng[8];                            // xorshift32 states, lanes 0-3 and 4-7 give the two uniform values
+    short shape;                                // 1 to enable noise shaping
+    float error[DITHER_MAX_CHANNELS][2];        // last two quantization errors of every channel, in LSBs
+};
+
+/**
+ * @brief Initializes a dithering stream
+ *
+ * @param state the state
+ * @param seed any value, streams with the same seed produce the same dither
+ * @param shape 1 to enable noise shaping
+ */
+void dither_Init(struct dither_state* state, uint32_t seed, short shape){
+    memset(state, 0, sizeof(struct dither_state));
+    state->shape = shape;
+    for(uint32_t i = 0; i < 8; i++){
+        // splitmix the seed so every lane starts from an unrelated, non-zero state
+        uint32_t z = seed + 0x9E3779B9u * (i + 1);
+        z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+        z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+        z ^= z >> 16;
+        state->rng[i] = z ? z : 0x12345678u;
+    }
+}
+
+/**
+ * @brief Returns the seed of the dither of one block of a file
+ *
+ * Without noise shaping every block of STREAM_BLOCK_FRAMES frames starts a stream of its own, so a block gets the
+ * same dither whether the file is processed in order or in ranges on several threads.
+ *
+ * @param block the index of the block in the data segment
+ */
+uint32_t dither_BlockSeed(uint64_t block){
+    return 0x5EED + (uint32_t)block * 0x9E3779B1u;
+}
+
+/**
+ * @brief Fills a buffer with TPDF dither in the range (-1, 1) LSB
+ *
+ * @param state the state
+ * @param out receives the dither
+ * @param count the number of values
+ */
+void dither_Fill(struct dither_state* state, float* out, uint32_t count){
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    __m128i a = _mm_loadu_si128((const __m128i*)state->rng);
+    __m128i b = _mm_loadu_si128((const __m128i*)(state->rng + 4));
+    const __m128i mantissa = _mm_set1_epi32(0x3F800000);
+    for(; i + 4 <= count; i += 4){
+        a = _mm_xor_si128(a, _mm_slli_epi32(a, 13));
+        a = _mm_xor_si128(a, _mm_srli_epi32(a, 17));
+        a = _mm_xor_si128(a, _mm_slli_epi32(a, 5));
+        b = _mm_xor_si128(b, _mm_slli_epi32(b, 13));
+        b = _mm_xor_si128(b, _mm_srli_epi32(b, 17));
+        b = _mm_xor_si128(b, _mm_slli_epi32(b, 5));
+        // the top 23 bits become the mantissa of a float in [1, 2)
+        __m128 ua = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(a, 9), mantissa));
+        __m128 ub = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(b, 9), mantissa));
+        _mm_storeu_ps(out + i, _mm_sub_ps(ua, ub));
+    }
+    _mm_storeu_si128((__m128i*)state->rng, a);
+    _mm_storeu_si128((__m128i*)(state->rng + 4), b);
+#endif
+    for(; i < count; i++){
+        uint32_t lane = i & 3;
+        uint32_t a = state->rng[lane];
+        uint32_t b = state->rng[lane + 4];
+        a ^= a << 13; a ^= a >> 17; a ^= a << 5;
+        b ^= b << 13; b ^= b >> 17; b ^= b << 5;
+        state->rng[lane] = a;
+        state->rng[lane + 4] = b;
+        out[i] = (float)(a >> 9) * (1.0f / 8388608.0f) - (float)(b >> 9) * (1.0f / 8388608.0f);
+    }
+}
+
+/**
+ * @brief Dithers a block of float samples so that pcm_FromFloat quantizes them to `bits` bits without truncation distortion
+ *
+ * Without noise shaping the dither is added to the samples. With noise shaping the samples are quantized here and
+ * replaced by the exact float value of the quantized sample, so pcm_FromFloat writes them unchanged.
+ *
+ * @param state the state
+ * @param samples the interleaved samples, modified in place
+ * @param dither scratch space for frames x channels floats
+ * @param frames the number of frames
+ * @param channels the number of interleaved channels, at most DITHER_MAX_CHANNELS when noise shaping is enabled
+ * @param bits the bit depth that the samples will be quantized to (8, 16 or 24)
+ */
+void dither_Apply(struct dither_state* state, float* samples, float* dither, uint32_t frames, uint32_t channels, uint16_t bits){
+    const uint32_t count = frames * channels;
+    const float scale = (float)(1u << (bits - 1));
+    const float lsb = 1.0f / scale;
+    dither_Fill(state, dither, count);
+
+    if(!state->shape){
+        for(uint32_t i = 0; i < count; i++){
+            samples[i] += dither[i] * lsb;
+        }
+        return;
+    }
+
+    const float top = scale - 1.0f;
+    for(uint32_t i = 0; i < frames; i++){
+        for(uint32_t c = 0; c < channels; c++){
+            float* e = state->error[c];
+            float* x = &samples[(size_t)i * channels + c];
+            float v = *x * scale - (2.0f * e[0] - e[1]);
+            float q = rintf(v + dither[(size_t)i * channels + c]);
+            q = q > top ? top : (q < -scale ? -scale : q);
+            e[1] = e[0];
+            // clipping can make the error large, bound it so the feedback loop stays stable
+            e[0] = fminf(fmaxf(q - v, -4.0f), 4.0f);
+            *x = q * lsb;
+        }
+    }
+}
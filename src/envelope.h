@@ -0,0 +1,230 @@
+/**
+ * @file envelope.h
+ * @author Rafael Diolatzis
+ * @brief Gain envelopes (fades and breakpoint files) rendered block by block into ramp tables
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * An envelope is never rendered for the whole file. For every block only the gains of that block are written to a
+ * small table, which is then applied with the same multiply/saturate kernels as the volume command. Blocks outside
+ * of any fade and whose breakpoints hold a gain of exactly 1 are reported as constant so the caller can skip the table.
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include"utils.h"
+
+#define ENVELOPE_CURVE_LINEAR 0
+#define ENVELOPE_CURVE_LOG 1
+#define ENVELOPE_CURVE_SCURVE 2
+
+#define ENVELOPE_LOG_RANGE_DB 60.0
+
+/**
+ * @brief A gain envelope over the frames of a file
+ */
+struct gain_envelope {
+    uint64_t total;         // number of frames of the file
+    uint64_t fade_in;       // length of the fade in, in frames
+    uint64_t fade_out;      // length of the fade out, in frames
+    int curve;
+
+    uint32_t points;        // number of breakpoints, zero for none
+    double* times;          // breakpoint positions in frames, increasing
+    double* gains;          // breakpoint gains
+    uint32_t segment;       // breakpoint segment of the last block, blocks are requested in order
+};
+
+/**
+ * @brief Parses the name of a fade curve
+ *
+ * @returns one of the ENVELOPE_CURVE_* values or -1 if the name is unknown
+ */
+int envelope_ParseCurve(const char* name){
+    if(strcmp(name, "lin") == 0) return ENVELOPE_CURVE_LINEAR;
+    if(strcmp(name, "log") == 0) return ENVELOPE_CURVE_LOG;
+    if(strcmp(name, "scurve") == 0) return ENVELOPE_CURVE_SCURVE;
+    return -1;
+}
+
+/**
+ * @brief Evaluates a fade in curve
+ *
+ * @param curve one of the ENVELOPE_CURVE_* values
+ * @param t the position inside the fade, from 0 (start) to 1 (end)
+ *
+ * @returns the gain, from 0 to 1
+ */
+double envelope_Curve(int curve, double t){
+    if(t <= 0.0) return 0.0;
+    if(t >= 1.0) return 1.0;
+    if(curve == ENVELOPE_CURVE_LOG){
+        // linear in dB from -ENVELOPE_LOG_RANGE_DB to 0 dB
+        return pow(10.0, (t - 1.0) * ENVELOPE_LOG_RANGE_DB / 20.0);
+    }
+    if(curve == ENVELOPE_CURVE_SCURVE){
+        return 0.5 - 0.5 * cos(M_PI * t);
+    }
+    return t;
+}
+
+/**
+ * @brief Releases the breakpoints of an envelope
+ */
+void envelope_Free(struct gain_envelope* env){
+    free(env->times);
+    free(env->gains);
+    env->times = NULL;
+    env->gains = NULL;
+    env->points = 0;
+}
+
+/**
+ * @brief Loads breakpoints from a text file with one "<time> <gain>" pair per line
+ *
+ * Times accept the same units as parse_Seconds ("1.5", "2s", "500ms") and must increase. Gains are linear ("0.5")
+ * or in decibels ("-6dB"). Empty lines and lines starting with '#' are ignored. The gain is interpolated linearly
+ * between breakpoints and held before the first and after the last one.
+ *
+ * @param env the envelope that receives the breakpoints
+ * @param path the path of the file
+ * @param sample_rate the sample rate used to convert times to frames
+ *
+ * @returns 0 on success or -1 on failure, after printing an error message
+ */
+int envelope_Load(struct gain_envelope* env, const char* path, uint32_t sample_rate){
+    FILE* file = fopen(path, "r");
+    if(file == NULL){
+        fprintf(stderr, "Error! unable to open %s\n", path);
+        return -1;
+    }
+
+    uint32_t capacity = 16;
+    env->points = 0;
+    env->segment = 0;
+    env->times = malloc(capacity * sizeof(double));
+    env->gains = malloc(capacity * sizeof(double));
+
+    char line[256];
+    uint32_t number = 0;
+    const char* error = NULL;
+    while(error == NULL && fgets(line, sizeof(line), file) != NULL){
+        number++;
+        char time_text[64], gain_text[64];
+        char* start = line + strspn(line, " \t");
+        if(*start == '#' || *start == '\n' || *start == '\r' || *start == '\0') continue;
+
+        short flag = sscanf(start, "%63s %63s", time_text, gain_text) != 2;
+        double seconds = flag ? 0.0 : parse_Seconds(time_text, &flag);
+        double gain = flag ? 0.0 : parse_Gain(gain_text, &flag);
+        double frame = seconds * sample_rate;
+        if(flag){
+            error = "expected \"<time> <gain>\"";
+        }else if(env->points > 0 && frame < env->times[env->points - 1]){
+            error = "breakpoint times should increase";
+        }else if(env->times == NULL || env->gains == NULL){
+            error = "unable to allocate memory";
+        }else{
+            if(env->points == capacity){
+                capacity *= 2;
+                double* times = realloc(env->times, capacity * sizeof(double));
+                if(times != NULL) env->times = times;
+                double* gains = realloc(env->gains, capacity * sizeof(double));
+                if(gains != NULL) env->gains = gains;
+                if(times == NULL || gains == NULL){
+                    error = "unable to allocate memory";
+                    break;
+                }
+            }
+            env->times[env->points] = frame;
+            env->gains[env->points] = gain;
+            env->points++;
+        }
+    }
+    fclose(file);
+
+    if(error != NULL){
+        fprintf(stderr, "Error! %s:%" PRIu32 ": %s\n", path, number, error);
+        envelope_Free(env);
+        return -1;
+    }
+    if(env->points == 0){
+        fprintf(stderr, "Error! %s has no breakpoints\n", path);
+        envelope_Free(env);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the breakpoint gain at a frame. Frames must be requested in increasing order
+ */
+double envelope_Breakpoint(struct gain_envelope* env, double frame){
+    if(frame <= env->times[0]) return env->gains[0];
+    if(frame >= env->times[env->points - 1]) return env->gains[env->points - 1];
+    while(env->segment + 1 < env->points && env->times[env->segment + 1] <= frame){
+        env->segment++;
+    }
+    double t0 = env->times[env->segment], t1 = env->times[env->segment + 1];
+    double g0 = env->gains[env->segment], g1 = env->gains[env->segment + 1];
+    return t1 > t0 ? g0 + (g1 - g0) * (frame - t0) / (t1 - t0) : g1;
+}
+
+/**
+ * @brief Returns 1 if the breakpoint gain is exactly 1 at every frame from first to last. Frames must be requested in
+ * increasing order
+ */
+short envelope_Unity(struct gain_envelope* env, double first, double last){
+    while(env->segment + 1 < env->points && env->times[env->segment + 1] <= first){
+        env->segment++;
+    }
+    // the gain between two breakpoints is interpolated, so it is 1 only if both ends are
+    for(uint32_t i = env->segment; i < env->points; i++){
+        if(env->gains[i] != 1.0) return 0;
+        if(env->times[i] >= last) break;
+    }
+    return 1;
+}
+
+/**
+ * @brief Renders the gains of a block of frames, repeated for every channel
+ *
+ * @param env the envelope. Blocks must be requested in increasing order
+ * @param first the index of the first frame of the block
+ * @param frames the number of frames of the block
+ * @param channels the number of interleaved channels
+ * @param gains receives frames x channels gains
+ *
+ * @returns 1 if every gain of the block is exactly 1, in which case `gains` is left untouched, and 0 otherwise
+ */
+short envelope_Fill(struct gain_envelope* env, uint64_t first, uint32_t frames, uint32_t channels, double* gains){
+    const uint64_t last = first + frames;
+    const uint64_t out_start = env->total > env->fade_out ? env->total - env->fade_out : 0;
+    short faded = (env->fade_in > 0 && first < env->fade_in) || (env->fade_out > 0 && last > out_start);
+    if(!faded && (env->points == 0 || envelope_Unity(env, (double)first, (double)last - 1.0))) return 1;
+
+    for(uint32_t i = 0; i < frames; i++){
+        uint64_t frame = first + i;
+        double gain = 1.0;
+        if(env->fade_in > 0 && frame < env->fade_in){
+            gain *= envelope_Curve(env->curve, (double)frame / env->fade_in);
+        }
+        if(env->fade_out > 0 && frame >= out_start){
+            gain *= envelope_Curve(env->curve, (double)(env->total - 1 - frame) / env->fade_out);
+        }
+        if(env->points > 0){
+            gain *= envelope_Breakpoint(env, (double)frame);
+        }
+        for(uint32_t c = 0; c < channels; c++){
+            gains[(size_t)i * channels + c] = gain;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,406 @@
+/**
+ * @file fft.h
+ * @author Rafael Diolatzis
+ * @brief Real-input FFT used by the spectral commands
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * A real transform of size n is computed as a complex transform of size n/2 followed by a split step.
+ * The complex transform is a Stockham autosort FFT (no bit reversal pass) made of radix-4 stages and, when
+ * log2(n/2) is odd, one final radix-2 stage. Real and imaginary parts are kept in separate arrays so that
+ * four butterflies can be computed at once with SSE. All twiddle factors are computed once when the plan is
+ * created and are stored stage by stage in the order the butterflies read them.
+ */
+
+#pragma once
+
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include"utils.h"
+
+#if defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+#define FFT_MAX_STAGES 32
+
+/**
+ * @brief Precomputed tables for a real FFT of a fixed size. A plan is read-only after creation and can be shared between threads.
+ */
+struct fft_plan {
+    uint32_t n;                             // real transform size
+    uint32_t m;                             // complex transform size (n / 2)
+    uint32_t stages;
+    uint32_t tw_offset[FFT_MAX_STAGES];     // offset of every radix-4 stage inside tw
+    float* tw;                              // w^p, w^2p, w^3p for every stage as 6 arrays (re, im) of length/4 floats
+    float* rcos;                            // cos(2 pi k / n) for the real split step
+    float* rsin;                            // sin(2 pi k / n) for the real split step
+};
+
+/**
+ * @brief Checks if a value is a power of two
+ */
+int fft_IsPowerOfTwo(uint32_t value){
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+/**
+ * @brief Creates the tables for a real FFT of size n
+ *
+ * @param n the transform size. Must be a power of two and at least 8
+ *
+ * @returns the plan or NULL if n is not valid or memory could not be allocated
+ */
+struct fft_plan* fft_plan_Create(uint32_t n){
+    if(!fft_IsPowerOfTwo(n) || n < 8) return NULL;
+
+    struct fft_plan* plan = calloc(1, sizeof(struct fft_plan));
+    if(plan == NULL) return NULL;
+
+    plan->n = n;
+    plan->m = n / 2;
+
+    // Count the twiddles of all radix-4 stages
+    uint32_t total = 0;
+    uint32_t length = plan->m;
+    while(length >= 4){
+        plan->tw_offset[plan->stages++] = total;
+        total += 6 * (length / 4);
+        length /= 4;
+    }
+
+    plan->tw = alloc_Aligned((total + 4) * sizeof(float));
+    plan->rcos = alloc_Aligned(plan->m * sizeof(float));
+    plan->rsin = alloc_Aligned(plan->m * sizeof(float));
+    if(plan->tw == NULL || plan->rcos == NULL || plan->rsin == NULL){
+        free_Aligned(plan->tw);
+        free_Aligned(plan->rcos);
+        free_Aligned(plan->rsin);
+        free(plan);
+        return NULL;
+    }
+
+    length = plan->m;
+    for(uint32_t stage = 0; stage < plan->stages; stage++){
+        uint32_t q = length / 4;
+        float* w = plan->tw + plan->tw_offset[stage];
+        for(uint32_t p = 0; p < q; p++){
+            double theta = -2.0 * M_PI * p / length;
+            w[0*q + p] = (float)cos(theta);
+            w[1*q + p] = (float)sin(theta);
+            w[2*q + p] = (float)cos(2 * theta);
+            w[3*q + p] = (float)sin(2 * theta);
+            w[4*q + p] = (float)cos(3 * theta);
+            w[5*q + p] = (float)sin(3 * theta);
+        }
+        length /= 4;
+    }
+
+    for(uint32_t k = 0; k < plan->m; k++){
+        double theta = 2.0 * M_PI * k / n;
+        plan->rcos[k] = (float)cos(theta);
+        plan->rsin[k] = (float)sin(theta);
+    }
+
+    return plan;
+}
+
+/**
+ * @brief Releases a plan created with fft_plan_Create
+ */
+void fft_plan_Destroy(struct fft_plan* plan){
+    if(plan == NULL) return;
+    free_Aligned(plan->tw);
+    free_Aligned(plan->rcos);
+    free_Aligned(plan->rsin);
+    free(plan);
+}
+
+/**
+ * @brief Returns the number of floats of scratch memory that fft_Forward and fft_Inverse need
+ */
+uint32_t fft_ScratchSize(const struct fft_plan* plan){
+    return 4 * plan->m + 16;
+}
+
+/**
+ * @brief One radix-4 Stockham stage
+ *
+ * @param length the length of the sub-transforms of this stage
+ * @param s the stride (number of interleaved sub-transforms)
+ * @param w the twiddles of the stage
+ */
+void fft_Radix4(uint32_t length, uint32_t s, const float* w,
+                const float* xr, const float* xi, float* yr, float* yi){
+    const uint32_t q = length / 4;
+    const float* w1r = w;
+    const float* w1i = w + q;
+    const float* w2r = w + 2*q;
+    const float* w2i = w + 3*q;
+    const float* w3r = w + 4*q;
+    const float* w3i = w + 5*q;
+
+#if defined(__SSE2__)
+    if(s == 1 && q % 4 == 0){
+        // First stage: the sub-transforms are contiguous, vectorize across p and transpose the outputs back in place
+        for(uint32_t p = 0; p < q; p += 4){
+            __m128 ar = _mm_loadu_ps(xr + p),       ai = _mm_loadu_ps(xi + p);
+            __m128 br = _mm_loadu_ps(xr + p + q),   bi = _mm_loadu_ps(xi + p + q);
+            __m128 cr = _mm_loadu_ps(xr + p + 2*q), ci = _mm_loadu_ps(xi + p + 2*q);
+            __m128 dr = _mm_loadu_ps(xr + p + 3*q), di = _mm_loadu_ps(xi + p + 3*q);
+
+            __m128 apcr = _mm_add_ps(ar, cr), apci = _mm_add_ps(ai, ci);
+            __m128 amcr = _mm_sub_ps(ar, cr), amci = _mm_sub_ps(ai, ci);
+            __m128 bpdr = _mm_add_ps(br, dr), bpdi = _mm_add_ps(bi, di);
+            __m128 bmdr = _mm_sub_ps(br, dr), bmdi = _mm_sub_ps(bi, di);
+
+            __m128 y0r = _mm_add_ps(apcr, bpdr), y0i = _mm_add_ps(apci, bpdi);
+            // amc - j*bmd and amc + j*bmd
+            __m128 t1r = _mm_add_ps(amcr, bmdi), t1i = _mm_sub_ps(amci, bmdr);
+            __m128 t2r = _mm_sub_ps(apcr, bpdr), t2i = _mm_sub_ps(apci, bpdi);
+            __m128 t3r = _mm_sub_ps(amcr, bmdi), t3i = _mm_add_ps(amci, bmdr);
+
+            __m128 c1 = _mm_loadu_ps(w1r + p), s1 = _mm_loadu_ps(w1i + p);
+            __m128 c2 = _mm_loadu_ps(w2r + p), s2 = _mm_loadu_ps(w2i + p);
+            __m128 c3 = _mm_loadu_ps(w3r + p), s3 = _mm_loadu_ps(w3i + p);
+
+            __m128 y1r = _mm_sub_ps(_mm_mul_ps(t1r, c1), _mm_mul_ps(t1i, s1));
+            __m128 y1i = _mm_add_ps(_mm_mul_ps(t1r, s1), _mm_mul_ps(t1i, c1));
+            __m128 y2r = _mm_sub_ps(_mm_mul_ps(t2r, c2), _mm_mul_ps(t2i, s2));
+            __m128 y2i = _mm_add_ps(_mm_mul_ps(t2r, s2), _mm_mul_ps(t2i, c2));
+            __m128 y3r = _mm_sub_ps(_mm_mul_ps(t3r, c3), _mm_mul_ps(t3i, s3));
+            __m128 y3i = _mm_add_ps(_mm_mul_ps(t3r, s3), _mm_mul_ps(t3i, c3));
+
+            _MM_TRANSPOSE4_PS(y0r, y1r, y2r, y3r);
+            _MM_TRANSPOSE4_PS(y0i, y1i, y2i, y3i);
+            _mm_storeu_ps(yr + 4*p,      y0r); _mm_storeu_ps(yi + 4*p,      y0i);
+            _mm_storeu_ps(yr + 4*p + 4,  y1r); _mm_storeu_ps(yi + 4*p + 4,  y1i);
+            _mm_storeu_ps(yr + 4*p + 8,  y2r); _mm_storeu_ps(yi + 4*p + 8,  y2i);
+            _mm_storeu_ps(yr + 4*p + 12, y3r); _mm_storeu_ps(yi + 4*p + 12, y3i);
+        }
+        return;
+    }
+
+    if(s % 4 == 0){
+        // Later stages: vectorize across the interleaved sub-transforms, the twiddle is the same for all lanes
+        for(uint32_t p = 0; p < q; p++){
+            const __m128 c1 = _mm_set1_ps(w1r[p]), s1 = _mm_set1_ps(w1i[p]);
+            const __m128 c2 = _mm_set1_ps(w2r[p]), s2 = _mm_set1_ps(w2i[p]);
+            const __m128 c3 = _mm_set1_ps(w3r[p]), s3 = _mm_set1_ps(w3i[p]);
+            const float* ar_ = xr + s*p;           const float* ai_ = xi + s*p;
+            const float* br_ = xr + s*(p + q);     const float* bi_ = xi + s*(p + q);
+            const float* cr_ = xr + s*(p + 2*q);   const float* ci_ = xi + s*(p + 2*q);
+            const float* dr_ = xr + s*(p + 3*q);   const float* di_ = xi + s*(p + 3*q);
+            float* y0r_ = yr + s*(4*p);     float* y0i_ = yi + s*(4*p);
+            float* y1r_ = yr + s*(4*p + 1); float* y1i_ = yi + s*(4*p + 1);
+            float* y2r_ = yr + s*(4*p + 2); float* y2i_ = yi + s*(4*p + 2);
+            float* y3r_ = yr + s*(4*p + 3); float* y3i_ = yi + s*(4*p + 3);
+
+            for(uint32_t j = 0; j < s; j += 4){
+                __m128 ar = _mm_loadu_ps(ar_ + j), ai = _mm_loadu_ps(ai_ + j);
+                __m128 br = _mm_loadu_ps(br_ + j), bi = _mm_loadu_ps(bi_ + j);
+                __m128 cr = _mm_loadu_ps(cr_ + j), ci = _mm_loadu_ps(ci_ + j);
+                __m128 dr = _mm_loadu_ps(dr_ + j), di = _mm_loadu_ps(di_ + j);
+
+                __m128 apcr = _mm_add_ps(ar, cr), apci = _mm_add_ps(ai, ci);
+                __m128 amcr = _mm_sub_ps(ar, cr), amci = _mm_sub_ps(ai, ci);
+                __m128 bpdr = _mm_add_ps(br, dr), bpdi = _mm_add_ps(bi, di);
+                __m128 bmdr = _mm_sub_ps(br, dr), bmdi = _mm_sub_ps(bi, di);
+
+                __m128 t1r = _mm_add_ps(amcr, bmdi), t1i = _mm_sub_ps(amci, bmdr);
+                __m128 t2r = _mm_sub_ps(apcr, bpdr), t2i = _mm_sub_ps(apci, bpdi);
+                __m128 t3r = _mm_sub_ps(amcr, bmdi), t3i = _mm_add_ps(amci, bmdr);
+
+                _mm_storeu_ps(y0r_ + j, _mm_add_ps(apcr, bpdr));
+                _mm_storeu_ps(y0i_ + j, _mm_add_ps(apci, bpdi));
+                _mm_storeu_ps(y1r_ + j, _mm_sub_ps(_mm_mul_ps(t1r, c1), _mm_mul_ps(t1i, s1)));
+                _mm_storeu_ps(y1i_ + j, _mm_add_ps(_mm_mul_ps(t1r, s1), _mm_mul_ps(t1i, c1)));
+                _mm_storeu_ps(y2r_ + j, _mm_sub_ps(_mm_mul_ps(t2r, c2), _mm_mul_ps(t2i, s2)));
+                _mm_storeu_ps(y2i_ + j, _mm_add_ps(_mm_mul_ps(t2r, s2), _mm_mul_ps(t2i, c2)));
+                _mm_storeu_ps(y3r_ + j, _mm_sub_ps(_mm_mul_ps(t3r, c3), _mm_mul_ps(t3i, s3)));
+                _mm_storeu_ps(y3i_ + j, _mm_add_ps(_mm_mul_ps(t3r, s3), _mm_mul_ps(t3i, c3)));
+            }
+        }
+        return;
+    }
+#endif
+
+    for(uint32_t p = 0; p < q; p++){
+        for(uint32_t j = 0; j < s; j++){
+            float ar = xr[j + s*p],         ai = xi[j + s*p];
+            float br = xr[j + s*(p + q)],   bi = xi[j + s*(p + q)];
+            float cr = xr[j + s*(p + 2*q)], ci = xi[j + s*(p + 2*q)];
+            float dr = xr[j + s*(p + 3*q)], di = xi[j + s*(p + 3*q)];
+
+            float apcr = ar + cr, apci = ai + ci;
+            float amcr = ar - cr, amci = ai - ci;
+            float bpdr = br + dr, bpdi = bi + di;
+            float bmdr = br - dr, bmdi = bi - di;
+
+            float t1r = amcr + bmdi, t1i = amci - bmdr;
+            float t2r = apcr - bpdr, t2i = apci - bpdi;
+            float t3r = amcr - bmdi, t3i = amci + bmdr;
+
+            yr[j + s*(4*p)] = apcr + bpdr;
+            yi[j + s*(4*p)] = apci + bpdi;
+            yr[j + s*(4*p + 1)] = t1r * w1r[p] - t1i * w1i[p];
+            yi[j + s*(4*p + 1)] = t1r * w1i[p] + t1i * w1r[p];
+            yr[j + s*(4*p + 2)] = t2r * w2r[p] - t2i * w2i[p];
+            yi[j + s*(4*p + 2)] = t2r * w2i[p] + t2i * w2r[p];
+            yr[j + s*(4*p + 3)] = t3r * w3r[p] - t3i * w3i[p];
+            yi[j + s*(4*p + 3)] = t3r * w3i[p] + t3i * w3r[p];
+        }
+    }
+}
+
+/**
+ * @brief The final radix-2 Stockham stage, used when log2 of the complex size is odd. Its twiddles are all 1.
+ *
+ * @param s the stride (half the complex transform size)
+ */
+void fft_Radix2(uint32_t s, const float* xr, const float* xi, float* yr, float* yi){
+    uint32_t j = 0;
+#if defined(__SSE2__)
+    for(; j + 4 <= s; j += 4){
+        __m128 ar = _mm_loadu_ps(xr + j),     ai = _mm_loadu_ps(xi + j);
+        __m128 br = _mm_loadu_ps(xr + s + j), bi = _mm_loadu_ps(xi + s + j);
+        _mm_storeu_ps(yr + j,     _mm_add_ps(ar, br));
+        _mm_storeu_ps(yi + j,     _mm_add_ps(ai, bi));
+        _mm_storeu_ps(yr + s + j, _mm_sub_ps(ar, br));
+        _mm_storeu_ps(yi + s + j, _mm_sub_ps(ai, bi));
+    }
+#endif
+    for(; j < s; j++){
+        float ar = xr[j], ai = xi[j];
+        float br = xr[s + j], bi = xi[s + j];
+        yr[j] = ar + br;
+        yi[j] = ai + bi;
+        yr[s + j] = ar - br;
+        yi[s + j] = ai - bi;
+    }
+}
+
+/**
+ * @brief Forward complex FFT of size plan->m, ping-ponging between the (ar, ai) and (br, bi) buffers
+ *
+ * @returns 0 if the result ended up in (ar, ai) and 1 if it ended up in (br, bi)
+ */
+int fft_Complex(const struct fft_plan* plan, float* ar, float* ai, float* br, float* bi){
+    uint32_t length = plan->m;
+    uint32_t s = 1;
+    int in_b = 0;
+
+    for(uint32_t stage = 0; stage < plan->stages; stage++){
+        const float* w = plan->tw + plan->tw_offset[stage];
+        if(in_b){
+            fft_Radix4(length, s, w, br, bi, ar, ai);
+        } else{
+            fft_Radix4(length, s, w, ar, ai, br, bi);
+        }
+        in_b = !in_b;
+        length /= 4;
+        s *= 4;
+    }
+
+    if(length == 2){
+        if(in_b){
+            fft_Radix2(s, br, bi, ar, ai);
+        } else{
+            fft_Radix2(s, ar, ai, br, bi);
+        }
+        in_b = !in_b;
+    }
+    return in_b;
+}
+
+/**
+ * @brief Computes the spectrum of plan->n real samples
+ *
+ * @param plan the plan of the transform
+ * @param in plan->n real samples
+ * @param re receives the real part of bins 0 to n/2 (n/2 + 1 values)
+ * @param im receives the imaginary part of bins 0 to n/2 (n/2 + 1 values)
+ * @param scratch fft_ScratchSize(plan) floats owned by the caller
+ */
+void fft_Forward(const struct fft_plan* plan, const float* in, float* re, float* im, float* scratch){
+    const uint32_t m = plan->m;
+    float* ar = scratch;
+    float* ai = scratch + m;
+    float* br = scratch + 2*m;
+    float* bi = scratch + 3*m;
+
+    // Pack even samples as the real part and odd samples as the imaginary part
+    for(uint32_t k = 0; k < m; k++){
+        ar[k] = in[2*k];
+        ai[k] = in[2*k + 1];
+    }
+
+    float* zr = ar;
+    float* zi = ai;
+    if(fft_Complex(plan, ar, ai, br, bi)){
+        zr = br;
+        zi = bi;
+    }
+
+    re[0] = zr[0] + zi[0];
+    im[0] = 0.0f;
+    re[m] = zr[0] - zi[0];
+    im[m] = 0.0f;
+
+    for(uint32_t k = 1; k < m; k++){
+        float Ar = zr[k], Ai = zi[k];
+        float Br = zr[m - k], Bi = -zi[m - k];
+        float fer = 0.5f * (Ar + Br), fei = 0.5f * (Ai + Bi);
+        float for_ = 0.5f * (Ai - Bi), foi = -0.5f * (Ar - Br);
+        float c = plan->rcos[k], s = plan->rsin[k];
+        re[k] = fer + c * for_ + s * foi;
+        im[k] = fei + c * foi - s * for_;
+    }
+}
+
+/**
+ * @brief Computes plan->n real samples from their spectrum. The result is normalized so that fft_Inverse(fft_Forward(x)) == x
+ *
+ * @param plan the plan of the transform
+ * @param re the real part of bins 0 to n/2
+ * @param im the imaginary part of bins 0 to n/2
+ * @param out receives plan->n real samples
+ * @param scratch fft_ScratchSize(plan) floats owned by the caller
+ */
+void fft_Inverse(const struct fft_plan* plan, const float* re, const float* im, float* out, float* scratch){
+    const uint32_t m = plan->m;
+    float* ar = scratch;
+    float* ai = scratch + m;
+    float* br = scratch + 2*m;
+    float* bi = scratch + 3*m;
+
+    for(uint32_t k = 0; k < m; k++){
+        float Ar = re[k], Ai = im[k];
+        float Br = re[m - k], Bi = -im[m - k];
+        float fer = 0.5f * (Ar + Br), fei = 0.5f * (Ai + Bi);
+        float dr = 0.5f * (Ar - Br), di = 0.5f * (Ai - Bi);
+        float c = plan->rcos[k], s = plan->rsin[k];
+        float for_ = dr * c - di * s;
+        float foi = dr * s + di * c;
+        ar[k] = fer - foi;
+        ai[k] = fei + for_;
+    }
+
+    // An inverse transform is a forward transform with the real and imaginary parts swapped
+    float* zr = ai;
+    float* zi = ar;
+    if(fft_Complex(plan, ai, ar, bi, br)){
+        zr = bi;
+        zi = br;
+    }
+
+    const float scale = 1.0f / m;
+    for(uint32_t k = 0; k < m; k++){
+        out[2*k] = zi[k] * scale;
+        out[2*k + 1] = zr[k] * scale;
+    }
+}
@@ -0,0 +1,763 @@
+/**
+ * @file fingerprint.h
+ * @author Rafael Diolatzis
+ * @brief Spectral peak fingerprints of WAV files and an on-disk inverted index to find duplicates and their offsets
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * A file is downmixed, resampled to 11025 Hz and cut into frames of 1024 samples every 512 samples (46 ms). The peaks
+ * of the magnitude spectrum are the bins that are the largest within +-10 bins and +-3 frames, and that stand out from
+ * the mean log magnitude of their frame, at most 5 per frame. Because the test is relative, the same audio at another
+ * gain gives the same peaks, and because the samples are decoded first, so does the same audio in another format or
+ * with other chunks in its header.
+ *
+ * Every peak (the anchor) is paired with the next peaks up to 63 frames later, at most 5 of them, and each pair is a
+ * 24 bit hash of the two frequencies and the frame distance, stored with the frame of the anchor. Two files that share
+ * audio share many hashes, all with the same difference between their frames.
+ *
+ * The index is one file: a header, a directory of 65536 buckets selected by the top 16 bits of a hash, the postings
+ * (hash, file, frame) sorted by hash, and the names of the files. A query maps the file and reads only the buckets of
+ * its own hashes, so its cost depends on the query and on the postings of the same hashes, not on the size of the
+ * index. The postings vote for (file, frame difference) pairs and the pairs with the most votes are the matches.
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<inttypes.h>
+#include<string.h>
+#include<math.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<pthread.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include"utils.h"
+#include"fft.h"
+#include"codec.h"
+#include"flac.h"
+#include"batch.h"
+
+#define FINGERPRINT_RATE 11025
+#define FINGERPRINT_FFT 1024
+#define FINGERPRINT_HOP 512
+#define FINGERPRINT_BINS 512            // the Nyquist bin is left out
+#define FINGERPRINT_MIN_BIN 2           // and the bins below 20 Hz
+#define FINGERPRINT_NEIGHBOR_BINS 10
+#define FINGERPRINT_NEIGHBOR_FRAMES 3
+#define FINGERPRINT_SPAN (2 * FINGERPRINT_NEIGHBOR_FRAMES + 1)
+#define FINGERPRINT_THRESHOLD 2.3f      // natural log of the magnitude over the mean of the frame, 20 dB
+#define FINGERPRINT_PEAKS 5
+#define FINGERPRINT_FANOUT 5
+#define FINGERPRINT_MAX_DT 63
+#define FINGERPRINT_MAX_DF 127
+
+#define FINGERPRINT_INDEX_MAGIC "SWFPIDX1"
+#define FINGERPRINT_BUCKET_BITS 16
+#define FINGERPRINT_BUCKETS (1u << FINGERPRINT_BUCKET_BITS)
+#define FINGERPRINT_MAX_POSTINGS (1u << 16)  // hashes more common than this match too much to tell files apart
+
+/**
+ * @brief A hash and the frame of its anchor peak
+ */
+struct fingerprint_hash {
+    uint32_t hash;
+    uint32_t frame;
+};
+
+/**
+ * @brief The hashes of one file
+ */
+struct fingerprint {
+    struct fingerprint_hash* hashes;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t frames;                // frames of FINGERPRINT_HOP samples at FINGERPRINT_RATE
+};
+
+struct fingerprint_peak {
+    uint16_t bin;
+    uint16_t pairs;
+};
+
+/**
+ * @brief The streaming analysis of one file, a few frames of memory whatever the length of the file
+ */
+struct fingerprint_state {
+    const struct fft_plan* plan;
+    float* scratch;
+    float window[FINGERPRINT_FFT];
+    float frame[FINGERPRINT_FFT];
+    float re[FINGERPRINT_FFT / 2 + 1];
+    float im[FINGERPRINT_FFT / 2 + 1];
+    float magnitude[FINGERPRINT_SPAN][FINGERPRINT_BINS];    // log magnitude of the last frames
+    float local[FINGERPRINT_SPAN][FINGERPRINT_BINS];        // largest log magnitude within +-10 bins
+    float mean[FINGERPRINT_SPAN];
+    struct fingerprint_peak peaks[FINGERPRINT_MAX_DT + 1][FINGERPRINT_PEAKS];
+    uint32_t peak_count[FINGERPRINT_MAX_DT + 1];
+    uint32_t fill;                  // samples in frame
+    uint32_t frames;                // frames analyzed
+    struct fingerprint* out;
+};
+
+/**
+ * @brief Releases the hashes of a fingerprint
+ */
+void fingerprint_Free(struct fingerprint* fp){
+    free(fp->hashes);
+    memset(fp, 0, sizeof(struct fingerprint));
+}
+
+static short fingerprint_Push(struct fingerprint* fp, uint32_t hash, uint32_t frame){
+    if(fp->count == fp->capacity){
+        uint32_t capacity = fp->capacity == 0 ? 1024 : fp->capacity * 2;
+        struct fingerprint_hash* grown = realloc(fp->hashes, capacity * sizeof(struct fingerprint_hash));
+        if(grown == NULL) return -1;
+        fp->hashes = grown;
+        fp->capacity = capacity;
+    }
+    fp->hashes[fp->count].hash = hash;
+    fp->hashes[fp->count].frame = frame;
+    fp->count++;
+    return 0;
+}
+
+/**
+ * @brief Creates the state of the analysis of a file
+ *
+ * @param plan a plan of FINGERPRINT_FFT points, shared between threads
+ * @param out receives the hashes
+ *
+ * @returns the state or NULL if memory could not be allocated
+ */
+struct fingerprint_state* fingerprint_state_Create(const struct fft_plan* plan, struct fingerprint* out){
+    struct fingerprint_state* st = calloc(1, sizeof(struct fingerprint_state));
+    if(st == NULL) return NULL;
+    st->scratch = alloc_Aligned(fft_ScratchSize(plan) * sizeof(float));
+    if(st->scratch == NULL){
+        free(st);
+        return NULL;
+    }
+    st->plan = plan;
+    for(uint32_t i = 0; i < FINGERPRINT_FFT; i++) st->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / FINGERPRINT_FFT));
+    st->out = out;
+    memset(out, 0, sizeof(struct fingerprint));
+    return st;
+}
+
+void fingerprint_state_Destroy(struct fingerprint_state* st){
+    if(st == NULL) return;
+    free_Aligned(st->scratch);
+    free(st);
+}
+
+/**
+ * @brief Pairs the peaks of a frame, as targets, with the anchors of the frames before it that have pairs left
+ */
+static short fingerprint_Pair(struct fingerprint_state* st, uint32_t frame){
+    const struct fingerprint_peak* targets = st->peaks[frame % (FINGERPRINT_MAX_DT + 1)];
+    const uint32_t target_count = st->peak_count[frame % (FINGERPRINT_MAX_DT + 1)];
+    for(uint32_t dt = frame < FINGERPRINT_MAX_DT ? frame : FINGERPRINT_MAX_DT; dt >= 1; dt--){
+        const uint32_t anchor = frame - dt;
+        struct fingerprint_peak* anchors = st->peaks[anchor % (FINGERPRINT_MAX_DT + 1)];
+        for(uint32_t a = 0; a < st->peak_count[anchor % (FINGERPRINT_MAX_DT + 1)]; a++){
+            for(uint32_t t = 0; t < target_count && anchors[a].pairs < FINGERPRINT_FANOUT; t++){
+                int df = (int)targets[t].bin - (int)anchors[a].bin;
+                if(df < -FINGERPRINT_MAX_DF || df > FINGERPRINT_MAX_DF) continue;
+                uint32_t hash = (uint32_t)anchors[a].bin << 15 | (uint32_t)targets[t].bin << 6 | dt;
+                if(fingerprint_Push(st->out, hash, anchor) != 0) return -1;
+                anchors[a].pairs++;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Finds the peaks of a frame once the frames around it are known, and pairs them
+ *
+ * @param last the last frame analyzed, the frames after it are not part of the neighborhood
+ */
+static short fingerprint_Peaks(struct fingerprint_state* st, uint32_t frame, uint32_t last){
+    const uint32_t first = frame < FINGERPRINT_NEIGHBOR_FRAMES ? 0 : frame - FINGERPRINT_NEIGHBOR_FRAMES;
+    const uint32_t end = frame + FINGERPRINT_NEIGHBOR_FRAMES < last ? frame + FINGERPRINT_NEIGHBOR_FRAMES : last;
+    const float* magnitude = st->magnitude[frame % FINGERPRINT_SPAN];
+    const float threshold = st->mean[frame % FINGERPRINT_SPAN] + FINGERPRINT_THRESHOLD;
+    struct fingerprint_peak* peaks = st->peaks[frame % (FINGERPRINT_MAX_DT + 1)];
+    float strength[FINGERPRINT_PEAKS];
+    uint32_t count = 0;
+    for(uint32_t k = FINGERPRINT_MIN_BIN; k < FINGERPRINT_BINS; k++){
+        const float m = magnitude[k];
+        if(m < threshold) continue;
+        short peak = 1;
+        for(uint32_t r = first; r <= end && peak; r++) peak = m >= st->local[r % FINGERPRINT_SPAN][k];
+        if(!peak) continue;
+        // the strongest peaks of the frame, weakest last
+        uint32_t at = count < FINGERPRINT_PEAKS ? count++ : FINGERPRINT_PEAKS;
+        if(at == FINGERPRINT_PEAKS && m <= strength[FINGERPRINT_PEAKS - 1]) continue;
+        if(at == FINGERPRINT_PEAKS) at = FINGERPRINT_PEAKS - 1;
+        while(at > 0 && strength[at - 1] < m){
+            strength[at] = strength[at - 1];
+            peaks[at] = peaks[at - 1];
+            at--;
+        }
+        strength[at] = m;
+        peaks[at].bin = (uint16_t)k;
+        peaks[at].pairs = 0;
+    }
+    st->peak_count[frame % (FINGERPRINT_MAX_DT + 1)] = count;
+    return fingerprint_Pair(st, frame);
+}
+
+/**
+ * @brief The largest value within +-FINGERPRINT_NEIGHBOR_BINS of every bin, in three passes whatever the width
+ * (van Herk / Gil-Werman): the maxima from the start and from the end of blocks of the window size
+ */
+static void fingerprint_LocalMax(const float* in, float* out){
+    enum { W = 2 * FINGERPRINT_NEIGHBOR_BINS + 1, N = FINGERPRINT_BINS + 2 * FINGERPRINT_NEIGHBOR_BINS };
+    enum { PADDED = (N + W - 1) / W * W };
+    float x[PADDED], forward[PADDED], backward[PADDED];
+    for(uint32_t i = 0; i < PADDED; i++){
+        x[i] = i >= FINGERPRINT_NEIGHBOR_BINS && i < FINGERPRINT_NEIGHBOR_BINS + FINGERPRINT_BINS ? in[i - FINGERPRINT_NEIGHBOR_BINS] : -INFINITY;
+    }
+    for(uint32_t i = 0; i < PADDED; i++) forward[i] = i % W == 0 ? x[i] : fmaxf(forward[i - 1], x[i]);
+    for(uint32_t i = PADDED; i-- > 0;) backward[i] = i % W == W - 1 ? x[i] : fmaxf(backward[i + 1], x[i]);
+    for(uint32_t k = 0; k < FINGERPRINT_BINS; k++) out[k] = fmaxf(backward[k], forward[k + W - 1]);
+}
+
+static short fingerprint_Analyze(struct fingerprint_state* st){
+    for(uint32_t i = 0; i < FINGERPRINT_FFT; i++) st->frame[i] *= st->window[i];
+    fft_Forward(st->plan, st->frame, st->re, st->im, st->scratch);
+    const uint32_t slot = st->frames % FINGERPRINT_SPAN;
+    float* magnitude = st->magnitude[slot];
+    float sum = 0.0f;
+    for(uint32_t k = 0; k < FINGERPRINT_BINS; k++){
+        magnitude[k] = 0.5f * logf(st->re[k] * st->re[k] + st->im[k] * st->im[k] + 1e-20f);
+        sum += magnitude[k];
+    }
+    st->mean[slot] = sum / FINGERPRINT_BINS;
+    fingerprint_LocalMax(magnitude, st->local[slot]);
+    st->frames++;
+    if(st->frames > FINGERPRINT_NEIGHBOR_FRAMES){
+        return fingerprint_Peaks(st, st->frames - 1 - FINGERPRINT_NEIGHBOR_FRAMES, st->frames - 1);
+    }
+    return 0;
+}
+
+static short fingerprint_Sample(struct fingerprint_state* st, float x){
+    st->frame[st->fill++] = x;
+    if(st->fill < FINGERPRINT_FFT) return 0;
+    float* frame = st->frame;
+    float saved[FINGERPRINT_FFT - FINGERPRINT_HOP];
+    memcpy(saved, frame + FINGERPRINT_HOP, sizeof(saved));
+    short error = fingerprint_Analyze(st);
+    memcpy(frame, saved, sizeof(saved));
+    st->fill = FINGERPRINT_FFT - FINGERPRINT_HOP;
+    return error;
+}
+
+/**
+ * @brief Adds mono samples at FINGERPRINT_RATE
+ *
+ * @returns 0 on success, -1 if memory could not be allocated
+ */
+short fingerprint_Feed(struct fingerprint_state* st, const float* samples, uint32_t n){
+    for(uint32_t i = 0; i < n; i++){
+        if(fingerprint_Sample(st, samples[i]) != 0) return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Analyzes the samples left at the end of a file and the peaks of its last frames
+ */
+short fingerprint_Finish(struct fingerprint_state* st){
+    if(st->fill > FINGERPRINT_FFT - FINGERPRINT_HOP || (st->frames == 0 && st->fill > 0)){
+        memset(st->frame + st->fill, 0, (FINGERPRINT_FFT - st->fill) * sizeof(float));
+        st->fill = 0;
+        if(fingerprint_Analyze(st) != 0) return -1;
+    }
+    const uint32_t first = st->frames > FINGERPRINT_NEIGHBOR_FRAMES ? st->frames - FINGERPRINT_NEIGHBOR_FRAMES : 0;
+    for(uint32_t frame = first; frame < st->frames; frame++){
+        if(fingerprint_Peaks(st, frame, st->frames - 1) != 0) return -1;
+    }
+    st->out->frames = st->frames;
+    return 0;
+}
+
+/**
+ * @brief Fingerprints the WAV file of a stream, PCM or float samples of any size and a header of any chunks
+ *
+ * @returns 0 on success, -1 with an error reported
+ */
+short fingerprint_Stream(FILE* in, const struct fft_plan* plan, struct fingerprint* out){
+    memset(out, 0, sizeof(struct fingerprint));
+    struct codec_mono mono;
+    if(codec_MonoOpen(in, &mono, FINGERPRINT_RATE) != 0) return -1;
+    struct fingerprint_state* st = fingerprint_state_Create(plan, out);
+    short status = -1;
+    if(st == NULL) goto memory;
+    const float* samples;
+    for(uint32_t n = codec_MonoRead(in, &mono, &samples); n > 0; n = codec_MonoRead(in, &mono, &samples)){
+        if(fingerprint_Feed(st, samples, n) != 0) goto memory;
+    }
+    if(fingerprint_Finish(st) != 0) goto memory;
+    status = 0;
+    goto cleanup;
+memory:
+    fprintf(stderr, "Error! unable to allocate memory\n");
+cleanup:
+    if(status != 0) fingerprint_Free(out);
+    fingerprint_state_Destroy(st);
+    codec_MonoClose(&mono);
+    return status;
+}
+
+/**
+ * @brief Fingerprints a file of any format the commands read
+ *
+ * @returns 0 on success, -1 with an error reported
+ */
+short fingerprint_File(const char* path, const struct fft_plan* plan, struct fingerprint* out){
+    memset(out, 0, sizeof(struct fingerprint));
+    FILE* file = fopen(path, "rb");
+    if(file == NULL){
+        fprintf(stderr, "Error! unable to open %s\n", path);
+        return -1;
+    }
+    struct codec_stream stream;
+    FILE* in = flac_Open(file, &stream);
+    short status = in != NULL ? fingerprint_Stream(in, plan, out) : -1;
+    if(in != NULL && codec_StreamClose(&stream) == 1) status = -1;
+    fclose(file);
+    if(status != 0){
+        fingerprint_Free(out);
+        fprintf(stderr, "Error! unable to fingerprint %s\n", path);
+    }
+    return status;
+}
+
+struct fingerprint_job {
+    char* const* paths;
+    uint32_t count;
+    uint32_t* next;                 // the next file to take, shared by the jobs
+    const struct fft_plan* plan;
+    struct fingerprint* results;
+    short* failed;
+    short threaded;
+};
+
+/**
+ * @brief Thread entry point that fingerprints files until none are left
+ */
+void* fingerprint_Worker(void* arg){
+    struct fingerprint_job* job = arg;
+    for(uint32_t i = __atomic_fetch_add(job->next, 1, __ATOMIC_RELAXED); i < job->count;
+        i = __atomic_fetch_add(job->next, 1, __ATOMIC_RELAXED)){
+        job->failed[i] = fingerprint_File(job->paths[i], job->plan, &job->results[i]) != 0;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Fingerprints files on several threads, each thread taking the next file when it is done with one
+ *
+ * @param results receives the fingerprint of every file, empty for the files in failed
+ * @param failed set to 1 for the files that could not be fingerprinted
+ *
+ * @returns 0 on success, -1 if the threads could not be set up
+ */
+short fingerprint_Files(char* const* paths, uint32_t count, int threads, struct fingerprint* results, short* failed){
+    struct fft_plan* plan = fft_plan_Create(FINGERPRINT_FFT);
+    if(threads < 1) threads = 1;
+    if((uint32_t)threads > count) threads = count > 0 ? (int)count : 1;
+    pthread_t* ids = malloc(threads * sizeof(pthread_t));
+    struct fingerprint_job* jobs = malloc(threads * sizeof(struct fingerprint_job));
+    if(plan == NULL || ids == NULL || jobs == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        fft_plan_Destroy(plan);
+        free(ids);
+        free(jobs);
+        return -1;
+    }
+    uint32_t next = 0;
+    for(int t = 0; t < threads; t++){
+        jobs[t] = (struct fingerprint_job){paths, count, &next, plan, results, failed, 0};
+        if(t < threads - 1 && pthread_create(&ids[t], NULL, fingerprint_Worker, &jobs[t]) == 0){
+            jobs[t].threaded = 1;
+        } else{
+            fingerprint_Worker(&jobs[t]);
+        }
+    }
+    for(int t = 0; t < threads; t++){
+        if(jobs[t].threaded) pthread_join(ids[t], NULL);
+    }
+    fft_plan_Destroy(plan);
+    free(ids);
+    free(jobs);
+    return 0;
+}
+
+/**
+ * @brief The header of an index file, followed by FINGERPRINT_BUCKETS + 1 offsets of the buckets in the postings,
+ * the postings, the length in frames and the offset of the name of every file, and the names
+ */
+struct fingerprint_index_header {
+    char magic[8];
+    uint32_t bucket_bits;
+    uint32_t rate;
+    uint32_t hop;
+    uint32_t reserved;
+    uint64_t files;
+    uint64_t postings;
+    uint64_t names_size;
+};
+
+struct fingerprint_posting {
+    uint32_t hash;
+    uint32_t file;
+    uint32_t frame;
+};
+
+int fingerprint_ComparePostings(const void* a, const void* b){
+    const struct fingerprint_posting* x = a;
+    const struct fingerprint_posting* y = b;
+    if(x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    if(x->file != y->file) return x->file < y->file ? -1 : 1;
+    return (x->frame > y->frame) - (x->frame < y->frame);
+}
+
+/**
+ * @brief Writes the index of a set of fingerprints. The postings are placed in their buckets by a counting sort and
+ * every bucket is then sorted by hash
+ *
+ * @returns 0 on success, -1 with an error reported
+ */
+short fingerprint_IndexWrite(const char* path, char* const* names, const struct fingerprint* fps, uint32_t count){
+    uint64_t* buckets = calloc(FINGERPRINT_BUCKETS + 1, sizeof(uint64_t));
+    uint32_t* frames = malloc((count > 0 ? count : 1) * sizeof(uint32_t));
+    uint64_t* name_offsets = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+    uint64_t total = 0, names_size = 0;
+    for(uint32_t f = 0; f < count; f++){
+        total += fps[f].count;
+        names_size += strlen(names[f]) + 1;
+    }
+    struct fingerprint_posting* postings = malloc((total > 0 ? total : 1) * sizeof(struct fingerprint_posting));
+    if(buckets == NULL || frames == NULL || name_offsets == NULL || postings == NULL){
+        fprintf(stderr, "Error! unable to allocate memory for %" PRIu64 " postings\n", total);
+        free(buckets);
+        free(frames);
+        free(name_offsets);
+        free(postings);
+        return -1;
+    }
+
+    const uint32_t shift = 24 - FINGERPRINT_BUCKET_BITS;
+    for(uint32_t f = 0; f < count; f++){
+        for(uint32_t i = 0; i < fps[f].count; i++) buckets[(fps[f].hashes[i].hash >> shift) + 1]++;
+    }
+    for(uint32_t b = 0; b < FINGERPRINT_BUCKETS; b++) buckets[b + 1] += buckets[b];
+    uint64_t offset = 0;
+    for(uint32_t f = 0; f < count; f++){
+        for(uint32_t i = 0; i < fps[f].count; i++){
+            const struct fingerprint_hash* h = &fps[f].hashes[i];
+            // buckets[b] is the next free slot of bucket b, and ends as the start of bucket b + 1
+            struct fingerprint_posting* p = &postings[buckets[h->hash >> shift]++];
+            p->hash = h->hash;
+            p->file = f;
+            p->frame = h->frame;
+        }
+        frames[f] = fps[f].frames;
+        name_offsets[f] = offset;
+        offset += strlen(names[f]) + 1;
+    }
+    memmove(buckets + 1, buckets, FINGERPRINT_BUCKETS * sizeof(uint64_t));
+    buckets[0] = 0;
+    for(uint32_t b = 0; b < FINGERPRINT_BUCKETS; b++){
+        qsort(postings + buckets[b], buckets[b + 1] - buckets[b], sizeof(struct fingerprint_posting), fingerprint_ComparePostings);
+    }
+
+    struct fingerprint_index_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FINGERPRINT_INDEX_MAGIC, 8);
+    header.bucket_bits = FINGERPRINT_BUCKET_BITS;
+    header.rate = FINGERPRINT_RATE;
+    header.hop = FINGERPRINT_HOP;
+    header.files = count;
+    header.postings = total;
+    header.names_size = names_size;
+
+    short status = -1;
+    FILE* out = fopen(path, "wb");
+    if(out == NULL){
+        fprintf(stderr, "Error! unable to create the index %s\n", path);
+    } else{
+        short written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                        fwrite(buckets, sizeof(uint64_t), FINGERPRINT_BUCKETS + 1, out) == FINGERPRINT_BUCKETS + 1 &&
+                        fwrite(postings, sizeof(struct fingerprint_posting), total, out) == total &&
+                        fwrite(frames, sizeof(uint32_t), count, out) == count &&
+                        fwrite(name_offsets, sizeof(uint64_t), count, out) == count;
+        for(uint32_t f = 0; written && f < count; f++) written = fputs(names[f], out) >= 0 && fputc('\0', out) != EOF;
+        if(fclose(out) != 0) written = 0;
+        if(written) status = 0;
+        else fprintf(stderr, "Error! unable to write the index %s\n", path);
+    }
+    free(buckets);
+    free(frames);
+    free(name_offsets);
+    free(postings);
+    return status;
+}
+
+/**
+ * @brief An index file mapped into memory
+ */
+struct fingerprint_index {
+    void* map;
+    size_t size;
+    const struct fingerprint_index_header* header;
+    const uint64_t* buckets;
+    const struct fingerprint_posting* postings;
+    const uint32_t* frames;
+    const uint64_t* name_offsets;
+    const char* names;
+};
+
+/**
+ * @brief Maps an index file and checks its layout
+ *
+ * @returns 0 on success, -1 with an error reported
+ */
+short fingerprint_IndexOpen(const char* path, struct fingerprint_index* index){
+    memset(index, 0, sizeof(struct fingerprint_index));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0){
+        fprintf(stderr, "Error! unable to open the index %s\n", path);
+        if(fd >= 0) close(fd);
+        return -1;
+    }
+    const size_t size = (size_t)st.st_size;
+    void* map = size >= sizeof(struct fingerprint_index_header) ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(map == MAP_FAILED){
+        fprintf(stderr, "Error! %s is not an index\n", path);
+        return -1;
+    }
+    const struct fingerprint_index_header* h = map;
+    const uint64_t fixed = sizeof(struct fingerprint_index_header) + (FINGERPRINT_BUCKETS + 1) * sizeof(uint64_t);
+    short valid = memcmp(h->magic, FINGERPRINT_INDEX_MAGIC, 8) == 0 && h->bucket_bits == FINGERPRINT_BUCKET_BITS &&
+                  h->rate == FINGERPRINT_RATE && h->hop == FINGERPRINT_HOP && h->files < UINT32_MAX &&
+                  h->postings < (UINT64_MAX - fixed) / sizeof(struct fingerprint_posting);
+    if(valid){
+        const uint64_t expected = fixed + h->postings * sizeof(struct fingerprint_posting) + h->files * 12 + h->names_size;
+        valid = expected == size && (h->names_size > 0) == (h->files > 0);
+    }
+    if(valid){
+        index->buckets = (const uint64_t*)(h + 1);
+        index->postings = (const struct fingerprint_posting*)(index->buckets + FINGERPRINT_BUCKETS + 1);
+        index->frames = (const uint32_t*)(index->postings + h->postings);
+        index->name_offsets = (const uint64_t*)(index->frames + h->files);
+        index->names = (const char*)(index->name_offsets + h->files);
+        valid = index->buckets[0] == 0 && index->buckets[FINGERPRINT_BUCKETS] == h->postings &&
+                (h->files == 0 || index->names[h->names_size - 1] == '\0');
+        for(uint32_t b = 0; valid && b < FINGERPRINT_BUCKETS; b++) valid = index->buckets[b] <= index->buckets[b + 1];
+        for(uint64_t f = 0; valid && f < h->files; f++) valid = index->name_offsets[f] < h->names_size;
+    }
+    if(!valid){
+        fprintf(stderr, "Error! %s is not an index or is damaged\n", path);
+        munmap(map, size);
+        return -1;
+    }
+    index->map = map;
+    index->size = size;
+    index->header = h;
+    // the postings are read in random order
+    madvise(map, size, MADV_RANDOM);
+    return 0;
+}
+
+void fingerprint_IndexClose(struct fingerprint_index* index){
+    if(index->map != NULL) munmap(index->map, index->size);
+    memset(index, 0, sizeof(struct fingerprint_index));
+}
+
+const char* fingerprint_IndexName(const struct fingerprint_index* index, uint32_t file){
+    return index->names + index->name_offsets[file];
+}
+
+/**
+ * @brief A file of the index and the offset at which a query matches it
+ */
+struct fingerprint_match {
+    uint32_t file;
+    int32_t offset;                 // frame of the file at the start of the query
+    uint32_t score;                 // hashes of the query that agree with this offset
+};
+
+static inline uint64_t fingerprint_VoteSlot(uint64_t key, uint64_t mask){
+    key *= 0x9E3779B97F4A7C15ull;
+    return (key ^ key >> 32) & mask;
+}
+
+int fingerprint_CompareMatches(const void* a, const void* b){
+    const struct fingerprint_match* x = a;
+    const struct fingerprint_match* y = b;
+    if(x->file != y->file) return x->file < y->file ? -1 : 1;
+    return (x->score < y->score) - (x->score > y->score);
+}
+
+int fingerprint_CompareScores(const void* a, const void* b){
+    const struct fingerprint_match* x = a;
+    const struct fingerprint_match* y = b;
+    if(x->score != y->score) return x->score < y->score ? 1 : -1;
+    return (x->file > y->file) - (x->file < y->file);
+}
+
+/**
+ * @brief Finds the files of an index that share audio with a fingerprint. Every posting of every hash of the query
+ * votes for its file and the difference between its frame and the frame of the query, in an open addressing table
+ *
+ * @param matches receives up to `top` matches, best first, one per file
+ * @param min_score the votes a match needs
+ *
+ * @returns the number of matches, or -1 with an error reported
+ */
+int fingerprint_Query(const struct fingerprint_index* index, const struct fingerprint* query, struct fingerprint_match* matches,
+                      uint32_t top, uint32_t min_score){
+    uint64_t capacity = 1024;
+    uint64_t used = 0;
+    uint64_t* keys = malloc(capacity * sizeof(uint64_t));
+    uint32_t* votes = malloc(capacity * sizeof(uint32_t));
+    if(keys == NULL || votes == NULL) goto memory;
+    memset(keys, 0xFF, capacity * sizeof(uint64_t));
+
+    const uint32_t shift = 24 - FINGERPRINT_BUCKET_BITS;
+    for(uint32_t q = 0; q < query->count; q++){
+        const uint32_t hash = query->hashes[q].hash;
+        uint64_t low = index->buckets[hash >> shift], high = index->buckets[(hash >> shift) + 1];
+        while(low < high){
+            uint64_t mid = low + (high - low) / 2;
+            if(index->postings[mid].hash < hash) low = mid + 1;
+            else high = mid;
+        }
+        uint64_t end = low;
+        while(end < index->buckets[(hash >> shift) + 1] && index->postings[end].hash == hash) end++;
+        if(end - low > FINGERPRINT_MAX_POSTINGS) continue;
+        for(uint64_t p = low; p < end; p++){
+            const int64_t offset = (int64_t)index->postings[p].frame - query->hashes[q].frame;
+            const uint64_t key = (uint64_t)index->postings[p].file << 32 | (uint32_t)(int32_t)offset;
+            if(2 * (used + 1) > capacity){
+                // grow and reinsert, the table stays at most half full
+                uint64_t* old_keys = keys;
+                uint32_t* old_votes = votes;
+                const uint64_t old_capacity = capacity;
+                capacity *= 2;
+                keys = malloc(capacity * sizeof(uint64_t));
+                votes = malloc(capacity * sizeof(uint32_t));
+                if(keys == NULL || votes == NULL){
+                    free(old_keys);
+                    free(old_votes);
+                    goto memory;
+                }
+                memset(keys, 0xFF, capacity * sizeof(uint64_t));
+                for(uint64_t i = 0; i < old_capacity; i++){
+                    if(old_keys[i] == UINT64_MAX) continue;
+                    uint64_t s = fingerprint_VoteSlot(old_keys[i], capacity - 1);
+                    while(keys[s] != UINT64_MAX) s = (s + 1) & (capacity - 1);
+                    keys[s] = old_keys[i];
+                    votes[s] = old_votes[i];
+                }
+                free(old_keys);
+                free(old_votes);
+            }
+            uint64_t s = fingerprint_VoteSlot(key, capacity - 1);
+            while(keys[s] != UINT64_MAX && keys[s] != key) s = (s + 1) & (capacity - 1);
+            if(keys[s] == UINT64_MAX){
+                keys[s] = key;
+                votes[s] = 0;
+                used++;
+            }
+            votes[s]++;
+        }
+    }
+
+    // the best offset of every file
+    uint64_t count = 0;
+    struct fingerprint_match* candidates = malloc((used > 0 ? used : 1) * sizeof(struct fingerprint_match));
+    if(candidates == NULL) goto memory;
+    for(uint64_t i = 0; i < capacity; i++){
+        if(keys[i] == UINT64_MAX || votes[i] < min_score) continue;
+        candidates[count].file = (uint32_t)(keys[i] >> 32);
+        candidates[count].offset = (int32_t)(uint32_t)keys[i];
+        candidates[count].score = votes[i];
+        count++;
+    }
+    qsort(candidates, count, sizeof(struct fingerprint_match), fingerprint_CompareMatches);
+    uint64_t files = 0;
+    for(uint64_t i = 0; i < count; i++){
+        if(i == 0 || candidates[i].file != candidates[i - 1].file) candidates[files++] = candidates[i];
+    }
+    qsort(candidates, files, sizeof(struct fingerprint_match), fingerprint_CompareScores);
+    const uint32_t found = files < top ? (uint32_t)files : top;
+    memcpy(matches, candidates, found * sizeof(struct fingerprint_match));
+    free(candidates);
+    free(keys);
+    free(votes);
+    return (int)found;
+memory:
+    fprintf(stderr, "Error! unable to allocate memory\n");
+    free(keys);
+    free(votes);
+    return -1;
+}
+
+/**
+ * @brief Expands the inputs of a command to a list of files: a directory stands for its .wav files
+ *
+ * @returns the number of files, or -1 with an error reported. The paths must be released with free()
+ */
+int fingerprint_Paths(char* const* inputs, int count, char*** paths){
+    uint32_t total = 0, capacity = 64;
+    char** list = malloc(capacity * sizeof(char*));
+    if(list == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        return -1;
+    }
+    for(int i = 0; i < count; i++){
+        struct stat st;
+        char** names = NULL;
+        int found = 1;
+        if(stat(inputs[i], &st) == 0 && S_ISDIR(st.st_mode)){
+            found = batch_List(inputs[i], &names);
+            if(found < 0){
+                fprintf(stderr, "Error! unable to read the directory %s\n", inputs[i]);
+                found = 0;
+            }
+        }
+        for(int k = 0; k < found; k++){
+            if(total == capacity){
+                char** grown = realloc(list, 2 * capacity * sizeof(char*));
+                if(grown == NULL) break;
+                list = grown;
+                capacity *= 2;
+            }
+            if(names != NULL){
+                size_t length = strlen(inputs[i]) + strlen(names[k]) + 2;
+                list[total] = malloc(length);
+                if(list[total] != NULL) snprintf(list[total], length, "%s/%s", inputs[i], names[k]);
+            } else{
+                list[total] = strdup(inputs[i]);
+            }
+            if(list[total] != NULL) total++;
+        }
+        for(int k = 0; names != NULL && k < found; k++) free(names[k]);
+        free(names);
+    }
+    *paths = list;
+    return (int)total;
+}
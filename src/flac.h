@@ -0,0 +1,1311 @@
+/**
+ * @file flac.h
+ * @author Rafael Diolatzis
+ * @brief A FLAC encoder that compresses frames in parallel, and a streaming FLAC decoder
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * A FLAC stream is "fLaC", a STREAMINFO block and a sequence of frames of a fixed number of samples. Every frame is
+ * independent: each channel is predicted from its own past samples, by a fixed polynomial or by a linear predictor
+ * whose quantized coefficients are stored in the frame, and the prediction residual is Rice coded in partitions that
+ * each pick their own parameter. Stereo frames can store the side channel (left - right) together with the left,
+ * the right or the mid channel instead of the two channels, whichever is smallest.
+ *
+ * Because frames do not depend on each other the encoder reads a batch of frames, compresses them on several threads
+ * and writes them in order. The decoder is sequential and streams: it needs one frame of memory, checks the CRC of
+ * every frame and, at the end, the MD5 of the samples, so a decoded file is bit exact or an error is reported.
+ *
+ * Commands that read WAV data also accept FLAC: flac_Run() decodes STDIN on a thread into a pipe that the command
+ * reads as a WAV file, see codec_PipeRun().
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include<pthread.h>
+#include"utils.h"
+#include"codec.h"
+
+#define FLAC_MAX_CHANNELS 8
+#define FLAC_MAX_LPC_ORDER 32
+#define FLAC_MAX_FIXED_ORDER 4
+#define FLAC_MAX_PARTITION_ORDER 8
+#define FLAC_MIN_BLOCK 16
+#define FLAC_MAX_BLOCK 65535
+#define FLAC_DEFAULT_LEVEL 5
+#define FLAC_FRAMES_PER_THREAD 16
+#define FLAC_READ_BUFFER (1 << 16)
+
+#define FLAC_SUBFRAME_CONSTANT 0
+#define FLAC_SUBFRAME_VERBATIM 1
+#define FLAC_SUBFRAME_FIXED 8
+#define FLAC_SUBFRAME_LPC 32
+
+#define FLAC_INDEPENDENT 0
+#define FLAC_LEFT_SIDE 8
+#define FLAC_SIDE_RIGHT 9
+#define FLAC_MID_SIDE 10
+
+/**
+ * @brief How hard the encoder tries
+ */
+struct flac_params {
+    uint32_t block;                 // samples per channel in a frame
+    uint32_t max_lpc_order;         // 0 for the fixed predictors only
+    uint32_t max_partition_order;
+    short stereo;                   // 1 to try the side channel stereo modes
+    short exhaustive;               // 1 to encode every LPC order instead of the one with the best estimate
+};
+
+/**
+ * @brief Fills the parameters of a compression level from 0 (fastest) to 8 (smallest)
+ *
+ * @returns 0 on success, -1 if the level is out of range
+ */
+short flac_Level(struct flac_params* params, int level){
+    static const uint16_t block[9] = {1152, 1152, 1152, 4096, 4096, 4096, 4096, 4096, 4096};
+    static const uint8_t lpc[9] = {0, 0, 0, 6, 8, 8, 8, 12, 12};
+    static const uint8_t partition[9] = {2, 3, 4, 4, 4, 5, 6, 6, 8};
+    if(level < 0 || level > 8) return -1;
+    params->block = block[level];
+    params->max_lpc_order = lpc[level];
+    params->max_partition_order = partition[level];
+    params->stereo = level != 0 && level != 3;
+    params->exhaustive = level == 8;
+    return 0;
+}
+
+/**
+ * @brief The format of the samples of a stream
+ */
+struct flac_format {
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bits;
+};
+
+static uint8_t flac_crc8_table[256];
+static uint16_t flac_crc16_table[256];
+static uint32_t flac_md5_table[64];
+static pthread_once_t flac_tables_once = PTHREAD_ONCE_INIT;
+
+static void flac_InitTables(void){
+    for(uint32_t i = 0; i < 256; i++){
+        uint32_t c8 = i, c16 = i << 8;
+        for(int b = 0; b < 8; b++){
+            c8 = (c8 << 1) ^ (c8 & 0x80 ? 0x07 : 0);
+            c16 = (c16 << 1) ^ (c16 & 0x8000 ? 0x8005 : 0);
+        }
+        flac_crc8_table[i] = (uint8_t)c8;
+        flac_crc16_table[i] = (uint16_t)c16;
+    }
+    for(int i = 0; i < 64; i++) flac_md5_table[i] = (uint32_t)(fabs(sin(i + 1.0)) * 4294967296.0);
+}
+
+static inline uint8_t flac_Crc8(uint8_t crc, const uint8_t* data, size_t size){
+    for(size_t i = 0; i < size; i++) crc = flac_crc8_table[crc ^ data[i]];
+    return crc;
+}
+
+static inline uint16_t flac_Crc16(uint16_t crc, const uint8_t* data, size_t size){
+    for(size_t i = 0; i < size; i++) crc = (uint16_t)(crc << 8) ^ flac_crc16_table[(crc >> 8) ^ data[i]];
+    return crc;
+}
+
+/**
+ * @brief The MD5 of the samples that STREAMINFO carries, computed over the samples as signed little endian integers
+ * of (bits + 7) / 8 bytes
+ */
+struct flac_md5 {
+    uint32_t state[4];
+    uint64_t length;
+    uint8_t block[64];
+    uint32_t fill;
+};
+
+void flac_md5_Init(struct flac_md5* md5){
+    pthread_once(&flac_tables_once, flac_InitTables);
+    md5->state[0] = 0x67452301;
+    md5->state[1] = 0xefcdab89;
+    md5->state[2] = 0x98badcfe;
+    md5->state[3] = 0x10325476;
+    md5->length = 0;
+    md5->fill = 0;
+}
+
+static void flac_md5_Block(struct flac_md5* md5, const uint8_t* p){
+    static const uint8_t shifts[16] = {7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+    uint32_t m[16];
+    for(int i = 0; i < 16; i++) m[i] = p[4*i] | p[4*i + 1] << 8 | p[4*i + 2] << 16 | (uint32_t)p[4*i + 3] << 24;
+    uint32_t a = md5->state[0], b = md5->state[1], c = md5->state[2], d = md5->state[3];
+    for(int i = 0; i < 64; i++){
+        uint32_t f;
+        int g;
+        if(i < 16){ f = (b & c) | (~b & d); g = i; }
+        else if(i < 32){ f = (d & b) | (~d & c); g = (5*i + 1) & 15; }
+        else if(i < 48){ f = b ^ c ^ d; g = (3*i + 5) & 15; }
+        else{ f = c ^ (b | ~d); g = (7*i) & 15; }
+        uint32_t s = shifts[(i >> 4) * 4 + (i & 3)];
+        f += a + flac_md5_table[i] + m[g];
+        a = d;
+        d = c;
+        c = b;
+        b += (f << s) | (f >> (32 - s));
+    }
+    md5->state[0] += a;
+    md5->state[1] += b;
+    md5->state[2] += c;
+    md5->state[3] += d;
+}
+
+void flac_md5_Update(struct flac_md5* md5, const void* data, size_t size){
+    const uint8_t* p = data;
+    md5->length += size;
+    if(md5->fill > 0){
+        size_t n = 64 - md5->fill < size ? 64 - md5->fill : size;
+        memcpy(md5->block + md5->fill, p, n);
+        md5->fill += (uint32_t)n;
+        p += n;
+        size -= n;
+        if(md5->fill < 64) return;
+        flac_md5_Block(md5, md5->block);
+        md5->fill = 0;
+    }
+    for(; size >= 64; p += 64, size -= 64) flac_md5_Block(md5, p);
+    memcpy(md5->block, p, size);
+    md5->fill = (uint32_t)size;
+}
+
+void flac_md5_Final(struct flac_md5* md5, uint8_t digest[16]){
+    uint64_t bits = md5->length * 8;
+    uint8_t pad[72] = {0x80};
+    size_t n = (md5->fill < 56 ? 56 : 120) - md5->fill;
+    for(int i = 0; i < 8; i++) pad[n + i] = (uint8_t)(bits >> (8 * i));
+    flac_md5_Update(md5, pad, n + 8);
+    for(int i = 0; i < 16; i++) digest[i] = (uint8_t)(md5->state[i / 4] >> (8 * (i % 4)));
+}
+
+/**
+ * @brief Writes MSB first bit fields to a buffer that is large enough
+ */
+struct flac_writer {
+    uint8_t* data;
+    size_t bytes;
+    uint64_t pending;               // the last `count` bits written, not yet stored
+    uint32_t count;
+};
+
+static inline void flac_Put(struct flac_writer* w, uint32_t value, uint32_t bits){
+    if(bits == 0) return;
+    w->pending = (w->pending << bits) | (value & (uint32_t)(0xFFFFFFFFu >> (32 - bits)));
+    w->count += bits;
+    while(w->count >= 8){
+        w->count -= 8;
+        w->data[w->bytes++] = (uint8_t)(w->pending >> w->count);
+    }
+}
+
+/**
+ * @brief Writes q zeros and a one
+ */
+static inline void flac_PutUnary(struct flac_writer* w, uint32_t q){
+    for(; q >= 32; q -= 32) flac_Put(w, 0, 32);
+    flac_Put(w, 1, q + 1);
+}
+
+static inline void flac_PutRice(struct flac_writer* w, uint32_t u, uint32_t k){
+    uint32_t q = u >> k;
+    if(q + 1 + k <= 32){
+        flac_Put(w, (1u << k) | (u & ((1u << k) - 1)), q + 1 + k);
+    } else{
+        flac_PutUnary(w, q);
+        flac_Put(w, u, k);
+    }
+}
+
+static inline void flac_Align(struct flac_writer* w){
+    if(w->count > 0) flac_Put(w, 0, 8 - w->count);
+}
+
+/**
+ * @brief Writes a frame or sample number in the UTF-8 like code of the frame header
+ */
+static void flac_PutNumber(struct flac_writer* w, uint64_t v){
+    if(v < 0x80){
+        flac_Put(w, (uint32_t)v, 8);
+        return;
+    }
+    uint32_t bytes = 2;
+    while(bytes < 7 && v >= (1ull << (5*bytes + 1))) bytes++;
+    flac_Put(w, (0xFF00u >> bytes & 0xFF) | (uint32_t)(v >> (6 * (bytes - 1))), 8);
+    for(uint32_t i = bytes - 1; i-- > 0;) flac_Put(w, 0x80 | (uint32_t)(v >> (6 * i) & 0x3F), 8);
+}
+
+/**
+ * @brief Reads MSB first bit fields from a stream. Bytes are loaded one at a time when a field needs them, so the
+ * CRCs cover exactly the bytes of the fields read since they were reset
+ */
+struct flac_reader {
+    FILE* in;
+    uint8_t buffer[FLAC_READ_BUFFER];
+    size_t position;
+    size_t end;
+    uint64_t pending;
+    uint32_t count;
+    uint8_t crc8;
+    uint16_t crc16;
+    short eof;                      // 1 once a field needed more bytes than the stream has
+};
+
+static int flac_Load(struct flac_reader* r){
+    if(r->position == r->end){
+        r->position = 0;
+        r->end = r->in == IO_IN ? read_Block((char*)r->buffer, sizeof(r->buffer)) : fread(r->buffer, 1, sizeof(r->buffer), r->in);
+        if(r->end == 0){
+            r->eof = 1;
+            return 0;
+        }
+    }
+    uint8_t b = r->buffer[r->position++];
+    r->crc8 = flac_crc8_table[r->crc8 ^ b];
+    r->crc16 = (uint16_t)(r->crc16 << 8) ^ flac_crc16_table[(r->crc16 >> 8) ^ b];
+    r->pending = (r->pending << 8) | b;
+    r->count += 8;
+    return 1;
+}
+
+static inline uint32_t flac_Get(struct flac_reader* r, uint32_t bits){
+    if(bits == 0) return 0;
+    while(r->count < bits){
+        if(!flac_Load(r)) return 0;
+    }
+    r->count -= bits;
+    return (uint32_t)(r->pending >> r->count) & (0xFFFFFFFFu >> (32 - bits));
+}
+
+static inline int32_t flac_GetSigned(struct flac_reader* r, uint32_t bits){
+    if(bits == 0) return 0;
+    uint32_t v = flac_Get(r, bits) << (32 - bits);
+    return (int32_t)v >> (32 - bits);
+}
+
+/**
+ * @brief Reads zeros up to a one and returns their number
+ */
+static inline uint32_t flac_GetUnary(struct flac_reader* r){
+    uint32_t q = 0;
+    for(;;){
+        if(r->count == 0 && !flac_Load(r)) return q;
+        uint64_t bits = r->pending & ((1ull << r->count) - 1);
+        if(bits == 0){
+            q += r->count;
+            r->count = 0;
+            continue;
+        }
+        uint32_t top = 63 - (uint32_t)__builtin_clzll(bits);
+        q += r->count - 1 - top;
+        r->count = top;
+        return q;
+    }
+}
+
+/**
+ * @brief The chosen coding of one channel of a frame
+ */
+struct flac_subframe {
+    int type;
+    uint32_t bits;                  // bits per sample after the wasted bits, including the extra bit of a side channel
+    uint32_t wasted;                // low bits that are zero in every sample and are not stored
+    uint32_t order;
+    uint32_t precision;
+    int shift;
+    int32_t coefficients[FLAC_MAX_LPC_ORDER];
+    const int32_t* samples;         // samples without the wasted bits, for the warm-up and VERBATIM
+    const int32_t* residual;        // block - order residuals
+    uint32_t partition_order;
+    uint32_t method;                // 0 for 4 bit Rice parameters, 1 for 5 bit
+    uint8_t parameters[1 << FLAC_MAX_PARTITION_ORDER];
+    uint64_t size;                  // bits of the whole subframe
+};
+
+/**
+ * @brief Per thread buffers of the encoder
+ */
+struct flac_scratch {
+    int32_t* channels[FLAC_MAX_CHANNELS + 2];   // the input channels, then mid and side
+    int32_t* shifted[FLAC_MAX_CHANNELS + 2];
+    int32_t* residual[FLAC_MAX_CHANNELS + 2][2];
+    double* windowed;
+    double* window;
+    uint32_t window_size;
+    uint64_t* sums;
+    void* memory;
+};
+
+short flac_scratch_Create(struct flac_scratch* s, uint32_t block, uint16_t channels){
+    pthread_once(&flac_tables_once, flac_InitTables);
+    memset(s, 0, sizeof(struct flac_scratch));
+    const uint32_t analyses = channels == 2 ? 4 : channels;
+    const size_t ints = (size_t)block * analyses * 4;
+    s->memory = alloc_Aligned(ints * sizeof(int32_t) + (size_t)block * 2 * sizeof(double) + (1 << FLAC_MAX_PARTITION_ORDER) * sizeof(uint64_t));
+    if(s->memory == NULL) return -1;
+    int32_t* p = s->memory;
+    for(uint32_t c = 0; c < analyses; c++){
+        s->channels[c] = p;
+        s->shifted[c] = p + block;
+        s->residual[c][0] = p + 2 * (size_t)block;
+        s->residual[c][1] = p + 3 * (size_t)block;
+        p += 4 * (size_t)block;
+    }
+    s->windowed = (double*)p;
+    s->window = s->windowed + block;
+    s->sums = (uint64_t*)(s->window + block);
+    return 0;
+}
+
+void flac_scratch_Destroy(struct flac_scratch* s){
+    free_Aligned(s->memory);
+    s->memory = NULL;
+}
+
+static inline uint32_t flac_Fold(int32_t r){
+    return ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+}
+
+/**
+ * @brief Picks the partition order and the Rice parameters of a residual
+ *
+ * The sums of the folded residuals of the finest partitions are merged pairwise for the coarser orders, and every
+ * order is estimated from the sums. The chosen order is then counted exactly.
+ *
+ * @returns the exact size of the residual section in bits
+ */
+uint64_t flac_PlanRice(const int32_t* residual, uint32_t block, uint32_t order, uint32_t max_partition_order,
+                       uint64_t* sums, struct flac_subframe* sf){
+    uint32_t max_order = max_partition_order;
+    while(max_order > 0 && ((block & ((1u << max_order) - 1)) != 0 || (block >> max_order) <= order)) max_order--;
+
+    const uint32_t partitions = 1u << max_order;
+    const uint32_t length = block >> max_order;
+    for(uint32_t p = 0, i = 0; p < partitions; p++){
+        uint64_t sum = 0;
+        uint32_t end = (p + 1) * length - order;
+        for(; i < end; i++) sum += flac_Fold(residual[i]);
+        sums[p] = sum;
+    }
+
+    uint64_t best = UINT64_MAX;
+    for(uint32_t po = max_order + 1; po-- > 0;){
+        uint32_t n = 1u << po;
+        uint64_t estimate = 0;
+        uint8_t parameters[1 << FLAC_MAX_PARTITION_ORDER];
+        short wide = 0;
+        for(uint32_t p = 0; p < n; p++){
+            uint64_t count = (block >> po) - (p == 0 ? order : 0);
+            uint32_t k = 0;
+            while(k < 30 && count > 0 && (count << (k + 1)) <= sums[p]) k++;
+            parameters[p] = (uint8_t)k;
+            wide |= k > 14;
+            estimate += count * (k + 1) + (sums[p] >> k);
+        }
+        estimate += (uint64_t)n * (wide ? 5 : 4);
+        if(estimate < best){
+            best = estimate;
+            sf->partition_order = po;
+            sf->method = wide;
+            memcpy(sf->parameters, parameters, n);
+        }
+        for(uint32_t p = 0; p < n / 2; p++) sums[p] = sums[2*p] + sums[2*p + 1];
+    }
+
+    const uint32_t n = 1u << sf->partition_order;
+    uint64_t size = 2 + 4 + (uint64_t)n * (sf->method ? 5 : 4);
+    for(uint32_t p = 0, i = 0; p < n; p++){
+        const uint32_t k = sf->parameters[p];
+        uint32_t end = (p + 1) * (block >> sf->partition_order) - order;
+        size += (uint64_t)(end - i) * (k + 1);
+        for(; i < end; i++) size += flac_Fold(residual[i]) >> k;
+    }
+    return size;
+}
+
+/**
+ * @brief Computes the residual of a fixed polynomial predictor
+ */
+void flac_FixedResidual(const int32_t* x, uint32_t n, uint32_t order, int32_t* residual){
+    for(uint32_t i = order; i < n; i++){
+        int64_t r;
+        switch(order){
+            case 0: r = x[i]; break;
+            case 1: r = (int64_t)x[i] - x[i-1]; break;
+            case 2: r = (int64_t)x[i] - 2*(int64_t)x[i-1] + x[i-2]; break;
+            case 3: r = (int64_t)x[i] - 3*(int64_t)x[i-1] + 3*(int64_t)x[i-2] - x[i-3]; break;
+            default: r = (int64_t)x[i] - 4*(int64_t)x[i-1] + 6*(int64_t)x[i-2] - 4*(int64_t)x[i-3] + x[i-4]; break;
+        }
+        residual[i - order] = (int32_t)r;
+    }
+}
+
+/**
+ * @brief Returns the fixed order whose residual has the smallest sum of magnitudes
+ */
+uint32_t flac_FixedOrder(const int32_t* x, uint32_t n){
+    uint64_t sums[FLAC_MAX_FIXED_ORDER + 1] = {0};
+    for(uint32_t i = FLAC_MAX_FIXED_ORDER; i < n; i++){
+        int64_t e0 = x[i];
+        int64_t e1 = e0 - x[i-1];
+        int64_t e2 = e1 - ((int64_t)x[i-1] - x[i-2]);
+        int64_t e3 = e2 - ((int64_t)x[i-1] - 2*(int64_t)x[i-2] + x[i-3]);
+        int64_t e4 = e3 - ((int64_t)x[i-1] - 3*(int64_t)x[i-2] + 3*(int64_t)x[i-3] - x[i-4]);
+        sums[0] += (uint64_t)llabs(e0);
+        sums[1] += (uint64_t)llabs(e1);
+        sums[2] += (uint64_t)llabs(e2);
+        sums[3] += (uint64_t)llabs(e3);
+        sums[4] += (uint64_t)llabs(e4);
+    }
+    uint32_t order = 0;
+    for(uint32_t o = 1; o <= FLAC_MAX_FIXED_ORDER; o++){
+        if(sums[o] < sums[order]) order = o;
+    }
+    return order;
+}
+
+/**
+ * @brief Quantizes predictor coefficients to `precision` bit integers and a right shift, carrying the rounding
+ * error of each coefficient into the next
+ *
+ * @returns 0 on success, -1 if the coefficients are too large for the precision
+ */
+short flac_Quantize(const double* lp, uint32_t order, uint32_t precision, int32_t* q, int* shift){
+    double cmax = 0.0;
+    for(uint32_t i = 0; i < order; i++){
+        if(fabs(lp[i]) > cmax) cmax = fabs(lp[i]);
+    }
+    if(cmax <= 0.0) return -1;
+    int log2cmax;
+    frexp(cmax, &log2cmax);
+    precision--;
+    const int32_t qmax = (1 << precision) - 1;
+    const int32_t qmin = -(1 << precision);
+    *shift = (int)precision - log2cmax;
+    if(*shift > 15) *shift = 15;
+    if(*shift < 0) return -1;
+    double error = 0.0;
+    for(uint32_t i = 0; i < order; i++){
+        error += lp[i] * (1 << *shift);
+        long v = lround(error);
+        if(v > qmax) v = qmax;
+        if(v < qmin) v = qmin;
+        error -= (double)v;
+        q[i] = (int32_t)v;
+    }
+    return 0;
+}
+
+/**
+ * @brief Computes the residual of a quantized linear predictor
+ *
+ * @returns 0 on success, -1 if a residual does not fit in 32 bits
+ */
+short flac_LpcResidual(const int32_t* x, uint32_t n, const int32_t* q, uint32_t order, int shift, int32_t* residual){
+    for(uint32_t i = order; i < n; i++){
+        int64_t sum = 0;
+        for(uint32_t j = 0; j < order; j++) sum += (int64_t)q[j] * x[i - 1 - j];
+        int64_t r = x[i] - (sum >> shift);
+        if(r > INT32_MAX || r < INT32_MIN) return -1;
+        residual[i - order] = (int32_t)r;
+    }
+    return 0;
+}
+
+/**
+ * @brief Computes the predictors of every order up to max_order from the autocorrelation of a windowed block
+ * (Levinson-Durbin recursion)
+ *
+ * @param lp receives the coefficients of order o + 1 in lp[o], lp[o][j] weighs the sample j + 1 before
+ * @param error receives the prediction error of each order
+ *
+ * @returns the highest order computed, lower than max_order if the block is predicted perfectly before it
+ */
+uint32_t flac_LevinsonDurbin(const double* r, uint32_t max_order, double lp[][FLAC_MAX_LPC_ORDER], double* error){
+    double a[FLAC_MAX_LPC_ORDER] = {0};
+    double err = r[0];
+    for(uint32_t i = 0; i < max_order; i++){
+        if(err <= 0.0) return i;
+        double acc = r[i + 1];
+        for(uint32_t j = 0; j < i; j++) acc -= a[j] * r[i - j];
+        const double k = acc / err;
+        double previous[FLAC_MAX_LPC_ORDER];
+        memcpy(previous, a, i * sizeof(double));
+        for(uint32_t j = 0; j < i; j++) a[j] = previous[j] - k * previous[i - 1 - j];
+        a[i] = k;
+        err *= 1.0 - k * k;
+        memcpy(lp[i], a, (i + 1) * sizeof(double));
+        error[i] = err;
+    }
+    return max_order;
+}
+
+/**
+ * @brief Chooses the coding of one channel of a frame: CONSTANT, VERBATIM, a fixed predictor or a linear predictor,
+ * whichever takes the fewest bits
+ *
+ * @param x the samples of the channel
+ * @param bits bits per sample of the channel
+ * @param c the index of the channel's buffers in the scratch
+ */
+void flac_AnalyzeSubframe(const struct flac_params* params, struct flac_scratch* s, uint32_t c, uint32_t n, uint32_t bits,
+                          struct flac_subframe* sf){
+    const int32_t* x = s->channels[c];
+    sf->wasted = 0;
+    sf->order = 0;
+    sf->samples = x;
+
+    short constant = 1;
+    uint32_t any = 0;
+    for(uint32_t i = 0; i < n; i++){
+        constant &= x[i] == x[0];
+        any |= (uint32_t)x[i];
+    }
+    if(constant){
+        sf->type = FLAC_SUBFRAME_CONSTANT;
+        sf->bits = bits;
+        sf->size = 8 + bits;
+        return;
+    }
+
+    // low bits that are zero in every sample, e.g. 16 bit data in a 24 bit file, are not stored
+    const uint32_t wasted = (uint32_t)__builtin_ctz(any);
+    if(wasted > 0){
+        int32_t* shifted = s->shifted[c];
+        for(uint32_t i = 0; i < n; i++) shifted[i] = x[i] >> wasted;
+        x = shifted;
+        sf->samples = x;
+        sf->wasted = wasted;
+        bits -= wasted;
+    }
+    sf->bits = bits;
+    const uint64_t header = 8 + wasted;
+    sf->type = FLAC_SUBFRAME_VERBATIM;
+    sf->size = header + (uint64_t)n * bits;
+
+    int32_t* trial = s->residual[c][0];
+    int32_t* spare = s->residual[c][1];
+    struct flac_subframe candidate;
+
+    if(n > FLAC_MAX_FIXED_ORDER){
+        candidate.order = flac_FixedOrder(x, n);
+        flac_FixedResidual(x, n, candidate.order, trial);
+        candidate.size = header + (uint64_t)candidate.order * bits +
+                         flac_PlanRice(trial, n, candidate.order, params->max_partition_order, s->sums, &candidate);
+        if(candidate.size < sf->size){
+            sf->type = FLAC_SUBFRAME_FIXED;
+            sf->order = candidate.order;
+            sf->size = candidate.size;
+            sf->residual = trial;
+            sf->partition_order = candidate.partition_order;
+            sf->method = candidate.method;
+            memcpy(sf->parameters, candidate.parameters, 1u << candidate.partition_order);
+            trial = spare;
+            spare = (int32_t*)sf->residual;
+        }
+    }
+
+    uint32_t max_order = params->max_lpc_order < n ? params->max_lpc_order : n - 1;
+    if(max_order == 0) return;
+
+    // a Tukey window with tapers of a quarter of the block on each side
+    if(s->window_size != n){
+        const uint32_t taper = n / 4;
+        for(uint32_t i = 0; i < n; i++){
+            double w = 1.0;
+            if(i < taper) w = 0.5 - 0.5 * cos(M_PI * i / taper);
+            else if(i >= n - taper) w = 0.5 - 0.5 * cos(M_PI * (n - 1 - i) / taper);
+            s->window[i] = w;
+        }
+        s->window_size = n;
+    }
+    double r[FLAC_MAX_LPC_ORDER + 1];
+    for(uint32_t i = 0; i < n; i++) s->windowed[i] = x[i] * s->window[i];
+    for(uint32_t lag = 0; lag <= max_order; lag++){
+        double sum = 0.0;
+        for(uint32_t i = lag; i < n; i++) sum += s->windowed[i] * s->windowed[i - lag];
+        r[lag] = sum;
+    }
+    double lp[FLAC_MAX_LPC_ORDER][FLAC_MAX_LPC_ORDER];
+    double error[FLAC_MAX_LPC_ORDER];
+    max_order = flac_LevinsonDurbin(r, max_order, lp, error);
+    if(max_order == 0) return;
+
+    uint32_t precision = n <= 192 ? 7 : n <= 384 ? 8 : n <= 576 ? 9 : n <= 1152 ? 10 : n <= 2304 ? 11 : n <= 4608 ? 12 : 13;
+    if(bits > 16) precision += 2;
+
+    // the order with the smallest estimated size and the highest order, or every order. The estimate assumes
+    // Laplacian residuals and often stops short on music, where the highest order usually wins
+    uint32_t orders[FLAC_MAX_LPC_ORDER];
+    uint32_t count = 0;
+    if(params->exhaustive){
+        for(uint32_t o = 1; o <= max_order; o++) orders[count++] = o;
+    } else{
+        double best = INFINITY;
+        uint32_t estimated = max_order;
+        for(uint32_t o = 1; o <= max_order; o++){
+            double per_sample = error[o - 1] > 0.0 ? 0.5 * log2(0.5 * error[o - 1] / n) : 0.0;
+            if(per_sample < 0.0) per_sample = 0.0;
+            double estimate = per_sample * (n - o) + (double)o * (precision + bits);
+            if(estimate < best){
+                best = estimate;
+                estimated = o;
+            }
+        }
+        orders[count++] = estimated;
+        if(estimated != max_order) orders[count++] = max_order;
+    }
+    for(uint32_t i = 0; i < count; i++){
+        const uint32_t o = orders[i];
+        if(flac_Quantize(lp[o - 1], o, precision, candidate.coefficients, &candidate.shift) != 0) continue;
+        if(flac_LpcResidual(x, n, candidate.coefficients, o, candidate.shift, trial) != 0) continue;
+        candidate.size = header + (uint64_t)o * bits + 4 + 5 + (uint64_t)o * precision +
+                         flac_PlanRice(trial, n, o, params->max_partition_order, s->sums, &candidate);
+        if(candidate.size < sf->size){
+            sf->type = FLAC_SUBFRAME_LPC;
+            sf->order = o;
+            sf->precision = precision;
+            sf->shift = candidate.shift;
+            memcpy(sf->coefficients, candidate.coefficients, o * sizeof(int32_t));
+            sf->size = candidate.size;
+            sf->residual = trial;
+            sf->partition_order = candidate.partition_order;
+            sf->method = candidate.method;
+            memcpy(sf->parameters, candidate.parameters, 1u << candidate.partition_order);
+            int32_t* swap = trial;
+            trial = spare;
+            spare = swap;
+        }
+    }
+}
+
+void flac_PutSubframe(struct flac_writer* w, const struct flac_subframe* sf, uint32_t n){
+    flac_Put(w, 0, 1);
+    if(sf->type == FLAC_SUBFRAME_LPC) flac_Put(w, FLAC_SUBFRAME_LPC | (sf->order - 1), 6);
+    else if(sf->type == FLAC_SUBFRAME_FIXED) flac_Put(w, FLAC_SUBFRAME_FIXED | sf->order, 6);
+    else flac_Put(w, (uint32_t)sf->type, 6);
+    if(sf->wasted > 0){
+        flac_Put(w, 1, 1);
+        flac_PutUnary(w, sf->wasted - 1);
+    } else{
+        flac_Put(w, 0, 1);
+    }
+
+    if(sf->type == FLAC_SUBFRAME_CONSTANT){
+        flac_Put(w, (uint32_t)sf->samples[0], sf->bits);
+        return;
+    }
+    if(sf->type == FLAC_SUBFRAME_VERBATIM){
+        for(uint32_t i = 0; i < n; i++) flac_Put(w, (uint32_t)sf->samples[i], sf->bits);
+        return;
+    }
+    for(uint32_t i = 0; i < sf->order; i++) flac_Put(w, (uint32_t)sf->samples[i], sf->bits);
+    if(sf->type == FLAC_SUBFRAME_LPC){
+        flac_Put(w, sf->precision - 1, 4);
+        flac_Put(w, (uint32_t)sf->shift, 5);
+        for(uint32_t i = 0; i < sf->order; i++) flac_Put(w, (uint32_t)sf->coefficients[i], sf->precision);
+    }
+
+    const uint32_t partitions = 1u << sf->partition_order;
+    const uint32_t parameter_bits = sf->method ? 5 : 4;
+    flac_Put(w, sf->method, 2);
+    flac_Put(w, sf->partition_order, 4);
+    for(uint32_t p = 0, i = 0; p < partitions; p++){
+        const uint32_t k = sf->parameters[p];
+        flac_Put(w, k, parameter_bits);
+        uint32_t end = (p + 1) * (n >> sf->partition_order) - sf->order;
+        for(; i < end; i++) flac_PutRice(w, flac_Fold(sf->residual[i]), k);
+    }
+}
+
+static uint32_t flac_BlockCode(uint32_t n){
+    if(n == 192) return 1;
+    for(uint32_t c = 2; c <= 5; c++){
+        if(n == 576u << (c - 2)) return c;
+    }
+    for(uint32_t c = 8; c <= 15; c++){
+        if(n == 256u << (c - 8)) return c;
+    }
+    return n <= 256 ? 6 : 7;
+}
+
+static uint32_t flac_RateCode(uint32_t rate){
+    static const uint32_t rates[12] = {0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+    for(uint32_t c = 1; c < 12; c++){
+        if(rate == rates[c]) return c;
+    }
+    if(rate % 1000 == 0 && rate / 1000 < 256) return 12;
+    if(rate < 65536) return 13;
+    if(rate % 10 == 0 && rate / 10 < 65536) return 14;
+    return 0;
+}
+
+static uint32_t flac_SizeCode(uint32_t bits){
+    return bits == 8 ? 1 : bits == 12 ? 2 : bits == 16 ? 4 : bits == 20 ? 5 : bits == 24 ? 6 : 0;
+}
+
+/**
+ * @brief Returns the size in bytes that a frame of n samples per channel takes at most
+ */
+size_t flac_FrameCapacity(uint32_t n, const struct flac_format* format){
+    return 32 + (size_t)format->channels * (((size_t)n * (format->bits + 1) + 7) / 8 + 8);
+}
+
+/**
+ * @brief Converts interleaved 8 (unsigned), 16 or 24 bit PCM samples to one array of integers per channel
+ */
+void flac_Deinterleave(const char* raw, uint32_t n, const struct flac_format* format, int32_t* const* channels){
+    const uint8_t* in = (const uint8_t*)raw;
+    const uint32_t count = format->channels;
+    for(uint32_t i = 0; i < n; i++){
+        for(uint32_t c = 0; c < count; c++){
+            int32_t v;
+            if(format->bits == 8){
+                v = (int32_t)in[0] - 128;
+                in += 1;
+            } else if(format->bits == 16){
+                v = (int16_t)(in[0] | in[1] << 8);
+                in += 2;
+            } else{
+                v = (int32_t)((uint32_t)in[0] << 8 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 24) >> 8;
+                in += 3;
+            }
+            channels[c][i] = v;
+        }
+    }
+}
+
+/**
+ * @brief Encodes one frame
+ *
+ * @param raw n interleaved PCM frames
+ * @param number the index of the frame in the stream
+ * @param out receives the frame, flac_FrameCapacity() bytes
+ *
+ * @returns the size of the frame in bytes
+ */
+size_t flac_EncodeFrame(const struct flac_params* params, struct flac_scratch* s, const struct flac_format* format,
+                        const char* raw, uint32_t n, uint64_t number, uint8_t* out){
+    const uint32_t channels = format->channels;
+    const uint32_t bits = format->bits;
+    flac_Deinterleave(raw, n, format, s->channels);
+
+    struct flac_subframe subframes[FLAC_MAX_CHANNELS + 2];
+    for(uint32_t c = 0; c < channels; c++) flac_AnalyzeSubframe(params, s, c, n, bits, &subframes[c]);
+
+    uint32_t assignment = FLAC_INDEPENDENT;
+    const struct flac_subframe* chosen[FLAC_MAX_CHANNELS];
+    for(uint32_t c = 0; c < channels; c++) chosen[c] = &subframes[c];
+    if(channels == 2 && params->stereo){
+        int32_t* mid = s->channels[2];
+        int32_t* side = s->channels[3];
+        const int32_t* left = s->channels[0];
+        const int32_t* right = s->channels[1];
+        for(uint32_t i = 0; i < n; i++){
+            mid[i] = (left[i] + right[i]) >> 1;
+            side[i] = left[i] - right[i];
+        }
+        flac_AnalyzeSubframe(params, s, 2, n, bits, &subframes[2]);
+        flac_AnalyzeSubframe(params, s, 3, n, bits + 1, &subframes[3]);
+        const uint64_t l = subframes[0].size, r = subframes[1].size, m = subframes[2].size, d = subframes[3].size;
+        uint64_t best = l + r;
+        if(l + d < best){ best = l + d; assignment = FLAC_LEFT_SIDE; chosen[1] = &subframes[3]; }
+        if(d + r < best){ best = d + r; assignment = FLAC_SIDE_RIGHT; chosen[0] = &subframes[3]; chosen[1] = &subframes[1]; }
+        if(m + d < best){ assignment = FLAC_MID_SIDE; chosen[0] = &subframes[2]; chosen[1] = &subframes[3]; }
+    }
+
+    struct flac_writer w = {out, 0, 0, 0};
+    flac_Put(&w, 0xFFF8, 16);                           // sync code, fixed block size
+    const uint32_t block_code = flac_BlockCode(n);
+    const uint32_t rate_code = flac_RateCode(format->sample_rate);
+    flac_Put(&w, block_code, 4);
+    flac_Put(&w, rate_code, 4);
+    flac_Put(&w, assignment == FLAC_INDEPENDENT ? channels - 1 : assignment, 4);
+    flac_Put(&w, flac_SizeCode(bits), 3);
+    flac_Put(&w, 0, 1);
+    flac_PutNumber(&w, number);
+    if(block_code == 6) flac_Put(&w, n - 1, 8);
+    if(block_code == 7) flac_Put(&w, n - 1, 16);
+    if(rate_code == 12) flac_Put(&w, format->sample_rate / 1000, 8);
+    if(rate_code == 13) flac_Put(&w, format->sample_rate, 16);
+    if(rate_code == 14) flac_Put(&w, format->sample_rate / 10, 16);
+    flac_Put(&w, flac_Crc8(0, out, w.bytes), 8);
+
+    for(uint32_t c = 0; c < channels; c++) flac_PutSubframe(&w, chosen[c], n);
+    flac_Align(&w);
+    flac_Put(&w, flac_Crc16(0, out, w.bytes), 16);
+    return w.bytes;
+}
+
+/**
+ * @brief The frames of a batch that a single thread encodes
+ */
+struct flac_job {
+    const struct flac_params* params;
+    const struct flac_format* format;
+    const char* raw;                // the interleaved PCM frames of the batch
+    uint32_t samples;               // samples per channel in the batch, the last frame may be shorter than a block
+    uint64_t number;                // the index of the first frame of the batch in the stream
+    uint8_t* out;                   // flac_FrameCapacity(block) bytes per frame of the batch
+    size_t* sizes;                  // receives the size of each frame of the batch
+    uint32_t first;                 // first frame of the batch that this job encodes
+    uint32_t last;                  // one past the last frame
+    short threaded;                 // 1 if the job runs on its own thread and must be joined
+};
+
+/**
+ * @brief Thread entry point that encodes the frames of a flac_job
+ */
+void* flac_Worker(void* arg){
+    struct flac_job* job = arg;
+    const uint32_t block = job->params->block;
+    const size_t capacity = flac_FrameCapacity(block, job->format);
+    const size_t frame_bytes = (size_t)block * job->format->channels * (job->format->bits / 8);
+    struct flac_scratch s;
+    if(flac_scratch_Create(&s, block, job->format->channels) != 0) return (void*)1;
+    for(uint32_t f = job->first; f < job->last; f++){
+        uint32_t n = job->samples - f * block < block ? job->samples - f * block : block;
+        job->sizes[f] = flac_EncodeFrame(job->params, &s, job->format, job->raw + f * frame_bytes, n,
+                                         job->number + f, job->out + f * capacity);
+    }
+    flac_scratch_Destroy(&s);
+    return NULL;
+}
+
+/**
+ * @brief Formats "fLaC" and the STREAMINFO block
+ *
+ * @param b receives 42 bytes
+ * @param md5 the MD5 of the samples, or NULL if it is not known
+ */
+void flac_FormatStreamInfo(uint8_t* b, const struct flac_format* format, uint32_t block, uint32_t min_frame,
+                           uint32_t max_frame, uint64_t samples, const uint8_t* md5){
+    struct flac_writer w = {b, 0, 0, 0};
+    memcpy(b, "fLaC", 4);
+    w.bytes = 4;
+    flac_Put(&w, 0x80, 8);                              // the last metadata block, STREAMINFO
+    flac_Put(&w, 34, 24);
+    flac_Put(&w, block, 16);
+    flac_Put(&w, block, 16);
+    flac_Put(&w, min_frame, 24);
+    flac_Put(&w, max_frame, 24);
+    flac_Put(&w, format->sample_rate, 20);
+    flac_Put(&w, format->channels - 1u, 3);
+    flac_Put(&w, format->bits - 1u, 5);
+    flac_Put(&w, (uint32_t)(samples >> 32), 4);
+    flac_Put(&w, (uint32_t)samples, 32);
+    if(md5 != NULL) memcpy(b + w.bytes, md5, 16);
+    else memset(b + w.bytes, 0, 16);
+}
+
+/**
+ * @brief The STREAMINFO of a stream
+ */
+struct flac_stream {
+    struct flac_format format;
+    uint32_t min_block;
+    uint32_t max_block;
+    uint64_t samples;               // 0 if not known
+    uint8_t md5[16];                // all zero if not known
+};
+
+/**
+ * @brief Reads "fLaC" and the metadata blocks, keeping STREAMINFO
+ *
+ * @returns 0 on success, -1 on error
+ */
+short flac_ReadStreamInfo(struct flac_reader* r, struct flac_stream* stream){
+    char tag[4];
+    for(int i = 0; i < 4; i++) tag[i] = (char)flac_Get(r, 8);
+    if(r->eof || memcmp(tag, "fLaC", 4) != 0){
+        fprintf(stderr, "Error! \"fLaC\" not found\n");
+        return -1;
+    }
+    short found = 0;
+    for(uint32_t last = 0; !last;){
+        last = flac_Get(r, 1);
+        uint32_t type = flac_Get(r, 7);
+        uint32_t length = flac_Get(r, 24);
+        if(type == 0 && length == 34){
+            stream->min_block = flac_Get(r, 16);
+            stream->max_block = flac_Get(r, 16);
+            flac_Get(r, 24);
+            flac_Get(r, 24);
+            stream->format.sample_rate = flac_Get(r, 20);
+            stream->format.channels = (uint16_t)(flac_Get(r, 3) + 1);
+            stream->format.bits = (uint16_t)(flac_Get(r, 5) + 1);
+            stream->samples = (uint64_t)flac_Get(r, 4) << 32;
+            stream->samples |= flac_Get(r, 32);
+            for(int i = 0; i < 16; i++) stream->md5[i] = (uint8_t)flac_Get(r, 8);
+            found = 1;
+        } else{
+            for(uint32_t i = 0; i < length && !r->eof; i++) flac_Get(r, 8);
+        }
+        if(r->eof){
+            fprintf(stderr, "Error! the FLAC metadata is truncated\n");
+            return -1;
+        }
+    }
+    if(!found){
+        fprintf(stderr, "Error! STREAMINFO not found\n");
+        return -1;
+    }
+    if(stream->format.bits < 4 || stream->format.bits > 24){
+        fprintf(stderr, "Error! FLAC samples of %u bits are not supported, the maximum is 24\n", stream->format.bits);
+        return -1;
+    }
+    if(stream->max_block < FLAC_MIN_BLOCK || stream->format.sample_rate == 0){
+        fprintf(stderr, "Error! invalid STREAMINFO\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads the residual of a subframe into out[order..block)
+ */
+static short flac_ReadResidual(struct flac_reader* r, int32_t* out, uint32_t block, uint32_t order){
+    const uint32_t method = flac_Get(r, 2);
+    if(method > 1) return -1;
+    const uint32_t parameter_bits = method ? 5 : 4;
+    const uint32_t escape = (1u << parameter_bits) - 1;
+    const uint32_t partition_order = flac_Get(r, 4);
+    const uint32_t length = block >> partition_order;
+    if((block & ((1u << partition_order) - 1)) != 0 || length < order) return -1;
+    int32_t* p = out + order;
+    for(uint32_t part = 0; part < (1u << partition_order); part++){
+        const uint32_t k = flac_Get(r, parameter_bits);
+        const uint32_t count = length - (part == 0 ? order : 0);
+        if(k == escape){
+            const uint32_t bits = flac_Get(r, 5);
+            for(uint32_t i = 0; i < count; i++) p[i] = flac_GetSigned(r, bits);
+        } else{
+            for(uint32_t i = 0; i < count; i++){
+                uint32_t u = flac_GetUnary(r) << k | flac_Get(r, k);
+                p[i] = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+            }
+        }
+        if(r->eof) return -1;
+        p += count;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads one subframe
+ *
+ * @returns 0 on success, -1 on error
+ */
+static short flac_ReadSubframe(struct flac_reader* r, int32_t* out, uint32_t block, uint32_t bits){
+    if(flac_Get(r, 1) != 0) return -1;
+    const uint32_t type = flac_Get(r, 6);
+    uint32_t wasted = 0;
+    if(flac_Get(r, 1)){
+        wasted = flac_GetUnary(r) + 1;
+        if(wasted >= bits) return -1;
+        bits -= wasted;
+    }
+
+    if(type == FLAC_SUBFRAME_CONSTANT){
+        const int32_t v = flac_GetSigned(r, bits);
+        for(uint32_t i = 0; i < block; i++) out[i] = v;
+    } else if(type == FLAC_SUBFRAME_VERBATIM){
+        for(uint32_t i = 0; i < block; i++) out[i] = flac_GetSigned(r, bits);
+    } else if(type >= FLAC_SUBFRAME_FIXED && type <= FLAC_SUBFRAME_FIXED + FLAC_MAX_FIXED_ORDER){
+        const uint32_t order = type - FLAC_SUBFRAME_FIXED;
+        if(order > block) return -1;
+        for(uint32_t i = 0; i < order; i++) out[i] = flac_GetSigned(r, bits);
+        if(flac_ReadResidual(r, out, block, order) != 0) return -1;
+        for(uint32_t i = order; i < block; i++){
+            int64_t p;
+            switch(order){
+                case 0: p = 0; break;
+                case 1: p = out[i-1]; break;
+                case 2: p = 2*(int64_t)out[i-1] - out[i-2]; break;
+                case 3: p = 3*(int64_t)out[i-1] - 3*(int64_t)out[i-2] + out[i-3]; break;
+                default: p = 4*(int64_t)out[i-1] - 6*(int64_t)out[i-2] + 4*(int64_t)out[i-3] - out[i-4]; break;
+            }
+            out[i] = (int32_t)(out[i] + p);
+        }
+    } else if(type >= FLAC_SUBFRAME_LPC){
+        const uint32_t order = (type & 31) + 1;
+        if(order > block) return -1;
+        for(uint32_t i = 0; i < order; i++) out[i] = flac_GetSigned(r, bits);
+        const uint32_t precision = flac_Get(r, 4) + 1;
+        const int shift = flac_GetSigned(r, 5);
+        if(precision == 16 || shift < 0) return -1;
+        int32_t q[FLAC_MAX_LPC_ORDER];
+        for(uint32_t j = 0; j < order; j++) q[j] = flac_GetSigned(r, precision);
+        if(flac_ReadResidual(r, out, block, order) != 0) return -1;
+        for(uint32_t i = order; i < block; i++){
+            int64_t sum = 0;
+            for(uint32_t j = 0; j < order; j++) sum += (int64_t)q[j] * out[i - 1 - j];
+            out[i] = (int32_t)(out[i] + (sum >> shift));
+        }
+    } else{
+        return -1;
+    }
+
+    if(wasted > 0){
+        for(uint32_t i = 0; i < block; i++) out[i] = (int32_t)((uint32_t)out[i] << wasted);
+    }
+    return r->eof ? -1 : 0;
+}
+
+/**
+ * @brief Reads one frame
+ *
+ * @param channels one array of max_block samples per channel
+ * @param block receives the number of samples per channel of the frame
+ *
+ * @returns 1 for a frame, 0 at the end of the stream, -1 on error
+ */
+short flac_ReadFrame(struct flac_reader* r, const struct flac_stream* stream, int32_t* const* channels, uint32_t* block){
+    r->crc8 = 0;
+    r->crc16 = 0;
+    if(r->count == 0 && !flac_Load(r)) return 0;
+    const uint32_t sync = flac_Get(r, 16);
+    if((sync & 0xFFFE) != 0xFFF8){
+        fprintf(stderr, "Error! lost the sync of the FLAC frames\n");
+        return -1;
+    }
+    const uint32_t block_code = flac_Get(r, 4);
+    const uint32_t rate_code = flac_Get(r, 4);
+    const uint32_t assignment = flac_Get(r, 4);
+    const uint32_t size_code = flac_Get(r, 3);
+    flac_Get(r, 1);
+
+    // the frame or sample number
+    uint32_t b = flac_Get(r, 8);
+    uint32_t bytes = 0;
+    while(bytes < 8 && (b & (0x80u >> bytes))) bytes++;
+    if(bytes == 1 || bytes > 7){
+        fprintf(stderr, "Error! invalid FLAC frame number\n");
+        return -1;
+    }
+    for(uint32_t i = 1; i < bytes; i++){
+        if((flac_Get(r, 8) & 0xC0) != 0x80){
+            fprintf(stderr, "Error! invalid FLAC frame number\n");
+            return -1;
+        }
+    }
+
+    uint32_t n = 0;
+    if(block_code == 1) n = 192;
+    else if(block_code >= 2 && block_code <= 5) n = 576u << (block_code - 2);
+    else if(block_code == 6) n = flac_Get(r, 8) + 1;
+    else if(block_code == 7) n = flac_Get(r, 16) + 1;
+    else if(block_code >= 8) n = 256u << (block_code - 8);
+    if(rate_code == 12) flac_Get(r, 8);
+    else if(rate_code == 13 || rate_code == 14) flac_Get(r, 16);
+    static const uint8_t sizes[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+    const uint32_t bits = size_code == 0 ? stream->format.bits : sizes[size_code];
+    const uint32_t channel_count = assignment < 8 ? assignment + 1 : 2;
+    const uint8_t crc8 = r->crc8;
+    if(flac_Get(r, 8) != crc8 || r->eof){
+        fprintf(stderr, "Error! CRC mismatch in a FLAC frame header\n");
+        return -1;
+    }
+    if(n == 0 || n > stream->max_block || rate_code == 15 || assignment > FLAC_MID_SIDE ||
+       channel_count != stream->format.channels || bits != stream->format.bits){
+        fprintf(stderr, "Error! the FLAC frame does not match STREAMINFO\n");
+        return -1;
+    }
+
+    for(uint32_t c = 0; c < channel_count; c++){
+        // the side channel takes one more bit
+        const short side = (assignment == FLAC_LEFT_SIDE && c == 1) || (assignment == FLAC_SIDE_RIGHT && c == 0) ||
+                           (assignment == FLAC_MID_SIDE && c == 1);
+        if(flac_ReadSubframe(r, channels[c], n, bits + side) != 0){
+            fprintf(stderr, r->eof ? "Error! the FLAC stream is truncated\n" : "Error! invalid FLAC subframe\n");
+            return -1;
+        }
+    }
+    r->count -= r->count % 8;
+    const uint16_t crc16 = r->crc16;
+    if(flac_Get(r, 16) != crc16 || r->eof){
+        fprintf(stderr, "Error! CRC mismatch in a FLAC frame\n");
+        return -1;
+    }
+
+    int32_t* a = channels[0];
+    int32_t* d = channels[1];
+    if(assignment == FLAC_LEFT_SIDE){
+        for(uint32_t i = 0; i < n; i++) d[i] = a[i] - d[i];
+    } else if(assignment == FLAC_SIDE_RIGHT){
+        for(uint32_t i = 0; i < n; i++) a[i] += d[i];
+    } else if(assignment == FLAC_MID_SIDE){
+        for(uint32_t i = 0; i < n; i++){
+            int32_t mid = (int32_t)((uint32_t)a[i] << 1) | (d[i] & 1);
+            a[i] = (mid + d[i]) >> 1;
+            d[i] = (mid - d[i]) >> 1;
+        }
+    }
+    *block = n;
+    return 1;
+}
+
+static short flac_Write(FILE* out, const void* data, size_t size){
+    return (out == IO_OUT ? write_Block(data, size) : fwrite(data, 1, size, out)) == size ? 0 : -1;
+}
+
+/**
+ * @brief Decodes a FLAC stream to a WAV file. Samples of 4 to 7 bits become 8 bit, 9 to 15 bits 16 bit and 17 to
+ * 23 bits 24 bit PCM, shifted to the top of the container
+ *
+ * @returns 0 on success, 1 on error (reported to STDERR), 2 if the output was closed before the end
+ */
+int flac_Decode(FILE* in, FILE* out){
+    pthread_once(&flac_tables_once, flac_InitTables);
+    struct flac_reader* r = calloc(1, sizeof(struct flac_reader));
+    if(r == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        return 1;
+    }
+    r->in = in;
+    struct flac_stream stream;
+    if(flac_ReadStreamInfo(r, &stream) != 0){
+        free(r);
+        return 1;
+    }
+
+    const uint32_t channels = stream.format.channels;
+    const uint32_t width = (stream.format.bits + 7u) / 8u;
+    const uint32_t shift = width * 8 - stream.format.bits;
+    const uint64_t data_size = stream.samples * channels * width;
+    if(stream.samples == 0 || data_size > UINT32_MAX - SIZE_OF_WAVE_HEADER){
+        fprintf(stderr, stream.samples == 0 ? "Error! the FLAC stream does not give its length\n"
+                                            : "Error! the FLAC stream is too long for a WAV file\n");
+        free(r);
+        return 1;
+    }
+    struct wav_header header;
+    header.format_chunk = 16;
+    header.wave_format = WAVE_FORMAT_PCM;
+    header.mono_stereo = (uint16_t)channels;
+    header.sample_rate = stream.format.sample_rate;
+    header.block_align = (uint16_t)(channels * width);
+    header.bytes_per_sec = header.sample_rate * header.block_align;
+    header.bits_per_sample = (uint16_t)(width * 8);
+    header.data_segment_size = (uint32_t)data_size;
+    header.size_of_file = SIZE_OF_WAVE_HEADER + header.data_segment_size;
+    if(out == IO_OUT) write_WavHeader(&header);
+    else fwrite_WavHeader(out, &header);
+
+    int32_t* samples = malloc((size_t)stream.max_block * channels * sizeof(int32_t));
+    uint8_t* bytes = malloc((size_t)stream.max_block * channels * width * 2);
+    int32_t* planes[FLAC_MAX_CHANNELS];
+    if(samples == NULL || bytes == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free(samples);
+        free(bytes);
+        free(r);
+        return 1;
+    }
+    for(uint32_t c = 0; c < channels; c++) planes[c] = samples + (size_t)c * stream.max_block;
+    uint8_t* plain = bytes + (size_t)stream.max_block * channels * width;
+
+    struct flac_md5 md5;
+    flac_md5_Init(&md5);
+    int status = 0;
+    uint64_t decoded = 0;
+    for(;;){
+        uint32_t n;
+        short got = flac_ReadFrame(r, &stream, planes, &n);
+        if(got < 0) status = 1;
+        if(got <= 0) break;
+        if(decoded + n > stream.samples) n = (uint32_t)(stream.samples - decoded);
+        // the WAV bytes, and the bytes of the MD5 where they differ: signed and without the shift
+        uint8_t* o = bytes;
+        uint8_t* m = plain;
+        for(uint32_t i = 0; i < n; i++){
+            for(uint32_t c = 0; c < channels; c++){
+                const int32_t v = planes[c][i];
+                const uint32_t u = (uint32_t)v << shift;
+                if(width == 1){
+                    *o++ = (uint8_t)(u + 128);
+                } else{
+                    for(uint32_t k = 0; k < width; k++) *o++ = (uint8_t)(u >> (8 * k));
+                }
+                for(uint32_t k = 0; k < width; k++) *m++ = (uint8_t)((uint32_t)v >> (8 * k));
+            }
+        }
+        flac_md5_Update(&md5, plain, (size_t)n * channels * width);
+        decoded += n;
+        if(flac_Write(out, bytes, (size_t)n * channels * width) != 0){
+            status = 2;
+            break;
+        }
+    }
+
+    if(status == 0 && decoded != stream.samples){
+        fprintf(stderr, "Error! the FLAC stream ended after %" PRIu64 " of %" PRIu64 " samples\n", decoded, stream.samples);
+        status = 1;
+    }
+    static const uint8_t unknown[16] = {0};
+    uint8_t digest[16];
+    flac_md5_Final(&md5, digest);
+    if(status == 0 && memcmp(stream.md5, unknown, 16) != 0 && memcmp(stream.md5, digest, 16) != 0){
+        fprintf(stderr, "Error! the MD5 of the decoded samples does not match STREAMINFO\n");
+        status = 1;
+    }
+    free(samples);
+    free(bytes);
+    free(r);
+    return status;
+}
+
+/**
+ * @brief Returns 1 if a stream starts with a FLAC file. A WAV file starts with "RIFF", so the first byte is enough
+ * and can be put back
+ */
+short flac_Detect(FILE* in){
+    if(isatty(fileno(in))) return 0;
+    int c = getc(in);
+    if(c == EOF) return 0;
+    ungetc(c, in);
+    return c == 'f';
+}
+
+static int flac_PipeDecode(FILE* in, FILE* out, void* arg){
+    (void)arg;
+    return flac_Decode(in, out);
+}
+
+/**
+ * @brief Runs a command line whose STDIN is a FLAC stream, with the stream decoded into a pipe that the command
+ * reads as a WAV file
+ *
+ * @param run the function that runs the command line
+ *
+ * @returns the status of the command, or 1 if the stream could not be decoded
+ */
+int flac_Run(int (*run)(int, char*[]), int argc, char* argv[]){
+    return codec_PipeRun(flac_PipeDecode, NULL, run, argc, argv);
+}
+
+/**
+ * @brief Opens a file for reading as a WAV file: FLAC, mu-law, A-law and IMA ADPCM files are decoded by a thread,
+ * other files are read directly
+ *
+ * @param s the stream, closed with codec_StreamClose() once the file has been read
+ *
+ * @returns the stream to read, or NULL with an error reported
+ */
+FILE* flac_Open(FILE* in, struct codec_stream* s){
+    if(!flac_Detect(in)) return codec_Open(in, s);
+    memset(s, 0, sizeof(struct codec_stream));
+    return codec_StreamOpen(s, flac_PipeDecode, NULL, in);
+}
@@ -0,0 +1,1540 @@
+/**
+ * @file libsoundwave.c
+ * @author Rafael Dioaltzis
+ * @brief The main core code of soundwave, built as libsoundwave.a and libsoundwave.so
+ * @version 0.1
+ * @date 2025-12-01
+ * 
+ * @copyright Copyright (c) 2025
+ * 
+ */
+
+#include"libsoundwave.h"
+#include"soundman.h"
+#include"serve.h"
+#include"batch.h"
+#include"cache.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<inttypes.h>
+
+void print_help_message(){
+    fprintf(IO_OUT, "\nSoundWave - A simple WAV audio utility\n\n");
+    fprintf(IO_OUT, "Usage ./soundwave <command> [parameters]\n\n"
+           "Commands:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--help or -h", "displays this help message");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "info", "display the properties of the wav file");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "rate <value>", "changes the rate of the wav file");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "channel <left|right>", "keeps the data from one channel if wav is stereo");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "volume <value>", "changes the volume of the wav data");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "generate [options]", "Generate a WAV file with the specified options");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "dj [files] [options]", "plays the wav file, with live volume, pause and seek control");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "or plays files one after the other as decks, crossfading each into the next");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "spectrum [options]", "Writes the magnitude spectrogram of the wav data");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "filter <type:freq[:q[:gain]]>...", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "Applies a cascade of filters to the wav data");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "convolve <ir.wav> [options]", "Convolves the wav data with an impulse response");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "tempo <factor> [--mode wsola|pv]", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "changes the tempo of the wav data without changing its pitch");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "convert --bits <8|16|24|32|32f>", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "changes the bit depth of the wav data");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "fade [options]", "fades the wav data in and/or out");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "envelope <file.txt>", "multiplies the wav data by a breakpoint gain envelope");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "silence [options]", "reports, trims or splits on the silent regions of the wav data");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "serve --socket <path>", "runs commands sent by clients over a UNIX socket until interrupted");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "client --socket <path> <command>", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "runs a command on a server, or prints its counters with the stats command");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "batch --in <dir> --out <dir> <command>", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "runs a command on every .wav file of a directory");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "remix <preset|matrix>", "remixes the channels with a gain matrix (downmix, upmix)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "render <project.txt> [options]", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "renders a range of an edit decision list project");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "encode-flac [options]", "compresses the wav data to FLAC, losslessly");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "decode-flac", "decompresses FLAC data to a wav file");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "the commands that read wav data also read FLAC, e.g. ./soundwave dj < song.flac");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "fingerprint [<file|dir>...]", "writes the spectral peak hashes of wav files, or of STDIN");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "index build <index> <file|dir>...", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "fingerprints wav files into an inverted hash index");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "index query <index> [<file|dir>...]", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "finds the indexed files that share audio with wav files, or with STDIN");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "tempo-detect [<file|dir>...]", "writes the tempo and the first beat of wav files, or of STDIN (alias: bpm)\n");
+
+    fprintf(IO_OUT, "Global options (before the command):\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--stats[=text|json]", "Reports stage timings, throughput, peak RSS and page faults to STDERR");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--stats=<format>,counters", "Adds the cycles, instructions and cache misses of the compute stage (perf_event_open)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "e.g. ./soundwave --stats=json,counters volume 0.5 < in.wav > out.wav");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--cache <dir>", "Stores the outputs of rate, channel, remix, volume, convert, filter, fade, tempo and spectrum");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "and reuses them for the same input file and parameters");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--cache-limit <MB>", "Size of the cache, least recently used outputs are deleted (Default: 1024)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "e.g. ./soundwave --cache ~/.cache/soundwave volume 0.5 < in.wav > out.wav\n");
+
+    fprintf(IO_OUT, "Generate command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--dur <seconds>", "Duration of the sound (Default: 3)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--sr <rate>", "Sample rate in Hz (Default: 44100)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--fm <modulation>", "Frequency modulation (Default: 2.0)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--fc <carrier>", "Frequency carrier (Default: 1500.0)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--mi <index>", "Modulation index (Default: 100.0)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--amp <amplitude>", "Amplitude (Default: 30000.0)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--voice <wave[:freq[-to][:gain[:ch]]]>", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "Adds a wavetable or noise voice instead of the FM sound, may be repeated");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "waves: sine, saw, square, triangle, white, pink. e.g. --voice saw:220 --voice sine:20-20000");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--wave <wave> --freq <Hz[-Hz]>", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "Shorthand for a single voice (Default frequency: 440)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--sweep <lin|log>", "How voices with a frequency range move (Default: lin)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--channels <count>", "Number of channels of the voices, 1 to 8 (Default: 1)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--bits <8|16|24|32|32f>", "Bit depth of the voices (Default: 16)\n");
+
+    fprintf(IO_OUT, "Dj command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--xfade <time>", "Decks: length of the equal-power crossfades (Default: 0, gapless)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--beat-align", "Decks: crossfade on a beat and start each next file at its first beat");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--volume <gain>", "Initial volume, e.g. 0.5 or -6dB (Default: 1)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--control <path>", "Reads control lines from a file or FIFO instead of keys from the terminal");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "volume <gain>, pause, resume, toggle, seek <[+|-]time>, wait <time>, quit");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--sink <device|sim|virtual>", "sim writes what would be played to STDOUT as a WAV file, in real time");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "virtual does the same on a virtual clock and counts underruns");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--latency <low|normal|safe>", "Period and buffer: 256x2, 1024x4 or 2048x4 frames (Default: normal)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--period <frames>", "Period size in frames, the device may round it");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--periods <count>", "Periods of the buffer, playback starts when the buffer is full");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--stall <time>[@<time>]", "Virtual sink: the player stalls once, at a position (Default: 0)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "keys", "space pause/resume, + and - volume by 1 dB, arrows or , and . seek by 5 s, q quit\n");
+
+    fprintf(IO_OUT, "Spectrum command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--fft <size>", "FFT size, a power of two (Default: 1024)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--hop <samples>", "Distance between frames (Default: FFT size / 4)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--window <name>", "hann, hamming, blackman or rect (Default: hann)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--format <csv|bin|pgm>", "Magnitude matrix as text, as 32 bit floats or as an image (Default: csv)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--range <dB>", "Dynamic range of the pgm image (Default: 96)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--threads <count>", "Number of threads (Default: number of cores)\n");
+
+    fprintf(IO_OUT, "Filter types:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "lowpass, highpass", "freq is the cutoff frequency in Hz (Default Q: 0.7071)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "bandpass, notch", "freq is the center frequency in Hz");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "lowshelf, highshelf", "freq is the corner frequency, q the slope and gain in dB");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "peaking", "freq is the center frequency and gain in dB");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "e.g. ./soundwave filter highpass:80 peaking:3000:1.4:-4 < in.wav > out.wav\n");
+
+    fprintf(IO_OUT, "Convolve command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--block <frames>", "Partition size, a power of two (Default: based on the impulse response)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--gain <value>", "Gain applied to the output (Default: 1.0)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--threads <count>", "Convolve channels on their own threads when larger than 1 (Default: number of cores)\n");
+
+    fprintf(IO_OUT, "Convert command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--bits <8|16|24|32|32f>", "Output bit depth, 32f for float samples");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--codec <ulaw|alaw|ima-adpcm>", "Encode to G.711 mu-law or A-law, or to IMA ADPCM, instead of PCM");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "Every command decodes these formats to 16 bit PCM as it reads them");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--dither <tpdf|none>", "Dither (Default: tpdf when the bit depth is reduced)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--shape", "Shape the dither noise towards high frequencies\n");
+
+    fprintf(IO_OUT, "Rate, channel, volume and convert options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--threads <count>", "Threads that process ranges of the file when STDIN and STDOUT are files (Default: number of cores)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "e.g. ./soundwave volume 0.5 --threads 8 < in.wav > out.wav\n");
+
+    fprintf(IO_OUT, "Fade command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--in <time>", "Length of the fade in, e.g. 2s or 500ms (Default: 0)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--out <time>", "Length of the fade out (Default: 0)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--curve <lin|log|scurve>", "Shape of the fades (Default: lin)");
+
+    fprintf(IO_OUT, "Envelope file format:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "<time> <gain>", "one breakpoint per line, e.g. \"1.5s -6dB\" or \"2 0.5\"");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "the gain is interpolated linearly between breakpoints, '#' starts a comment\n");
+
+    fprintf(IO_OUT, "Silence command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--threshold <level>", "Samples at or below this level are silent, e.g. -50dB or 0.003 (Default: -50dB)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--min <time>", "Shortest silent region that is reported or split on (Default: 0.5s)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--mode <report|trim|split>", "Print the regions, trim the leading and trailing silence or");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "write the parts between regions to numbered files (Default: report)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--prefix <name>", "Files of the split mode are <name>_001.wav, <name>_002.wav ... (Default: segment)\n");
+
+    fprintf(IO_OUT, "Serve command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--socket <path>", "Path of the UNIX socket");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--workers <count>", "Number of worker processes (Default: number of cores)\n");
+
+    fprintf(IO_OUT, "Client command options (before the command):\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--socket <path>", "Path of the UNIX socket of the server");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--in <path> --out <path>", "Files of the job (Default: the STDIN and STDOUT of the client)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--repeat <count>", "Sends the job count times and prints the request rate and latency");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "e.g. ./soundwave client --socket /tmp/sw.sock volume 0.5 < in.wav > out.wav\n");
+
+    fprintf(IO_OUT, "Batch command options (before the command):\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--in <dir> --out <dir>", "Directory of the .wav files and directory of the results");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--io <auto|uring|threads|naive>", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "How the files are read and written (Default: auto, io_uring when available)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--depth <count>", "Number of files in flight (Default: 64)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--threads <count>", "Number of compute threads of the uring backend (Default: number of cores)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "e.g. ./soundwave batch --in wavs --out quiet volume 0.5\n");
+
+    fprintf(IO_OUT, "Remix command presets and matrices:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "mono", "averages all the channels");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "stereo", "copies a mono file to both channels");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "5.1-stereo", "folds L, R, C, LFE, Ls, Rs to stereo (ITU-R BS.775, LFE dropped)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "<g,g,...>/<g,g,...>...", "one row of gains per output channel, one gain per input channel");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "e.g. ./soundwave remix 0.7,0.3 < stereo.wav > mono.wav\n");
+
+    fprintf(IO_OUT, "Render command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--start <time>", "Start of the rendered range, e.g. 90s (Default: 0)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--dur <time>", "Length of the rendered range (Default: the rest of the project)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--bits <8|16|24|32|32f>", "Output bit depth (Default: the format of the first source)");
+    fprintf(IO_OUT, "Project file format (the last node is the output, '#' starts a comment):\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "source <name> <file.wav>", "a WAV file, relative to the directory of the project");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "<name> = volume <node> <gain>", "gain as a factor or in dB, e.g. -3dB");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "<name> = trim <node> <start> [<end>]", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "keeps a range of the node");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "<name> = fade <node> <in> <out> [curve]", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "fades the node in and out, curve is lin, log or scurve");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "<name> = channel <node> <left|right|n>", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "keeps one channel of the node");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "<name> = concat <node> <node>...", "");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "plays the nodes one after the other\n");
+
+    fprintf(IO_OUT, "Encode-flac command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--level <0-8>", "0 is the fastest, 8 the smallest (Default: 5)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--block <samples>", "Samples per channel in a frame, 16 to 65535 (Default: 4096, 1152 for levels 0-2)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--threads <count>", "Number of threads that encode frames (Default: number of cores)\n");
+
+    fprintf(IO_OUT, "Fingerprint and index command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--threads <count>", "Number of files fingerprinted at once (Default: number of cores)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--top <count>", "Most matches reported per query file (Default: 5)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--min-score <count>", "Hashes that must agree on a file and offset for a match (Default: 10)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "e.g. ./soundwave index build lib.idx music/ && ./soundwave index query lib.idx clip.wav\n");
+
+    fprintf(IO_OUT, "Tempo-detect command options:\n");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--threads <count>", "Number of files analyzed at once (Default: number of cores)");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--beats", "Also write the time of every beat");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "--refresh", "Analyze the files again instead of reading their <file>.bpm sidecar");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "Tempos from 60 to 170 BPM are found, faster music is reported at half its tempo");
+    fprintf(IO_OUT, "  %-30s%-60s\n", "", "e.g. ./soundwave bpm music/ --threads 8");
+
+}
+
+/**
+ * @brief Parses the --threads option of the commands that can process a file in ranges
+ *
+ * @param first the index of the first option in argv
+ * @param command the name of the command for the messages
+ * @param threads receives the number of threads, left unchanged when the option is not given
+ *
+ * @returns 0 on success, 1 if the option has no value
+ */
+short parse_Threads(int argc, char* argv[], int first, const char* command, int* threads){
+    for(int i = first; i < argc; i++){
+        if(strcmp(argv[i], "--threads") == 0){
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command %s the parameter %s has no value\n", command, argv[i]);
+                return 1;
+            }
+            i++;
+            *threads = (int)safe_StrToDouble(argv[i]);
+        } else{
+            fprintf(stderr, "Warning: undefined parameter %s in the %s command\n", argv[i], command);
+        }
+    }
+    return 0;
+}
+
+void parse_args(int argc, char* argv[], short* flag){
+    *flag = 0;
+    
+    if(argc <= 1){
+        print_help_message();
+        return;
+    }
+
+    if(strcmp(argv[1], "info") == 0){
+        *flag = 1;
+    } 
+    else if(strcmp(argv[1], "rate") == 0){
+        if(argc < 3){
+            fprintf(IO_OUT, "Usage: ./soundwave rate <value>\n");
+            return;
+        }
+        *flag = 2;
+    } 
+    else if(strcmp(argv[1], "channel") == 0){
+        if(argc < 3){
+            fprintf(IO_OUT, "Usage: ./soundwave channel <left|right>\n");
+            return;
+        }
+        *flag = 3;
+    } 
+    else if(strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0){
+        print_help_message();
+    }
+    else if(strcmp(argv[1], "volume") == 0){
+        if(argc < 3){
+            fprintf(IO_OUT, "Usage: ./soundwave volume <value>\n");
+            return;
+        }
+        *flag = 4;
+    } 
+    else if(strcmp(argv[1], "generate") == 0){
+        *flag = 5;
+    }
+    else if(strcmp(argv[1], "dj") == 0){
+        *flag = 6;
+    }
+    else if(strcmp(argv[1], "spectrum") == 0){
+        *flag = 7;
+    }
+    else if(strcmp(argv[1], "filter") == 0){
+        if(argc < 3){
+            fprintf(IO_OUT, "Usage: ./soundwave filter <type:freq[:q[:gain]]>...\n");
+            return;
+        }
+        *flag = 8;
+    }
+    else if(strcmp(argv[1], "convolve") == 0){
+        if(argc < 3){
+            fprintf(IO_OUT, "Usage: ./soundwave convolve <ir.wav> [options]\n");
+            return;
+        }
+        *flag = 9;
+    }
+    else if(strcmp(argv[1], "tempo") == 0){
+        if(argc < 3){
+            fprintf(IO_OUT, "Usage: ./soundwave tempo <factor> [--mode wsola|pv]\n");
+            return;
+        }
+        *flag = 10;
+    }
+    else if(strcmp(argv[1], "convert") == 0){
+        *flag = 11;
+    }
+    else if(strcmp(argv[1], "fade") == 0){
+        *flag = 12;
+    }
+    else if(strcmp(argv[1], "envelope") == 0){
+        if(argc < 3){
+            fprintf(IO_OUT, "Usage: ./soundwave envelope <file.txt>\n");
+            return;
+        }
+        *flag = 13;
+    }
+    else if(strcmp(argv[1], "silence") == 0){
+        *flag = 14;
+    }
+    else if(strcmp(argv[1], "serve") == 0){
+        *flag = 15;
+    }
+    else if(strcmp(argv[1], "client") == 0){
+        *flag = 16;
+    }
+    else if(strcmp(argv[1], "batch") == 0){
+        *flag = 17;
+    }
+    else if(strcmp(argv[1], "remix") == 0){
+        if(argc < 3){
+            fprintf(IO_OUT, "Usage: ./soundwave remix <mono|stereo|5.1-stereo|matrix>\n");
+            return;
+        }
+        *flag = 19;
+    }
+    else if(strcmp(argv[1], "render") == 0){
+        if(argc < 3){
+            fprintf(IO_OUT, "Usage: ./soundwave render <project.txt> [--start <time>] [--dur <time>] [--bits <8|16|24|32|32f>]\n");
+            return;
+        }
+        *flag = 18;
+    }
+    else if(strcmp(argv[1], "encode-flac") == 0){
+        *flag = 20;
+    }
+    else if(strcmp(argv[1], "decode-flac") == 0){
+        *flag = 21;
+    }
+    else if(strcmp(argv[1], "fingerprint") == 0){
+        *flag = 22;
+    }
+    else if(strcmp(argv[1], "index") == 0){
+        if(argc < 4 || (strcmp(argv[2], "build") != 0 && strcmp(argv[2], "query") != 0)){
+            fprintf(IO_OUT, "Usage: ./soundwave index build <index> <file|dir>... [--threads <count>]\n");
+            fprintf(IO_OUT, "       ./soundwave index query <index> [<file|dir>...] [--top <count>] [--min-score <count>] [--threads <count>]\n");
+            return;
+        }
+        *flag = 23;
+    }
+    else if(strcmp(argv[1], "tempo-detect") == 0 || strcmp(argv[1], "bpm") == 0){
+        *flag = 24;
+    }
+}
+
+/**
+ * @brief Returns 1 for the commands that read a WAV file from STDIN, and so also read FLAC through flac_Run() and
+ * mu-law, A-law and IMA ADPCM through codec_Run()
+ */
+static short reads_Wav(short args_flag){
+    return (args_flag >= 1 && args_flag <= 4) || (args_flag >= 6 && args_flag <= 14) || args_flag == 19 || args_flag == 20;
+}
+
+/**
+ * @brief Returns 1 if the arguments of a dj command name files to play as decks, options other than --beat-align take
+ * a value
+ */
+static short dj_HasFiles(int argc, char* argv[]){
+    for(int i = 2; i < argc; i++){
+        if(strncmp(argv[i], "--", 2) != 0) return 1;
+        if(strcmp(argv[i], "--beat-align") != 0) i++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs the command that follows a --stats option and reports the measurements of the run to STDERR
+ * 
+ * @param run the function that runs the command line without the option
+ * 
+ * @returns the status of the command
+ */
+int run_WithStats(int argc, char* argv[], int (*run)(int, char*[])){
+    short json = 0;
+    short counters = 0;
+    if(argv[1][7] != '\0' && argv[1][7] != '='){
+        fprintf(stderr, "Error: unknown option %s\n", argv[1]);
+        return 1;
+    }
+    // --stats=<word>[,<word>], the words are text, json and counters
+    for(const char* word = argv[1][7] == '=' ? argv[1] + 8 : ""; *word != '\0';){
+        size_t length = strcspn(word, ",");
+        if(length == 4 && strncmp(word, "text", 4) == 0) json = 0;
+        else if(length == 4 && strncmp(word, "json", 4) == 0) json = 1;
+        else if(length == 8 && strncmp(word, "counters", 8) == 0) counters = 1;
+        else{
+            fprintf(stderr, "Error: unknown stats option %.*s, use text, json or counters\n", (int)length, word);
+            return 1;
+        }
+        word += length + (word[length] == ',');
+    }
+    if(argc < 3){
+        fprintf(IO_OUT, "Usage: ./soundwave --stats[=text|json][,counters] <command> [parameters]\n");
+        return 1;
+    }
+
+    // the option takes the place of the program name, so the command sees the argv it expects
+    char* option = argv[1];
+    argv[1] = argv[0];
+    struct run_stats stats;
+    struct run_stats* previous = io_stats;
+    io_stats = &stats;
+    stats_Start(&stats, counters);
+    int status = run(argc - 1, argv + 1);
+    double start = stats_Begin();
+    fflush(IO_OUT);
+    stats_End(STATS_WRITE, start, 0);
+    stats_Stop(&stats);
+    io_stats = previous;
+    argv[1] = option;
+
+    // the name of the command follows the options of the cache
+    int name = 2;
+    if(name + 1 < argc && strcmp(argv[name], "--cache") == 0) name += 2;
+    if(name + 1 < argc && strcmp(argv[name], "--cache-limit") == 0) name += 2;
+    stats_Report(stderr, &stats, argv[name < argc ? name : 2], json, io_arena);
+    return status;
+}
+
+/**
+ * @brief Runs the command that follows a --cache option through the cache directory, see cache.h
+ * 
+ * @param run the function that runs the command line without the option
+ * 
+ * @returns the status of the command
+ */
+int run_WithCache(int argc, char* argv[], int (*run)(int, char*[])){
+    if(argc < 3){
+        fprintf(stderr, "Error: the parameter --cache has no value\n");
+        return 1;
+    }
+    int skip = 2;
+    double limit = CACHE_DEFAULT_LIMIT_MB;
+    if(argc > 3 && strcmp(argv[3], "--cache-limit") == 0){
+        if(argc < 5){
+            fprintf(stderr, "Error: the parameter --cache-limit has no value\n");
+            return 1;
+        }
+        limit = safe_StrToDouble(argv[4]);
+        skip = 4;
+    }
+    if(argc <= skip + 1){
+        fprintf(IO_OUT, "Usage: ./soundwave --cache <dir> [--cache-limit <MB>] <command> [parameters]\n");
+        return 1;
+    }
+
+    if(strncmp(argv[skip + 1], "--stats", 7) == 0){
+        // the global options go in any order: the stats of the run include the cache, as with --stats --cache
+        char** reordered = malloc((argc + 1) * sizeof(char*));
+        if(reordered == NULL){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            return 1;
+        }
+        reordered[0] = argv[0];
+        reordered[1] = argv[skip + 1];
+        for(int i = 1; i <= skip; i++) reordered[i + 1] = argv[i];
+        for(int i = skip + 2; i <= argc; i++) reordered[i] = argv[i];
+        int status = run_WithStats(argc, reordered, run);
+        free(reordered);
+        return status;
+    }
+
+    // the program name takes the place of the last word of the option, so the command sees the argv it expects
+    const char* dir = argv[2];
+    char* option = argv[skip];
+    argv[skip] = argv[0];
+    int status = cache_Run(dir, (uint64_t)(limit * 1048576.0), run, argc - skip, argv + skip);
+    argv[skip] = option;
+    return status;
+}
+
+/**
+ * @brief Runs one command line. This is main() without the process around it, so the workers of the serve command run jobs with it
+ */
+int run_Command(int argc, char* argv[]){
+    /*
+        0 = N/A
+        1 = info
+        2 = rate
+        3 = channel
+        4 = volume
+        5 = generate
+        6 = dj
+        7 = spectrum
+        8 = filter
+        9 = convolve
+        10 = tempo
+        11 = convert
+        12 = fade
+        13 = envelope
+        14 = silence
+        15 = serve
+        16 = client
+        17 = batch
+        18 = render
+        19 = remix
+        20 = encode-flac
+        21 = decode-flac
+        22 = fingerprint
+        23 = index
+        24 = tempo-detect
+    */
+    short args_flag = 0;
+    short flag = 0; 
+
+    if(argc > 1 && strncmp(argv[1], "--stats", 7) == 0){
+        return run_WithStats(argc, argv, run_Command);
+    }
+    if(argc > 1 && strcmp(argv[1], "--cache") == 0){
+        return run_WithCache(argc, argv, run_Command);
+    }
+
+    parse_args(argc, argv, &args_flag);
+    // dj with files does not read STDIN
+    short decks = args_flag == 6 && dj_HasFiles(argc, argv);
+    if(reads_Wav(args_flag) && !decks && flac_Detect(IO_IN)){
+        return flac_Run(run_Command, argc, argv);
+    }
+    if(reads_Wav(args_flag) && !decks && codec_Detect(IO_IN)){
+        return codec_Run(run_Command, argc, argv);
+    }
+
+    if(args_flag == 0){
+        flag = 1;
+    } 
+    else if(args_flag == 1){
+        info_command(&flag);
+    } 
+    else if(args_flag == 2){
+        char* endptr;
+        double rate = strtod(argv[2], &endptr);
+        if(*endptr == *argv[2] || errno == ERANGE || *endptr != '\0'){
+            fprintf(stderr, "Warning: Something unexpected occured while parsing the value of the rate argument. This might lead to unexpected behavior\n");
+            errno = 0;
+        }
+        int threads = get_ThreadCount();
+        if(parse_Threads(argc, argv, 3, "rate", &threads)) return 1;
+        if(!chunked_Rate(rate, threads, &flag)) srate_command(rate, &flag);
+    }
+    else if(args_flag == 3){
+        short channel;
+        if(strcmp(argv[2], "left") == 0){
+            channel = 0;
+        } else if(strcmp(argv[2], "right") == 0){
+            channel = 1;
+        } else{
+            print_help_message();
+            return 1;
+        }
+        int threads = get_ThreadCount();
+        if(parse_Threads(argc, argv, 3, "channel", &threads)) return 1;
+        if(!chunked_Channel(channel, threads, &flag)) schannel_command(channel, &flag);
+    }
+    else if(args_flag == 4){
+        double volume = safe_StrToDouble(argv[2]);
+        int threads = get_ThreadCount();
+        if(parse_Threads(argc, argv, 3, "volume", &threads)) return 1;
+        if(!chunked_Volume(volume, threads, &flag)) svolume_command(volume, &flag);
+    }
+    else if(args_flag == 5){
+        double duration = 3;
+        int sample_rate = 44100;
+        double frequency_modulation = 2.0;
+        double carrier_frequency = 1500.0;
+        double modulation_index = 100.0;
+        double amplitude = 30000.0;
+        struct synth_voice_spec* voices = malloc(argc * sizeof(struct synth_voice_spec));
+        uint32_t voice_count = 0;
+        const char* wave = NULL;
+        const char* frequency = "440";
+        int sweep = SYNTH_SWEEP_LINEAR;
+        uint16_t channels = 1;
+        uint16_t bits = 16;
+        short to_float = 0;
+        if(voices == NULL){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            return 1;
+        }
+
+        for(int i = 2; i < argc; i++){
+            if(strcmp(argv[i], "--dur") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                duration = safe_StrToDouble(argv[i]);
+            }
+            else if(strcmp(argv[i], "--sr") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                sample_rate = (int)safe_StrToDouble(argv[i]);
+            }
+            else if(strcmp(argv[i], "--fm") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                frequency_modulation = safe_StrToDouble(argv[i]);
+            }
+            else if(strcmp(argv[i], "--fc") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                carrier_frequency = safe_StrToDouble(argv[i]);
+            }
+            else if(strcmp(argv[i], "--mi") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                modulation_index = safe_StrToDouble(argv[i]);
+            }
+            else if(strcmp(argv[i], "--amp") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                amplitude = safe_StrToDouble(argv[i]);
+            }
+            else if(strcmp(argv[i], "--voice") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                if(synth_ParseVoice(argv[i], &voices[voice_count]) != 0){
+                    fprintf(stderr, "Error: invalid voice %s\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                voice_count++;
+            }
+            else if(strcmp(argv[i], "--wave") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                wave = argv[i];
+            }
+            else if(strcmp(argv[i], "--freq") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                frequency = argv[i];
+            }
+            else if(strcmp(argv[i], "--sweep") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                if(strcmp(argv[i], "lin") == 0) sweep = SYNTH_SWEEP_LINEAR;
+                else if(strcmp(argv[i], "log") == 0) sweep = SYNTH_SWEEP_LOG;
+                else{
+                    fprintf(stderr, "Error: unknown sweep %s\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--channels") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                channels = (uint16_t)safe_StrToDouble(argv[i]);
+            }
+            else if(strcmp(argv[i], "--bits") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command generate the parameter %s has no value\n", argv[i]);
+                    free(voices);
+                    return 1;
+                }
+                i++;
+                to_float = strcmp(argv[i], "32f") == 0;
+                bits = to_float ? 32 : (uint16_t)safe_StrToDouble(argv[i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the generate command\n", argv[i]);
+            }
+        }
+        if(wave != NULL){
+            char text[256];
+            snprintf(text, sizeof(text), "%s:%s", wave, frequency);
+            if(synth_ParseVoice(text, &voices[voice_count]) != 0){
+                fprintf(stderr, "Error: invalid wave %s or frequency %s\n", wave, frequency);
+                free(voices);
+                return 1;
+            }
+            voice_count++;
+        }
+
+        if(voice_count == 0){
+            mysound((int)duration, sample_rate, frequency_modulation, carrier_frequency, modulation_index, amplitude);
+        } else{
+            generate_command(voices, voice_count, duration, (uint32_t)sample_rate, channels, bits, to_float, amplitude / 32768.0, sweep, &flag);
+        }
+        free(voices);
+    }
+    else if(args_flag == 6){
+        struct player_options options = {NULL, PLAYER_SINK_DEVICE, 1.0, PLAYER_PERIOD_FRAMES, PLAYER_PERIODS, 0.0, 0.0};
+        // files play as decks, without them the wav file on STDIN plays
+        double xfade = 0.0;
+        short beat_align = 0;
+        char** paths = malloc(argc * sizeof(char*));
+        uint32_t path_count = 0;
+        if(paths == NULL){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            return 1;
+        }
+
+        for(int i = 2; i < argc; i++){
+            short parse_flag = 0;
+            if(strncmp(argv[i], "--", 2) != 0){
+                paths[path_count++] = argv[i];
+                continue;
+            }
+            else if(strcmp(argv[i], "--beat-align") == 0){
+                beat_align = 1;
+                continue;
+            }
+            else if(i+1 >= argc){
+                fprintf(stderr, "Error: in command dj the parameter %s has no value\n", argv[i]);
+                free(paths);
+                return 1;
+            }
+            else if(strcmp(argv[i], "--xfade") == 0){
+                xfade = parse_Seconds(argv[++i], &parse_flag);
+            }
+            else if(strcmp(argv[i], "--control") == 0){
+                options.control = argv[++i];
+            }
+            else if(strcmp(argv[i], "--sink") == 0){
+                i++;
+                if(strcmp(argv[i], "device") == 0) options.sink = PLAYER_SINK_DEVICE;
+                else if(strcmp(argv[i], "sim") == 0) options.sink = PLAYER_SINK_SIM;
+                else if(strcmp(argv[i], "virtual") == 0) options.sink = PLAYER_SINK_VIRTUAL;
+                else{
+                    fprintf(stderr, "Error: unknown sink %s\n", argv[i]);
+                    free(paths);
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--volume") == 0){
+                options.volume = parse_Gain(argv[++i], &parse_flag);
+            }
+            else if(strcmp(argv[i], "--latency") == 0){
+                if(player_ParseLatency(argv[++i], &options.period, &options.periods) != 0){
+                    fprintf(stderr, "Error: unknown latency %s, use low, normal or safe\n", argv[i]);
+                    free(paths);
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--period") == 0){
+                options.period = (uint32_t)safe_StrToDouble(argv[++i]);
+            }
+            else if(strcmp(argv[i], "--periods") == 0){
+                options.periods = (uint32_t)safe_StrToDouble(argv[++i]);
+            }
+            else if(strcmp(argv[i], "--stall") == 0){
+                // <time>[@<time>]
+                char* at = strchr(argv[++i], '@');
+                if(at != NULL) *at = '\0';
+                options.stall = parse_Seconds(argv[i], &parse_flag);
+                if(at != NULL){
+                    options.stall_at = parse_Seconds(at + 1, &parse_flag);
+                    *at = '@';
+                }
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the dj command\n", argv[i]);
+                i++;
+            }
+            if(parse_flag){
+                fprintf(stderr, "Error: invalid value %s\n", argv[i]);
+                free(paths);
+                return 1;
+            }
+        }
+        if(options.period < 16 || options.period > 65536 || options.periods < 2 || options.periods > 64){
+            fprintf(stderr, "Error: the period should be 16 to 65536 frames and the buffer 2 to 64 periods\n");
+            free(paths);
+            return 1;
+        }
+        if(path_count > 0) flag = play_decks(&options, paths, path_count, xfade, beat_align) == 0 ? 0u : 1u;
+        else flag = play_sound(&options) == 0 ? 0u : 1u;
+        free(paths);
+    }
+    else if(args_flag == 7){
+        uint32_t fft_size = 1024;
+        uint32_t hop = 0;
+        short window = SPECTRUM_WINDOW_HANN;
+        short format = SPECTRUM_FORMAT_CSV;
+        double range = 96.0;
+        int threads = get_ThreadCount();
+
+        for(int i = 2; i < argc; i++){
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command spectrum the parameter %s has no value\n", argv[i]);
+                return 1;
+            }
+            if(strcmp(argv[i], "--fft") == 0){
+                fft_size = (uint32_t)safe_StrToDouble(argv[++i]);
+            }
+            else if(strcmp(argv[i], "--hop") == 0){
+                hop = (uint32_t)safe_StrToDouble(argv[++i]);
+            }
+            else if(strcmp(argv[i], "--window") == 0){
+                i++;
+                if(strcmp(argv[i], "hann") == 0) window = SPECTRUM_WINDOW_HANN;
+                else if(strcmp(argv[i], "hamming") == 0) window = SPECTRUM_WINDOW_HAMMING;
+                else if(strcmp(argv[i], "blackman") == 0) window = SPECTRUM_WINDOW_BLACKMAN;
+                else if(strcmp(argv[i], "rect") == 0) window = SPECTRUM_WINDOW_RECT;
+                else{
+                    fprintf(stderr, "Error: unknown window %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--format") == 0){
+                i++;
+                if(strcmp(argv[i], "csv") == 0) format = SPECTRUM_FORMAT_CSV;
+                else if(strcmp(argv[i], "bin") == 0) format = SPECTRUM_FORMAT_BIN;
+                else if(strcmp(argv[i], "pgm") == 0) format = SPECTRUM_FORMAT_PGM;
+                else{
+                    fprintf(stderr, "Error: unknown format %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--range") == 0){
+                range = safe_StrToDouble(argv[++i]);
+            }
+            else if(strcmp(argv[i], "--threads") == 0){
+                threads = (int)safe_StrToDouble(argv[++i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the spectrum command\n", argv[i]);
+                i++;
+            }
+        }
+        if(hop == 0) hop = fft_size / 4 > 0 ? fft_size / 4 : 1;
+        spectrum_command(fft_size, hop, window, format, range, threads, &flag);
+    }
+    else if(args_flag == 8){
+        uint32_t count = (uint32_t)(argc - 2);
+        struct biquad_spec* specs = malloc(count * sizeof(struct biquad_spec));
+        if(specs == NULL){
+            fprintf(stderr, "Error: unable to allocate memory\n");
+            return 1;
+        }
+        for(uint32_t i = 0; i < count; i++){
+            if(biquad_ParseSpec(argv[i + 2], &specs[i]) != 0){
+                fprintf(stderr, "Error: invalid filter %s\n", argv[i + 2]);
+                free(specs);
+                return 1;
+            }
+        }
+        filter_command(specs, count, &flag);
+        free(specs);
+    }
+    else if(args_flag == 9){
+        uint32_t block = 0;
+        double gain = 1.0;
+        int threads = get_ThreadCount();
+
+        for(int i = 3; i < argc; i++){
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command convolve the parameter %s has no value\n", argv[i]);
+                return 1;
+            }
+            if(strcmp(argv[i], "--block") == 0){
+                block = (uint32_t)safe_StrToDouble(argv[++i]);
+            }
+            else if(strcmp(argv[i], "--gain") == 0){
+                gain = safe_StrToDouble(argv[++i]);
+            }
+            else if(strcmp(argv[i], "--threads") == 0){
+                threads = (int)safe_StrToDouble(argv[++i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the convolve command\n", argv[i]);
+                i++;
+            }
+        }
+        convolve_command(argv[2], block, gain, threads, &flag);
+    }
+    else if(args_flag == 10){
+        double factor = safe_StrToDouble(argv[2]);
+        int mode = TEMPO_WSOLA;
+
+        for(int i = 3; i < argc; i++){
+            if(strcmp(argv[i], "--mode") == 0){
+                if(i+1 >= argc){
+                    fprintf(stderr, "Error: in command tempo the parameter %s has no value\n", argv[i]);
+                    return 1;
+                }
+                i++;
+                mode = tempo_ParseMode(argv[i]);
+                if(mode < 0){
+                    fprintf(stderr, "Error: unknown tempo mode %s\n", argv[i]);
+                    return 1;
+                }
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the tempo command\n", argv[i]);
+            }
+        }
+        tempo_command(factor, mode, &flag);
+    }
+    else if(args_flag == 11){
+        uint16_t bits = 0;
+        short to_float = 0;
+        short dither = -1;
+        short shape = 0;
+        uint16_t codec = 0;
+        int threads = get_ThreadCount();
+
+        for(int i = 2; i < argc; i++){
+            if(strcmp(argv[i], "--shape") == 0){
+                shape = 1;
+                continue;
+            }
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command convert the parameter %s has no value\n", argv[i]);
+                return 1;
+            }
+            if(strcmp(argv[i], "--bits") == 0){
+                i++;
+                to_float = strcmp(argv[i], "32f") == 0;
+                bits = to_float ? 32 : (uint16_t)safe_StrToDouble(argv[i]);
+            }
+            else if(strcmp(argv[i], "--codec") == 0){
+                i++;
+                if(strcmp(argv[i], "ulaw") == 0) codec = WAVE_FORMAT_MULAW;
+                else if(strcmp(argv[i], "alaw") == 0) codec = WAVE_FORMAT_ALAW;
+                else if(strcmp(argv[i], "ima-adpcm") == 0) codec = WAVE_FORMAT_IMA_ADPCM;
+                else{
+                    fprintf(stderr, "Error: unknown codec %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--dither") == 0){
+                i++;
+                if(strcmp(argv[i], "tpdf") == 0) dither = 1;
+                else if(strcmp(argv[i], "none") == 0) dither = 0;
+                else{
+                    fprintf(stderr, "Error: unknown dither %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--threads") == 0){
+                i++;
+                threads = (int)safe_StrToDouble(argv[i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the convert command\n", argv[i]);
+                i++;
+            }
+        }
+        if(codec != 0 && bits != 0){
+            fprintf(stderr, "Error: in command convert --bits and --codec cannot be used together\n");
+            return 1;
+        }
+        if(codec != 0) encode_codec_command(codec, &flag);
+        else if(bits == 0){
+            fprintf(IO_OUT, "Usage: ./soundwave convert --bits <8|16|24|32|32f> [--dither tpdf|none] [--shape] [--threads <count>]\n");
+            fprintf(IO_OUT, "       ./soundwave convert --codec <ulaw|alaw|ima-adpcm>\n");
+            return 1;
+        }
+        else if(!chunked_Convert(bits, to_float, dither, shape, threads, &flag)) convert_command(bits, to_float, dither, shape, &flag);
+    }
+    else if(args_flag == 12){
+        double fade_in = 0.0;
+        double fade_out = 0.0;
+        int curve = ENVELOPE_CURVE_LINEAR;
+
+        for(int i = 2; i < argc; i++){
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command fade the parameter %s has no value\n", argv[i]);
+                return 1;
+            }
+            short parse_flag = 0;
+            if(strcmp(argv[i], "--in") == 0){
+                fade_in = parse_Seconds(argv[++i], &parse_flag);
+            }
+            else if(strcmp(argv[i], "--out") == 0){
+                fade_out = parse_Seconds(argv[++i], &parse_flag);
+            }
+            else if(strcmp(argv[i], "--curve") == 0){
+                curve = envelope_ParseCurve(argv[++i]);
+                if(curve < 0){
+                    fprintf(stderr, "Error: unknown fade curve %s\n", argv[i]);
+                    return 1;
+                }
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the fade command\n", argv[i]);
+                i++;
+            }
+            if(parse_flag){
+                fprintf(stderr, "Error: invalid time %s\n", argv[i]);
+                return 1;
+            }
+        }
+        fade_command(fade_in, fade_out, curve, &flag);
+    }
+    else if(args_flag == 13){
+        envelope_command(argv[2], &flag);
+    }
+    else if(args_flag == 14){
+        double threshold = parse_Gain("-50dB", &flag);
+        double min_seconds = 0.5;
+        int mode = SILENCE_REPORT;
+        const char* prefix = "segment";
+
+        for(int i = 2; i < argc; i++){
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command silence the parameter %s has no value\n", argv[i]);
+                return 1;
+            }
+            short parse_flag = 0;
+            if(strcmp(argv[i], "--threshold") == 0){
+                threshold = parse_Gain(argv[++i], &parse_flag);
+            }
+            else if(strcmp(argv[i], "--min") == 0){
+                min_seconds = parse_Seconds(argv[++i], &parse_flag);
+            }
+            else if(strcmp(argv[i], "--mode") == 0){
+                mode = silence_ParseMode(argv[++i]);
+                if(mode < 0){
+                    fprintf(stderr, "Error: unknown silence mode %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--prefix") == 0){
+                prefix = argv[++i];
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the silence command\n", argv[i]);
+                i++;
+            }
+            if(parse_flag){
+                fprintf(stderr, "Error: invalid value %s\n", argv[i]);
+                return 1;
+            }
+        }
+        silence_command(threshold, min_seconds, mode, prefix, &flag);
+    }
+    else if(args_flag == 15){
+        const char* socket_path = NULL;
+        int workers = get_ThreadCount();
+
+        for(int i = 2; i < argc; i++){
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command serve the parameter %s has no value\n", argv[i]);
+                return 1;
+            }
+            if(strcmp(argv[i], "--socket") == 0){
+                socket_path = argv[++i];
+            }
+            else if(strcmp(argv[i], "--workers") == 0){
+                workers = (int)safe_StrToDouble(argv[++i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the serve command\n", argv[i]);
+                i++;
+            }
+        }
+        if(socket_path == NULL){
+            fprintf(IO_OUT, "Usage: ./soundwave serve --socket <path> [--workers <count>]\n");
+            return 1;
+        }
+        serve_command(socket_path, workers, run_Command, &flag);
+    }
+    else if(args_flag == 16){
+        const char* socket_path = NULL;
+        const char* in = NULL;
+        const char* out = NULL;
+        uint32_t repeat = 1;
+
+        int i = 2;
+        for(; i < argc && strncmp(argv[i], "--", 2) == 0; i++){
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command client the parameter %s has no value\n", argv[i]);
+                return 1;
+            }
+            if(strcmp(argv[i], "--socket") == 0){
+                socket_path = argv[++i];
+            }
+            else if(strcmp(argv[i], "--in") == 0){
+                in = argv[++i];
+            }
+            else if(strcmp(argv[i], "--out") == 0){
+                out = argv[++i];
+            }
+            else if(strcmp(argv[i], "--repeat") == 0){
+                repeat = (uint32_t)safe_StrToDouble(argv[++i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the client command\n", argv[i]);
+                i++;
+            }
+        }
+        if(socket_path == NULL || i >= argc){
+            fprintf(IO_OUT, "Usage: ./soundwave client --socket <path> [--in <path>] [--out <path>] [--repeat <count>] <command|stats> [parameters]\n");
+            return 1;
+        }
+        return client_command(socket_path, in, out, repeat > 0 ? repeat : 1, argc - i, argv + i);
+    }
+    else if(args_flag == 17){
+        const char* in_dir = NULL;
+        const char* out_dir = NULL;
+        int io = BATCH_IO_AUTO;
+        uint32_t depth = BATCH_DEFAULT_DEPTH;
+        int threads = get_ThreadCount();
+
+        int i = 2;
+        for(; i < argc && strncmp(argv[i], "--", 2) == 0; i++){
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command batch the parameter %s has no value\n", argv[i]);
+                return 1;
+            }
+            if(strcmp(argv[i], "--in") == 0){
+                in_dir = argv[++i];
+            }
+            else if(strcmp(argv[i], "--out") == 0){
+                out_dir = argv[++i];
+            }
+            else if(strcmp(argv[i], "--io") == 0){
+                io = batch_ParseIo(argv[++i]);
+                if(io < 0){
+                    fprintf(stderr, "Error: unknown I/O backend %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--depth") == 0){
+                depth = (uint32_t)safe_StrToDouble(argv[++i]);
+            }
+            else if(strcmp(argv[i], "--threads") == 0){
+                threads = (int)safe_StrToDouble(argv[++i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the batch command\n", argv[i]);
+                i++;
+            }
+        }
+        if(in_dir == NULL || out_dir == NULL || i >= argc){
+            fprintf(IO_OUT, "Usage: ./soundwave batch --in <dir> --out <dir> [--io auto|uring|threads|naive] [--depth <count>] [--threads <count>] <command> [parameters]\n");
+            return 1;
+        }
+        // the command line of every file, with the program name in front as main() gets it
+        char** command = malloc((argc - i + 2) * sizeof(char*));
+        if(command == NULL){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            return 1;
+        }
+        command[0] = argv[0];
+        memcpy(command + 1, argv + i, (argc - i) * sizeof(char*));
+        command[argc - i + 1] = NULL;
+        batch_command(in_dir, out_dir, io, depth, threads, run_Command, argc - i + 1, command, &flag);
+        free(command);
+    }
+    else if(args_flag == 18){
+        double start = 0.0;
+        double duration = -1.0;
+        uint16_t bits = 0;
+        short to_float = 0;
+
+        for(int i = 3; i < argc; i++){
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command render the parameter %s has no value\n", argv[i]);
+                return 1;
+            }
+            short parse_flag = 0;
+            if(strcmp(argv[i], "--start") == 0){
+                start = parse_Seconds(argv[++i], &parse_flag);
+            }
+            else if(strcmp(argv[i], "--dur") == 0){
+                duration = parse_Seconds(argv[++i], &parse_flag);
+            }
+            else if(strcmp(argv[i], "--bits") == 0){
+                i++;
+                to_float = strcmp(argv[i], "32f") == 0;
+                bits = to_float ? 32 : (uint16_t)safe_StrToDouble(argv[i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the render command\n", argv[i]);
+                i++;
+            }
+            if(parse_flag){
+                fprintf(stderr, "Error: invalid time %s\n", argv[i]);
+                return 1;
+            }
+        }
+        render_command(argv[2], start, duration, bits, to_float, &flag);
+    }
+    else if(args_flag == 19){
+        remix_command(argv[2], &flag);
+    }
+    else if(args_flag == 20){
+        struct flac_params params;
+        flac_Level(&params, FLAC_DEFAULT_LEVEL);
+        uint32_t block = 0;
+        int threads = get_ThreadCount();
+
+        for(int i = 2; i < argc; i++){
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command encode-flac the parameter %s has no value\n", argv[i]);
+                return 1;
+            }
+            if(strcmp(argv[i], "--level") == 0){
+                if(flac_Level(&params, (int)safe_StrToDouble(argv[++i])) != 0){
+                    fprintf(stderr, "Error: the level should be 0 to 8\n");
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--block") == 0){
+                block = (uint32_t)safe_StrToDouble(argv[++i]);
+                if(block < FLAC_MIN_BLOCK || block > FLAC_MAX_BLOCK){
+                    fprintf(stderr, "Error: the block should be %d to %d samples\n", FLAC_MIN_BLOCK, FLAC_MAX_BLOCK);
+                    return 1;
+                }
+            }
+            else if(strcmp(argv[i], "--threads") == 0){
+                threads = (int)safe_StrToDouble(argv[++i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the encode-flac command\n", argv[i]);
+                i++;
+            }
+        }
+        if(block != 0) params.block = block;
+        encode_flac_command(&params, threads, &flag);
+    }
+    else if(args_flag == 21){
+        decode_flac_command(&flag);
+    }
+    else if(args_flag == 22 || args_flag == 23){
+        // the options and the files can come in any order
+        const short index = args_flag == 23;
+        const char* command = index ? "index" : "fingerprint";
+        int threads = get_ThreadCount();
+        uint32_t top = 5;
+        uint32_t min_score = 10;
+        char** inputs = malloc(argc * sizeof(char*));
+        int input_count = 0;
+        if(inputs == NULL){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            return 1;
+        }
+        for(int i = index ? 4 : 2; i < argc; i++){
+            if(strncmp(argv[i], "--", 2) != 0){
+                inputs[input_count++] = argv[i];
+                continue;
+            }
+            if(i+1 >= argc){
+                fprintf(stderr, "Error: in command %s the parameter %s has no value\n", command, argv[i]);
+                free(inputs);
+                return 1;
+            }
+            if(strcmp(argv[i], "--threads") == 0){
+                threads = (int)safe_StrToDouble(argv[++i]);
+            }
+            else if(index && strcmp(argv[i], "--top") == 0){
+                top = (uint32_t)safe_StrToDouble(argv[++i]);
+            }
+            else if(index && strcmp(argv[i], "--min-score") == 0){
+                min_score = (uint32_t)safe_StrToDouble(argv[++i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the %s command\n", argv[i], command);
+                i++;
+            }
+        }
+        if(!index) fingerprint_command(inputs, input_count, threads, &flag);
+        else if(strcmp(argv[2], "build") == 0){
+            if(input_count == 0){
+                fprintf(stderr, "Error: in command index build there are no files to index\n");
+                free(inputs);
+                return 1;
+            }
+            index_build_command(argv[3], inputs, input_count, threads, &flag);
+        }
+        else index_query_command(argv[3], inputs, input_count, threads, top, min_score, &flag);
+        free(inputs);
+    }
+    else if(args_flag == 24){
+        // the options and the files can come in any order
+        int threads = get_ThreadCount();
+        short refresh = 0;
+        short beats = 0;
+        char** inputs = malloc(argc * sizeof(char*));
+        int input_count = 0;
+        if(inputs == NULL){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            return 1;
+        }
+        for(int i = 2; i < argc; i++){
+            if(strncmp(argv[i], "--", 2) != 0){
+                inputs[input_count++] = argv[i];
+            }
+            else if(strcmp(argv[i], "--beats") == 0){
+                beats = 1;
+            }
+            else if(strcmp(argv[i], "--refresh") == 0){
+                refresh = 1;
+            }
+            else if(i+1 >= argc){
+                fprintf(stderr, "Error: in command tempo-detect the parameter %s has no value\n", argv[i]);
+                free(inputs);
+                return 1;
+            }
+            else if(strcmp(argv[i], "--threads") == 0){
+                threads = (int)safe_StrToDouble(argv[++i]);
+            } else{
+                fprintf(stderr, "Warning: undefined parameter %s in the tempo-detect command\n", argv[i]);
+                i++;
+            }
+        }
+        tempo_detect_command(inputs, input_count, threads, refresh, beats, &flag);
+        free(inputs);
+    }
+
+    if(flag == 1){
+        return 1;
+    }
+
+    return 0;
+}
+
+struct sw_context {
+    FILE* input;
+    FILE* output;
+    char* memory;
+    size_t memory_size;
+    struct sample_arena arena;
+};
+
+/**
+ * @brief Points the streams and the sample arena of the calling thread at a context for the duration of a call
+ */
+static void sw_context_Enter(struct sw_context* ctx){
+    io_input = ctx->input;
+    io_output = ctx->output;
+    io_arena = &ctx->arena;
+}
+
+/**
+ * @brief Flushes the output of a call and restores STDIN, STDOUT and the plain allocator
+ *
+ * @returns status, or 1 if the output could not be written
+ */
+static int sw_context_Leave(int status){
+    if(fflush(IO_OUT) != 0){
+        fprintf(stderr, "Error! unable to write the output\n");
+        status = 1;
+    }
+    clearerr(IO_IN);
+    io_input = NULL;
+    io_output = NULL;
+    io_arena = NULL;
+    return status;
+}
+
+static void sw_context_CloseInput(struct sw_context* ctx){
+    if(ctx->input != NULL) fclose(ctx->input);
+    ctx->input = NULL;
+}
+
+static void sw_context_CloseOutput(struct sw_context* ctx){
+    if(ctx->output != NULL) fclose(ctx->output);
+    ctx->output = NULL;
+    free(ctx->memory);
+    ctx->memory = NULL;
+    ctx->memory_size = 0;
+}
+
+/**
+ * @brief Runs a command function on a context and turns its flag into a return value
+ */
+#define SW_CALL(ctx, call) do{ \
+    short flag = 0; \
+    sw_context_Enter(ctx); \
+    call; \
+    return sw_context_Leave(flag != 0); \
+} while(0)
+
+struct sw_context* sw_context_Create(void){
+    return calloc(1, sizeof(struct sw_context));
+}
+
+void sw_context_Destroy(struct sw_context* ctx){
+    if(ctx == NULL) return;
+    sw_context_CloseInput(ctx);
+    sw_context_CloseOutput(ctx);
+    arena_Release(&ctx->arena);
+    free(ctx);
+}
+
+int sw_context_SetInputFd(struct sw_context* ctx, int fd){
+    sw_context_CloseInput(ctx);
+    int copy = dup(fd);
+    if(copy < 0 || (ctx->input = fdopen(copy, "rb")) == NULL){
+        fprintf(stderr, "Error! unable to open the input: %s\n", strerror(errno));
+        if(copy >= 0) close(copy);
+        return 1;
+    }
+    return 0;
+}
+
+int sw_context_SetOutputFd(struct sw_context* ctx, int fd){
+    sw_context_CloseOutput(ctx);
+    int copy = dup(fd);
+    if(copy < 0 || (ctx->output = fdopen(copy, "wb")) == NULL){
+        fprintf(stderr, "Error! unable to open the output: %s\n", strerror(errno));
+        if(copy >= 0) close(copy);
+        return 1;
+    }
+    return 0;
+}
+
+int sw_context_SetInputBuffer(struct sw_context* ctx, const void* data, size_t size){
+    sw_context_CloseInput(ctx);
+    // fmemopen() does not accept an empty buffer, an empty input is a stream at its end
+    ctx->input = size > 0 ? fmemopen((void*)data, size, "rb") : fopen("/dev/null", "rb");
+    if(ctx->input == NULL){
+        fprintf(stderr, "Error! unable to open the input: %s\n", strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+int sw_context_SetOutputMemory(struct sw_context* ctx){
+    sw_context_CloseOutput(ctx);
+    ctx->output = open_memstream(&ctx->memory, &ctx->memory_size);
+    if(ctx->output == NULL){
+        fprintf(stderr, "Error! unable to open the output: %s\n", strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+const char* sw_context_Output(struct sw_context* ctx, size_t* size){
+    *size = 0;
+    if(ctx->output == NULL || fflush(ctx->output) != 0 || ctx->memory == NULL) return NULL;
+    *size = ctx->memory_size;
+    return ctx->memory;
+}
+
+int sw_run(struct sw_context* ctx, int argc, char* argv[]){
+    sw_context_Enter(ctx);
+    return sw_context_Leave(run_Command(argc, argv));
+}
+
+int sw_info(struct sw_context* ctx){
+    SW_CALL(ctx, info_command(&flag));
+}
+
+int sw_rate(struct sw_context* ctx, double rate){
+    SW_CALL(ctx, if(!chunked_Rate(rate, get_ThreadCount(), &flag)) srate_command(rate, &flag));
+}
+
+int sw_channel(struct sw_context* ctx, int channel){
+    if(channel != 0 && channel != 1){
+        fprintf(stderr, "Error! the channel should be 0 (left) or 1 (right)\n");
+        return 1;
+    }
+    SW_CALL(ctx, if(!chunked_Channel((short)channel, get_ThreadCount(), &flag)) schannel_command((short)channel, &flag));
+}
+
+int sw_volume(struct sw_context* ctx, double volume){
+    SW_CALL(ctx, if(!chunked_Volume(volume, get_ThreadCount(), &flag)) svolume_command(volume, &flag));
+}
+
+int sw_filter(struct sw_context* ctx, const char* const* specs, uint32_t count){
+    struct biquad_spec* parsed = malloc((count > 0 ? count : 1) * sizeof(struct biquad_spec));
+    if(parsed == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        return 1;
+    }
+    for(uint32_t i = 0; i < count; i++){
+        if(biquad_ParseSpec(specs[i], &parsed[i]) != 0){
+            fprintf(stderr, "Error: invalid filter %s\n", specs[i]);
+            free(parsed);
+            return 1;
+        }
+    }
+    short flag = 0;
+    sw_context_Enter(ctx);
+    filter_command(parsed, count, &flag);
+    free(parsed);
+    return sw_context_Leave(flag != 0);
+}
+
+int sw_convert(struct sw_context* ctx, uint16_t bits, int to_float, int dither, int shape){
+    short mode = (short)(dither < 0 ? -1 : dither != 0);
+    SW_CALL(ctx, if(!chunked_Convert(bits, to_float != 0, mode, shape != 0, get_ThreadCount(), &flag))
+                     convert_command(bits, to_float != 0, mode, shape != 0, &flag));
+}
+
+int sw_fade(struct sw_context* ctx, double fade_in, double fade_out, const char* curve){
+    int parsed = envelope_ParseCurve(curve != NULL ? curve : "lin");
+    if(parsed < 0){
+        fprintf(stderr, "Error: unknown curve %s\n", curve);
+        return 1;
+    }
+    SW_CALL(ctx, fade_command(fade_in, fade_out, parsed, &flag));
+}
+
+int sw_tempo(struct sw_context* ctx, double factor, const char* mode){
+    int parsed = tempo_ParseMode(mode != NULL ? mode : "wsola");
+    if(parsed < 0){
+        fprintf(stderr, "Error: unknown mode %s\n", mode);
+        return 1;
+    }
+    SW_CALL(ctx, tempo_command(factor, parsed, &flag));
+}
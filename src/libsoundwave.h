@@ -0,0 +1,126 @@
+/**
+ * @file libsoundwave.h
+ * @author Rafael Diolatzis
+ * @brief The public interface of the soundwave library
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Every command of the soundwave program can be run from another program through a context. A context holds the
+ * streams that the commands read the WAV data from and write the result to, and a sample arena that keeps the
+ * buffers of the commands allocated between calls. By default a context reads STDIN and writes STDOUT, like the
+ * program does.
+ *
+ * A context must not be used by two threads at the same time, but different contexts can run on different threads.
+ * Every function returns 0 on success and a non-zero value otherwise. Error messages are written to STDERR.
+ *
+ * Example:
+ *
+ *     struct sw_context* ctx = sw_context_Create();
+ *     sw_context_SetInputBuffer(ctx, wav, wav_size);
+ *     sw_context_SetOutputMemory(ctx);
+ *     if(sw_volume(ctx, 0.5) == 0){
+ *         size_t size;
+ *         const char* out = sw_context_Output(ctx, &size);
+ *     }
+ *     sw_context_Destroy(ctx);
+ */
+
+#pragma once
+
+#include<stddef.h>
+#include<stdint.h>
+
+#define SW_API __attribute__((visibility("default")))
+
+struct sw_context;
+
+/**
+ * @brief Creates a context that reads STDIN and writes STDOUT
+ *
+ * @returns the context or NULL on failure
+ */
+SW_API struct sw_context* sw_context_Create(void);
+
+/**
+ * @brief Closes the streams of a context and releases its sample arena
+ */
+SW_API void sw_context_Destroy(struct sw_context* ctx);
+
+/**
+ * @brief Makes the following calls read a file descriptor. The descriptor is duplicated, the caller keeps ownership of fd
+ */
+SW_API int sw_context_SetInputFd(struct sw_context* ctx, int fd);
+
+/**
+ * @brief Makes the following calls write a file descriptor. The descriptor is duplicated, the caller keeps ownership of fd
+ */
+SW_API int sw_context_SetOutputFd(struct sw_context* ctx, int fd);
+
+/**
+ * @brief Makes the following calls read a WAV file in memory. The buffer is not copied and must outlive the calls
+ */
+SW_API int sw_context_SetInputBuffer(struct sw_context* ctx, const void* data, size_t size);
+
+/**
+ * @brief Makes the following calls write to a growing buffer owned by the context, see sw_context_Output()
+ */
+SW_API int sw_context_SetOutputMemory(struct sw_context* ctx);
+
+/**
+ * @brief Returns what the calls wrote since the last sw_context_SetOutputMemory()
+ *
+ * @param size receives the number of bytes
+ *
+ * @returns the data, valid until the next call on the context, or NULL if the output is not in memory
+ */
+SW_API const char* sw_context_Output(struct sw_context* ctx, size_t* size);
+
+/**
+ * @brief Runs a command line exactly like the soundwave program, argv[0] is the program name and argv[1] the command
+ */
+SW_API int sw_run(struct sw_context* ctx, int argc, char* argv[]);
+
+/**
+ * @brief Writes the properties of the WAV file
+ */
+SW_API int sw_info(struct sw_context* ctx);
+
+/**
+ * @brief Multiplies the sample rate of the WAV file by rate
+ */
+SW_API int sw_rate(struct sw_context* ctx, double rate);
+
+/**
+ * @brief Keeps one channel of a stereo WAV file, 0 for the left and 1 for the right
+ */
+SW_API int sw_channel(struct sw_context* ctx, int channel);
+
+/**
+ * @brief Multiplies the samples by volume
+ */
+SW_API int sw_volume(struct sw_context* ctx, double volume);
+
+/**
+ * @brief Applies a cascade of filters given as "type:freq[:q[:gain]]" strings
+ */
+SW_API int sw_filter(struct sw_context* ctx, const char* const* specs, uint32_t count);
+
+/**
+ * @brief Changes the bit depth to 8, 16, 24 or 32 bit PCM, or to 32 bit float when to_float is set
+ *
+ * @param dither 1 for TPDF dither, 0 for none, -1 to dither only when the depth is reduced
+ * @param shape non-zero for noise shaping of the dither
+ */
+SW_API int sw_convert(struct sw_context* ctx, uint16_t bits, int to_float, int dither, int shape);
+
+/**
+ * @brief Fades the data in and out over the given number of seconds, curve is "lin", "log" or "scurve"
+ */
+SW_API int sw_fade(struct sw_context* ctx, double fade_in, double fade_out, const char* curve);
+
+/**
+ * @brief Changes the tempo by factor without changing the pitch, mode is "wsola" or "pv"
+ */
+SW_API int sw_tempo(struct sw_context* ctx, double factor, const char* mode);
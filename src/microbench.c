@@ -0,0 +1,425 @@
+/**
+ * @file microbench.c
+ * @author Rafael Diolatzis
+ * @brief Microbenchmarks of the inner kernels of soundwave on in-memory buffers
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Every kernel runs in a tight loop on buffers that stay in memory, with the sample arena of utils.h attached so the
+ * buffers that the legacy kernels allocate are reused like they are in a library context. Every kernel is also run
+ * once against a plain scalar reference written here, compiled without vectorization, and the outputs are compared
+ * byte for byte. A mismatch makes the program exit with status 1.
+ *
+ * The SIMD variant is chosen when the kernels are compiled, like in the program, so `make microbench` builds the
+ * harness three times: microbench (the default SSE2 build), microbench-scalar (SSE2 paths disabled and no
+ * auto-vectorization) and microbench-avx2 (x86-64-v3). Cycles come from perf_event_open() when it is available,
+ * see stats.h. Otherwise that column is empty.
+ *
+ * The FM sound of the generate command has no SIMD path, its row is labelled libm in every build. The wavetable
+ * oscillator of the voices (synth.h), which is scalar too, is measured next to it on the same samples, so the two
+ * engines can be compared.
+ *
+ * Usage: ./microbench [--samples <count>] [--json]
+ */
+
+#include"soundman.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<inttypes.h>
+#include<math.h>
+
+#if defined(__AVX2__)
+#define MB_BUILD "avx2"
+#elif defined(__SSE2__)
+#define MB_BUILD "sse2"
+#else
+#define MB_BUILD "scalar"
+#endif
+
+#define MB_REFERENCE __attribute__((noinline, optimize("no-tree-vectorize")))
+#define MB_MIN_SECONDS 0.2
+#define MB_INCREMENT 134217728u     // phase increment of the oscillator, 1/32 of a period per sample
+
+/**
+ * @brief The buffers shared by the kernels
+ */
+struct mb_data {
+    uint32_t samples;
+    char* pcm16;            // samples 16 bit samples, interleaved stereo for the channel kernels
+    char* pcm8;             // samples 8 bit samples
+    int32_t* wide;          // samples 32 bit values around the 16 bit range, for clamp_16bit
+    int16_t* clamped;
+    float* floats;          // samples float samples, interleaved stereo or 5.1 for the remix kernels
+    struct remix_matrix mono;
+    struct remix_matrix fold;
+    char* header;           // a 44 byte WAV header
+    FILE* header_stream;
+    struct synth_tables* tables;
+    float* wave;            // the output of the wavetable oscillator
+    struct wav_header parsed;
+    char* result;           // the last buffer returned by a kernel
+};
+
+/**
+ * @brief The measurement of one kernel
+ */
+struct mb_result {
+    double seconds;
+    uint64_t rounds;
+    uint64_t cycles;
+    short has_cycles;
+};
+
+typedef void (*mb_Kernel)(struct mb_data* data);
+
+static struct run_stats mb_counters;
+
+/**
+ * @brief Returns the cycle counter of the process, 0 if it is not open
+ */
+uint64_t mb_Cycles(void){
+    uint64_t value = 0;
+    if(mb_counters.counter_fd[0] < 0 || read(mb_counters.counter_fd[0], &value, sizeof(value)) != (ssize_t)sizeof(value)) return 0;
+    return value;
+}
+
+/**
+ * @brief Runs a kernel until MB_MIN_SECONDS have passed, after one warm-up round
+ */
+struct mb_result mb_Measure(mb_Kernel kernel, struct mb_data* data){
+    struct mb_result result = {0, 0, 0, mb_counters.counter_fd[0] >= 0};
+    kernel(data);
+    free_Aligned(data->result);
+    data->result = NULL;
+
+    uint64_t cycles = mb_Cycles();
+    double begin = stats_Now();
+    do{
+        for(int i = 0; i < 8; i++){
+            kernel(data);
+            free_Aligned(data->result);
+            data->result = NULL;
+        }
+        result.rounds += 8;
+        result.seconds = stats_Now() - begin;
+    } while(result.seconds < MB_MIN_SECONDS);
+    result.cycles = mb_Cycles() - cycles;
+    return result;
+}
+
+void mb_Volume16(struct mb_data* data){
+    data->result = set_Volume16bit(data->pcm16, data->samples * 2, 0.7);
+}
+
+void mb_Volume8(struct mb_data* data){
+    data->result = set_Volume8bit(data->pcm8, data->samples, 0.7);
+}
+
+void mb_Channel16(struct mb_data* data){
+    data->result = read_Channel_16bit(data->pcm16, data->samples * 2, 1);
+}
+
+void mb_Channel8(struct mb_data* data){
+    data->result = read_Channel_8bit(data->pcm8, data->samples, 1);
+}
+
+void mb_RemixMono(struct mb_data* data){
+    data->result = alloc_Aligned((size_t)data->samples / 2 * sizeof(float));
+    remix_Apply(&data->mono, data->floats, (float*)data->result, data->samples / 2);
+}
+
+void mb_RemixFold(struct mb_data* data){
+    data->result = alloc_Aligned((size_t)data->samples / 3 * sizeof(float));
+    remix_Apply(&data->fold, data->floats, (float*)data->result, data->samples / 6);
+}
+
+void mb_Clamp(struct mb_data* data){
+    for(uint32_t i = 0; i < data->samples; i++) data->clamped[i] = clamp_16bit(data->wide[i]);
+}
+
+void mb_Mysound(struct mb_data* data){
+    data->result = alloc_Aligned((size_t)data->samples * 2);
+    mysound_Render(data->result, 0, data->samples, (int)data->samples, 2.0, 1500.0, 100.0, 30000.0);
+}
+
+void mb_Oscillate(struct mb_data* data){
+    synth_Oscillate(synth_Table(data->tables, SYNTH_SINE, 0), 0, MB_INCREMENT, data->wave, data->samples);
+}
+
+void mb_Header(struct mb_data* data){
+    short flag;
+    for(uint32_t i = 0; i < 64; i++){
+        rewind(data->header_stream);
+        fread_WavHeader(data->header_stream, &data->parsed, &flag);
+    }
+}
+
+MB_REFERENCE void mb_RefVolume16(const char* in, char* out, uint32_t samples, double volume){
+    for(uint32_t i = 0; i < samples; i++){
+        int32_t tmp = (int16_t)((uint8_t)in[2*i] | ((uint8_t)in[2*i + 1] << 8));
+        double scaled = tmp * volume;
+        int16_t s = scaled >= 32767.0 ? INT16_MAX : (scaled <= -32768.0 ? INT16_MIN : (int16_t)scaled);
+        out[2*i] = (char)(s & 0xFF);
+        out[2*i + 1] = (char)((s >> 8) & 0xFF);
+    }
+}
+
+MB_REFERENCE void mb_RefVolume8(const char* in, char* out, uint32_t samples, double volume){
+    for(uint32_t i = 0; i < samples; i++){
+        double scaled = ((int32_t)(uint8_t)in[i] - 128) * volume;
+        int32_t s = scaled >= 127.0 ? 127 : (scaled <= -128.0 ? -128 : (int32_t)scaled);
+        out[i] = (char)(uint8_t)(s + 128);
+    }
+}
+
+MB_REFERENCE void mb_RefChannel(const char* in, char* out, uint32_t frames, uint32_t bytes, uint32_t channel){
+    for(uint32_t i = 0; i < frames; i++){
+        for(uint32_t k = 0; k < bytes; k++) out[bytes*i + k] = in[2*bytes*i + bytes*channel + k];
+    }
+}
+
+MB_REFERENCE void mb_RefRemix(const struct remix_matrix* mx, const float* in, float* out, uint32_t frames){
+    for(uint32_t f = 0; f < frames; f++){
+        for(uint32_t m = 0; m < mx->out_channels; m++){
+            float sum = in[f*mx->in_channels] * mx->columns[0][m];
+            for(uint32_t n = 1; n < mx->in_channels; n++) sum += in[f*mx->in_channels + n] * mx->columns[n][m];
+            out[f*mx->out_channels + m] = sum;
+        }
+    }
+}
+
+MB_REFERENCE void mb_RefClamp(const int32_t* in, int16_t* out, uint32_t samples){
+    for(uint32_t i = 0; i < samples; i++){
+        out[i] = in[i] < INT16_MIN ? INT16_MIN : (in[i] > INT16_MAX ? INT16_MAX : (int16_t)in[i]);
+    }
+}
+
+MB_REFERENCE void mb_RefMysound(char* out, uint32_t samples){
+    for(uint32_t i = 0; i < samples; i++){
+        double t = (double)i / samples;
+        int16_t s = trunc(30000.0 * sin(2 * M_PI * 1500.0 * t - 100.0 * sin(2 * M_PI * 2.0 * t)));
+        out[2*i] = (char)(s & 0xFF);
+        out[2*i + 1] = (char)((s >> 8) & 0xFF);
+    }
+}
+
+MB_REFERENCE void mb_RefOscillate(const float* table, uint32_t phase, uint32_t increment, float* out, uint32_t count){
+    const uint32_t shift = 32 - SYNTH_TABLE_BITS;
+    const float to_frac = 1.0f / (float)(1u << shift);
+    for(uint32_t i = 0; i < count; i++){
+        uint32_t idx = phase >> shift;
+        float f = (float)(phase & ((1u << shift) - 1)) * to_frac;
+        out[i] = table[idx] + f * (table[idx + 1] - table[idx]);
+        phase += increment;
+    }
+}
+
+/**
+ * @brief Prints one row of the report
+ *
+ * @param bytes the bytes read and written by one round
+ * @param units the samples (or headers) of one round
+ */
+void mb_Report(const char* kernel, const char* variant, const struct mb_result* r, double bytes, double units, const char* check, short json){
+    double ns = r->seconds * 1e9 / (r->rounds * units);
+    double cycles = r->has_cycles ? (double)r->cycles / (r->rounds * units) : -1;
+    double gbs = bytes * r->rounds / r->seconds / 1e9;
+    if(json){
+        printf("{\"kernel\":\"%s\",\"variant\":\"%s\",\"ns_per_sample\":%.4f,", kernel, variant, ns);
+        if(cycles >= 0) printf("\"cycles_per_sample\":%.4f,", cycles);
+        else printf("\"cycles_per_sample\":null,");
+        printf("\"gb_per_s\":%.3f,\"check\":\"%s\"}\n", gbs, check);
+        return;
+    }
+    char cycles_text[32] = "-";
+    if(cycles >= 0) snprintf(cycles_text, sizeof(cycles_text), "%.3f", cycles);
+    printf("  %-20s%-12s%-12.3f%-16s%-10.2f%-8s\n", kernel, variant, ns, cycles_text, gbs, check);
+}
+
+/**
+ * @brief Measures a kernel and, if there is one, its scalar reference, and compares their outputs
+ *
+ * @param variant the build for kernels with a SIMD path, how the kernel is computed for the others
+ *
+ * @returns 1 if the outputs match
+ */
+short mb_Run(const char* name, const char* variant, mb_Kernel kernel, mb_Kernel reference, struct mb_data* data,
+             const char* expected, const void* (*output)(struct mb_data*), size_t size, double bytes, double units, short json){
+    kernel(data);
+    short match = memcmp(output(data), expected, size) == 0;
+    free_Aligned(data->result);
+    data->result = NULL;
+
+    struct mb_result r = mb_Measure(kernel, data);
+    mb_Report(name, variant, &r, bytes, units, match ? "ok" : "MISMATCH", json);
+    if(reference != NULL){
+        r = mb_Measure(reference, data);
+        mb_Report(name, "reference", &r, bytes, units, "-", json);
+    }
+    return match;
+}
+
+/*
+ * The references as kernels, writing to the buffers the kernels allocate from the arena.
+ */
+void mb_RefVolume16Kernel(struct mb_data* data){
+    data->result = alloc_Aligned(data->samples * 2);
+    mb_RefVolume16(data->pcm16, data->result, data->samples, 0.7);
+}
+
+void mb_RefVolume8Kernel(struct mb_data* data){
+    data->result = alloc_Aligned(data->samples);
+    mb_RefVolume8(data->pcm8, data->result, data->samples, 0.7);
+}
+
+void mb_RefChannel16Kernel(struct mb_data* data){
+    data->result = alloc_Aligned(data->samples);
+    mb_RefChannel(data->pcm16, data->result, data->samples / 2, 2, 1);
+}
+
+void mb_RefChannel8Kernel(struct mb_data* data){
+    data->result = alloc_Aligned(data->samples / 2);
+    mb_RefChannel(data->pcm8, data->result, data->samples / 2, 1, 1);
+}
+
+void mb_RefRemixMonoKernel(struct mb_data* data){
+    data->result = alloc_Aligned((size_t)data->samples / 2 * sizeof(float));
+    mb_RefRemix(&data->mono, data->floats, (float*)data->result, data->samples / 2);
+}
+
+void mb_RefRemixFoldKernel(struct mb_data* data){
+    data->result = alloc_Aligned((size_t)data->samples / 3 * sizeof(float));
+    mb_RefRemix(&data->fold, data->floats, (float*)data->result, data->samples / 6);
+}
+
+void mb_RefClampKernel(struct mb_data* data){
+    mb_RefClamp(data->wide, data->clamped, data->samples);
+}
+
+void mb_RefMysoundKernel(struct mb_data* data){
+    data->result = alloc_Aligned(data->samples * 2);
+    mb_RefMysound(data->result, data->samples);
+}
+
+const void* mb_Result(struct mb_data* data){
+    return data->result;
+}
+
+const void* mb_Clamped(struct mb_data* data){
+    return data->clamped;
+}
+
+void mb_RefOscillateKernel(struct mb_data* data){
+    mb_RefOscillate(synth_Table(data->tables, SYNTH_SINE, 0), 0, MB_INCREMENT, data->wave, data->samples);
+}
+
+const void* mb_Wave(struct mb_data* data){
+    return data->wave;
+}
+
+const void* mb_Parsed(struct mb_data* data){
+    return &data->parsed;
+}
+
+int main(int argc, char* argv[]){
+    uint32_t samples = 1 << 18;
+    short json = 0;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--samples") == 0 && i+1 < argc){
+            samples = (uint32_t)atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--json") == 0){
+            json = 1;
+        } else{
+            fprintf(stderr, "Usage: ./microbench [--samples <count>] [--json]\n");
+            return 1;
+        }
+    }
+    samples = samples < 1024 ? 1024 : samples & ~(uint32_t)63;
+#if defined(__AVX2__)
+    if(!__builtin_cpu_supports("avx2")){
+        fprintf(stderr, "Error: this build needs AVX2, run ./microbench instead\n");
+        return 1;
+    }
+#endif
+
+    struct sample_arena arena;
+    memset(&arena, 0, sizeof(arena));
+    io_arena = &arena;
+    stats_OpenCounters(&mb_counters);
+    stats_Count(&mb_counters, 1);
+
+    struct mb_data data;
+    memset(&data, 0, sizeof(data));
+    data.samples = samples;
+    data.pcm16 = alloc_Aligned((size_t)samples * 2);
+    data.pcm8 = alloc_Aligned(samples);
+    data.wide = alloc_Aligned((size_t)samples * sizeof(int32_t));
+    data.clamped = alloc_Aligned((size_t)samples * sizeof(int16_t));
+    data.floats = alloc_Aligned((size_t)samples * sizeof(float));
+    data.header = alloc_Aligned(SIZE_OF_WAVE_HEADER + 8);
+    data.wave = alloc_Aligned((size_t)samples * sizeof(float));
+    data.tables = synth_tables_Create();
+    char* expected = alloc_Aligned((size_t)samples * sizeof(float));
+    int16_t* expected_clamp = alloc_Aligned((size_t)samples * sizeof(int16_t));
+    if(data.pcm16 == NULL || data.pcm8 == NULL || data.wide == NULL || data.clamped == NULL || data.floats == NULL || data.header == NULL ||
+       data.wave == NULL || data.tables == NULL || expected == NULL || expected_clamp == NULL){
+        fprintf(stderr, "Error: unable to allocate memory\n");
+        return 1;
+    }
+    uint32_t seed = 1;
+    for(uint32_t i = 0; i < samples; i++){
+        seed = seed * 1664525u + 1013904223u;
+        data.pcm16[2*i] = (char)(seed >> 8);
+        data.pcm16[2*i + 1] = (char)(seed >> 16);
+        data.pcm8[i] = (char)(seed >> 24);
+        data.wide[i] = (int32_t)(seed >> 14) - (1 << 17);     // about half of the values are out of range
+        data.floats[i] = (int32_t)seed / 2147483648.0f;
+    }
+    remix_Preset(&data.mono, "mono", 2);
+    remix_Preset(&data.fold, "5.1-stereo", 6);
+    struct wav_header header = {SIZE_OF_WAVE_HEADER + samples * 4, 16, WAVE_FORMAT_PCM, 2, 48000, 192000, 4, 16, samples * 4};
+    format_WavHeader(&header, (uint8_t*)data.header);
+    data.header_stream = fmemopen(data.header, SIZE_OF_WAVE_HEADER + 8, "rb");
+    if(data.header_stream == NULL){
+        fprintf(stderr, "Error: unable to open the memory streams\n");
+        return 1;
+    }
+
+    if(!json){
+        printf("microbench: %s build, %" PRIu32 " samples, cycles %s\n", MB_BUILD, samples,
+               mb_counters.counter_fd[0] >= 0 ? "from perf_event_open" : "unavailable");
+        printf("  %-20s%-12s%-12s%-16s%-10s%-8s\n", "kernel", "variant", "ns/sample", "cycles/sample", "GB/s", "check");
+    }
+
+    short ok = 1;
+    mb_RefVolume16(data.pcm16, expected, samples, 0.7);
+    ok &= mb_Run("set_Volume16bit", MB_BUILD, mb_Volume16, mb_RefVolume16Kernel, &data, expected, mb_Result, (size_t)samples * 2, samples * 4.0, samples, json);
+    mb_RefVolume8(data.pcm8, expected, samples, 0.7);
+    ok &= mb_Run("set_Volume8bit", MB_BUILD, mb_Volume8, mb_RefVolume8Kernel, &data, expected, mb_Result, samples, samples * 2.0, samples, json);
+    mb_RefChannel(data.pcm16, expected, samples / 2, 2, 1);
+    ok &= mb_Run("read_Channel_16bit", MB_BUILD, mb_Channel16, mb_RefChannel16Kernel, &data, expected, mb_Result, samples, samples * 3.0, samples / 2, json);
+    mb_RefChannel(data.pcm8, expected, samples / 2, 1, 1);
+    ok &= mb_Run("read_Channel_8bit", MB_BUILD, mb_Channel8, mb_RefChannel8Kernel, &data, expected, mb_Result, samples / 2, samples * 1.5, samples / 2, json);
+    mb_RefRemix(&data.mono, data.floats, (float*)expected, samples / 2);
+    ok &= mb_Run("remix 2->1", MB_BUILD, mb_RemixMono, mb_RefRemixMonoKernel, &data, expected, mb_Result, samples / 2 * sizeof(float), samples * 6.0, samples, json);
+    mb_RefRemix(&data.fold, data.floats, (float*)expected, samples / 6);
+    ok &= mb_Run("remix 6->2", MB_BUILD, mb_RemixFold, mb_RefRemixFoldKernel, &data, expected, mb_Result, samples / 6 * 2 * sizeof(float), samples * 4.0 * 8 / 6, samples, json);
+    mb_RefClamp(data.wide, expected_clamp, samples);
+    ok &= mb_Run("clamp_16bit", MB_BUILD, mb_Clamp, mb_RefClampKernel, &data, (const char*)expected_clamp, mb_Clamped, (size_t)samples * 2, samples * 6.0, samples, json);
+    mb_RefMysound(expected, samples);
+    ok &= mb_Run("mysound (fm)", "libm", mb_Mysound, mb_RefMysoundKernel, &data, expected, mb_Result, (size_t)samples * 2, samples * 2.0, samples, json);
+    mb_RefOscillate(synth_Table(data.tables, SYNTH_SINE, 0), 0, MB_INCREMENT, (float*)expected, samples);
+    ok &= mb_Run("synth_Oscillate", "scalar", mb_Oscillate, mb_RefOscillateKernel, &data, expected, mb_Wave, (size_t)samples * sizeof(float), samples * 4.0, samples, json);
+    ok &= mb_Run("fread_WavHeader", "scalar", mb_Header, NULL, &data, (const char*)&header, mb_Parsed, sizeof(header), 64.0 * 44, 64, json);
+
+    fclose(data.header_stream);
+    synth_tables_Destroy(data.tables);
+    io_arena = NULL;
+    arena_Release(&arena);
+    stats_Stop(&mb_counters);
+    if(!ok) fprintf(stderr, "Error: a kernel does not match its scalar reference\n");
+    return ok ? 0 : 1;
+}
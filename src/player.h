@@ -0,0 +1,933 @@
+/**
+ * @file player.h
+ * @author Rafael Diolatzis
+ * @brief Playback of the dj command with live control of the volume, pause and seek
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Two threads take part in playback. The audio thread (the caller of player_Play) writes one period at a time to the
+ * sink and must never wait for anything but the sink. The control thread reads keys from the terminal, or lines from
+ * a control file or FIFO, and turns them into requests. The two share nothing but the atomics of player_control: the
+ * control thread stores a target gain, a pause flag and a seek position, and the audio thread loads them once per
+ * period and publishes the frame it has reached, so neither thread ever takes a lock.
+ *
+ * Changes are never applied as a step, which would click. The gain of a period moves linearly from the gain the last
+ * period ended with to the target, so a volume change, a pause or a resume is a ramp of one period. A seek ramps the
+ * current position down over one period and continues at the new position from silence, which the next period ramps
+ * up.
+ *
+ * The sink is the sound device, or a simulated sink that writes the periods that would have been played to STDOUT as
+ * a WAV file, paced like a device. Playback can then be checked without a sound card, e.g. by driving it with a
+ * control file that has wait lines between the commands.
+ *
+ * The period and the number of periods of the buffer come from a latency profile (low, normal, safe) or are given
+ * explicitly. Playback starts when the buffer is full and the latency reported is the time the buffer holds. The
+ * virtual sink models a device with that buffer on a virtual clock instead of waiting: time passes by the real time
+ * the player spends between two writes, plus a stall that can be injected at a position, and jumps ahead whenever the
+ * buffer is full. When the device would have run dry the virtual sink counts an underrun and restarts at the start
+ * threshold like a device does, so the underrun behavior of a profile can be checked in a fraction of real time.
+ *
+ * Keys: space pauses and resumes, + and - change the volume by 1 dB, the left and right arrows (or , and .) seek by
+ * 5 seconds and q stops. Control lines: volume <gain>, pause, resume, toggle, seek <time>, seek +<time>,
+ * seek -<time>, wait <time> and quit.
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<inttypes.h>
+#include<errno.h>
+#include<math.h>
+#include<time.h>
+#include<fcntl.h>
+#include<poll.h>
+#include<sched.h>
+#include<termios.h>
+#include<unistd.h>
+#include<pthread.h>
+#include<stdatomic.h>
+#include<sys/stat.h>
+#include"utils.h"
+#include"caudio.h"
+#include"codec.h"
+#include"flac.h"
+#include"beat.h"
+
+#define PLAYER_PERIOD_FRAMES 1024
+#define PLAYER_PERIODS 4
+#define PLAYER_SEEK_STEP 5.0
+#define PLAYER_GAIN_STEP_DB 1.0
+#define PLAYER_POLL_MS 50
+
+#define PLAYER_DECK_FRAMES (1 << 17)    // decoded frames a deck holds ahead of playback, 3 s at 44.1 kHz
+#define PLAYER_DECK_POLL_MS 5
+#define PLAYER_PREFETCH 10.0            // seconds before its transition that the next deck starts to decode
+
+#define PLAYER_SINK_DEVICE 0
+#define PLAYER_SINK_SIM 1
+#define PLAYER_SINK_VIRTUAL 2
+
+/**
+ * @brief The parameters shared by the control thread and the audio thread
+ */
+struct player_control {
+    _Atomic uint32_t gain;          // the target gain, the bits of a float
+    atomic_int paused;
+    _Atomic int64_t seek;           // the frame to continue from, -1 when no seek is pending
+    atomic_int quit;
+    _Atomic uint64_t position;      // the next frame of the file, published by the audio thread
+    atomic_int done;                // set by the audio thread when playback ends
+
+    // set before the threads start
+    uint32_t sample_rate;
+    uint64_t frames;
+    const char* path;               // the control file or FIFO, NULL for the terminal
+};
+
+/**
+ * @brief A sound device or a simulated sink
+ */
+struct player_sink {
+    int type;
+    int fd;                         // the device
+    uint32_t sample_rate;
+    uint16_t block_align;
+    uint32_t period_frames;         // as negotiated with the device
+    uint32_t buffer_frames;
+    uint32_t start_threshold;
+    unsigned int underruns;
+    double start;                   // simulated sink: the time the first frame was written
+    uint64_t written;               // frames written
+
+    // virtual sink
+    double clock;                   // virtual time of the last write
+    double last;                    // real time the last write returned
+    double stall;                   // seconds of stall injected once, before the write at stall_at frames
+    uint64_t stall_at;
+    short running;
+    double started_at;              // virtual time the device started
+    uint64_t base;                  // frames written when the device started
+};
+
+/**
+ * @brief The options of the dj command
+ */
+struct player_options {
+    const char* control;            // a control file or FIFO, NULL for the keys of the terminal
+    int sink;                       // PLAYER_SINK_*
+    double volume;                  // the initial volume
+    uint32_t period;                // frames
+    uint32_t periods;               // periods of the buffer
+    double stall;                   // virtual sink: seconds the player stalls once, at stall_at seconds
+    double stall_at;
+};
+
+/**
+ * @brief Returns the period and the number of periods of a latency profile
+ *
+ * @returns 0 on success, -1 if the name is not a profile
+ */
+short player_ParseLatency(const char* name, uint32_t* period, uint32_t* periods){
+    if(strcmp(name, "low") == 0){
+        *period = 256;
+        *periods = 2;
+    } else if(strcmp(name, "normal") == 0){
+        *period = PLAYER_PERIOD_FRAMES;
+        *periods = PLAYER_PERIODS;
+    } else if(strcmp(name, "safe") == 0){
+        *period = 2048;
+        *periods = 4;
+    } else{
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Prints the buffer geometry of a sink and the latency it gives to STDERR
+ */
+void player_ReportLatency(const struct player_sink* sink){
+    fprintf(stderr, "dj: period %" PRIu32 " frames, buffer %" PRIu32 " frames, start at %" PRIu32 " frames, latency %.1f ms\n",
+            sink->period_frames, sink->buffer_frames, sink->start_threshold, 1000.0 * sink->buffer_frames / sink->sample_rate);
+}
+
+static inline uint32_t player_FloatBits(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline float player_BitsFloat(uint32_t bits){
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Returns the time of a monotonic clock in seconds
+ */
+double player_Now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Sleeps until a time of the monotonic clock
+ */
+void player_SleepUntil(double when){
+    struct timespec ts;
+    ts.tv_sec = (time_t)when;
+    ts.tv_nsec = (long)((when - (double)ts.tv_sec) * 1e9);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/**
+ * @brief Requests a seek relative to the position the audio thread has published, clamped to the file
+ */
+void player_SeekBy(struct player_control* ctl, double seconds){
+    int64_t target = (int64_t)atomic_load(&ctl->position) + (int64_t)llround(seconds * ctl->sample_rate);
+    if(target < 0) target = 0;
+    if((uint64_t)target > ctl->frames) target = (int64_t)ctl->frames;
+    atomic_store(&ctl->seek, target);
+}
+
+/**
+ * @brief Multiplies the target gain by a number of decibels
+ */
+void player_GainBy(struct player_control* ctl, double db){
+    float gain = player_BitsFloat(atomic_load(&ctl->gain)) * (float)pow(10.0, db / 20.0);
+    atomic_store(&ctl->gain, player_FloatBits(gain));
+}
+
+/**
+ * @brief Applies one line of a control file
+ *
+ * @returns 0 on success, 1 if the line is not a valid command
+ */
+short player_Command(struct player_control* ctl, char* line){
+    char* words[2] = {NULL, NULL};
+    uint32_t count = 0;
+    for(char* word = strtok(line, " \t\r\n"); word != NULL && count < 2; word = strtok(NULL, " \t\r\n")) words[count++] = word;
+    if(count == 0 || words[0][0] == '#') return 0;
+
+    short flag = 0;
+    if(strcmp(words[0], "pause") == 0) atomic_store(&ctl->paused, 1);
+    else if(strcmp(words[0], "resume") == 0) atomic_store(&ctl->paused, 0);
+    else if(strcmp(words[0], "toggle") == 0) atomic_fetch_xor(&ctl->paused, 1);
+    else if(strcmp(words[0], "quit") == 0) atomic_store(&ctl->quit, 1);
+    else if(count < 2) return 1;
+    else if(strcmp(words[0], "volume") == 0){
+        double gain = parse_Gain(words[1], &flag);
+        if(!flag) atomic_store(&ctl->gain, player_FloatBits((float)gain));
+    }
+    else if(strcmp(words[0], "seek") == 0){
+        double sign = words[1][0] == '-' ? -1.0 : 1.0;
+        short relative = words[1][0] == '+' || words[1][0] == '-';
+        double seconds = parse_Seconds(words[1] + relative, &flag);
+        if(flag) return 1;
+        if(relative) player_SeekBy(ctl, sign * seconds);
+        else{
+            uint64_t target = (uint64_t)llround(seconds * ctl->sample_rate);
+            atomic_store(&ctl->seek, (int64_t)(target < ctl->frames ? target : ctl->frames));
+        }
+    }
+    else if(strcmp(words[0], "wait") == 0){
+        double until = player_Now() + parse_Seconds(words[1], &flag);
+        while(!flag && !atomic_load(&ctl->done) && player_Now() < until){
+            double left = until - player_Now();
+            player_SleepUntil(player_Now() + (left < PLAYER_POLL_MS / 1000.0 ? left : PLAYER_POLL_MS / 1000.0));
+        }
+    }
+    else return 1;
+    return flag;
+}
+
+/**
+ * @brief Applies one key of the terminal
+ *
+ * @param escape the state of an arrow key escape sequence (ESC [ C), kept between calls
+ */
+void player_Key(struct player_control* ctl, char key, int* escape){
+    if(*escape == 1){
+        *escape = key == '[' ? 2 : 0;
+        return;
+    }
+    if(*escape == 2){
+        *escape = 0;
+        if(key == 'C') player_SeekBy(ctl, PLAYER_SEEK_STEP);
+        if(key == 'D') player_SeekBy(ctl, -PLAYER_SEEK_STEP);
+        return;
+    }
+    if(key == 27) *escape = 1;
+    else if(key == ' ') atomic_fetch_xor(&ctl->paused, 1);
+    else if(key == '+' || key == '=') player_GainBy(ctl, PLAYER_GAIN_STEP_DB);
+    else if(key == '-') player_GainBy(ctl, -PLAYER_GAIN_STEP_DB);
+    else if(key == '.') player_SeekBy(ctl, PLAYER_SEEK_STEP);
+    else if(key == ',') player_SeekBy(ctl, -PLAYER_SEEK_STEP);
+    else if(key == 'q') atomic_store(&ctl->quit, 1);
+}
+
+/**
+ * @brief The control thread: reads the terminal or the control file until playback is done
+ */
+void* player_ControlThread(void* arg){
+    struct player_control* ctl = arg;
+    // non-blocking so that opening a FIFO does not wait for a writer
+    int fd = open(ctl->path != NULL ? ctl->path : "/dev/tty", O_RDONLY | O_NONBLOCK);
+    if(fd < 0){
+        if(ctl->path != NULL) fprintf(stderr, "Error! unable to open the control file %s\n", ctl->path);
+        return NULL;
+    }
+    struct stat st;
+    short fifo = fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+    struct termios saved;
+    short tty = ctl->path == NULL && tcgetattr(fd, &saved) == 0;
+    if(tty){
+        struct termios raw = saved;
+        raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &raw);
+    }
+
+    char line[256];
+    size_t length = 0;
+    int escape = 0;
+    while(!atomic_load(&ctl->done)){
+        struct pollfd p = {fd, POLLIN, 0};
+        if(poll(&p, 1, PLAYER_POLL_MS) <= 0) continue;
+        char input[64];
+        ssize_t n = read(fd, input, sizeof(input));
+        if(n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if(n == 0 && fifo){
+            // the writer closed the FIFO, wait for the next one
+            close(fd);
+            fd = open(ctl->path, O_RDONLY | O_NONBLOCK);
+            if(fd < 0) break;
+            continue;
+        }
+        if(n <= 0) break;
+        for(ssize_t i = 0; i < n; i++){
+            if(tty){
+                player_Key(ctl, input[i], &escape);
+                continue;
+            }
+            if(input[i] != '\n' && length + 1 < sizeof(line)){
+                line[length++] = input[i];
+                continue;
+            }
+            line[length] = '\0';
+            length = 0;
+            if(player_Command(ctl, line)) fprintf(stderr, "Warning: undefined control command\n");
+        }
+    }
+    if(tty) tcsetattr(fd, TCSANOW, &saved);
+    if(fd >= 0) close(fd);
+    return NULL;
+}
+
+/**
+ * @brief Writes frames to a sink. The simulated sink takes them at the pace of a device
+ *
+ * @returns 0 on success, -1 on failure
+ */
+int player_SinkWrite(struct player_sink* sink, char* data, uint32_t frames){
+    if(sink->type == PLAYER_SINK_DEVICE){
+        int ret = caudio_write_data_to_device(sink->fd, data, frames * sink->block_align, &sink->underruns);
+        sink->written += frames;
+        return ret;
+    }
+    if(sink->type == PLAYER_SINK_VIRTUAL){
+        const double rate = sink->sample_rate;
+        if(sink->written > 0) sink->clock += player_Now() - sink->last;
+        if(sink->stall > 0 && sink->written >= sink->stall_at){
+            sink->clock += sink->stall;
+            sink->stall = 0;
+        }
+        double queued = (double)(sink->written - sink->base);
+        if(sink->running){
+            queued -= (sink->clock - sink->started_at) * rate;
+            if(queued < 0){
+                // the buffer ran dry, the device stops and waits for the start threshold again
+                sink->underruns++;
+                sink->running = 0;
+                sink->base = sink->written;
+                queued = 0;
+            }
+        }
+        if(sink->running && queued + frames > sink->buffer_frames){
+            // the write waits until the device has made room
+            sink->clock += (queued + frames - sink->buffer_frames) / rate;
+        }
+        sink->written += frames;
+        if(!sink->running && sink->written - sink->base >= sink->start_threshold){
+            sink->running = 1;
+            sink->started_at = sink->clock;
+        }
+        int ret = write_Block(data, (size_t)frames * sink->block_align) == (size_t)frames * sink->block_align ? 0 : -1;
+        sink->last = player_Now();
+        return ret;
+    }
+    if(sink->written == 0) sink->start = player_Now();
+    // a device accepts a period once the one before it has been played
+    player_SleepUntil(sink->start + (double)sink->written / sink->sample_rate);
+    sink->written += frames;
+    return write_Block(data, (size_t)frames * sink->block_align) == (size_t)frames * sink->block_align ? 0 : -1;
+}
+
+/**
+ * @brief Opens the sink of the dj command. The simulated sinks start their WAV file on STDOUT
+ *
+ * @param header the format of the frames that will be written
+ * @param header_offset receives the offset of the header on STDOUT, -1 for the device
+ *
+ * @returns 0 on success, 1 if there is no device, or the error of caudio_setup_params()
+ */
+int player_SinkOpen(struct player_sink* sink, const struct player_options* options, const struct wav_header* header, off_t* header_offset){
+    memset(sink, 0, sizeof(struct player_sink));
+    sink->type = options->sink;
+    sink->fd = -1;
+    sink->sample_rate = header->sample_rate;
+    sink->block_align = header->block_align;
+    sink->period_frames = options->period;
+    sink->buffer_frames = options->period * options->periods;
+    sink->start_threshold = sink->buffer_frames;
+    sink->stall = options->stall;
+    sink->stall_at = (uint64_t)llround(options->stall_at * header->sample_rate);
+    *header_offset = -1;
+    if(sink->type != PLAYER_SINK_DEVICE){
+        // the simulated sink writes what it plays, the sizes are fixed at the end when STDOUT can seek
+        fflush(IO_OUT);
+        *header_offset = ftello(IO_OUT);
+        write_WavHeader(header);
+        return 0;
+    }
+    sink->fd = caudio_open_device();
+    if(sink->fd < 0){
+        fprintf(stderr, "Error: Unable to detect a valid audio device to use\n");
+        return 1;
+    }
+    struct snd_pcm_hw_params hw;
+    struct snd_pcm_sw_params sw;
+    struct caudio_latency latency;
+    int err = caudio_setup_params(sink->fd, &hw, &sw, (int)header->mono_stereo, header->bits_per_sample,
+                                  (unsigned int)header->sample_rate, options->period, options->periods, &latency);
+    if(err != 0){
+        fprintf(stderr, "Error: Unable to configure audio device (Error code: %d)\n", err);
+        caudio_close_audio_devide(sink->fd);
+        return err;
+    }
+    // playback starts by itself at the start threshold, starting it now would underrun right away
+    sink->period_frames = latency.period_size;
+    sink->buffer_frames = latency.buffer_size;
+    sink->start_threshold = latency.start_threshold;
+    return 0;
+}
+
+/**
+ * @brief Closes the sink of the dj command. The simulated sinks complete the sizes of the header of their WAV file
+ *
+ * @param err the status of playback
+ */
+void player_SinkClose(struct player_sink* sink, struct wav_header* header, off_t header_offset, int err){
+    if(sink->type == PLAYER_SINK_DEVICE){
+        if(err != 0) fprintf(stderr, "Error: An unexpected error occured while playing your WAV file\n");
+        caudio_stop_playback(sink->fd);
+        caudio_close_audio_devide(sink->fd);
+    } else if(header_offset >= 0 && fflush(IO_OUT) == 0){
+        header->data_segment_size = (uint32_t)(sink->written * header->block_align);
+        header->size_of_file = SIZE_OF_WAVE_HEADER + header->data_segment_size;
+        off_t end_offset = ftello(IO_OUT);
+        if(fseeko(IO_OUT, header_offset, SEEK_SET) == 0){
+            fwrite_WavHeader(IO_OUT, header);
+            fseeko(IO_OUT, end_offset, SEEK_SET);
+        }
+    }
+}
+
+/**
+ * @brief Plays a data segment to a sink, applying the requests of the control thread between periods
+ *
+ * @param data the data segment
+ * @param header the header of the file, 8 or 16 bit PCM
+ * @param ctl the shared parameters, gain set to the initial volume
+ *
+ * @returns 0 on success, -1 if the sink failed
+ */
+int player_Play(const char* data, const struct wav_header* header, struct player_sink* sink, struct player_control* ctl){
+    const uint16_t channels = header->mono_stereo;
+    const uint16_t align = header->block_align;
+    const uint32_t period_frames = sink->period_frames;
+    char* period = malloc((size_t)period_frames * align);
+    double* gains = malloc((size_t)period_frames * channels * sizeof(double));
+    if(period == NULL || gains == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free(period);
+        free(gains);
+        return -1;
+    }
+
+    uint64_t position = 0;
+    float current = player_BitsFloat(atomic_load(&ctl->gain));
+    int error = 0;
+    while(position < ctl->frames && !atomic_load(&ctl->quit) && error == 0){
+        int64_t seek = atomic_exchange(&ctl->seek, -1);
+        float goal = atomic_load(&ctl->paused) || seek >= 0 ? 0.0f : player_BitsFloat(atomic_load(&ctl->gain));
+
+        if(current == 0.0f && goal == 0.0f){
+            if(seek >= 0){
+                position = (uint64_t)seek;
+                atomic_store(&ctl->position, position);
+                continue;
+            }
+            // paused: the device keeps playing silence
+            memset(period, header->bits_per_sample == 8 ? 0x80 : 0, (size_t)period_frames * align);
+            error = player_SinkWrite(sink, period, period_frames);
+            continue;
+        }
+
+        uint32_t frames = ctl->frames - position < period_frames ? (uint32_t)(ctl->frames - position) : period_frames;
+        for(uint32_t i = 0; i < frames; i++){
+            double gain = current + (goal - current) * (double)(i + 1) / frames;
+            for(uint16_t c = 0; c < channels; c++) gains[(size_t)i * channels + c] = gain;
+        }
+        const char* in = data + position * align;
+        if(header->bits_per_sample == 8) gain_Apply8bit(in, period, frames * channels, gains);
+        else gain_Apply16bit(in, period, frames * channels, gains);
+        error = player_SinkWrite(sink, period, frames);
+
+        current = goal;
+        position = seek >= 0 ? (uint64_t)seek : position + frames;
+        atomic_store(&ctl->position, position);
+    }
+
+    free(period);
+    free(gains);
+    return error;
+}
+
+/**
+ * @brief A file of a dj playlist, decoded ahead of playback by a reader thread into a ring of float frames
+ *
+ * The reader and the audio thread share the ring through two counters: the reader publishes the frames it has
+ * written, the audio thread the frames it has taken, and each only writes its own, so neither waits for the other.
+ */
+struct player_deck {
+    const char* path;
+    struct codec_wav wav;           // read when the playlist is checked
+    uint64_t frames;                // frames of the file
+    uint16_t channels;              // of the output, the file is downmixed or upmixed to them
+    short beat_align;               // find the beats of the file before decoding it
+    short cue;                      // and start at the first beat
+    struct beat_result beat;        // set by the reader before ready, a bpm of 0 when there are no beats
+    uint64_t skip;                  // frames left out at the start, set by the reader before ready
+    float* ring;
+    _Atomic uint64_t produced;      // frames the reader has written to the ring
+    _Atomic uint64_t consumed;      // frames the audio thread has taken from the ring
+    atomic_int ready;               // beat and skip are set
+    atomic_int eof;                 // produced will not grow any more
+    atomic_int stop;                // the audio thread is done with the deck
+    pthread_t thread;
+    short started;
+};
+
+/**
+ * @brief The cost of mixing the periods of a playlist
+ */
+struct player_mix_stats {
+    uint64_t periods;
+    double total;                   // seconds spent mixing
+    double max;
+    uint64_t late;                  // periods that took longer to mix than to play
+    uint64_t underflows;            // periods in which a deck had no frames ready
+    uint64_t shortened;             // crossfades placed after their start because the next deck was not ready
+};
+
+/**
+ * @brief Reads the header of the file of a deck, which may be FLAC or any format codec.h decodes
+ *
+ * @returns 0 on success, -1 with an error reported
+ */
+short player_DeckCheck(struct player_deck* deck){
+    FILE* file = fopen(deck->path, "rb");
+    if(file == NULL){
+        fprintf(stderr, "Error! unable to open %s\n", deck->path);
+        return -1;
+    }
+    struct codec_stream stream;
+    struct codec_input input;
+    memset(&input, 0, sizeof(input));
+    FILE* in = flac_Open(file, &stream);
+    short status = in != NULL ? codec_ReadHeader(in, &input) : -1;
+    free(input.prefix);
+    if(in != NULL) codec_StreamClose(&stream);
+    fclose(file);
+    deck->wav = input.wav;
+    if(status != 0 || !codec_Readable(&deck->wav) || deck->wav.channels > 2){
+        fprintf(stderr, "Error! %s is not a mono or stereo WAV file of PCM or float samples\n", deck->path);
+        return -1;
+    }
+    deck->frames = deck->wav.data_size / deck->wav.block_align;
+    return 0;
+}
+
+/**
+ * @brief Returns 1 once the audio thread has taken the last frame of a deck
+ */
+static short player_DeckEnded(struct player_deck* deck){
+    return atomic_load(&deck->eof) && atomic_load(&deck->produced) == atomic_load(&deck->consumed);
+}
+
+/**
+ * @brief Thread entry point that finds the beats of a deck if asked, then decodes it into its ring, waiting for room
+ * whenever the ring is full
+ */
+void* player_DeckReader(void* arg){
+    struct player_deck* deck = arg;
+    if(deck->beat_align){
+        struct fft_plan* plan = fft_plan_Create(BEAT_FFT);
+        if(plan == NULL || beat_File(deck->path, plan, 0, &deck->beat) != 0) memset(&deck->beat, 0, sizeof(deck->beat));
+        fft_plan_Destroy(plan);
+        if(deck->cue && deck->beat.bpm > 0.0) deck->skip = (uint64_t)llround(deck->beat.first * deck->wav.sample_rate);
+    }
+    atomic_store(&deck->ready, 1);
+
+    const struct codec_wav* w = &deck->wav;
+    const uint32_t channels = w->channels;
+    FILE* file = fopen(deck->path, "rb");
+    struct codec_stream stream;
+    struct codec_input input;
+    memset(&input, 0, sizeof(input));
+    FILE* in = file != NULL ? flac_Open(file, &stream) : NULL;
+    char* raw = malloc((size_t)STREAM_BLOCK_FRAMES * w->block_align);
+    float* samples = malloc((size_t)STREAM_BLOCK_FRAMES * channels * sizeof(float));
+    if(in == NULL || codec_ReadHeader(in, &input) != 0 || raw == NULL || samples == NULL){
+        fprintf(stderr, "Error! unable to read %s\n", deck->path);
+    } else{
+        uint64_t skip = deck->skip;
+        for(uint64_t remaining = deck->frames; remaining > 0 && !atomic_load(&deck->stop);){
+            const uint64_t produced = atomic_load(&deck->produced);
+            if(skip == 0 && PLAYER_DECK_FRAMES - (produced - atomic_load(&deck->consumed)) < STREAM_BLOCK_FRAMES){
+                player_SleepUntil(player_Now() + PLAYER_DECK_POLL_MS / 1000.0);
+                continue;
+            }
+            uint32_t frames = remaining < STREAM_BLOCK_FRAMES ? (uint32_t)remaining : STREAM_BLOCK_FRAMES;
+            if(skip > 0 && skip < frames) frames = (uint32_t)skip;
+            const size_t got = fread(raw, w->block_align, frames, in);
+            if(got == 0) break;
+            remaining -= got;
+            if(skip > 0){
+                skip -= got;
+                continue;
+            }
+            pcm_ToFloat(raw, samples, (uint32_t)got * channels, w->format, w->bits_per_sample);
+            for(size_t i = 0; i < got; i++){
+                float* frame = deck->ring + ((produced + i) % PLAYER_DECK_FRAMES) * deck->channels;
+                if(channels == deck->channels){
+                    for(uint32_t c = 0; c < channels; c++) frame[c] = samples[i * channels + c];
+                } else if(channels == 1){
+                    frame[0] = frame[1] = samples[i];
+                } else{
+                    frame[0] = 0.5f * (samples[2 * i] + samples[2 * i + 1]);
+                }
+            }
+            atomic_store(&deck->produced, produced + got);
+        }
+    }
+    atomic_store(&deck->eof, 1);
+    free(input.prefix);
+    free(raw);
+    free(samples);
+    if(in != NULL) codec_StreamClose(&stream);
+    if(file != NULL) fclose(file);
+    return NULL;
+}
+
+/**
+ * @brief Starts the reader of a deck
+ *
+ * @returns 0 on success, -1 with an error reported
+ */
+short player_DeckStart(struct player_deck* deck){
+    deck->ring = malloc((size_t)PLAYER_DECK_FRAMES * deck->channels * sizeof(float));
+    if(deck->ring == NULL || pthread_create(&deck->thread, NULL, player_DeckReader, deck) != 0){
+        fprintf(stderr, "Error! unable to start the deck of %s\n", deck->path);
+        free(deck->ring);
+        deck->ring = NULL;
+        // a deck that cannot start plays as an empty file
+        atomic_store(&deck->ready, 1);
+        atomic_store(&deck->eof, 1);
+        deck->started = 1;
+        return -1;
+    }
+    deck->started = 1;
+    return 0;
+}
+
+/**
+ * @brief Stops the reader of a deck and releases its ring
+ */
+void player_DeckJoin(struct player_deck* deck){
+    if(!deck->started) return;
+    atomic_store(&deck->stop, 1);
+    if(deck->ring != NULL) pthread_join(deck->thread, NULL);
+    free(deck->ring);
+    deck->ring = NULL;
+    deck->started = 0;
+}
+
+/**
+ * @brief Takes up to a number of frames from the ring of a deck
+ *
+ * @param waited NULL on a real-time sink; on the virtual clock the reader is waited for, since playback runs faster
+ * than real time there, and the seconds spent waiting are added to it
+ *
+ * @returns the number of frames taken, fewer when the reader is behind or at the end of the file
+ */
+static uint32_t player_DeckPull(struct player_deck* deck, float* out, uint32_t frames, double* waited){
+    if(deck->ring == NULL) return 0;
+    const uint64_t consumed = atomic_load(&deck->consumed);
+    if(waited != NULL && atomic_load(&deck->produced) - consumed < frames && !atomic_load(&deck->eof)){
+        const double start = player_Now();
+        while(atomic_load(&deck->produced) - consumed < frames && !atomic_load(&deck->eof)) sched_yield();
+        *waited += player_Now() - start;
+    }
+    const uint64_t available = atomic_load(&deck->produced) - consumed;
+    const uint32_t n = available < frames ? (uint32_t)available : frames;
+    const uint16_t channels = deck->channels;
+    for(uint32_t i = 0; i < n; i++){
+        const float* frame = deck->ring + ((consumed + i) % PLAYER_DECK_FRAMES) * channels;
+        for(uint16_t c = 0; c < channels; c++) out[i * channels + c] = frame[c];
+    }
+    atomic_store(&deck->consumed, consumed + n);
+    return n;
+}
+
+/**
+ * @brief Returns the frames of a deck that the audio thread takes, from the first beat when it starts there
+ */
+static uint64_t player_DeckLength(const struct player_deck* deck){
+    return deck->frames > deck->skip ? deck->frames - deck->skip : 0;
+}
+
+/**
+ * @brief Places the crossfade from a deck into the next one, once the next deck is ready
+ *
+ * The crossfade ends with the outgoing deck, or with its last beat before that when both decks have beats: the
+ * incoming deck then starts at its first beat, so its beats fall on the beats of the outgoing deck at the start of the
+ * crossfade. The tempos are not matched.
+ *
+ * @param position the frames of the outgoing deck already played
+ * @param length receives the length of the crossfade in frames, 0 for a cut
+ *
+ * @returns the frame of the outgoing deck where the crossfade starts
+ */
+static uint64_t player_Transition(const struct player_deck* a, const struct player_deck* b, uint64_t position,
+                                  double xfade, uint64_t* length){
+    const uint64_t total = player_DeckLength(a);
+    const uint32_t rate = a->wav.sample_rate;
+    uint64_t frames = (uint64_t)llround(xfade * rate);
+    if(frames > total) frames = total;
+    if(frames > player_DeckLength(b)) frames = player_DeckLength(b);
+    uint64_t start = total - frames;
+    if(a->beat.bpm > 0.0 && b->beat.bpm > 0.0 && frames > 0){
+        const double period = 60.0 / a->beat.bpm * rate;
+        const double first = a->beat.first * rate - (double)a->skip;
+        const double beats = floor(((double)start - first) / period);
+        if(beats >= 0.0) start = (uint64_t)llround(first + beats * period);
+    }
+    if(start < position){
+        start = position;
+        if(frames > total - position) frames = total > position ? total - position : 0;
+    }
+    *length = frames;
+    return start;
+}
+
+/**
+ * @brief Plays the decks of a playlist one after the other to a sink, crossfading each into the next with an
+ * equal-power curve, and applying the volume, pause and quit requests of the control thread between periods
+ *
+ * The next deck starts to decode PLAYER_PREFETCH seconds before its crossfade, so by then its ring is full. A deck
+ * that has no frames ready, which cannot happen on the virtual clock, plays silence for the rest of the period. Seek
+ * requests are dropped: the decks are streams.
+ *
+ * @param decks checked decks, all at the sample rate of the sink
+ * @param xfade the length of the crossfades in seconds
+ * @param stats receives the cost of mixing every period
+ *
+ * @returns 0 on success, -1 if the sink failed
+ */
+int player_Decks(struct player_deck* decks, uint32_t count, double xfade, struct player_sink* sink,
+                 struct player_control* ctl, struct player_mix_stats* stats){
+    const uint16_t channels = decks[0].channels;
+    const uint32_t rate = sink->sample_rate;
+    const uint32_t period_frames = sink->period_frames;
+    const double budget = (double)period_frames / rate;
+    float* mix = malloc((size_t)period_frames * channels * sizeof(float));
+    float* incoming = malloc((size_t)period_frames * channels * sizeof(float));
+    char* period = malloc((size_t)period_frames * channels * sizeof(int16_t));
+    memset(stats, 0, sizeof(struct player_mix_stats));
+    if(mix == NULL || incoming == NULL || period == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free(mix);
+        free(incoming);
+        free(period);
+        return -1;
+    }
+
+    // playback starts with a full buffer, like the device
+    player_DeckStart(&decks[0]);
+    const uint64_t preload = sink->buffer_frames < player_DeckLength(&decks[0]) ? sink->buffer_frames : player_DeckLength(&decks[0]);
+    while(!atomic_load(&decks[0].eof) && atomic_load(&decks[0].produced) < preload){
+        player_SleepUntil(player_Now() + PLAYER_DECK_POLL_MS / 1000.0);
+    }
+
+    uint32_t current = 0;
+    uint64_t fade_at = UINT64_MAX;  // frame of the current deck where the crossfade starts, once it is placed
+    uint64_t fade_frames = 0;
+    float gain = player_BitsFloat(atomic_load(&ctl->gain));
+    short finished = 0;
+    int error = 0;
+    while(!finished && !atomic_load(&ctl->quit) && error == 0){
+        const double begin = player_Now();
+        double waited = 0.0;
+        double* wait = sink->type == PLAYER_SINK_VIRTUAL ? &waited : NULL;
+        struct player_deck* a = &decks[current];
+        struct player_deck* b = current + 1 < count ? &decks[current + 1] : NULL;
+        uint64_t position = atomic_load(&a->consumed);
+        const uint64_t length = player_DeckLength(a);
+        const uint64_t xfade_frames = (uint64_t)llround(xfade * rate);
+        // a crossfade on a beat can start up to a beat before the end of the deck less the crossfade
+        const uint64_t beat = a->beat.bpm > 0.0 ? (uint64_t)ceil(60.0 / a->beat.bpm * rate) : 0;
+        const uint64_t planned = length > xfade_frames + beat ? length - xfade_frames - beat : 0;
+        if(b != NULL && !b->started && position + (uint64_t)(PLAYER_PREFETCH * rate) >= planned){
+            if(current > 0) player_DeckJoin(&decks[current - 1]);
+            player_DeckStart(b);
+        }
+        if(wait != NULL && b != NULL && b->started && fade_at == UINT64_MAX && position + period_frames >= planned &&
+           !atomic_load(&b->ready)){
+            // the virtual clock runs ahead of the reader, which would otherwise be late for the crossfade
+            const double start = player_Now();
+            while(!atomic_load(&b->ready)) sched_yield();
+            waited += player_Now() - start;
+        }
+        if(b != NULL && b->started && fade_at == UINT64_MAX && atomic_load(&b->ready)){
+            fade_at = player_Transition(a, b, position, xfade, &fade_frames);
+            fprintf(stderr, "dj: %s from %.3f s of %s, crossfade %.3f s\n", b->path,
+                    (double)(fade_at + a->skip) / rate, a->path, (double)fade_frames / rate);
+            uint64_t wanted = xfade_frames < length ? xfade_frames : length;
+            if(wanted > player_DeckLength(b)) wanted = player_DeckLength(b);
+            if(fade_frames < wanted){
+                fprintf(stderr, "dj: crossfade into %s shortened by %.3f s, the deck was not ready in time\n", b->path,
+                        (double)(wanted - fade_frames) / rate);
+                stats->shortened++;
+            }
+        }
+
+        atomic_exchange(&ctl->seek, -1);
+        const float goal = atomic_load(&ctl->paused) ? 0.0f : player_BitsFloat(atomic_load(&ctl->gain));
+        if(gain == 0.0f && goal == 0.0f){
+            // paused: the device keeps playing silence
+            memset(period, 0, (size_t)period_frames * channels * sizeof(int16_t));
+            error = player_SinkWrite(sink, period, period_frames);
+            continue;
+        }
+
+        uint32_t k = 0;
+        short underflow = 0;
+        while(k < period_frames){
+            float* out = mix + (size_t)k * channels;
+            if(position < fade_at){
+                const uint64_t left = fade_at - position;
+                const uint32_t n = left < period_frames - k ? (uint32_t)left : period_frames - k;
+                const uint32_t got = player_DeckPull(a, out, n, wait);
+                position += got;
+                k += got;
+                if(got == n) continue;
+                if(!player_DeckEnded(a)){
+                    underflow = 1;
+                } else if(b == NULL){
+                    finished = 1;
+                    break;
+                } else if(atomic_load(&b->ready)){
+                    // the deck ended before its crossfade: cut to the next one
+                    atomic_store(&a->stop, 1);
+                    current++;
+                    a = b;
+                    b = current + 1 < count ? &decks[current + 1] : NULL;
+                    position = atomic_load(&a->consumed);
+                    fade_at = UINT64_MAX;
+                    continue;
+                } else{
+                    underflow = 1;
+                }
+                // the reader is behind, the rest of the period is silence
+                memset(mix + (size_t)k * channels, 0, (size_t)(period_frames - k) * channels * sizeof(float));
+                k = period_frames;
+                break;
+            }
+
+            const uint64_t left = fade_at + fade_frames - position;
+            const uint32_t n = left < period_frames - k ? (uint32_t)left : period_frames - k;
+            const uint32_t got_a = player_DeckPull(a, out, n, wait);
+            const uint32_t got_b = player_DeckPull(b, incoming, n, wait);
+            if((got_a < n && !player_DeckEnded(a)) || (got_b < n && !player_DeckEnded(b))) underflow = 1;
+            memset(out + (size_t)got_a * channels, 0, (size_t)(n - got_a) * channels * sizeof(float));
+            memset(incoming + (size_t)got_b * channels, 0, (size_t)(n - got_b) * channels * sizeof(float));
+            // cos and sin of the angle from 0 to pi/2 over the crossfade, by rotation from the start of the run
+            const double step = M_PI / 2.0 / (double)fade_frames;
+            const double angle = step * ((double)(position - fade_at) + 0.5);
+            double c = cos(angle), s = sin(angle);
+            const double cos_step = cos(step), sin_step = sin(step);
+            for(uint32_t i = 0; i < n; i++){
+                for(uint16_t ch = 0; ch < channels; ch++){
+                    const size_t at = (size_t)i * channels + ch;
+                    out[at] = (float)c * out[at] + (float)s * incoming[at];
+                }
+                const double next = c * cos_step - s * sin_step;
+                s = s * cos_step + c * sin_step;
+                c = next;
+            }
+            position += n;
+            k += n;
+            if(position >= fade_at + fade_frames){
+                atomic_store(&a->stop, 1);
+                current++;
+                a = b;
+                b = current + 1 < count ? &decks[current + 1] : NULL;
+                position = atomic_load(&a->consumed);
+                fade_at = UINT64_MAX;
+            }
+        }
+        atomic_store(&ctl->position, position);
+
+        for(uint32_t i = 0; i < k; i++){
+            const float g = gain + (goal - gain) * (float)(i + 1) / (float)k;
+            for(uint16_t ch = 0; ch < channels; ch++) mix[(size_t)i * channels + ch] *= g;
+        }
+        pcm_FromFloat(mix, period, k * channels, WAVE_FORMAT_PCM, 16);
+        gain = goal;
+
+        // the virtual clock counts the time spent waiting for a reader, the cost of the period does not
+        const double cost = player_Now() - begin - waited;
+        stats->periods++;
+        stats->total += cost;
+        if(cost > stats->max) stats->max = cost;
+        if(cost > budget) stats->late++;
+        if(underflow) stats->underflows++;
+        if(k > 0) error = player_SinkWrite(sink, period, k);
+    }
+
+    for(uint32_t d = 0; d < count; d++) player_DeckJoin(&decks[d]);
+    free(mix);
+    free(incoming);
+    free(period);
+    return error;
+}
@@ -0,0 +1,381 @@
+/**
+ * @file project.h
+ * @author Rafael Diolatzis
+ * @brief Edit decision list projects: source files and a chain of ops, rendered lazily one block at a time
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * A project is a text file with one definition per line. Empty lines and lines starting with '#' are ignored.
+ *
+ *     source <name> <file.wav>                    a WAV file, relative paths start at the directory of the project
+ *     <name> = volume <node> <gain>               gain as a factor or in dB ("0.5", "-6dB")
+ *     <name> = trim <node> <start> [<end>]        times like "1.5", "2s" or "500ms", end defaults to the end
+ *     <name> = fade <node> <in> <out> [curve]     fade lengths and a curve: lin (default), log or scurve
+ *     <name> = channel <node> <left|right|index>  keeps one channel
+ *     <name> = concat <node> <node>...            plays the nodes one after the other
+ *
+ * A node can only use nodes defined above it, so the ops form a graph without cycles. The last node is the output.
+ *
+ * Nothing is rendered when the project is loaded, only the headers of the sources are read. project_Pull() asks the
+ * output node for a range of frames and every op asks its inputs for the frames that range depends on, so rendering
+ * a few seconds of a long edit reads a few seconds of the sources, with pread() at the right offsets. Samples travel
+ * through the ops as float.
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include"utils.h"
+#include"envelope.h"
+
+#define PROJECT_SOURCE 0
+#define PROJECT_VOLUME 1
+#define PROJECT_TRIM 2
+#define PROJECT_FADE 3
+#define PROJECT_CHANNEL 4
+#define PROJECT_CONCAT 5
+
+#define PROJECT_NAME_SIZE 64
+#define PROJECT_MAX_INPUTS 64
+
+/**
+ * @brief A source file or an op of a project
+ */
+struct project_node {
+    char name[PROJECT_NAME_SIZE];
+    int type;
+    uint32_t inputs[PROJECT_MAX_INPUTS];
+    uint32_t input_count;
+
+    uint64_t frames;                // the length of the output of the node
+    uint16_t channels;
+    uint32_t sample_rate;
+
+    double gain;                    // volume
+    uint64_t start;                 // trim, the first frame of the input
+    uint32_t channel;               // channel, the channel that is kept
+    struct gain_envelope fade;      // fade, over the frames of the node
+
+    int fd;                         // source, the file and the format of its data
+    off_t data_offset;
+    struct wav_header header;
+
+    char* raw;                      // per-node scratch of STREAM_BLOCK_FRAMES frames: source data, channel input
+    float* scratch;
+    double* gains;
+};
+
+/**
+ * @brief A loaded project
+ */
+struct project {
+    struct project_node* nodes;
+    uint32_t count;
+    uint32_t output;
+};
+
+/**
+ * @brief Closes the sources of a project and releases its nodes
+ */
+void project_Free(struct project* p){
+    for(uint32_t i = 0; i < p->count; i++){
+        struct project_node* node = &p->nodes[i];
+        if(node->type == PROJECT_SOURCE && node->fd >= 0) close(node->fd);
+        free_Aligned(node->raw);
+        free_Aligned(node->scratch);
+        free_Aligned(node->gains);
+    }
+    free(p->nodes);
+    p->nodes = NULL;
+    p->count = 0;
+}
+
+/**
+ * @brief Returns the index of the node with a name, or -1 if there is none
+ */
+int64_t project_Find(const struct project* p, const char* name){
+    for(uint32_t i = p->count; i > 0; i--){
+        if(strcmp(p->nodes[i - 1].name, name) == 0) return i - 1;
+    }
+    return -1;
+}
+
+/**
+ * @brief Opens a source file and reads its header
+ *
+ * @param directory the directory of the project, prepended to relative paths
+ *
+ * @returns NULL on success or an error message
+ */
+const char* project_OpenSource(struct project_node* node, const char* directory, const char* file_name){
+    char path[4096];
+    if(file_name[0] == '/' || directory[0] == '\0') snprintf(path, sizeof(path), "%s", file_name);
+    else snprintf(path, sizeof(path), "%s/%s", directory, file_name);
+
+    FILE* file = fopen(path, "rb");
+    if(file == NULL) return "unable to open the source file";
+    short flag = 0;
+    fread_WavHeader(file, &node->header, &flag);
+    node->data_offset = ftello(file);
+    node->fd = flag ? -1 : dup(fileno(file));
+    fclose(file);
+    if(flag) return "the source is not a valid WAV file";
+    if(node->fd < 0) return "unable to open the source file";
+
+    node->frames = node->header.data_segment_size / node->header.block_align;
+    node->channels = node->header.mono_stereo;
+    node->sample_rate = node->header.sample_rate;
+    return NULL;
+}
+
+/**
+ * @brief Parses the op of a "<name> = <op> <args>" line
+ *
+ * @param words the words after the '=', words[0] is the op
+ *
+ * @returns NULL on success or an error message
+ */
+const char* project_ParseOp(struct project* p, struct project_node* node, char** words, uint32_t count){
+    if(count < 2) return "expected \"<name> = <op> <node> [args]\"";
+    if(strcmp(words[0], "concat") == 0){
+        if(count - 1 > PROJECT_MAX_INPUTS) return "too many inputs";
+        node->type = PROJECT_CONCAT;
+    }
+    else if(strcmp(words[0], "volume") == 0) node->type = PROJECT_VOLUME;
+    else if(strcmp(words[0], "trim") == 0) node->type = PROJECT_TRIM;
+    else if(strcmp(words[0], "fade") == 0) node->type = PROJECT_FADE;
+    else if(strcmp(words[0], "channel") == 0) node->type = PROJECT_CHANNEL;
+    else return "unknown op, expected volume, trim, fade, channel or concat";
+
+    node->input_count = node->type == PROJECT_CONCAT ? count - 1 : 1;
+    for(uint32_t i = 0; i < node->input_count; i++){
+        int64_t input = project_Find(p, words[1 + i]);
+        if(input < 0) return "unknown node, nodes must be defined before they are used";
+        node->inputs[i] = (uint32_t)input;
+    }
+    const struct project_node* in = &p->nodes[node->inputs[0]];
+    node->frames = in->frames;
+    node->channels = in->channels;
+    node->sample_rate = in->sample_rate;
+
+    short flag = 0;
+    if(node->type == PROJECT_VOLUME){
+        if(count != 3) return "expected \"volume <node> <gain>\"";
+        node->gain = parse_Gain(words[2], &flag);
+        if(flag) return "invalid gain";
+    }
+    else if(node->type == PROJECT_TRIM){
+        if(count != 3 && count != 4) return "expected \"trim <node> <start> [<end>]\"";
+        double start = parse_Seconds(words[2], &flag);
+        double end = count == 4 ? parse_Seconds(words[3], &flag) : -1.0;
+        if(flag) return "invalid time";
+        node->start = (uint64_t)llround(start * in->sample_rate);
+        uint64_t last = end >= 0 ? (uint64_t)llround(end * in->sample_rate) : in->frames;
+        if(last > in->frames) last = in->frames;
+        if(node->start > last) return "the trim starts after its end";
+        node->frames = last - node->start;
+    }
+    else if(node->type == PROJECT_FADE){
+        if(count != 4 && count != 5) return "expected \"fade <node> <in> <out> [curve]\"";
+        double fade_in = parse_Seconds(words[2], &flag);
+        double fade_out = parse_Seconds(words[3], &flag);
+        if(flag) return "invalid time";
+        int curve = count == 5 ? envelope_ParseCurve(words[4]) : ENVELOPE_CURVE_LINEAR;
+        if(curve < 0) return "unknown curve, expected lin, log or scurve";
+        memset(&node->fade, 0, sizeof(node->fade));
+        node->fade.total = node->frames;
+        node->fade.fade_in = (uint64_t)llround(fade_in * in->sample_rate);
+        node->fade.fade_out = (uint64_t)llround(fade_out * in->sample_rate);
+        node->fade.curve = curve;
+    }
+    else if(node->type == PROJECT_CHANNEL){
+        if(count != 3) return "expected \"channel <node> <left|right|index>\"";
+        if(strcmp(words[2], "left") == 0) node->channel = 0;
+        else if(strcmp(words[2], "right") == 0) node->channel = 1;
+        else{
+            char* end;
+            long channel = strtol(words[2], &end, 10);
+            if(*end != '\0' || channel < 0 || channel > UINT16_MAX) return "the input has no such channel";
+            node->channel = (uint32_t)channel;
+        }
+        if(node->channel >= in->channels) return "the input has no such channel";
+        node->channels = 1;
+    }
+    else{
+        node->frames = 0;
+        for(uint32_t i = 0; i < node->input_count; i++){
+            const struct project_node* part = &p->nodes[node->inputs[i]];
+            if(part->channels != in->channels || part->sample_rate != in->sample_rate){
+                return "concat needs inputs with the same channels and sample rate";
+            }
+            node->frames += part->frames;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Loads a project file. The sources are opened and their headers read, no samples are read
+ *
+ * @returns 0 on success or -1 on failure, after printing an error message
+ */
+int project_Load(struct project* p, const char* path){
+    memset(p, 0, sizeof(struct project));
+    FILE* file = fopen(path, "r");
+    if(file == NULL){
+        fprintf(stderr, "Error! unable to open %s\n", path);
+        return -1;
+    }
+    char directory[4096];
+    const char* slash = strrchr(path, '/');
+    size_t length = slash != NULL ? (size_t)(slash - path) : 0;
+    if(length >= sizeof(directory)) length = sizeof(directory) - 1;
+    memcpy(directory, path, length);
+    directory[length] = '\0';
+    if(slash == path) strcpy(directory, "/");
+
+    uint32_t capacity = 0;
+    char line[4096];
+    uint32_t number = 0;
+    const char* error = NULL;
+    while(error == NULL && fgets(line, sizeof(line), file) != NULL){
+        number++;
+        char* words[PROJECT_MAX_INPUTS + 4];
+        uint32_t count = 0;
+        for(char* word = strtok(line, " \t\r\n"); word != NULL && count < PROJECT_MAX_INPUTS + 4; word = strtok(NULL, " \t\r\n")){
+            words[count++] = word;
+        }
+        if(count == 0 || words[0][0] == '#') continue;
+
+        if(p->count == capacity){
+            capacity = capacity == 0 ? 16 : capacity * 2;
+            struct project_node* nodes = realloc(p->nodes, capacity * sizeof(struct project_node));
+            if(nodes == NULL){
+                error = "unable to allocate memory";
+                break;
+            }
+            p->nodes = nodes;
+        }
+        struct project_node* node = &p->nodes[p->count];
+        memset(node, 0, sizeof(struct project_node));
+        node->fd = -1;
+
+        if(strcmp(words[0], "source") == 0){
+            if(count != 3){
+                error = "expected \"source <name> <file.wav>\"";
+                break;
+            }
+            node->type = PROJECT_SOURCE;
+            snprintf(node->name, sizeof(node->name), "%s", words[1]);
+            error = project_OpenSource(node, directory, words[2]);
+        } else if(count >= 3 && strcmp(words[1], "=") == 0){
+            snprintf(node->name, sizeof(node->name), "%s", words[0]);
+            error = project_ParseOp(p, node, words + 2, count - 2);
+        } else{
+            error = "expected \"source <name> <file.wav>\" or \"<name> = <op> <node> [args]\"";
+        }
+        if(error == NULL || node->fd >= 0) p->count++;   // keep an opened source so it is closed
+    }
+    fclose(file);
+
+    if(error == NULL && p->count == 0) error = "the project defines no nodes";
+    for(uint32_t i = 0; error == NULL && i < p->count; i++){
+        struct project_node* node = &p->nodes[i];
+        uint32_t raw_align = node->type == PROJECT_SOURCE ? node->header.block_align : 0;
+        uint32_t scratch_channels = node->type == PROJECT_CHANNEL ? p->nodes[node->inputs[0]].channels : 0;
+        if(raw_align > 0) node->raw = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * raw_align);
+        if(scratch_channels > 0) node->scratch = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * scratch_channels * sizeof(float));
+        if(node->type == PROJECT_FADE) node->gains = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * node->channels * sizeof(double));
+        if((raw_align > 0 && node->raw == NULL) || (scratch_channels > 0 && node->scratch == NULL) ||
+           (node->type == PROJECT_FADE && node->gains == NULL)){
+            error = "unable to allocate memory";
+        }
+    }
+    if(error != NULL){
+        fprintf(stderr, "Error! %s:%" PRIu32 ": %s\n", path, number, error);
+        project_Free(p);
+        return -1;
+    }
+    p->output = p->count - 1;
+    return 0;
+}
+
+/**
+ * @brief Renders frames of a node
+ *
+ * @param index the node
+ * @param first the first frame, relative to the start of the node
+ * @param frames the number of frames, at most STREAM_BLOCK_FRAMES, the range must be inside the node
+ * @param out receives frames x channels interleaved samples
+ *
+ * @returns 0 on success, 1 if a source could not be read
+ */
+short project_Pull(struct project* p, uint32_t index, uint64_t first, uint32_t frames, float* out){
+    struct project_node* node = &p->nodes[index];
+    if(frames == 0) return 0;
+
+    if(node->type == PROJECT_SOURCE){
+        const size_t size = (size_t)frames * node->header.block_align;
+        off_t offset = node->data_offset + (off_t)first * node->header.block_align;
+        double start = stats_Begin();
+        size_t done = 0;
+        while(done < size){
+            ssize_t got = pread(node->fd, node->raw + done, size - done, offset + (off_t)done);
+            if(got <= 0) break;
+            done += (size_t)got;
+        }
+        stats_End(STATS_READ, start, done);
+        if(done < size){
+            fprintf(stderr, "Error! insufficient data in source %s\n", node->name);
+            return 1;
+        }
+        pcm_ToFloat(node->raw, out, frames * node->channels, node->header.wave_format, node->header.bits_per_sample);
+        return 0;
+    }
+    if(node->type == PROJECT_TRIM){
+        return project_Pull(p, node->inputs[0], node->start + first, frames, out);
+    }
+    if(node->type == PROJECT_VOLUME){
+        if(project_Pull(p, node->inputs[0], first, frames, out)) return 1;
+        const uint32_t count = frames * node->channels;
+        const float gain = (float)node->gain;
+        for(uint32_t i = 0; i < count; i++) out[i] *= gain;
+        return 0;
+    }
+    if(node->type == PROJECT_FADE){
+        if(project_Pull(p, node->inputs[0], first, frames, out)) return 1;
+        if(envelope_Fill(&node->fade, first, frames, node->channels, node->gains)) return 0;
+        const uint32_t count = frames * node->channels;
+        for(uint32_t i = 0; i < count; i++) out[i] = (float)(out[i] * node->gains[i]);
+        return 0;
+    }
+    if(node->type == PROJECT_CHANNEL){
+        const uint32_t channels = p->nodes[node->inputs[0]].channels;
+        if(project_Pull(p, node->inputs[0], first, frames, node->scratch)) return 1;
+        for(uint32_t i = 0; i < frames; i++) out[i] = node->scratch[(size_t)i * channels + node->channel];
+        return 0;
+    }
+
+    // concat: the range can span several inputs
+    uint64_t offset = 0;
+    uint32_t done = 0;
+    for(uint32_t i = 0; i < node->input_count && done < frames; i++){
+        const struct project_node* part = &p->nodes[node->inputs[i]];
+        uint64_t position = first + done;
+        if(position < offset + part->frames){
+            uint64_t available = offset + part->frames - position;
+            uint32_t n = available < frames - done ? (uint32_t)available : frames - done;
+            if(project_Pull(p, node->inputs[i], position - offset, n, out + (size_t)done * node->channels)) return 1;
+            done += n;
+        }
+        offset += part->frames;
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+/**
+ * @file remix.h
+ * @author Rafael Diolatzis
+ * @brief Channel remixing with a gain matrix: downmix, upmix and any N to M channel mapping
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Output channel m of a frame is the sum over the input channels n of gain[m][n] * in[n]. The matrix is written as
+ * rows of comma separated gains, one row per output channel, with rows separated by '/' or ';'. Gains are linear
+ * factors or decibels, e.g. "0.5,0.5" mixes stereo to mono and "1/1" copies mono to both channels of a stereo file.
+ *
+ * The kernel treats a frame as a vector and the matrix as a set of columns: every input sample is broadcast and
+ * multiplied with its column, and the column products add up to the whole output frame in one or two SSE registers.
+ * Stereo to mono, the common case, has its own kernel that de-interleaves four frames at a time instead.
+ */
+
+#pragma once
+
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include"utils.h"
+
+#if defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+#define REMIX_MAX_CHANNELS 8
+
+/**
+ * @brief A gain matrix
+ */
+struct remix_matrix {
+    uint16_t in_channels;
+    uint16_t out_channels;
+    float columns[REMIX_MAX_CHANNELS][REMIX_MAX_CHANNELS];     // columns[n][m], the gain of input n in output m
+};
+
+/**
+ * @brief Fills a matrix from a preset
+ *
+ * mono averages any number of channels, stereo copies mono to two channels and 5.1-stereo folds L, R, C, LFE, Ls, Rs
+ * to stereo with the ITU-R BS.775 coefficients (centre and surrounds at -3 dB, LFE dropped), scaled so that full
+ * scale on every channel does not clip.
+ *
+ * @param name the name of the preset
+ * @param channels the number of channels of the input
+ *
+ * @returns 0 on success, 1 if the name is not a preset, -1 if the preset does not apply to the input
+ */
+short remix_Preset(struct remix_matrix* mx, const char* name, uint16_t channels){
+    memset(mx, 0, sizeof(struct remix_matrix));
+    mx->in_channels = channels;
+    if(strcmp(name, "mono") == 0){
+        mx->out_channels = 1;
+        for(uint16_t n = 0; n < channels; n++) mx->columns[n][0] = 1.0f / channels;
+        return 0;
+    }
+    if(strcmp(name, "stereo") == 0){
+        if(channels != 1) return -1;
+        mx->out_channels = 2;
+        mx->columns[0][0] = mx->columns[0][1] = 1.0f;
+        return 0;
+    }
+    if(strcmp(name, "5.1-stereo") == 0){
+        if(channels != 6) return -1;
+        const float side = (float)M_SQRT1_2;
+        const float scale = 1.0f / (1.0f + 2.0f * side);
+        mx->out_channels = 2;
+        mx->columns[0][0] = scale;
+        mx->columns[1][1] = scale;
+        mx->columns[2][0] = mx->columns[2][1] = side * scale;
+        mx->columns[4][0] = side * scale;
+        mx->columns[5][1] = side * scale;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Parses a matrix written as rows of gains, e.g. "1,0,0.7/0,1,0.7" for 3 input and 2 output channels
+ *
+ * @returns 0 on success, -1 if the text is not a valid matrix or its rows have different lengths
+ */
+short remix_ParseMatrix(struct remix_matrix* mx, const char* text){
+    memset(mx, 0, sizeof(struct remix_matrix));
+    char gain[64];
+    uint16_t row = 0, column = 0;
+    for(const char* p = text;; p++){
+        size_t length = strcspn(p, ",/;");
+        if(length == 0 || length >= sizeof(gain) || row >= REMIX_MAX_CHANNELS || column >= REMIX_MAX_CHANNELS) return -1;
+        memcpy(gain, p, length);
+        gain[length] = '\0';
+        short flag = 0;
+        mx->columns[column][row] = (float)parse_Gain(gain, &flag);
+        if(flag) return -1;
+        column++;
+        p += length;
+        if(*p == ','){
+            continue;
+        }
+        // the end of a row
+        if(row == 0) mx->in_channels = column;
+        else if(column != mx->in_channels) return -1;
+        column = 0;
+        row++;
+        if(*p == '\0') break;
+    }
+    mx->out_channels = row;
+    return 0;
+}
+
+/**
+ * @brief Remixes interleaved float frames
+ *
+ * @param in frames x in_channels samples
+ * @param out receives frames x out_channels samples, must not overlap `in`
+ */
+void remix_Apply(const struct remix_matrix* mx, const float* in, float* out, uint32_t frames){
+    const uint32_t in_channels = mx->in_channels;
+    const uint32_t out_channels = mx->out_channels;
+    uint32_t f = 0;
+#if defined(__SSE2__)
+    if(in_channels == 2 && out_channels == 1){
+        const __m128 left = _mm_set1_ps(mx->columns[0][0]);
+        const __m128 right = _mm_set1_ps(mx->columns[1][0]);
+        for(; f + 4 <= frames; f += 4){
+            __m128 a = _mm_loadu_ps(in + 2*f);
+            __m128 b = _mm_loadu_ps(in + 2*f + 4);
+            __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(out + f, _mm_add_ps(_mm_mul_ps(l, left), _mm_mul_ps(r, right)));
+        }
+    } else{
+        __m128 lo[REMIX_MAX_CHANNELS], hi[REMIX_MAX_CHANNELS];
+        for(uint32_t n = 0; n < in_channels; n++){
+            lo[n] = _mm_loadu_ps(mx->columns[n]);
+            hi[n] = _mm_loadu_ps(mx->columns[n] + 4);
+        }
+        // every store writes 4 or 8 floats, the next frame overwrites what lies past this one
+        const uint32_t width = out_channels <= 4 ? 4 : 8;
+        for(; f < frames && f * out_channels + width <= frames * out_channels; f++){
+            const float* frame = in + (size_t)f * in_channels;
+            __m128 a = _mm_mul_ps(_mm_set1_ps(frame[0]), lo[0]);
+            for(uint32_t n = 1; n < in_channels; n++) a = _mm_add_ps(a, _mm_mul_ps(_mm_set1_ps(frame[n]), lo[n]));
+            _mm_storeu_ps(out + (size_t)f * out_channels, a);
+            if(width == 8){
+                __m128 b = _mm_mul_ps(_mm_set1_ps(frame[0]), hi[0]);
+                for(uint32_t n = 1; n < in_channels; n++) b = _mm_add_ps(b, _mm_mul_ps(_mm_set1_ps(frame[n]), hi[n]));
+                _mm_storeu_ps(out + (size_t)f * out_channels + 4, b);
+            }
+        }
+    }
+#endif
+    for(; f < frames; f++){
+        const float* frame = in + (size_t)f * in_channels;
+        for(uint32_t m = 0; m < out_channels; m++){
+            float sum = frame[0] * mx->columns[0][m];
+            for(uint32_t n = 1; n < in_channels; n++) sum += frame[n] * mx->columns[n][m];
+            out[(size_t)f * out_channels + m] = sum;
+        }
+    }
+}
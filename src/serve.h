@@ -0,0 +1,805 @@
+/**
+ * @file serve.h
+ * @author Rafael Diolatzis
+ * @brief A long-running server that runs soundwave commands sent over a UNIX socket, and its client
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * The commands read STDIN and write STDOUT, which are shared by every thread of a process, so the worker pool is a
+ * set of processes forked once when the server starts. A worker points its file descriptors 0, 1 and 2 at the files
+ * of a job with dup2(), runs the command in-process and points them back at /dev/null, so a job costs no fork, exec
+ * or pipe setup, and a worker keeps its heap (and the blocks that the allocator already mapped) from job to job.
+ *
+ * The server process only moves messages: it accepts clients, queues their jobs, hands them to idle workers and
+ * keeps the counters. Messages are SOCK_SEQPACKET packets, so every request and reply is exactly one packet.
+ *
+ * A request is a list of NUL-terminated fields. "stats" asks for the counters. A job is "run", followed by optional
+ * "in=<path>", "out=<path>", "err=<path>" and "fds=<letters>" fields, then "--" and the command line, e.g.
+ * "run\0fds=io\0--\0volume\00.5\0". The letters of "fds" tell which of the descriptors passed with the packet
+ * (SCM_RIGHTS) are the input (i), the output (o) and the error output (e), in order. The reply to a job is
+ * "ok <exit status> <queue time in us> <run time in us>" or "error <reason>".
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdio_ext.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<inttypes.h>
+#include<string.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<poll.h>
+#include<signal.h>
+#include<dirent.h>
+#include<time.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<sys/wait.h>
+
+#define SERVE_MAX_MESSAGE 65536
+#define SERVE_MAX_FDS 3
+#define SERVE_MAX_CLIENTS 1024
+#define SERVE_MAX_QUEUE 4096
+#define SERVE_MAX_WORKERS 256
+#define SERVE_HISTOGRAM 32
+
+/**
+ * @brief Runs one command line, the same way as main() does
+ */
+typedef int (*serve_Runner)(int argc, char* argv[]);
+
+/**
+ * @brief A job waiting for a worker or running on one
+ */
+struct serve_job {
+    int client;                 // the connection that receives the reply
+    int fds[SERVE_MAX_FDS];
+    int count;                  // number of descriptors in fds
+    char* request;
+    size_t length;
+    uint64_t queued;            // time the job was received, in us
+    uint64_t started;           // time the job was handed to a worker, in us
+};
+
+/**
+ * @brief A worker process
+ */
+struct serve_worker {
+    pid_t pid;
+    int fd;                     // the server end of the socket pair
+    short busy;
+    struct serve_job job;
+};
+
+/**
+ * @brief The counters reported by a stats request
+ */
+struct serve_stats {
+    uint64_t started;           // time the server started, in us
+    uint64_t completed;
+    uint64_t failed;            // jobs whose command returned a non-zero status
+    uint64_t rejected;          // jobs refused because the queue was full or a worker died
+    uint64_t queue_max;
+    uint64_t latency_total;     // queue + run time of all completed jobs, in us
+    uint64_t latency_max;
+    uint64_t wait_total;
+    uint64_t run_total;
+    uint64_t histogram[SERVE_HISTOGRAM];    // completed jobs by floor(log2(latency in us))
+};
+
+static volatile sig_atomic_t serve_stop = 0;
+
+/**
+ * @brief Returns a monotonic time in microseconds
+ */
+uint64_t serve_Now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void serve_OnSignal(int signal){
+    (void)signal;
+    serve_stop = 1;
+}
+
+/**
+ * @brief Sends one packet with up to SERVE_MAX_FDS descriptors
+ *
+ * @returns 0 on success or -1 on failure
+ */
+int serve_Send(int socket, const char* data, size_t length, const int* fds, int count){
+    struct iovec iov = {(void*)data, length};
+    union {
+        char buffer[CMSG_SPACE(SERVE_MAX_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    if(count > 0){
+        memset(&control, 0, sizeof(control));
+        message.msg_control = control.buffer;
+        message.msg_controllen = CMSG_SPACE(count * sizeof(int));
+        struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(count * sizeof(int));
+        memcpy(CMSG_DATA(header), fds, count * sizeof(int));
+    }
+    ssize_t sent;
+    do{
+        sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+    } while(sent < 0 && errno == EINTR);
+    return sent == (ssize_t)length ? 0 : -1;
+}
+
+/**
+ * @brief Receives one packet and the descriptors that came with it
+ *
+ * @param socket the socket
+ * @param data receives the packet, which is NUL-terminated
+ * @param capacity the size of data
+ * @param fds receives up to SERVE_MAX_FDS descriptors, extra ones are closed
+ * @param count receives the number of descriptors
+ *
+ * @returns the length of the packet, 0 if the peer closed the connection or -1 on failure
+ */
+ssize_t serve_Receive(int socket, char* data, size_t capacity, int* fds, int* count){
+    struct iovec iov = {data, capacity - 1};
+    union {
+        char buffer[CMSG_SPACE(8 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    *count = 0;
+    ssize_t length;
+    do{
+        length = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+    } while(length < 0 && errno == EINTR);
+    if(length < 0) return -1;
+    data[length] = '\0';
+
+    for(struct cmsghdr* header = CMSG_FIRSTHDR(&message); header != NULL; header = CMSG_NXTHDR(&message, header)){
+        if(header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) continue;
+        int received = (int)((header->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        int* passed = (int*)CMSG_DATA(header);
+        for(int i = 0; i < received; i++){
+            int fd;
+            memcpy(&fd, passed + i, sizeof(int));
+            if(*count < SERVE_MAX_FDS) fds[(*count)++] = fd;
+            else close(fd);
+        }
+    }
+    if(length > 0 && (message.msg_flags & MSG_TRUNC)){
+        for(int i = 0; i < *count; i++) close(fds[i]);
+        *count = 0;
+        errno = EMSGSIZE;
+        return -1;
+    }
+    return length;
+}
+
+/**
+ * @brief Splits a packet into its NUL-terminated fields
+ *
+ * @returns the number of fields, at most `capacity`
+ */
+int serve_Fields(char* data, size_t length, char** fields, int capacity){
+    int count = 0;
+    size_t start = 0;
+    for(size_t i = 0; i < length && count < capacity; i++){
+        if(data[i] == '\0'){
+            fields[count++] = data + start;
+            start = i + 1;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Runs the jobs handed over by the server until the server closes the socket
+ *
+ * @param socket the worker end of the socket pair
+ * @param run the function that runs a command line
+ */
+void serve_Worker(int socket, serve_Runner run){
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGPIPE, SIG_IGN);
+    int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    int error_fd = fcntl(2, F_DUPFD_CLOEXEC, 3);
+    dup2(null_fd, 0);
+    dup2(null_fd, 1);
+
+    char* data = malloc(SERVE_MAX_MESSAGE);
+    char** fields = malloc((SERVE_MAX_MESSAGE / 2 + 2) * sizeof(char*));
+    char** argv = malloc((SERVE_MAX_MESSAGE / 2 + 2) * sizeof(char*));
+    if(data == NULL || fields == NULL || argv == NULL || null_fd < 0 || error_fd < 0){
+        free(data);
+        free(fields);
+        free(argv);
+        return;
+    }
+
+    for(;;){
+        int fds[SERVE_MAX_FDS], count;
+        ssize_t length = serve_Receive(socket, data, SERVE_MAX_MESSAGE, fds, &count);
+        if(length <= 0) break;
+
+        int total = serve_Fields(data, (size_t)length, fields, SERVE_MAX_MESSAGE / 2);
+        int io[3] = {-1, -1, -1};
+        int opened[3] = {0, 0, 0};
+        int next_fd = 0;
+        int first = total;
+        const char* problem = NULL;
+        for(int i = 1; i < total; i++){
+            if(strcmp(fields[i], "--") == 0){
+                first = i + 1;
+                break;
+            }
+            int which = strncmp(fields[i], "in=", 3) == 0 ? 0 : (strncmp(fields[i], "out=", 4) == 0 ? 1 : (strncmp(fields[i], "err=", 4) == 0 ? 2 : -1));
+            if(which >= 0){
+                const char* path = strchr(fields[i], '=') + 1;
+                if(io[which] >= 0 && opened[which]) close(io[which]);
+                // outputs are truncated after the job instead of with O_TRUNC, because ext4 flushes a file that was
+                // truncated to zero and rewritten when it is closed, which costs more than the job itself
+                io[which] = which == 0 ? open(path, O_RDONLY | O_CLOEXEC) : open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+                opened[which] = 1;
+                if(io[which] < 0) problem = "unable to open a file of the job";
+            } else if(strncmp(fields[i], "fds=", 4) == 0){
+                for(const char* c = fields[i] + 4; *c != '\0' && next_fd < count; c++){
+                    int slot = *c == 'i' ? 0 : (*c == 'o' ? 1 : (*c == 'e' ? 2 : -1));
+                    if(slot >= 0 && io[slot] < 0) io[slot] = fds[next_fd];
+                    next_fd++;
+                }
+            }
+        }
+        if(first >= total && problem == NULL) problem = "no command";
+        if(problem == NULL && (strcmp(fields[first], "serve") == 0 || strcmp(fields[first], "client") == 0)){
+            problem = "serve and client can not run as jobs";
+        }
+
+        char reply[128];
+        if(problem != NULL){
+            snprintf(reply, sizeof(reply), "error %s", problem);
+        } else{
+            // anything left in the stdio buffers belongs to the previous job
+            __fpurge(stdin);
+            clearerr(stdin);
+            clearerr(stdout);
+            dup2(io[0] >= 0 ? io[0] : null_fd, 0);
+            dup2(io[1] >= 0 ? io[1] : null_fd, 1);
+            dup2(io[2] >= 0 ? io[2] : error_fd, 2);
+            // stdin still caches the offset of the previous job, which ftello() would return for a seekable file
+            off_t position = lseek(0, 0, SEEK_CUR);
+            if(position >= 0) fseeko(stdin, position, SEEK_SET);
+
+            int argc = 0;
+            argv[argc++] = "soundwave";
+            for(int i = first; i < total; i++) argv[argc++] = fields[i];
+            argv[argc] = NULL;
+
+            errno = 0;
+            uint64_t start = serve_Now();
+            int status = run(argc, argv);
+            fflush(stdout);
+            fflush(stderr);
+            uint64_t elapsed = serve_Now() - start;
+
+            dup2(null_fd, 0);
+            dup2(null_fd, 1);
+            dup2(error_fd, 2);
+            __fpurge(stdin);
+            clearerr(stdin);
+            clearerr(stdout);
+            snprintf(reply, sizeof(reply), "%d %" PRIu64, status, elapsed);
+        }
+
+        for(int i = 0; i < 3; i++){
+            if(!opened[i] || io[i] < 0) continue;
+            off_t end = lseek(io[i], 0, SEEK_CUR);
+            if(i > 0 && end >= 0 && ftruncate(io[i], end) != 0) fprintf(stderr, "Warning: unable to truncate an output of a job\n");
+            close(io[i]);
+        }
+        for(int i = 0; i < count; i++) close(fds[i]);
+        if(serve_Send(socket, reply, strlen(reply) + 1, NULL, 0) != 0) break;
+    }
+    free(data);
+    free(fields);
+    free(argv);
+}
+
+/**
+ * @brief Closes every descriptor above 2 except `keep`
+ */
+void serve_CloseAllBut(int keep){
+    DIR* directory = opendir("/proc/self/fd");
+    if(directory == NULL){
+        for(int fd = 3; fd < 1024; fd++){
+            if(fd != keep) close(fd);
+        }
+        return;
+    }
+    int own = dirfd(directory);
+    struct dirent* entry;
+    while((entry = readdir(directory)) != NULL){
+        int fd = atoi(entry->d_name);
+        if(entry->d_name[0] != '.' && fd > 2 && fd != keep && fd != own) close(fd);
+    }
+    closedir(directory);
+}
+
+/**
+ * @brief Forks a worker process
+ *
+ * @param worker receives the pid and the server end of the socket pair
+ * @param run the function that runs a command line
+ *
+ * @returns 0 on success or -1 on failure
+ */
+int serve_Spawn(struct serve_worker* worker, serve_Runner run){
+    int pair[2];
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) != 0) return -1;
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if(pid < 0){
+        close(pair[0]);
+        close(pair[1]);
+        return -1;
+    }
+    if(pid == 0){
+        // a worker must not keep the sockets of the other workers, of the clients or the files of queued jobs open
+        serve_CloseAllBut(pair[1]);
+        serve_Worker(pair[1], run);
+        _exit(0);
+    }
+    close(pair[1]);
+    worker->pid = pid;
+    worker->fd = pair[0];
+    worker->busy = 0;
+    return 0;
+}
+
+/**
+ * @brief Returns an upper bound of a percentile of the latency histogram, in us
+ */
+uint64_t serve_Percentile(const struct serve_stats* stats, double percentile){
+    if(stats->completed == 0) return 0;
+    uint64_t target = (uint64_t)ceil(stats->completed * percentile);
+    uint64_t seen = 0;
+    for(int i = 0; i < SERVE_HISTOGRAM; i++){
+        seen += stats->histogram[i];
+        if(seen >= target){
+            uint64_t bound = (2ull << i) - 1;
+            return bound < stats->latency_max ? bound : stats->latency_max;
+        }
+    }
+    return stats->latency_max;
+}
+
+/**
+ * @brief Formats the counters of the server as "name value" lines
+ */
+void serve_FormatStats(const struct serve_stats* stats, uint32_t workers, uint32_t busy, uint32_t queued, char* out, size_t size){
+    uint64_t n = stats->completed > 0 ? stats->completed : 1;
+    snprintf(out, size,
+             "workers %" PRIu32 "\nbusy %" PRIu32 "\nqueue_depth %" PRIu32 "\nqueue_max %" PRIu64 "\n"
+             "completed %" PRIu64 "\nfailed %" PRIu64 "\nrejected %" PRIu64 "\n"
+             "latency_avg_us %" PRIu64 "\nlatency_p50_us %" PRIu64 "\nlatency_p99_us %" PRIu64 "\nlatency_max_us %" PRIu64 "\n"
+             "wait_avg_us %" PRIu64 "\nrun_avg_us %" PRIu64 "\nuptime_s %" PRIu64 "\n",
+             workers, busy, queued, stats->queue_max, stats->completed, stats->failed, stats->rejected,
+             stats->latency_total / n, serve_Percentile(stats, 0.5), serve_Percentile(stats, 0.99), stats->latency_max,
+             stats->wait_total / n, stats->run_total / n, (serve_Now() - stats->started) / 1000000u);
+}
+
+/**
+ * @brief Releases the descriptors and request of a job
+ */
+void serve_DropJob(struct serve_job* job){
+    for(int i = 0; i < job->count; i++) close(job->fds[i]);
+    job->count = 0;
+    free(job->request);
+    job->request = NULL;
+}
+
+/**
+ * @brief Serves jobs on a UNIX socket until SIGINT or SIGTERM
+ *
+ * @param path the path of the socket, replaced if it exists
+ * @param workers the number of worker processes
+ * @param run the function that runs a command line
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void serve_command(const char* path, int workers, serve_Runner run, short* flag){
+    *flag = 1;
+    if(workers < 1) workers = 1;
+    if(workers > SERVE_MAX_WORKERS) workers = SERVE_MAX_WORKERS;
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(address.sun_path)){
+        fprintf(stderr, "Error! the socket path is too long\n");
+        return;
+    }
+    strcpy(address.sun_path, path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if(listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listen_fd, 128) != 0){
+        fprintf(stderr, "Error! unable to listen on %s: %s\n", path, strerror(errno));
+        if(listen_fd >= 0) close(listen_fd);
+        return;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, serve_OnSignal);
+    signal(SIGTERM, serve_OnSignal);
+
+    struct serve_worker* pool = calloc(workers, sizeof(struct serve_worker));
+    struct serve_job* queue = calloc(SERVE_MAX_QUEUE, sizeof(struct serve_job));
+    int* clients = malloc(SERVE_MAX_CLIENTS * sizeof(int));
+    short* waiting = calloc(SERVE_MAX_CLIENTS, sizeof(short));     // 1 while a job of the client is queued or running
+    struct pollfd* polled = malloc((1 + workers + SERVE_MAX_CLIENTS) * sizeof(struct pollfd));
+    char* data = malloc(SERVE_MAX_MESSAGE);
+    if(pool == NULL || queue == NULL || clients == NULL || waiting == NULL || polled == NULL || data == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free(pool); free(queue); free(clients); free(waiting); free(polled); free(data);
+        close(listen_fd);
+        unlink(path);
+        return;
+    }
+    for(int i = 0; i < workers; i++){
+        if(serve_Spawn(&pool[i], run) != 0){
+            fprintf(stderr, "Error! unable to start a worker: %s\n", strerror(errno));
+            pool[i].fd = -1;
+        }
+    }
+
+    struct serve_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.started = serve_Now();
+    uint32_t head = 0, queued = 0, client_count = 0;
+    fprintf(stderr, "soundwave: serving on %s with %d workers\n", path, workers);
+
+    while(!serve_stop){
+        // hand queued jobs to idle workers
+        for(int w = 0; w < workers && queued > 0; w++){
+            if(pool[w].busy || pool[w].fd < 0) continue;
+            struct serve_job* job = &queue[head];
+            if(serve_Send(pool[w].fd, job->request, job->length, job->fds, job->count) != 0) continue;
+            for(int i = 0; i < job->count; i++) close(job->fds[i]);
+            job->count = 0;
+            job->started = serve_Now();
+            pool[w].job = *job;
+            pool[w].busy = 1;
+            head = (head + 1) % SERVE_MAX_QUEUE;
+            queued--;
+        }
+
+        nfds_t n = 0;
+        polled[n].fd = listen_fd;
+        polled[n++].events = POLLIN;
+        for(int w = 0; w < workers; w++){
+            polled[n].fd = pool[w].fd;
+            polled[n++].events = POLLIN;
+        }
+        for(uint32_t c = 0; c < client_count; c++){
+            polled[n].fd = waiting[c] ? -1 : clients[c];
+            polled[n++].events = POLLIN;
+        }
+        if(poll(polled, n, -1) < 0){
+            if(errno == EINTR) continue;
+            fprintf(stderr, "Error! poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        // replies of the workers
+        for(int w = 0; w < workers; w++){
+            short events = polled[1 + w].revents;
+            if(events == 0 || pool[w].fd < 0) continue;
+            int fds[SERVE_MAX_FDS], count;
+            ssize_t length = (events & POLLIN) ? serve_Receive(pool[w].fd, data, SERVE_MAX_MESSAGE, fds, &count) : 0;
+            for(int i = 0; length > 0 && i < count; i++) close(fds[i]);
+
+            struct serve_job* job = &pool[w].job;
+            char reply[160];
+            if(length <= 0){
+                // the worker died, most likely in the command of its job
+                close(pool[w].fd);
+                waitpid(pool[w].pid, NULL, 0);
+                pool[w].fd = -1;
+                if(serve_Spawn(&pool[w], run) != 0) pool[w].fd = -1;
+                if(!pool[w].busy) continue;
+                stats.rejected++;
+                snprintf(reply, sizeof(reply), "error the worker exited while running the job");
+            } else if(strncmp(data, "error", 5) == 0){
+                stats.rejected++;
+                snprintf(reply, sizeof(reply), "%s", data);
+            } else{
+                int status = 0;
+                uint64_t run_us = 0;
+                sscanf(data, "%d %" SCNu64, &status, &run_us);
+                uint64_t now = serve_Now();
+                uint64_t latency = now - job->queued;
+                uint64_t wait = job->started - job->queued;
+                stats.completed++;
+                if(status != 0) stats.failed++;
+                stats.latency_total += latency;
+                stats.wait_total += wait;
+                stats.run_total += run_us;
+                if(latency > stats.latency_max) stats.latency_max = latency;
+                int bucket = 0;
+                while(bucket + 1 < SERVE_HISTOGRAM && (latency >> (bucket + 1)) > 0) bucket++;
+                stats.histogram[bucket]++;
+                snprintf(reply, sizeof(reply), "ok %d %" PRIu64 " %" PRIu64, status, wait, run_us);
+            }
+            pool[w].busy = 0;
+            for(uint32_t c = 0; c < client_count; c++){
+                if(clients[c] == job->client){
+                    waiting[c] = 0;
+                    serve_Send(job->client, reply, strlen(reply) + 1, NULL, 0);
+                    break;
+                }
+            }
+            serve_DropJob(job);
+        }
+
+        // requests of the clients, and clients that hung up
+        for(uint32_t c = 0; c < client_count; c++){
+            short events = polled[1 + workers + c].revents;
+            if(events == 0 || waiting[c]) continue;
+            int fds[SERVE_MAX_FDS], count = 0;
+            ssize_t length = (events & POLLIN) ? serve_Receive(clients[c], data, SERVE_MAX_MESSAGE, fds, &count) : 0;
+            if(length <= 0){
+                close(clients[c]);
+                clients[c] = -1;
+                continue;
+            }
+
+            if(strcmp(data, "stats") == 0){
+                char text[1024];
+                uint32_t busy = 0;
+                for(int w = 0; w < workers; w++) busy += pool[w].busy;
+                serve_FormatStats(&stats, (uint32_t)workers, busy, queued, text, sizeof(text));
+                serve_Send(clients[c], text, strlen(text) + 1, NULL, 0);
+                for(int i = 0; i < count; i++) close(fds[i]);
+            } else if(strcmp(data, "run") != 0 || queued == SERVE_MAX_QUEUE){
+                const char* reply = queued == SERVE_MAX_QUEUE ? "error the queue is full" : "error unknown request";
+                if(queued == SERVE_MAX_QUEUE) stats.rejected++;
+                serve_Send(clients[c], reply, strlen(reply) + 1, NULL, 0);
+                for(int i = 0; i < count; i++) close(fds[i]);
+            } else{
+                struct serve_job* job = &queue[(head + queued) % SERVE_MAX_QUEUE];
+                job->request = malloc((size_t)length);
+                if(job->request == NULL){
+                    serve_Send(clients[c], "error out of memory", 20, NULL, 0);
+                    for(int i = 0; i < count; i++) close(fds[i]);
+                    continue;
+                }
+                memcpy(job->request, data, (size_t)length);
+                job->length = (size_t)length;
+                memcpy(job->fds, fds, count * sizeof(int));
+                job->count = count;
+                job->client = clients[c];
+                job->queued = serve_Now();
+                waiting[c] = 1;
+                queued++;
+                if(queued > stats.queue_max) stats.queue_max = queued;
+            }
+        }
+
+        // forget the clients that hung up
+        uint32_t kept = 0;
+        for(uint32_t c = 0; c < client_count; c++){
+            if(clients[c] < 0) continue;
+            clients[kept] = clients[c];
+            waiting[kept++] = waiting[c];
+        }
+        client_count = kept;
+
+        if(polled[0].revents & POLLIN){
+            int client = accept(listen_fd, NULL, NULL);
+            if(client >= 0 && client_count < SERVE_MAX_CLIENTS){
+                clients[client_count] = client;
+                waiting[client_count++] = 0;
+            } else if(client >= 0){
+                close(client);
+            }
+        }
+    }
+
+    for(int w = 0; w < workers; w++){
+        if(pool[w].fd < 0) continue;
+        close(pool[w].fd);
+        waitpid(pool[w].pid, NULL, 0);
+        if(pool[w].busy) serve_DropJob(&pool[w].job);
+    }
+    for(uint32_t i = 0; i < queued; i++) serve_DropJob(&queue[(head + i) % SERVE_MAX_QUEUE]);
+    for(uint32_t c = 0; c < client_count; c++) close(clients[c]);
+    close(listen_fd);
+    unlink(path);
+    free(pool); free(queue); free(clients); free(waiting); free(polled); free(data);
+    *flag = 0;
+}
+
+/**
+ * @brief Connects to a server
+ *
+ * @returns the socket or -1 on failure, after printing an error message
+ */
+int serve_Connect(const char* path){
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(address.sun_path)){
+        fprintf(stderr, "Error! the socket path is too long\n");
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0){
+        fprintf(stderr, "Error! unable to connect to %s: %s\n", path, strerror(errno));
+        if(fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Appends a field to a request
+ *
+ * @returns 0 on success or -1 if the request would be larger than SERVE_MAX_MESSAGE
+ */
+int serve_AddField(char* request, size_t* length, const char* prefix, const char* value){
+    size_t a = strlen(prefix), b = strlen(value);
+    if(*length + a + b + 1 > SERVE_MAX_MESSAGE) return -1;
+    memcpy(request + *length, prefix, a);
+    memcpy(request + *length + a, value, b + 1);
+    *length += a + b + 1;
+    return 0;
+}
+
+/**
+ * @brief Makes a relative path absolute, since the server resolves paths from its own working directory
+ */
+void serve_AbsolutePath(const char* path, char* out, size_t size){
+    if(path[0] == '/' || getcwd(out, size) == NULL){
+        snprintf(out, size, "%s", path);
+        return;
+    }
+    size_t used = strlen(out);
+    snprintf(out + used, size - used, "/%s", path);
+}
+
+/**
+ * @brief Sends a job or a stats request to a server and waits for the reply
+ *
+ * Without --in and --out the job reads and writes the STDIN and STDOUT of the client, which are passed to the
+ * server with the request, so `soundwave client --socket s volume 0.5 < in.wav > out.wav` behaves like
+ * `soundwave volume 0.5 < in.wav > out.wav`.
+ *
+ * @param path the path of the socket
+ * @param in the input file of the job, NULL for the STDIN of the client
+ * @param out the output file of the job, NULL for the STDOUT of the client
+ * @param repeat how many times the job is sent, one after the other. More than one needs `in`
+ * @param argc the number of words of the command line of the job
+ * @param argv the command line of the job, or "stats"
+ *
+ * @returns the exit status of the job, or 1 if it could not run
+ */
+int client_command(const char* path, const char* in, const char* out, uint32_t repeat, int argc, char* argv[]){
+    if(argc < 1){
+        fprintf(stderr, "Error! no command for the server\n");
+        return 1;
+    }
+    if(repeat > 1 && in == NULL && strcmp(argv[0], "stats") != 0){
+        fprintf(stderr, "Error! --repeat needs --in\n");
+        return 1;
+    }
+
+    char* request = malloc(SERVE_MAX_MESSAGE);
+    char* reply = malloc(SERVE_MAX_MESSAGE);
+    if(request == NULL || reply == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free(request);
+        free(reply);
+        return 1;
+    }
+
+    size_t length = 0;
+    int fds[SERVE_MAX_FDS], count = 0;
+    char letters[8] = "";
+    short problem = 0;
+    if(strcmp(argv[0], "stats") == 0){
+        problem |= serve_AddField(request, &length, "", "stats");
+    } else{
+        char absolute[4096];
+        problem |= serve_AddField(request, &length, "", "run");
+        if(in != NULL){
+            serve_AbsolutePath(in, absolute, sizeof(absolute));
+            problem |= serve_AddField(request, &length, "in=", absolute);
+        } else{
+            fds[count++] = 0;
+            strcat(letters, "i");
+        }
+        if(out != NULL){
+            serve_AbsolutePath(out, absolute, sizeof(absolute));
+            problem |= serve_AddField(request, &length, "out=", absolute);
+        } else{
+            fds[count++] = 1;
+            strcat(letters, "o");
+        }
+        fds[count++] = 2;
+        strcat(letters, "e");
+        problem |= serve_AddField(request, &length, "fds=", letters);
+        problem |= serve_AddField(request, &length, "", "--");
+        for(int i = 0; i < argc; i++) problem |= serve_AddField(request, &length, "", argv[i]);
+    }
+    if(problem){
+        fprintf(stderr, "Error! the command line is too long\n");
+        free(request);
+        free(reply);
+        return 1;
+    }
+
+    int socket = serve_Connect(path);
+    if(socket < 0){
+        free(request);
+        free(reply);
+        return 1;
+    }
+
+    int status = 0;
+    uint64_t start = serve_Now(), latency_max = 0;
+    // the jobs that got a reply, the loop stops at the first one that fails
+    uint32_t sent_count = 0, failed = 0;
+    for(uint32_t r = 0; r < repeat && status == 0; r++){
+        uint64_t sent = serve_Now();
+        int received_fds[SERVE_MAX_FDS], received = 0;
+        if(serve_Send(socket, request, length, fds, count) != 0 ||
+           serve_Receive(socket, reply, SERVE_MAX_MESSAGE, received_fds, &received) <= 0){
+            fprintf(stderr, "Error! the server closed the connection\n");
+            status = 1;
+            break;
+        }
+        for(int i = 0; i < received; i++) close(received_fds[i]);
+        sent_count++;
+        uint64_t latency = serve_Now() - sent;
+        if(latency > latency_max) latency_max = latency;
+
+        if(strcmp(argv[0], "stats") == 0){
+            fputs(reply, stdout);
+        } else if(strncmp(reply, "ok ", 3) == 0){
+            status = atoi(reply + 3);
+        } else{
+            fprintf(stderr, "Error! %s\n", strncmp(reply, "error ", 6) == 0 ? reply + 6 : reply);
+            status = 1;
+        }
+        if(status != 0) failed++;
+    }
+    if(repeat > 1 && sent_count > 0){
+        double seconds = (serve_Now() - start) / 1e6;
+        fprintf(stderr, "%" PRIu32 " of %" PRIu32 " requests in %.3f s, %" PRIu32 " failed, %.0f requests/s, latency avg %.0f us, max %" PRIu64 " us\n",
+                sent_count, repeat, seconds, failed, sent_count / seconds, seconds * 1e6 / sent_count, latency_max);
+    }
+
+    close(socket);
+    free(request);
+    free(reply);
+    return status;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file silence.h
+ * @author Rafael Diolatzis
+ * @brief Detection of silent regions with an early-exit SIMD abs-max
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * The data is cut into windows of SILENCE_WINDOW_MS milliseconds. A window is silent when the absolute value of every
+ * sample of every channel is at most the threshold. Most windows of speech or music are loud and the first loud
+ * sample is usually near the start of the window, so the abs-max is computed one cache line at a time and the scan
+ * stops as soon as a line exceeds the threshold. 16 bit data is scanned in place, other formats are converted to
+ * float first.
+ *
+ * Only the loud windows at the edges of a silent region are scanned again, frame by frame, so that the region starts
+ * right after the last loud sample and ends right before the next one. Every mode then cuts at the same sample, however
+ * its windows are aligned.
+ */
+
+#pragma once
+
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include"utils.h"
+
+#if defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+#define SILENCE_WINDOW_MS 10
+
+#define SILENCE_REPORT 0
+#define SILENCE_TRIM 1
+#define SILENCE_SPLIT 2
+
+/**
+ * @brief Parses the name of a silence mode
+ *
+ * @returns one of the SILENCE_* modes or -1 if the name is unknown
+ */
+int silence_ParseMode(const char* name){
+    if(strcmp(name, "report") == 0) return SILENCE_REPORT;
+    if(strcmp(name, "trim") == 0) return SILENCE_TRIM;
+    if(strcmp(name, "split") == 0) return SILENCE_SPLIT;
+    return -1;
+}
+
+/**
+ * @brief Returns the number of frames of a detection window
+ */
+uint32_t silence_WindowFrames(uint32_t sample_rate){
+    uint32_t frames = sample_rate / (1000 / SILENCE_WINDOW_MS);
+    return frames > 0 ? frames : 1;
+}
+
+/**
+ * @brief Checks whether every 16 bit sample of a buffer is within [-threshold, threshold]
+ *
+ * @param data the little-endian samples
+ * @param samples the number of samples
+ * @param threshold the largest absolute value that counts as silence
+ *
+ * @returns 1 if the buffer is silent, 0 as soon as a louder sample is found
+ */
+short silence_IsQuiet16bit(const char* data, uint32_t samples, int16_t threshold){
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i limit = _mm_set1_epi16(threshold);
+    for(; i + 32 <= samples; i += 32){
+        __m128i m = zero;
+        for(uint32_t k = 0; k < 32; k += 8){
+            __m128i s = _mm_loadu_si128((const __m128i*)(data + 2*(i + k)));
+            // the saturating negation maps -32768 to 32767 so the absolute value never wraps
+            m = _mm_max_epi16(m, _mm_max_epi16(s, _mm_subs_epi16(zero, s)));
+        }
+        if(_mm_movemask_epi8(_mm_cmpgt_epi16(m, limit))) return 0;
+    }
+#endif
+    for(; i < samples; i++){
+        int32_t s = (int16_t)((uint8_t)data[2*i] | ((uint8_t)data[2*i + 1] << 8));
+        if(abs(s) > threshold) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Checks whether every float sample of a buffer is within [-threshold, threshold]
+ *
+ * @returns 1 if the buffer is silent, 0 as soon as a louder sample is found
+ */
+short silence_IsQuietFloat(const float* samples, uint32_t count, float threshold){
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 limit = _mm_set1_ps(threshold);
+    for(; i + 16 <= count; i += 16){
+        __m128 m = _mm_andnot_ps(sign, _mm_loadu_ps(samples + i));
+        m = _mm_max_ps(m, _mm_andnot_ps(sign, _mm_loadu_ps(samples + i + 4)));
+        m = _mm_max_ps(m, _mm_andnot_ps(sign, _mm_loadu_ps(samples + i + 8)));
+        m = _mm_max_ps(m, _mm_andnot_ps(sign, _mm_loadu_ps(samples + i + 12)));
+        if(_mm_movemask_ps(_mm_cmpgt_ps(m, limit))) return 0;
+    }
+#endif
+    for(; i < count; i++){
+        if(fabsf(samples[i]) > threshold) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Checks whether a window of raw samples is silent
+ *
+ * @param raw the samples in the format of the header
+ * @param frames the number of frames of the window
+ * @param header the header of the file
+ * @param threshold the threshold as a fraction of full scale
+ * @param scratch space for frames x channels floats, used by formats other than 16 bit PCM
+ *
+ * @returns 1 if the window is silent, 0 otherwise
+ */
+short silence_IsQuiet(const char* raw, uint32_t frames, const struct wav_header* header, double threshold, float* scratch){
+    const uint32_t count = frames * header->mono_stereo;
+    if(header->wave_format == WAVE_FORMAT_PCM && header->bits_per_sample == 16){
+        double limit = floor(threshold * 32768.0);
+        return silence_IsQuiet16bit(raw, count, (int16_t)(limit > 32767.0 ? 32767.0 : limit));
+    }
+    pcm_ToFloat(raw, scratch, count, header->wave_format, header->bits_per_sample);
+    return silence_IsQuietFloat(scratch, count, (float)threshold);
+}
+
+/**
+ * @brief Finds the first loud frame of a window that is not silent
+ *
+ * @returns the index of the first frame with a sample louder than the threshold, or frames if there is none
+ */
+uint32_t silence_FirstLoud(const char* raw, uint32_t frames, const struct wav_header* header, double threshold, float* scratch){
+    uint32_t i = 0;
+    while(i < frames && silence_IsQuiet(raw + (size_t)i * header->block_align, 1, header, threshold, scratch)) i++;
+    return i;
+}
+
+/**
+ * @brief Finds the end of the last loud frame of a window that is not silent
+ *
+ * @returns one past the index of the last frame with a sample louder than the threshold, or 0 if there is none
+ */
+uint32_t silence_LastLoud(const char* raw, uint32_t frames, const struct wav_header* header, double threshold, float* scratch){
+    uint32_t i = frames;
+    while(i > 0 && silence_IsQuiet(raw + (size_t)(i - 1) * header->block_align, 1, header, threshold, scratch)) i--;
+    return i;
+}
@@ -15,6 +15,24 @@
 #define _USE_MATH_DEFINES
 #include<math.h>
 #include"caudio.h"
+#include"player.h"
+#include"fft.h"
+#include"biquad.h"
+#include"convolve.h"
+#include"tempo.h"
+#include"dither.h"
+#include"envelope.h"
+#include"silence.h"
+#include"synth.h"
+#include"remix.h"
+#include"chunked.h"
+#include"project.h"
+#include"codec.h"
+#include"flac.h"
+#include"fingerprint.h"
+#include"beat.h"
+#include"crew.h"
+#include<pthread.h>
 
 /**
  * @brief Displays the information of the WAV file provided through STDIN
@@ -64,8 +82,8 @@ void info_command(short* flag){
     }
 
     uint16_t wave_format = get_WaveFormat();
-    if(wave_format != 1){
-        fprintf(stderr, "Error! WAVE type format should be 1\n");
+    if(wave_format != WAVE_FORMAT_PCM && wave_format != WAVE_FORMAT_IEEE_FLOAT){
+        fprintf(stderr, "Error! WAVE type format should be 1 (PCM) or 3 (float)\n");
         *flag = 1;
         free(RIFF);
         free(WAVE);
@@ -96,8 +114,9 @@ void info_command(short* flag){
     }
 
     int16_t bits_per_sample = get_BitsPerSample();
-    if(bits_per_sample != 8 && bits_per_sample != 16){
-        fprintf(stderr, "Error! bits/sample should be 8 or 16\n");
+    if((wave_format == WAVE_FORMAT_IEEE_FLOAT && bits_per_sample != 32) ||
+       (bits_per_sample != 8 && bits_per_sample != 16 && bits_per_sample != 24 && bits_per_sample != 32)){
+        fprintf(stderr, "Error! bits/sample should be 8, 16, 24 or 32 (32 for float)\n");
         *flag = 1;
         free(RIFF);
         free(WAVE);
@@ -129,7 +148,7 @@ void info_command(short* flag){
     uint32_t index = 0;
     short error = 0;
     while(index < data_segment_size && !error){
-        error = getchar() == EOF ? 1 : error;
+        error = getc(IO_IN) == EOF ? 1 : error;
         index++;
     }
     if(error){
@@ -145,11 +164,11 @@ void info_command(short* flag){
     uint32_t total_bytes_traversed = SIZE_OF_WAVE_HEADER + index;
 
     while(total_bytes_traversed < SizeOfFile){
-        getchar();
+        getc(IO_IN);
         total_bytes_traversed++;
     }
 
-    if(getchar() != EOF){
+    if(getc(IO_IN) != EOF){
         fprintf(stderr, "Error! bad file size (found data past the expected end of file)\n");
         *flag = 1;
         free(RIFF);
@@ -159,15 +178,15 @@ void info_command(short* flag){
         return;
     }
     
-    printf("size of file: %" PRIu32 "\n", SizeOfFile);
-    printf("size of format chunk: %" PRIu32 "\n", format_chunk);
-    printf("WAVE type format: %" PRIu16 "\n", wave_format);
-    printf("mono/stereo: %" PRIu16 "\n", mono_stereo);
-    printf("sample rate: %" PRIu32 "\n", sample_rate);
-    printf("byte/sec: %" PRIu32 "\n", byte_per_sec);
-    printf("block align: %" PRIu16 "\n", block_align);
-    printf("bits/sample: %" PRId16 "\n", bits_per_sample);
-    printf("size of data chunk: %" PRIu32 "\n", data_segment_size);
+    fprintf(IO_OUT, "size of file: %" PRIu32 "\n", SizeOfFile);
+    fprintf(IO_OUT, "size of format chunk: %" PRIu32 "\n", format_chunk);
+    fprintf(IO_OUT, "WAVE type format: %" PRIu16 "\n", wave_format);
+    fprintf(IO_OUT, "mono/stereo: %" PRIu16 "\n", mono_stereo);
+    fprintf(IO_OUT, "sample rate: %" PRIu32 "\n", sample_rate);
+    fprintf(IO_OUT, "byte/sec: %" PRIu32 "\n", byte_per_sec);
+    fprintf(IO_OUT, "block align: %" PRIu16 "\n", block_align);
+    fprintf(IO_OUT, "bits/sample: %" PRId16 "\n", bits_per_sample);
+    fprintf(IO_OUT, "size of data chunk: %" PRIu32 "\n", data_segment_size);
 
     free(RIFF);
     free(WAVE);
@@ -297,21 +316,21 @@ void srate_command(double rate, short* flag){
         free(WAVE);
         free(FMT);
         free(data_start_segment);
-        free(data);
+        free_Aligned(data);
         *flag = 1;
         return;
     }
 
     char* other_data_buffer = get_OtherData(SizeOfFile, data_segment_size);
 
-    if(getchar() != EOF){
+    if(getc(IO_IN) != EOF){
         fprintf(stderr, "Error! bad file size (found data past the expected end of file)\n");
         free(RIFF);
         free(WAVE);
         free(FMT);
         free(data_start_segment);
-        free(data);
-        free(other_data_buffer);
+        free_Aligned(data);
+        free_Aligned(other_data_buffer);
         *flag = 1;
         return;
     }
@@ -340,8 +359,8 @@ void srate_command(double rate, short* flag){
     free(WAVE);
     free(FMT);
     free(data_start_segment);
-    free(data);
-    free(other_data_buffer);
+    free_Aligned(data);
+    free_Aligned(other_data_buffer);
 }
 
 /**
@@ -468,21 +487,21 @@ void schannel_command(short channel, short* flag){
         free(WAVE);
         free(FMT);
         free(data_start_segment);
-        free(data);
+        free_Aligned(data);
         *flag = 1;
         return;
     }
 
     char* other_data_buffer = get_OtherData(SizeOfFile, data_segment_size);
 
-    if(getchar() != EOF){
+    if(getc(IO_IN) != EOF){
         fprintf(stderr, "Error! bad file size (found data past the expected end of file)\n");
         free(RIFF);
         free(WAVE);
         free(FMT);
         free(data_start_segment);
-        free(data);
-        free(other_data_buffer);
+        free_Aligned(data);
+        free_Aligned(other_data_buffer);
         *flag = 1;
         return;
     }
@@ -521,9 +540,9 @@ void schannel_command(short channel, short* flag){
     free(WAVE);
     free(FMT);
     free(data_start_segment);
-    free(data);
-    free(other_data_buffer);
-    free(channel_data);
+    free_Aligned(data);
+    free_Aligned(other_data_buffer);
+    free_Aligned(channel_data);
 }
 
 /**
@@ -646,24 +665,24 @@ void svolume_command(double volume, short* flag){
         free(WAVE);
         free(FMT);
         free(data_start_segment);
-        free(data);
+        free_Aligned(data);
         *flag = 1;
         return;
     }
     
     char* newData = set_Volume(data, data_segment_size, bits_per_sample, volume);
-    free(data);
+    free_Aligned(data);
 
     char* other_data_buffer = get_OtherData(SizeOfFile, data_segment_size);
 
-    if(getchar() != EOF){
+    if(getc(IO_IN) != EOF){
         fprintf(stderr, "Error! bad file size (found data past the expected end of file)\n");
         free(RIFF);
         free(WAVE);
         free(FMT);
         free(data_start_segment);
-        free(newData);
-        free(other_data_buffer);
+        free_Aligned(newData);
+        free_Aligned(other_data_buffer);
         *flag = 1;
         return;
     }
@@ -688,8 +707,25 @@ void svolume_command(double volume, short* flag){
     free(WAVE);
     free(FMT);
     free(data_start_segment);
-    free(newData);
-    free(other_data_buffer);
+    free_Aligned(newData);
+    free_Aligned(other_data_buffer);
+}
+
+/**
+ * @brief Renders samples of the FM sound of mysound() as little-endian 16 bit PCM. There is no SIMD path, every sample
+ * takes two sin() calls of libm
+ *
+ * @param out receives count samples
+ * @param first the index of the first sample
+ */
+void mysound_Render(char* out, uint32_t first, uint32_t count, int sr, double fm, double fc, double mi, double amp){
+    for(uint32_t i = 0; i < count; i++){
+        double t = (double)(first + i) / sr;
+        double tmp = amp * sin(2 * M_PI * fc * t - mi * sin(2 * M_PI * fm * t));
+        int16_t sample = trunc(tmp);
+        out[2*i] = (char)(sample & 0xFF);
+        out[2*i + 1] = (char)((sample >> 8) & 0xFF);
+    }
 }
 
 /**
@@ -726,20 +762,24 @@ void mysound(int dur, int sr, double fm, double fc, double mi, double amp){
     write_d16(bits_per_sample);
     swrite_ch("data", 4);
     write_u32(data_segment_size);
+    stats_Format(1, (uint16_t)bits_per_sample);
     
     // write data
     uint32_t total_samples = dur * sr;
 
-    for(uint32_t i = 0; i < total_samples; i++){
-        double t = (double)i / sr;
-        double tmp = amp * sin(2 * M_PI * fc * t - mi * sin(2 * M_PI * fm * t));
-        int16_t sample = trunc(tmp);
-        write_d16(sample);
+    char block[STREAM_BLOCK_FRAMES * 2];
+    for(uint32_t i = 0; i < total_samples; i += STREAM_BLOCK_FRAMES){
+        uint32_t n = total_samples - i < STREAM_BLOCK_FRAMES ? total_samples - i : STREAM_BLOCK_FRAMES;
+        mysound_Render(block, i, n, sr, fm, fc, mi, amp);
+        write_Block(block, (size_t)n * 2);
     }
 }
 
 /**
- * @brief Plays the WAV file provided from standard input
+ * @brief Plays the WAV file provided from standard input, with live control of the volume, pause and seek (see player.h)
+ * 
+ * @param options The control file, the sink, the initial volume and the buffer geometry. The simulated sinks write what
+ * would be played to STDOUT as a WAV file
  * 
  * @return Zero on success.
  * Negative values are propagated from functions defined in caudio.h. See the header file documentation for more details. Positive values indicate the following function-specific errors
@@ -747,7 +787,7 @@ void mysound(int dur, int sr, double fm, double fc, double mi, double amp){
  *      - 2: An unexpected error occured while playing the WAV file
  * 
  */
-int play_sound(){
+int play_sound(const struct player_options* options){
     char* RIFF = get_RIFF();
     if(RIFF == NULL || memcmp(RIFF, "RIFF", 4) != 0){
         fprintf(stderr, "Error! \"RIFF\" not found\n");
@@ -756,7 +796,7 @@ int play_sound(){
     }
 
     //uint32_t SizeOfFile = get_SizeOfFile();
-    getchar(); getchar(); getchar(); getchar();
+    getc(IO_IN); getc(IO_IN); getc(IO_IN); getc(IO_IN);
 
     char* WAVE = get_WAVE();
     if(WAVE == NULL || memcmp(WAVE, "WAVE", 4) != 0){
@@ -845,10 +885,9 @@ int play_sound(){
     int err = 0;
     void* buffer = read_DataSegment(data_segment_size, &eof);
 
-    int fd = caudio_open_device();
-    if(fd < 0){
-        fprintf(stderr, "Error: Unable to detect a valid audio device to use\n");
-        free(buffer);
+    if(buffer == NULL || eof){
+        fprintf(stderr, "Error! insufficient data\n");
+        free_Aligned(buffer);
         free(data_start_segment);
         free(RIFF);
         free(WAVE);
@@ -856,13 +895,13 @@ int play_sound(){
         return 1;
     }
 
-    uint32_t segmentSize = 1024; // Default buffer size
-    struct snd_pcm_hw_params hw;
-    struct snd_pcm_sw_params sw;
-    err = caudio_setup_params(fd, &hw, &sw, (int)mono_stereo, bits_per_sample, (unsigned int)sample_rate, (unsigned int)segmentSize);
+    struct wav_header header = {SIZE_OF_WAVE_HEADER + data_segment_size, format_chunk, wave_format, mono_stereo, sample_rate,
+                                byte_per_sec, block_align, (uint16_t)bits_per_sample, data_segment_size};
+    struct player_sink sink;
+    off_t header_offset = -1;
+    err = player_SinkOpen(&sink, options, &header, &header_offset);
     if(err != 0){
-        fprintf(stderr, "Error: Unable to configure audio device (Error code: %d)\n", err);
-        free(buffer);
+        free_Aligned(buffer);
         free(data_start_segment);
         free(RIFF);
         free(WAVE);
@@ -870,46 +909,1959 @@ int play_sound(){
         return err;
     }
 
-    uint32_t steps = 0;
-    char* ptr = buffer;
-    void* segment = malloc(segmentSize * sizeof(uint8_t));
-    caudio_start_playback(fd);
-    while(steps < data_segment_size){
-        if(steps + segmentSize < data_segment_size){
-            memcpy(segment, ptr, segmentSize);
-            ptr += segmentSize;
-            steps += segmentSize;
+    player_ReportLatency(&sink);
+
+    struct player_control ctl;
+    atomic_init(&ctl.gain, player_FloatBits((float)options->volume));
+    atomic_init(&ctl.paused, 0);
+    atomic_init(&ctl.seek, -1);
+    atomic_init(&ctl.quit, 0);
+    atomic_init(&ctl.position, 0);
+    atomic_init(&ctl.done, 0);
+    ctl.sample_rate = sample_rate;
+    ctl.frames = data_segment_size / block_align;
+    ctl.path = options->control;
+    // without a control file the keys of the terminal are read, if there is one
+    pthread_t control_thread;
+    short controlled = pthread_create(&control_thread, NULL, player_ControlThread, &ctl) == 0;
+
+    err = player_Play(buffer, &header, &sink, &ctl);
+    atomic_store(&ctl.done, 1);
+    if(controlled) pthread_join(control_thread, NULL);
+    if(sink.type != PLAYER_SINK_SIM) fprintf(stderr, "dj: %u underruns\n", sink.underruns);
+    player_SinkClose(&sink, &header, header_offset, err);
+
+    free_Aligned(buffer);
+    free(data_start_segment);
+    free(RIFF);
+    free(WAVE);
+    free(FMT);
+    return err != 0 ? 2 : 0;
+}
+
+/**
+ * @brief Plays a playlist of files, crossfading each into the next, to the sink of the dj options
+ *
+ * @param paths the files, FLAC or any WAV format codec.h decodes, mono or stereo at one sample rate
+ * @param xfade the length of the crossfades in seconds, 0 for gapless playback
+ * @param beat_align end each crossfade on a beat of the outgoing file and start the incoming file at its first beat
+ *
+ * @returns 0 on success, 1 if a file cannot be played, 2 if playback failed
+ */
+int play_decks(const struct player_options* options, char** paths, uint32_t count, double xfade, short beat_align){
+    struct player_deck* decks = calloc(count, sizeof(struct player_deck));
+    if(decks == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        return 1;
+    }
+    uint16_t channels = 1;
+    uint64_t frames = 0;
+    for(uint32_t d = 0; d < count; d++){
+        decks[d].path = paths[d];
+        decks[d].beat_align = beat_align;
+        decks[d].cue = beat_align && d > 0;
+        atomic_init(&decks[d].produced, 0);
+        atomic_init(&decks[d].consumed, 0);
+        atomic_init(&decks[d].ready, 0);
+        atomic_init(&decks[d].eof, 0);
+        atomic_init(&decks[d].stop, 0);
+        if(player_DeckCheck(&decks[d]) != 0){
+            free(decks);
+            return 1;
+        }
+        if(decks[d].wav.sample_rate != decks[0].wav.sample_rate){
+            fprintf(stderr, "Error! %s is at %u Hz and %s at %u Hz, the decks need one sample rate\n", paths[d],
+                    decks[d].wav.sample_rate, paths[0], decks[0].wav.sample_rate);
+            free(decks);
+            return 1;
+        }
+        if(decks[d].wav.channels > channels) channels = decks[d].wav.channels;
+        frames += decks[d].frames;
+    }
+    for(uint32_t d = 0; d < count; d++) decks[d].channels = channels;
+
+    // the sizes are an upper bound until the sink closes
+    const uint32_t sample_rate = decks[0].wav.sample_rate;
+    const uint16_t block_align = channels * sizeof(int16_t);
+    const uint64_t size = frames * block_align;
+    const uint32_t data_segment_size = size < UINT32_MAX - SIZE_OF_WAVE_HEADER ? (uint32_t)size : UINT32_MAX - SIZE_OF_WAVE_HEADER;
+    struct wav_header header = {SIZE_OF_WAVE_HEADER + data_segment_size, 16, WAVE_FORMAT_PCM, channels, sample_rate,
+                                sample_rate * block_align, block_align, 16, data_segment_size};
+    struct player_sink sink;
+    off_t header_offset = -1;
+    int err = player_SinkOpen(&sink, options, &header, &header_offset);
+    if(err != 0){
+        free(decks);
+        return err;
+    }
+    player_ReportLatency(&sink);
+
+    struct player_control ctl;
+    atomic_init(&ctl.gain, player_FloatBits((float)options->volume));
+    atomic_init(&ctl.paused, 0);
+    atomic_init(&ctl.seek, -1);
+    atomic_init(&ctl.quit, 0);
+    atomic_init(&ctl.position, 0);
+    atomic_init(&ctl.done, 0);
+    ctl.sample_rate = sample_rate;
+    ctl.frames = frames;
+    ctl.path = options->control;
+    pthread_t control_thread;
+    short controlled = pthread_create(&control_thread, NULL, player_ControlThread, &ctl) == 0;
+
+    struct player_mix_stats stats;
+    err = player_Decks(decks, count, xfade, &sink, &ctl, &stats);
+    atomic_store(&ctl.done, 1);
+    if(controlled) pthread_join(control_thread, NULL);
+    fprintf(stderr, "dj: %lu periods mixed, mean %.1f us, max %.1f us of %.1f us per period, %lu late, %lu deck underflows, "
+            "%lu shortened crossfades\n", (unsigned long)stats.periods, stats.periods > 0 ? stats.total / stats.periods * 1e6 : 0.0,
+            stats.max * 1e6, (double)sink.period_frames / sample_rate * 1e6, (unsigned long)stats.late,
+            (unsigned long)stats.underflows, (unsigned long)stats.shortened);
+    if(sink.type != PLAYER_SINK_SIM) fprintf(stderr, "dj: %u underruns\n", sink.underruns);
+    player_SinkClose(&sink, &header, header_offset, err);
+
+    free(decks);
+    return err != 0 ? 2 : 0;
+}
+
+#define SPECTRUM_WINDOW_HANN 0
+#define SPECTRUM_WINDOW_HAMMING 1
+#define SPECTRUM_WINDOW_BLACKMAN 2
+#define SPECTRUM_WINDOW_RECT 3
+
+#define SPECTRUM_FORMAT_CSV 0
+#define SPECTRUM_FORMAT_BIN 1
+#define SPECTRUM_FORMAT_PGM 2
+
+#define SPECTRUM_FRAMES_PER_THREAD 64
+
+/**
+ * @brief The part of a batch of STFT frames that a single thread computes
+ */
+struct spectrum_job {
+    const struct fft_plan* plan;
+    const float* samples;   // mono samples, sample 0 is the first sample of the batch
+    const float* window;
+    float* magnitudes;      // one row of n/2 + 1 magnitudes per frame of the batch
+    uint32_t hop;
+    uint32_t first;         // first frame of the batch that this job computes
+    uint32_t last;          // one past the last frame
+    float scale;
+    float* frame;           // scratch of the job, kept for the whole stream
+    float* re;
+    float* im;
+    float* scratch;
+};
+
+/**
+ * @brief Thread entry point that computes the magnitude spectrum of the frames of a spectrum_job
+ */
+void* spectrum_Worker(void* arg){
+    struct spectrum_job* job = arg;
+    const uint32_t n = job->plan->n;
+    const uint32_t bins = n / 2 + 1;
+    float* frame = job->frame;
+    float* re = job->re;
+    float* im = job->im;
+    float* scratch = job->scratch;
+
+    for(uint32_t f = job->first; f < job->last; f++){
+        const float* in = job->samples + (size_t)f * job->hop;
+        for(uint32_t i = 0; i < n; i++){
+            frame[i] = in[i] * job->window[i];
+        }
+        fft_Forward(job->plan, frame, re, im, scratch);
+
+        float* out = job->magnitudes + (size_t)f * bins;
+        for(uint32_t k = 0; k < bins; k++){
+            out[k] = sqrtf(re[k] * re[k] + im[k] * im[k]) * job->scale;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reads a WAV file from standard input and writes the magnitude spectrogram of its (downmixed) data to standard output
+ * 
+ * The magnitudes are normalized so that a full scale sine wave produces a peak of 1.0.
+ * 
+ * @param fft_size The size of the FFT in samples. Must be a power of two and at least 8
+ * @param hop The distance in samples between the start of two consecutive frames
+ * @param window One of the SPECTRUM_WINDOW_* values
+ * @param format One of the SPECTRUM_FORMAT_* values. CSV writes one line per frame, BIN writes the same matrix as 32 bit floats and PGM writes a grayscale image with time on the x axis
+ * @param range The dynamic range in dB that is mapped to the gray levels of the PGM image
+ * @param threads The number of threads that compute frames in parallel
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void spectrum_command(uint32_t fft_size, uint32_t hop, short window, short format, double range, int threads, short* flag){
+    struct wav_header header;
+    read_WavHeader(&header, flag);
+    if(*flag) return;
+    *flag = 1;
+
+    struct fft_plan* plan = fft_plan_Create(fft_size);
+    if(plan == NULL){
+        fprintf(stderr, "Error! the FFT size should be a power of two and at least 8\n");
+        return;
+    }
+    if(hop == 0){
+        fprintf(stderr, "Error! the hop size should be at least 1\n");
+        fft_plan_Destroy(plan);
+        return;
+    }
+    if(threads < 1) threads = 1;
+
+    const uint32_t bins = fft_size / 2 + 1;
+    const uint32_t channels = header.mono_stereo;
+    const uint32_t total_samples = header.data_segment_size / header.block_align;
+    const uint32_t total_frames = total_samples <= fft_size ? (total_samples > 0) : 1 + (total_samples - fft_size) / hop;
+    const uint32_t batch = SPECTRUM_FRAMES_PER_THREAD * (uint32_t)threads;
+    const uint32_t span = (batch - 1) * hop + fft_size; // samples needed by a full batch
+
+    float* window_table = alloc_Aligned(fft_size * sizeof(float));
+    float* samples = alloc_Aligned(span * sizeof(float));
+    float* converted = alloc_Aligned(span * channels * sizeof(float));
+    char* raw = alloc_Aligned(span * header.block_align);
+    float* magnitudes = alloc_Aligned((size_t)batch * bins * sizeof(float));
+    uint8_t* image = format == SPECTRUM_FORMAT_PGM ? malloc((size_t)total_frames * bins + 1) : NULL;
+    struct spectrum_job* jobs = calloc(threads, sizeof(struct spectrum_job));
+    struct crew crew;
+    short crewed = 0;
+    int workers = 0;
+    if(window_table == NULL || samples == NULL || converted == NULL || raw == NULL || magnitudes == NULL ||
+       (format == SPECTRUM_FORMAT_PGM && image == NULL) || jobs == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        goto cleanup;
+    }
+    for(int t = 0; t < threads; t++){
+        jobs[t].frame = alloc_Aligned(fft_size * sizeof(float));
+        jobs[t].re = alloc_Aligned(bins * sizeof(float));
+        jobs[t].im = alloc_Aligned(bins * sizeof(float));
+        jobs[t].scratch = alloc_Aligned(fft_ScratchSize(plan) * sizeof(float));
+        if(jobs[t].frame == NULL || jobs[t].re == NULL || jobs[t].im == NULL || jobs[t].scratch == NULL){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            goto cleanup;
+        }
+    }
+
+    double window_sum = 0.0;
+    for(uint32_t i = 0; i < fft_size; i++){
+        double x = 2.0 * M_PI * i / fft_size;
+        double w = 1.0;
+        if(window == SPECTRUM_WINDOW_HANN) w = 0.5 - 0.5 * cos(x);
+        else if(window == SPECTRUM_WINDOW_HAMMING) w = 0.54 - 0.46 * cos(x);
+        else if(window == SPECTRUM_WINDOW_BLACKMAN) w = 0.42 - 0.5 * cos(x) + 0.08 * cos(2 * x);
+        window_table[i] = (float)w;
+        window_sum += w;
+    }
+    const float scale = (float)(2.0 / window_sum);
+
+    for(int t = 0; t < threads; t++){
+        jobs[t].plan = plan;
+        jobs[t].samples = samples;
+        jobs[t].window = window_table;
+        jobs[t].magnitudes = magnitudes;
+        jobs[t].hop = hop;
+        jobs[t].scale = scale;
+    }
+    // the workers and their scratch last for the whole stream, the calling thread computes the last slice itself
+    workers = crew_Create(&crew, threads - 1, spectrum_Worker, jobs, sizeof(struct spectrum_job));
+    crewed = 1;
+
+    if(format == SPECTRUM_FORMAT_PGM){
+        // a row of the image is a frequency bin, the highest frequency at the top
+        fprintf(IO_OUT, "P5\n%" PRIu32 " %" PRIu32 "\n255\n", total_frames, bins);
+    }
+
+    uint32_t available = 0;     // samples currently held in the buffer
+    uint32_t consumed = 0;      // samples read from the data segment so far
+    uint32_t skip = 0;          // samples to discard before filling the buffer
+    uint32_t frame = 0;
+    while(frame < total_frames){
+        // Skip the samples that fall between two frames when the hop is larger than the FFT size
+        while(skip > 0 && consumed < total_samples){
+            uint32_t n = skip < span ? skip : span;
+            if(n > total_samples - consumed) n = total_samples - consumed;
+            if(read_Block(raw, n * header.block_align) != n * header.block_align){
+                fprintf(stderr, "Error! insufficient data\n");
+                goto cleanup;
+            }
+            skip -= n;
+            consumed += n;
+        }
+
+        // Top the buffer up with the samples that the next batch needs
+        uint32_t wanted = span - available;
+        if(wanted > total_samples - consumed) wanted = total_samples - consumed;
+        if(wanted > 0){
+            uint32_t got = read_Block(raw, wanted * header.block_align) / header.block_align;
+            if(got < wanted){
+                fprintf(stderr, "Error! insufficient data\n");
+                goto cleanup;
+            }
+            pcm_ToFloat(raw, converted, got * channels, header.wave_format, header.bits_per_sample);
+            for(uint32_t i = 0; i < got; i++){
+                float sum = 0.0f;
+                for(uint32_t c = 0; c < channels; c++){
+                    sum += converted[i * channels + c];
+                }
+                samples[available + i] = sum / channels;
+            }
+            available += got;
+            consumed += got;
+        }
+        // zero-pad the tail of the last frame
+        for(uint32_t i = available; i < span; i++){
+            samples[i] = 0.0f;
+        }
+
+        uint32_t count = total_frames - frame < batch ? total_frames - frame : batch;
+        uint32_t per_thread = (count + threads - 1) / threads;
+        for(int t = 0; t < threads; t++){
+            jobs[t].first = t * per_thread < count ? t * per_thread : count;
+            jobs[t].last = jobs[t].first + per_thread < count ? jobs[t].first + per_thread : count;
+        }
+        if(workers > 0) crew_Start(&crew);
+        for(int t = workers; t < threads; t++){
+            spectrum_Worker(&jobs[t]);
+        }
+        if(workers > 0) crew_Wait(&crew);
+
+        for(uint32_t f = 0; f < count; f++){
+            const float* row = magnitudes + (size_t)f * bins;
+            if(format == SPECTRUM_FORMAT_CSV){
+                for(uint32_t k = 0; k < bins; k++){
+                    fprintf(IO_OUT, k + 1 < bins ? "%g," : "%g\n", row[k]);
+                }
+            } else if(format == SPECTRUM_FORMAT_BIN){
+                write_Block(row, sizeof(float) * bins);
+            } else{
+                for(uint32_t k = 0; k < bins; k++){
+                    double db = 20.0 * log10(row[k] + 1e-12);
+                    double level = 255.0 * (db + range) / range;
+                    level = level < 0.0 ? 0.0 : (level > 255.0 ? 255.0 : level);
+                    image[(size_t)(bins - 1 - k) * total_frames + frame + f] = (uint8_t)level;
+                }
+            }
+        }
+        frame += count;
+
+        // Drop the samples that no frame after this batch needs
+        uint32_t drop = count * hop < available ? count * hop : available;
+        memmove(samples, samples + drop, (available - drop) * sizeof(float));
+        available -= drop;
+        skip = count * hop - drop;
+    }
+
+    if(format == SPECTRUM_FORMAT_PGM){
+        write_Block(image, (size_t)total_frames * bins);
+    }
+    *flag = 0;
+
+cleanup:
+    if(crewed) crew_Destroy(&crew);
+    for(int t = 0; jobs != NULL && t < threads; t++){
+        free_Aligned(jobs[t].frame);
+        free_Aligned(jobs[t].re);
+        free_Aligned(jobs[t].im);
+        free_Aligned(jobs[t].scratch);
+    }
+    fft_plan_Destroy(plan);
+    free_Aligned(window_table);
+    free_Aligned(samples);
+    free_Aligned(converted);
+    free_Aligned(raw);
+    free_Aligned(magnitudes);
+    free(image);
+    free(jobs);
+}
+
+/**
+ * @brief Reads a WAV file from standard input and writes the file to standard output filtered by a cascade of biquad sections
+ * 
+ * The data segment is processed in blocks of STREAM_BLOCK_FRAMES frames, so the memory used does not depend on the size of the file.
+ * 
+ * @param specs The sections of the cascade in the order they are applied
+ * @param count The number of sections
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void filter_command(const struct biquad_spec* specs, uint32_t count, short* flag){
+    struct wav_header header;
+    read_WavHeader(&header, flag);
+    if(*flag) return;
+    *flag = 1;
+
+    struct biquad_chain* chain = biquad_chain_Create(header.mono_stereo, count);
+    if(chain == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        return;
+    }
+    for(uint32_t i = 0; i < count; i++){
+        double c[5];
+        if(biquad_Design(specs[i].type, specs[i].frequency, specs[i].q, specs[i].gain_db, header.sample_rate, c) != 0){
+            fprintf(stderr, "Error! filter %" PRIu32 " has a frequency outside (0, sample rate / 2) or a non-positive Q\n", i + 1);
+            biquad_chain_Destroy(chain);
+            return;
+        }
+        biquad_chain_SetSection(chain, i, c);
+    }
+
+    const uint32_t samples_per_block = STREAM_BLOCK_FRAMES * header.mono_stereo;
+    char* raw = alloc_Aligned(STREAM_BLOCK_FRAMES * header.block_align);
+    float* samples = alloc_Aligned(samples_per_block * sizeof(float));
+    if(raw == NULL || samples == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        biquad_chain_Destroy(chain);
+        free_Aligned(raw);
+        free_Aligned(samples);
+        return;
+    }
+
+    write_WavHeader(&header);
+
+    uint32_t remaining = header.data_segment_size / header.block_align;
+    while(remaining > 0){
+        uint32_t frames = remaining < STREAM_BLOCK_FRAMES ? remaining : STREAM_BLOCK_FRAMES;
+        if(read_Block(raw, frames * header.block_align) != frames * header.block_align){
+            fprintf(stderr, "Error! insufficient data\n");
+            biquad_chain_Destroy(chain);
+            free_Aligned(raw);
+            free_Aligned(samples);
+            return;
+        }
+        pcm_ToFloat(raw, samples, frames * header.mono_stereo, header.wave_format, header.bits_per_sample);
+        biquad_chain_Process(chain, samples, frames);
+        pcm_FromFloat(samples, raw, frames * header.mono_stereo, header.wave_format, header.bits_per_sample);
+        write_Block(raw, frames * header.block_align);
+        remaining -= frames;
+    }
+
+    // a data segment that is not a whole number of frames keeps its last partial frame as is
+    uint32_t tail = header.data_segment_size % header.block_align;
+    if(tail > 0){
+        write_Block(raw, read_Block(raw, tail));
+    }
+    copy_OtherData(header.size_of_file, header.data_segment_size);
+
+    biquad_chain_Destroy(chain);
+    free_Aligned(raw);
+    free_Aligned(samples);
+    *flag = 0;
+}
+
+/**
+ * @brief One channel of the convolve command
+ */
+struct convolve_channel {
+    struct conv_state* state;
+    float* in;                  // deinterleaved input of the current super block
+    float* out;                 // deinterleaved output of the current super block
+    uint32_t frames;            // frames of the current super block, a multiple of the partition size
+};
+
+/**
+ * @brief Thread entry point that convolves the current super block of a channel
+ */
+void* convolve_Worker(void* arg){
+    struct convolve_channel* channel = arg;
+    const uint32_t block = channel->state->ir->block;
+    for(uint32_t i = 0; i < channel->frames; i += block){
+        conv_state_Process(channel->state, channel->in + i, channel->out + i);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reads a whole WAV file into deinterleaved float buffers
+ * 
+ * @param path the path of the file
+ * @param header receives the header of the file
+ * @param frames receives the number of frames per channel
+ * 
+ * @returns an array of header->mono_stereo buffers, or NULL on failure. Every buffer must be released with free_Aligned() and the array with free()
+ */
+float** read_WavFile(const char* path, struct wav_header* header, uint32_t* frames){
+    FILE* file = fopen(path, "rb");
+    if(file == NULL){
+        fprintf(stderr, "Error! unable to open %s\n", path);
+        return NULL;
+    }
+
+    short flag;
+    fread_WavHeader(file, header, &flag);
+    if(flag){
+        fclose(file);
+        return NULL;
+    }
+
+    *frames = header->data_segment_size / header->block_align;
+    uint32_t samples = *frames * header->mono_stereo;
+    char* raw = alloc_Aligned((size_t)*frames * header->block_align + 1);
+    float* interleaved = alloc_Aligned((size_t)samples * sizeof(float));
+    float** channels = calloc(header->mono_stereo, sizeof(float*));
+    if(raw == NULL || interleaved == NULL || channels == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        fclose(file);
+        free_Aligned(raw);
+        free_Aligned(interleaved);
+        free(channels);
+        return NULL;
+    }
+
+    size_t got = fread(raw, 1, (size_t)*frames * header->block_align, file);
+    fclose(file);
+    if(got != (size_t)*frames * header->block_align){
+        fprintf(stderr, "Error! insufficient data in %s\n", path);
+        free_Aligned(raw);
+        free_Aligned(interleaved);
+        free(channels);
+        return NULL;
+    }
+    pcm_ToFloat(raw, interleaved, samples, header->wave_format, header->bits_per_sample);
+    free_Aligned(raw);
+
+    for(uint32_t c = 0; c < header->mono_stereo; c++){
+        channels[c] = alloc_Aligned((size_t)*frames * sizeof(float));
+        if(channels[c] == NULL){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            for(uint32_t i = 0; i < c; i++) free_Aligned(channels[i]);
+            free(channels);
+            free_Aligned(interleaved);
+            return NULL;
+        }
+        for(uint32_t i = 0; i < *frames; i++){
+            channels[c][i] = interleaved[(size_t)i * header->mono_stereo + c];
+        }
+    }
+    free_Aligned(interleaved);
+    return channels;
+}
+
+/**
+ * @brief Reads a WAV file from standard input and writes it to standard output convolved with an impulse response
+ * 
+ * The output is longer than the input by the length of the impulse response minus one sample, so reverb tails ring out.
+ * A mono impulse response is applied to every channel, otherwise the impulse response must have as many channels as the input.
+ * 
+ * @param ir_path The path of the WAV file that contains the impulse response
+ * @param block The partition size in frames. Zero picks a size based on the length of the impulse response
+ * @param gain A gain applied to the output
+ * @param threads When larger than 1 every channel but the last is convolved by a worker thread of its own, for the whole stream
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void convolve_command(const char* ir_path, uint32_t block, double gain, int threads, short* flag){
+    *flag = 1;
+
+    struct wav_header ir_header;
+    uint32_t ir_frames = 0;
+    float** ir_samples = read_WavFile(ir_path, &ir_header, &ir_frames);
+    if(ir_samples == NULL) return;
+
+    struct wav_header header;
+    read_WavHeader(&header, flag);
+    if(*flag){
+        for(uint32_t c = 0; c < ir_header.mono_stereo; c++) free_Aligned(ir_samples[c]);
+        free(ir_samples);
+        return;
+    }
+    *flag = 1;
+
+    const uint32_t channels = header.mono_stereo;
+    struct conv_ir* irs[2] = {NULL, NULL};
+    struct convolve_channel jobs[2];
+    struct crew crew;
+    short crewed = 0;
+    int workers = 0;
+    char* raw = NULL;
+    float* interleaved = NULL;
+    memset(jobs, 0, sizeof(jobs));
+
+    if(ir_header.mono_stereo != 1 && ir_header.mono_stereo != channels){
+        fprintf(stderr, "Error! the impulse response should be mono or have as many channels as the input\n");
+        goto cleanup;
+    }
+    if(ir_frames == 0){
+        fprintf(stderr, "Error! the impulse response is empty\n");
+        goto cleanup;
+    }
+    if(ir_header.sample_rate != header.sample_rate){
+        fprintf(stderr, "Warning: the impulse response sample rate (%" PRIu32 ") differs from the input (%" PRIu32 ")\n",
+                ir_header.sample_rate, header.sample_rate);
+    }
+    if(block == 0) block = conv_DefaultBlock(ir_frames);
+    if(!fft_IsPowerOfTwo(block) || block < 4){
+        fprintf(stderr, "Error! the block size should be a power of two and at least 4\n");
+        goto cleanup;
+    }
+
+    for(uint32_t c = 0; c < ir_header.mono_stereo; c++){
+        irs[c] = conv_ir_Create(ir_samples[c], ir_frames, block, (float)gain);
+        if(irs[c] == NULL){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            goto cleanup;
+        }
+    }
+
+    const uint32_t super_block = STREAM_BLOCK_FRAMES > block ? STREAM_BLOCK_FRAMES / block * block : block;
+    raw = alloc_Aligned((size_t)super_block * header.block_align);
+    interleaved = alloc_Aligned((size_t)super_block * channels * sizeof(float));
+    if(raw == NULL || interleaved == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        goto cleanup;
+    }
+    for(uint32_t c = 0; c < channels; c++){
+        jobs[c].state = conv_state_Create(irs[ir_header.mono_stereo == 1 ? 0 : c]);
+        jobs[c].in = alloc_Aligned(super_block * sizeof(float));
+        jobs[c].out = alloc_Aligned(super_block * sizeof(float));
+        if(jobs[c].state == NULL || jobs[c].in == NULL || jobs[c].out == NULL){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            goto cleanup;
+        }
+    }
+
+    if(threads > 1){
+        workers = crew_Create(&crew, (int)channels - 1, convolve_Worker, jobs, sizeof(struct convolve_channel));
+        crewed = 1;
+    }
+
+    const uint32_t in_frames = header.data_segment_size / header.block_align;
+    const uint64_t out_frames = (uint64_t)in_frames + ir_frames - 1;
+    const uint64_t out_size = out_frames * header.block_align;
+    if(out_size > UINT32_MAX - SIZE_OF_WAVE_HEADER){
+        fprintf(stderr, "Error! the output would be larger than the 4GB limit of WAV files\n");
+        goto cleanup;
+    }
+    const uint32_t in_data_size = header.data_segment_size;
+    const uint32_t other = header.size_of_file > SIZE_OF_WAVE_HEADER + in_data_size ? header.size_of_file - SIZE_OF_WAVE_HEADER - in_data_size : 0;
+    header.data_segment_size = (uint32_t)out_size;
+    header.size_of_file = SIZE_OF_WAVE_HEADER + header.data_segment_size + other;
+    write_WavHeader(&header);
+
+    uint32_t read_frames = 0;
+    uint64_t written = 0;
+    while(written < out_frames){
+        uint32_t frames = in_frames - read_frames < super_block ? in_frames - read_frames : super_block;
+        if(frames > 0 && read_Block(raw, frames * header.block_align) != frames * header.block_align){
+            fprintf(stderr, "Error! insufficient data\n");
+            goto cleanup;
+        }
+        read_frames += frames;
+        pcm_ToFloat(raw, interleaved, frames * channels, header.wave_format, header.bits_per_sample);
+
+        // whole partitions only, the tail of the stream is padded with silence
+        uint32_t padded = (frames + block - 1) / block * block;
+        if(padded == 0) padded = super_block;
+        for(uint32_t c = 0; c < channels; c++){
+            for(uint32_t i = 0; i < frames; i++){
+                jobs[c].in[i] = interleaved[(size_t)i * channels + c];
+            }
+            for(uint32_t i = frames; i < padded; i++){
+                jobs[c].in[i] = 0.0f;
+            }
+            jobs[c].frames = padded;
+        }
+
+        // the calling thread convolves the channels that have no worker, the last one at least
+        if(workers > 0) crew_Start(&crew);
+        for(uint32_t c = workers; c < channels; c++){
+            convolve_Worker(&jobs[c]);
+        }
+        if(workers > 0) crew_Wait(&crew);
+
+        uint32_t out = out_frames - written < padded ? (uint32_t)(out_frames - written) : padded;
+        for(uint32_t c = 0; c < channels; c++){
+            for(uint32_t i = 0; i < out; i++){
+                interleaved[(size_t)i * channels + c] = jobs[c].out[i];
+            }
+        }
+        pcm_FromFloat(interleaved, raw, out * channels, header.wave_format, header.bits_per_sample);
+        write_Block(raw, (size_t)out * header.block_align);
+        written += out;
+    }
+
+    // skip a partial last frame of the input and keep the chunks after the data segment
+    read_Block(raw, in_data_size % header.block_align);
+    copy_OtherData(SIZE_OF_WAVE_HEADER + in_data_size + other, in_data_size);
+    *flag = 0;
+
+cleanup:
+    if(crewed) crew_Destroy(&crew);
+    for(uint32_t c = 0; c < 2; c++){
+        conv_state_Destroy(jobs[c].state);
+        free_Aligned(jobs[c].in);
+        free_Aligned(jobs[c].out);
+        conv_ir_Destroy(irs[c]);
+    }
+    for(uint32_t c = 0; c < ir_header.mono_stereo; c++) free_Aligned(ir_samples[c]);
+    free(ir_samples);
+    free_Aligned(raw);
+    free_Aligned(interleaved);
+}
+
+/**
+ * @brief Reads a WAV file from standard input and writes it to standard output played `factor` times faster without changing its pitch
+ * 
+ * Unlike the rate command, which only re-tags the sample rate, the samples are time stretched. The data is streamed in blocks.
+ * 
+ * @param factor The tempo multiplier. 1.25 makes the file play 25% faster
+ * @param mode TEMPO_WSOLA or TEMPO_PHASE_VOCODER
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void tempo_command(double factor, int mode, short* flag){
+    struct wav_header header;
+    read_WavHeader(&header, flag);
+    if(*flag) return;
+    *flag = 1;
+
+    if(!(factor >= 0.1 && factor <= 10.0)){
+        fprintf(stderr, "Error! the tempo factor should be between 0.1 and 10\n");
+        return;
+    }
+
+    const uint32_t channels = header.mono_stereo;
+    struct tempo_stream* stream = tempo_Create(mode, channels, header.sample_rate, factor, STREAM_BLOCK_FRAMES);
+    const uint32_t out_capacity = stream ? tempo_MaxOutput(stream, STREAM_BLOCK_FRAMES) : 0;
+    char* raw = alloc_Aligned((size_t)(out_capacity > STREAM_BLOCK_FRAMES ? out_capacity : STREAM_BLOCK_FRAMES) * header.block_align);
+    float* in = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * channels * sizeof(float));
+    float* out = alloc_Aligned((size_t)out_capacity * channels * sizeof(float));
+    if(stream == NULL || raw == NULL || in == NULL || out == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        tempo_Destroy(stream);
+        free_Aligned(raw);
+        free_Aligned(in);
+        free_Aligned(out);
+        return;
+    }
+
+    const uint32_t in_frames = header.data_segment_size / header.block_align;
+    const uint32_t in_data_size = header.data_segment_size;
+    const uint32_t other = header.size_of_file > SIZE_OF_WAVE_HEADER + in_data_size ? header.size_of_file - SIZE_OF_WAVE_HEADER - in_data_size : 0;
+    const uint32_t out_frames = (uint32_t)llround(in_frames / factor);
+    header.data_segment_size = out_frames * header.block_align;
+    header.size_of_file = SIZE_OF_WAVE_HEADER + header.data_segment_size + other;
+    write_WavHeader(&header);
+
+    uint32_t read_frames = 0;
+    uint32_t written = 0;
+    while(written < out_frames){
+        uint32_t frames = in_frames - read_frames < STREAM_BLOCK_FRAMES ? in_frames - read_frames : STREAM_BLOCK_FRAMES;
+        if(frames > 0){
+            if(read_Block(raw, frames * header.block_align) != frames * header.block_align){
+                fprintf(stderr, "Error! insufficient data\n");
+                tempo_Destroy(stream);
+                free_Aligned(raw);
+                free_Aligned(in);
+                free_Aligned(out);
+                return;
+            }
+            pcm_ToFloat(raw, in, frames * channels, header.wave_format, header.bits_per_sample);
+            read_frames += frames;
         } else{
-            uint32_t N = data_segment_size - steps;
-            memcpy(segment, ptr, N);
-            ptr += N;
-            steps += N;
+            // flush the frames still in flight with silence
+            frames = STREAM_BLOCK_FRAMES;
+            memset(in, 0, (size_t)frames * channels * sizeof(float));
         }
 
-        if(caudio_write_data_to_device(fd, segment, segmentSize) == -1){
-            fprintf(stderr, "Error: An unexpected error occured while playing your WAV file\n");
-            caudio_stop_playback(fd);
-            caudio_close_audio_devide(fd);
+        uint32_t produced = tempo_Process(stream, in, frames, out);
+        if(produced > out_frames - written) produced = out_frames - written;
+        pcm_FromFloat(out, raw, produced * channels, header.wave_format, header.bits_per_sample);
+        write_Block(raw, (size_t)produced * header.block_align);
+        written += produced;
+    }
 
-            free(segment);
-            free(buffer);
-            free(data_start_segment);
-            free(RIFF);
-            free(WAVE);
-            free(FMT);
-            return 2;
+    // consume what is left of the input and keep the chunks after the data segment
+    while(read_frames < in_frames){
+        uint32_t frames = in_frames - read_frames < STREAM_BLOCK_FRAMES ? in_frames - read_frames : STREAM_BLOCK_FRAMES;
+        if(read_Block(raw, frames * header.block_align) != frames * header.block_align) break;
+        read_frames += frames;
+    }
+    read_Block(raw, in_data_size % header.block_align);
+    copy_OtherData(SIZE_OF_WAVE_HEADER + in_data_size + other, in_data_size);
+
+    tempo_Destroy(stream);
+    free_Aligned(raw);
+    free_Aligned(in);
+    free_Aligned(out);
+    *flag = 0;
+}
+
+/**
+ * @brief Reads a WAV file from standard input and writes it to standard output with a different sample format
+ * 
+ * @param bits The bit depth of the output: 8, 16, 24 or 32
+ * @param to_float 1 to write 32 bit float samples, 0 to write integer PCM
+ * @param dither 1 to add TPDF dither before quantizing, 0 to round without dither, -1 to dither only when the bit depth is reduced
+ * @param shape 1 to shape the quantization noise towards high frequencies (only used with dither)
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void convert_command(uint16_t bits, short to_float, short dither, short shape, short* flag){
+    struct wav_header header;
+    read_WavHeader(&header, flag);
+    if(*flag) return;
+    *flag = 1;
+
+    if(bits != 8 && bits != 16 && bits != 24 && bits != 32){
+        fprintf(stderr, "Error! bits/sample should be 8, 16, 24 or 32\n");
+        return;
+    }
+    if(to_float && bits != 32){
+        fprintf(stderr, "Error! float samples are always 32 bits\n");
+        return;
+    }
+
+    struct wav_header out_header = header;
+    out_header.wave_format = to_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+    out_header.bits_per_sample = bits;
+    out_header.block_align = (bits / 8) * header.mono_stereo;
+    out_header.bytes_per_sec = header.sample_rate * out_header.block_align;
+
+    // float input has 24 bits of precision
+    uint16_t in_precision = header.wave_format == WAVE_FORMAT_IEEE_FLOAT ? 24 : header.bits_per_sample;
+    if(dither < 0) dither = !to_float && bits < in_precision;
+    if(to_float || bits == 32) dither = 0; // float output needs no dither and 32 bit PCM has more resolution than a float
+    if(shape && dither && header.mono_stereo > DITHER_MAX_CHANNELS){
+        fprintf(stderr, "Error! noise shaping supports at most %d channels\n", DITHER_MAX_CHANNELS);
+        return;
+    }
+
+    const uint32_t channels = header.mono_stereo;
+    const uint32_t in_frames = header.data_segment_size / header.block_align;
+    const uint32_t in_data_size = header.data_segment_size;
+    const uint32_t other = header.size_of_file > SIZE_OF_WAVE_HEADER + in_data_size ? header.size_of_file - SIZE_OF_WAVE_HEADER - in_data_size : 0;
+    const uint64_t out_size = (uint64_t)in_frames * out_header.block_align;
+    if(out_size > UINT32_MAX - SIZE_OF_WAVE_HEADER - other){
+        fprintf(stderr, "Error! the output would be larger than the 4GB limit of WAV files\n");
+        return;
+    }
+    out_header.data_segment_size = (uint32_t)out_size;
+    out_header.size_of_file = SIZE_OF_WAVE_HEADER + out_header.data_segment_size + other;
+
+    const uint32_t largest_align = header.block_align > out_header.block_align ? header.block_align : out_header.block_align;
+    char* raw = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * largest_align);
+    float* samples = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * channels * sizeof(float));
+    float* noise = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * channels * sizeof(float));
+    if(raw == NULL || samples == NULL || noise == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free_Aligned(raw);
+        free_Aligned(samples);
+        free_Aligned(noise);
+        return;
+    }
+
+    struct dither_state state;
+    dither_Init(&state, 0x5EED, shape);
+
+    write_WavHeader(&out_header);
+    uint32_t remaining = in_frames;
+    for(uint64_t block = 0; remaining > 0; block++){
+        uint32_t frames = remaining < STREAM_BLOCK_FRAMES ? remaining : STREAM_BLOCK_FRAMES;
+        if(read_Block(raw, frames * header.block_align) != frames * header.block_align){
+            fprintf(stderr, "Error! insufficient data\n");
+            free_Aligned(raw);
+            free_Aligned(samples);
+            free_Aligned(noise);
+            return;
         }
+        pcm_ToFloat(raw, samples, frames * channels, header.wave_format, header.bits_per_sample);
+        if(dither){
+            // shaped noise depends on the previous samples and stays one stream, plain dither restarts every block
+            if(!shape) dither_Init(&state, dither_BlockSeed(block), 0);
+            dither_Apply(&state, samples, noise, frames, channels, bits);
+        }
+        pcm_FromFloat(samples, raw, frames * channels, out_header.wave_format, bits);
+        write_Block(raw, (size_t)frames * out_header.block_align);
+        remaining -= frames;
     }
 
-    caudio_stop_playback(fd);
-    
-    caudio_close_audio_devide(fd);
+    read_Block(raw, in_data_size % header.block_align);
+    copy_OtherData(SIZE_OF_WAVE_HEADER + in_data_size + other, in_data_size);
 
-    free(segment);
-    free(buffer);
-    free(data_start_segment);
-    free(RIFF);
-    free(WAVE);
-    free(FMT);
+    free_Aligned(raw);
+    free_Aligned(samples);
+    free_Aligned(noise);
+    *flag = 0;
+}
+
+/**
+ * @brief Streams the data segment of a WAV file from standard input to standard output multiplied by a gain envelope
+ * 
+ * 8 and 16 bit samples go through the same multiply/saturate kernels as the volume command. Other formats are
+ * converted to float, scaled and converted back, which clamps them to their range.
+ * 
+ * @param env the envelope, `total` is set here from the header
+ * @param header the header of the input, already read
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void stream_Envelope(struct gain_envelope* env, const struct wav_header* header, short* flag){
+    *flag = 1;
+    const uint32_t channels = header->mono_stereo;
+    const uint32_t in_frames = header->data_segment_size / header->block_align;
+    const uint32_t in_data_size = header->data_segment_size;
+    const uint32_t other = header->size_of_file > SIZE_OF_WAVE_HEADER + in_data_size ? header->size_of_file - SIZE_OF_WAVE_HEADER - in_data_size : 0;
+    const short integer = header->wave_format == WAVE_FORMAT_PCM && header->bits_per_sample <= 16;
+    env->total = in_frames;
+
+    char* raw = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * header->block_align);
+    double* gains = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * channels * sizeof(double));
+    float* samples = integer ? NULL : alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * channels * sizeof(float));
+    if(raw == NULL || gains == NULL || (!integer && samples == NULL)){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free_Aligned(raw);
+        free_Aligned(gains);
+        free_Aligned(samples);
+        return;
+    }
+
+    write_WavHeader(header);
+    uint32_t done = 0;
+    while(done < in_frames){
+        uint32_t frames = in_frames - done < STREAM_BLOCK_FRAMES ? in_frames - done : STREAM_BLOCK_FRAMES;
+        if(read_Block(raw, frames * header->block_align) != frames * header->block_align){
+            fprintf(stderr, "Error! insufficient data\n");
+            free_Aligned(raw);
+            free_Aligned(gains);
+            free_Aligned(samples);
+            return;
+        }
+
+        const uint32_t count = frames * channels;
+        if(!envelope_Fill(env, done, frames, channels, gains)){
+            if(header->bits_per_sample == 8){
+                gain_Apply8bit(raw, raw, count, gains);
+            } else if(integer){
+                gain_Apply16bit(raw, raw, count, gains);
+            } else{
+                pcm_ToFloat(raw, samples, count, header->wave_format, header->bits_per_sample);
+                for(uint32_t i = 0; i < count; i++){
+                    samples[i] = (float)(samples[i] * gains[i]);
+                }
+                pcm_FromFloat(samples, raw, count, header->wave_format, header->bits_per_sample);
+            }
+        }
+        write_Block(raw, (size_t)frames * header->block_align);
+        done += frames;
+    }
+
+    read_Block(raw, in_data_size % header->block_align);
+    copy_OtherData(SIZE_OF_WAVE_HEADER + in_data_size + other, in_data_size);
+
+    free_Aligned(raw);
+    free_Aligned(gains);
+    free_Aligned(samples);
+    *flag = 0;
+}
+
+/**
+ * @brief Reads a WAV file from standard input and writes it to standard output with a fade in and/or a fade out
+ * 
+ * @param fade_in The length of the fade in, in seconds. 0 for none
+ * @param fade_out The length of the fade out, in seconds. 0 for none
+ * @param curve The shape of the fades, one of the ENVELOPE_CURVE_* values
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void fade_command(double fade_in, double fade_out, int curve, short* flag){
+    struct wav_header header;
+    read_WavHeader(&header, flag);
+    if(*flag) return;
+
+    struct gain_envelope env;
+    memset(&env, 0, sizeof(env));
+    env.fade_in = (uint64_t)llround(fade_in * header.sample_rate);
+    env.fade_out = (uint64_t)llround(fade_out * header.sample_rate);
+    env.curve = curve;
+    stream_Envelope(&env, &header, flag);
+}
+
+/**
+ * @brief Reads a WAV file from standard input and writes it to standard output multiplied by a breakpoint envelope
+ * 
+ * @param path A text file with one "<time> <gain>" pair per line, see envelope_Load
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void envelope_command(const char* path, short* flag){
+    struct wav_header header;
+    read_WavHeader(&header, flag);
+    if(*flag) return;
+
+    struct gain_envelope env;
+    memset(&env, 0, sizeof(env));
+    if(envelope_Load(&env, path, header.sample_rate) != 0){
+        *flag = 1;
+        return;
+    }
+    stream_Envelope(&env, &header, flag);
+    envelope_Free(&env);
+}
+
+/**
+ * @brief Where the trim mode of the silence command reads frames from
+ */
+struct silence_source {
+    int fd;                 // STDIN when it is seekable, frames are read with pread
+    char* data;             // otherwise the whole data segment, read up front
+    uint32_t block_align;
+};
+
+/**
+ * @brief Reads `frames` frames starting at frame `first` of the data segment
+ *
+ * @returns 0 on success or -1 if the input is shorter than its header claims
+ */
+int silence_ReadFrames(const struct silence_source* source, uint32_t first, uint32_t frames, char* raw){
+    size_t size = (size_t)frames * source->block_align;
+    off_t offset = (off_t)first * source->block_align;
+    if(source->data != NULL){
+        memcpy(raw, source->data + offset, size);
+        return 0;
+    }
+    offset += SIZE_OF_WAVE_HEADER + 8;
+    while(size > 0){
+        ssize_t got = pread(source->fd, raw, size, offset);
+        if(got <= 0) return -1;
+        raw += got;
+        offset += got;
+        size -= (size_t)got;
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Closes a segment of the split mode, dropping the silence written after its last loud window
+ */
+void silence_CloseSegment(FILE* out, struct wav_header header, uint32_t frames){
+    header.data_segment_size = frames * header.block_align;
+    header.size_of_file = SIZE_OF_WAVE_HEADER + header.data_segment_size;
+    fflush(out);
+    if(ftruncate(fileno(out), (off_t)SIZE_OF_WAVE_HEADER + 8 + header.data_segment_size) != 0){
+        fprintf(stderr, "Warning: unable to truncate a segment\n");
+    }
+    fseek(out, 0, SEEK_SET);
+    fwrite_WavHeader(out, &header);
+    fclose(out);
+}
+
+/**
+ * @brief Trims the leading and trailing silence of the WAV file on STDIN and writes the result to STDOUT
+ *
+ * The leading silence is found by scanning forward from the start. When STDIN is seekable the trailing silence is
+ * found by scanning backward from the end, so the silent middle of the data is never read twice and the silent end
+ * is read only once. Otherwise the data segment is read in memory first.
+ */
+void silence_Trim(const struct wav_header* header, double threshold, short* flag){
+    *flag = 1;
+    const uint32_t channels = header->mono_stereo;
+    const uint32_t in_frames = header->data_segment_size / header->block_align;
+    const uint32_t in_data_size = header->data_segment_size;
+    const uint32_t other = header->size_of_file > SIZE_OF_WAVE_HEADER + in_data_size ? header->size_of_file - SIZE_OF_WAVE_HEADER - in_data_size : 0;
+    const uint32_t window = silence_WindowFrames(header->sample_rate);
+    const uint32_t block = STREAM_BLOCK_FRAMES > window ? STREAM_BLOCK_FRAMES / window * window : window;
+
+    struct silence_source source = {fileno(IO_IN), NULL, header->block_align};
+    const short seekable = lseek(source.fd, 0, SEEK_CUR) >= 0;
+    char* raw = alloc_Aligned((size_t)block * header->block_align);
+    float* scratch = alloc_Aligned((size_t)window * channels * sizeof(float));
+    if(!seekable) source.data = alloc_Aligned(in_data_size > 0 ? in_data_size : 1);
+    if(raw == NULL || scratch == NULL || (!seekable && source.data == NULL)){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free_Aligned(raw);
+        free_Aligned(scratch);
+        free_Aligned(source.data);
+        return;
+    }
+    if(!seekable && read_Block(source.data, in_data_size) != in_data_size){
+        fprintf(stderr, "Error! insufficient data\n");
+        free_Aligned(raw);
+        free_Aligned(scratch);
+        free_Aligned(source.data);
+        return;
+    }
+
+    // Forward to the first loud sample
+    uint32_t start = in_frames;
+    short error = 0;
+    for(uint32_t pos = 0; pos < in_frames && start == in_frames && !error; pos += block){
+        uint32_t n = in_frames - pos < block ? in_frames - pos : block;
+        error = silence_ReadFrames(&source, pos, n, raw) != 0;
+        for(uint32_t off = 0; off < n && !error; off += window){
+            uint32_t m = n - off < window ? n - off : window;
+            const char* w = raw + (size_t)off * header->block_align;
+            if(!silence_IsQuiet(w, m, header, threshold, scratch)){
+                start = pos + off + silence_FirstLoud(w, m, header, threshold, scratch);
+                break;
+            }
+        }
+    }
+
+    // Backward from the end to the last loud sample, with windows aligned to the end of the data
+    uint32_t end = start;
+    for(uint32_t last = in_frames; last > start && end == start && !error;){
+        uint32_t n = last - start < block ? last - start : block;
+        error = silence_ReadFrames(&source, last - n, n, raw) != 0;
+        for(uint32_t off = n; off > 0 && !error;){
+            uint32_t m = off < window ? off : window;
+            const char* w = raw + (size_t)(off - m) * header->block_align;
+            if(!silence_IsQuiet(w, m, header, threshold, scratch)){
+                end = last - n + off - m + silence_LastLoud(w, m, header, threshold, scratch);
+                break;
+            }
+            off -= m;
+        }
+        last -= n;
+    }
+
+    if(error){
+        fprintf(stderr, "Error! insufficient data\n");
+        free_Aligned(raw);
+        free_Aligned(scratch);
+        free_Aligned(source.data);
+        return;
+    }
+
+    struct wav_header out_header = *header;
+    out_header.data_segment_size = (end - start) * header->block_align;
+    out_header.size_of_file = SIZE_OF_WAVE_HEADER + out_header.data_segment_size + other;
+    write_WavHeader(&out_header);
+    for(uint32_t pos = start; pos < end && !error; pos += block){
+        uint32_t n = end - pos < block ? end - pos : block;
+        error = silence_ReadFrames(&source, pos, n, raw) != 0;
+        write_Block(raw, (size_t)n * header->block_align);
+    }
+
+    // keep the chunks after the data segment
+    if(seekable){
+        off_t offset = (off_t)SIZE_OF_WAVE_HEADER + 8 + in_data_size;
+        for(uint32_t copied = 0; copied < other;){
+            ssize_t got = pread(source.fd, raw, other - copied < block ? other - copied : block, offset + copied);
+            if(got <= 0) break;
+            write_Block(raw, (size_t)got);
+            copied += (uint32_t)got;
+        }
+    } else{
+        copy_OtherData(SIZE_OF_WAVE_HEADER + in_data_size + other, in_data_size);
+    }
+
+    free_Aligned(raw);
+    free_Aligned(scratch);
+    free_Aligned(source.data);
+    *flag = error;
+}
+
+/**
+ * @brief Finds the silent regions of the WAV file on STDIN
+ *
+ * A window of SILENCE_WINDOW_MS milliseconds is silent when no sample of any channel is louder than the threshold.
+ * Consecutive silent windows form a region, which extends to the last loud sample before them and the first loud
+ * sample after them.
+ *
+ * @param threshold The threshold as a fraction of full scale
+ * @param min_seconds Regions shorter than this are ignored by the report and split modes
+ * @param mode SILENCE_REPORT prints the regions as CSV, SILENCE_TRIM writes the file without its leading and
+ * trailing silence to STDOUT and SILENCE_SPLIT writes every part between regions to <prefix>_001.wav, <prefix>_002.wav ...
+ * @param prefix The prefix of the files of the split mode
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void silence_command(double threshold, double min_seconds, int mode, const char* prefix, short* flag){
+    struct wav_header header;
+    read_WavHeader(&header, flag);
+    if(*flag) return;
+
+    if(mode == SILENCE_TRIM){
+        silence_Trim(&header, threshold, flag);
+        return;
+    }
+    *flag = 1;
+
+    const uint32_t channels = header.mono_stereo;
+    const uint32_t in_frames = header.data_segment_size / header.block_align;
+    const uint32_t window = silence_WindowFrames(header.sample_rate);
+    const uint32_t block = STREAM_BLOCK_FRAMES > window ? STREAM_BLOCK_FRAMES / window * window : window;
+    const uint64_t min_frames = (uint64_t)llround(min_seconds * header.sample_rate);
+    const double rate = header.sample_rate;
+
+    char* raw = alloc_Aligned((size_t)block * header.block_align);
+    float* scratch = alloc_Aligned((size_t)window * channels * sizeof(float));
+    if(raw == NULL || scratch == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free_Aligned(raw);
+        free_Aligned(scratch);
+        return;
+    }
+
+    struct wav_header segment_header = header;
+    FILE* segment = NULL;
+    uint32_t segment_start = 0, segment_frames = 0, segment_loud = 0, segments = 0;
+    char name[4096];
+
+    // a region runs from the end of the last loud sample to the next loud sample, loud_end is the former
+    uint32_t run_start = 0, run = 0, loud_end = 0;
+    if(mode == SILENCE_REPORT) fprintf(IO_OUT, "start,end,duration\n");
+    else fprintf(IO_OUT, "file,start,end\n");
+
+    for(uint32_t pos = 0; pos < in_frames; pos += block){
+        uint32_t n = in_frames - pos < block ? in_frames - pos : block;
+        if(read_Block(raw, n * header.block_align) != n * header.block_align){
+            fprintf(stderr, "Error! insufficient data\n");
+            if(segment != NULL) silence_CloseSegment(segment, segment_header, segment_loud);
+            free_Aligned(raw);
+            free_Aligned(scratch);
+            return;
+        }
+
+        for(uint32_t off = 0; off < n; off += window){
+            uint32_t m = n - off < window ? n - off : window;
+            const char* w = raw + (size_t)off * header.block_align;
+            uint32_t frame = pos + off;
+            if(silence_IsQuiet(w, m, &header, threshold, scratch)){
+                if(run == 0) run_start = loud_end;
+                run = frame + m - run_start;
+                if(segment != NULL){
+                    // written tentatively, cut off again if the region turns out long enough
+                    fwrite(w, 1, (size_t)m * header.block_align, segment);
+                    segment_frames += m;
+                    if(run >= min_frames){
+                        silence_CloseSegment(segment, segment_header, segment_loud);
+                        fprintf(IO_OUT, "%s,%.3f,%.3f\n", name, segment_start / rate, (segment_start + segment_loud) / rate);
+                        segment = NULL;
+                    }
+                }
+                continue;
+            }
+
+            const uint32_t first = silence_FirstLoud(w, m, &header, threshold, scratch);
+            const uint32_t end = frame + first;
+            if(mode == SILENCE_REPORT && run > 0 && end - run_start >= min_frames){
+                fprintf(IO_OUT, "%.3f,%.3f,%.3f\n", run_start / rate, end / rate, (end - run_start) / rate);
+            }
+            if(segment != NULL && run > 0 && end - run_start >= min_frames){
+                // long enough only with the quiet start of this window
+                silence_CloseSegment(segment, segment_header, segment_loud);
+                fprintf(IO_OUT, "%s,%.3f,%.3f\n", name, segment_start / rate, (segment_start + segment_loud) / rate);
+                segment = NULL;
+            }
+            run = 0;
+            loud_end = frame + silence_LastLoud(w, m, &header, threshold, scratch);
+            if(mode == SILENCE_SPLIT){
+                if(segment == NULL){
+                    snprintf(name, sizeof(name), "%s_%03" PRIu32 ".wav", prefix, ++segments);
+                    segment = fopen(name, "wb");
+                    if(segment == NULL){
+                        fprintf(stderr, "Error! unable to create %s\n", name);
+                        free_Aligned(raw);
+                        free_Aligned(scratch);
+                        return;
+                    }
+                    fwrite_WavHeader(segment, &segment_header);
+                    segment_start = end;
+                    segment_frames = 0;
+                    fwrite(w + (size_t)first * header.block_align, 1, (size_t)(m - first) * header.block_align, segment);
+                    segment_frames += m - first;
+                } else{
+                    fwrite(w, 1, (size_t)m * header.block_align, segment);
+                    segment_frames += m;
+                }
+                segment_loud = loud_end - segment_start;
+            }
+        }
+    }
+
+    if(mode == SILENCE_REPORT && run > 0 && run >= min_frames){
+        fprintf(IO_OUT, "%.3f,%.3f,%.3f\n", run_start / rate, in_frames / rate, run / rate);
+    }
+    if(segment != NULL){
+        silence_CloseSegment(segment, segment_header, segment_loud);
+        fprintf(IO_OUT, "%s,%.3f,%.3f\n", name, segment_start / rate, (segment_start + segment_loud) / rate);
+    }
+
+    free_Aligned(raw);
+    free_Aligned(scratch);
+    *flag = 0;
+}
+
+/**
+ * @brief Writes to STDOUT a WAV file with the mix of a set of wavetable or noise voices
+ * 
+ * @param specs The voices
+ * @param count The number of voices
+ * @param duration The duration in seconds
+ * @param sample_rate The sample rate in Hz
+ * @param channels The number of channels, 1 to SYNTH_MAX_CHANNELS. Voices without a channel play on all of them
+ * @param bits The bit depth of the output: 8, 16, 24 or 32
+ * @param to_float 1 to write 32 bit float samples, 0 to write integer PCM
+ * @param amplitude The gain of the mix as a fraction of full scale
+ * @param sweep SYNTH_SWEEP_LINEAR or SYNTH_SWEEP_LOG, for voices with a frequency range
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void generate_command(const struct synth_voice_spec* specs, uint32_t count, double duration, uint32_t sample_rate,
+                      uint16_t channels, uint16_t bits, short to_float, double amplitude, int sweep, short* flag){
+    *flag = 1;
+    if(sample_rate < 1000 || sample_rate > 768000){
+        fprintf(stderr, "Error! the sample rate should be between 1000 and 768000 Hz\n");
+        return;
+    }
+    if(channels < 1 || channels > SYNTH_MAX_CHANNELS){
+        fprintf(stderr, "Error! the number of channels should be between 1 and %d\n", SYNTH_MAX_CHANNELS);
+        return;
+    }
+    if((bits != 8 && bits != 16 && bits != 24 && bits != 32) || (to_float && bits != 32)){
+        fprintf(stderr, "Error! bits/sample should be 8, 16, 24, 32 or 32f\n");
+        return;
+    }
+    for(uint32_t i = 0; i < count; i++){
+        if(specs[i].wave < SYNTH_TABLE_WAVES && (specs[i].frequency >= sample_rate / 2.0 || specs[i].to >= sample_rate / 2.0)){
+            fprintf(stderr, "Error! the frequency of voice %" PRIu32 " should be below %g Hz\n", i + 1, sample_rate / 2.0);
+            return;
+        }
+    }
+
+    struct wav_header header;
+    header.format_chunk = 16;
+    header.wave_format = to_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+    header.mono_stereo = channels;
+    header.sample_rate = sample_rate;
+    header.bits_per_sample = bits;
+    header.block_align = (bits / 8) * channels;
+    header.bytes_per_sec = sample_rate * header.block_align;
+    const double frames_wanted = duration > 0 ? floor(duration * sample_rate) : 0.0;
+    if(frames_wanted * header.block_align > UINT32_MAX - SIZE_OF_WAVE_HEADER){
+        fprintf(stderr, "Error! the output would be larger than the 4GB limit of WAV files\n");
+        return;
+    }
+    const uint32_t frames = (uint32_t)frames_wanted;
+    header.data_segment_size = frames * header.block_align;
+    header.size_of_file = SIZE_OF_WAVE_HEADER + header.data_segment_size;
+
+    struct synth_tables* tables = synth_tables_Create();
+    struct synth* synth = tables ? synth_Create(tables, specs, count, sample_rate, channels, frames, sweep) : NULL;
+    float* mix = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * channels * sizeof(float));
+    char* raw = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * header.block_align);
+    if(tables == NULL || synth == NULL || mix == NULL || raw == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        synth_tables_Destroy(tables);
+        synth_Destroy(synth);
+        free_Aligned(mix);
+        free_Aligned(raw);
+        return;
+    }
+
+    write_WavHeader(&header);
+    const float gain = (float)amplitude;
+    for(uint32_t done = 0; done < frames;){
+        uint32_t n = frames - done < STREAM_BLOCK_FRAMES ? frames - done : STREAM_BLOCK_FRAMES;
+        synth_Render(synth, mix, n);
+        for(uint32_t i = 0; i < n * channels; i++){
+            mix[i] *= gain;
+        }
+        pcm_FromFloat(mix, raw, n * channels, header.wave_format, bits);
+        write_Block(raw, (size_t)n * header.block_align);
+        done += n;
+    }
+
+    synth_tables_Destroy(tables);
+    synth_Destroy(synth);
+    free_Aligned(mix);
+    free_Aligned(raw);
+    *flag = 0;
+}
+
+/**
+ * @brief Reads a WAV file from standard input and writes it to standard output with its channels remixed by a gain matrix
+ * 
+ * @param spec A preset (mono, stereo, 5.1-stereo) or a matrix with one row of gains per output channel, see remix.h
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void remix_command(const char* spec, short* flag){
+    struct wav_header header;
+    fread_WavHeaderChannels(IO_IN, &header, REMIX_MAX_CHANNELS, flag);
+    if(*flag) return;
+    *flag = 1;
+
+    struct remix_matrix mx;
+    short preset = remix_Preset(&mx, spec, header.mono_stereo);
+    if(preset < 0){
+        fprintf(stderr, "Error! the %s preset does not apply to a file with %d channels\n", spec, header.mono_stereo);
+        return;
+    }
+    if(preset > 0 && remix_ParseMatrix(&mx, spec) != 0){
+        fprintf(stderr, "Error! invalid matrix %s, expected rows of gains such as 0.5,0.5 or 1/1 and at most %d channels\n",
+                spec, REMIX_MAX_CHANNELS);
+        return;
+    }
+    if(mx.in_channels != header.mono_stereo){
+        fprintf(stderr, "Error! the matrix has %d inputs but the file has %d channels\n", mx.in_channels, header.mono_stereo);
+        return;
+    }
+
+    struct wav_header out_header = header;
+    out_header.mono_stereo = mx.out_channels;
+    out_header.block_align = (header.bits_per_sample / 8) * mx.out_channels;
+    out_header.bytes_per_sec = header.sample_rate * out_header.block_align;
+
+    const uint32_t in_frames = header.data_segment_size / header.block_align;
+    const uint32_t in_data_size = header.data_segment_size;
+    const uint32_t other = header.size_of_file > SIZE_OF_WAVE_HEADER + in_data_size ? header.size_of_file - SIZE_OF_WAVE_HEADER - in_data_size : 0;
+    const uint64_t out_size = (uint64_t)in_frames * out_header.block_align;
+    if(out_size > UINT32_MAX - SIZE_OF_WAVE_HEADER - other){
+        fprintf(stderr, "Error! the output would be larger than the 4GB limit of WAV files\n");
+        return;
+    }
+    out_header.data_segment_size = (uint32_t)out_size;
+    out_header.size_of_file = SIZE_OF_WAVE_HEADER + out_header.data_segment_size + other;
+
+    const uint32_t largest_align = header.block_align > out_header.block_align ? header.block_align : out_header.block_align;
+    char* raw = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * largest_align);
+    float* samples = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * header.mono_stereo * sizeof(float));
+    float* mixed = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * mx.out_channels * sizeof(float));
+    if(raw == NULL || samples == NULL || mixed == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free_Aligned(raw);
+        free_Aligned(samples);
+        free_Aligned(mixed);
+        return;
+    }
+
+    write_WavHeader(&out_header);
+    for(uint32_t remaining = in_frames; remaining > 0;){
+        uint32_t frames = remaining < STREAM_BLOCK_FRAMES ? remaining : STREAM_BLOCK_FRAMES;
+        if(read_Block(raw, frames * header.block_align) != frames * header.block_align){
+            fprintf(stderr, "Error! insufficient data\n");
+            free_Aligned(raw);
+            free_Aligned(samples);
+            free_Aligned(mixed);
+            return;
+        }
+        pcm_ToFloat(raw, samples, frames * header.mono_stereo, header.wave_format, header.bits_per_sample);
+        remix_Apply(&mx, samples, mixed, frames);
+        pcm_FromFloat(mixed, raw, frames * mx.out_channels, header.wave_format, header.bits_per_sample);
+        write_Block(raw, (size_t)frames * out_header.block_align);
+        remaining -= frames;
+    }
+
+    read_Block(raw, in_data_size % header.block_align);
+    copy_OtherData(SIZE_OF_WAVE_HEADER + in_data_size + other, in_data_size);
+
+    free_Aligned(raw);
+    free_Aligned(samples);
+    free_Aligned(mixed);
+    *flag = 0;
+}
+
+/**
+ * @brief Renders a range of an edit decision list project to STDOUT as a WAV file
+ *
+ * Only the frames of the range are pulled through the ops of the project, see project.h
+ *
+ * @param path The project file
+ * @param start The start of the range in seconds
+ * @param duration The length of the range in seconds, negative for the rest of the project
+ * @param bits The bit depth of the output: 8, 16, 24 or 32, or 0 for the format of the first source
+ * @param to_float 1 to write 32 bit float samples, 0 to write integer PCM
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void render_command(const char* path, double start, double duration, uint16_t bits, short to_float, short* flag){
+    *flag = 1;
+    if(bits != 0 && ((bits != 8 && bits != 16 && bits != 24 && bits != 32) || (to_float && bits != 32))){
+        fprintf(stderr, "Error! bits/sample should be 8, 16, 24, 32 or 32f\n");
+        return;
+    }
+    struct project project;
+    if(project_Load(&project, path) != 0) return;
+    const struct project_node* output = &project.nodes[project.output];
+
+    const struct wav_header* source = &project.nodes[0].header;
+    struct wav_header header;
+    header.format_chunk = 16;
+    header.wave_format = bits != 0 ? (to_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM) : source->wave_format;
+    header.mono_stereo = output->channels;
+    header.sample_rate = output->sample_rate;
+    header.bits_per_sample = bits != 0 ? bits : source->bits_per_sample;
+    header.block_align = (header.bits_per_sample / 8) * output->channels;
+    header.bytes_per_sec = header.sample_rate * header.block_align;
+
+    uint64_t first = (uint64_t)llround(start * output->sample_rate);
+    if(first > output->frames) first = output->frames;
+    uint64_t frames = output->frames - first;
+    if(duration >= 0 && (uint64_t)llround(duration * output->sample_rate) < frames) frames = (uint64_t)llround(duration * output->sample_rate);
+    if(frames * header.block_align > UINT32_MAX - SIZE_OF_WAVE_HEADER){
+        fprintf(stderr, "Error! the output would be larger than the 4GB limit of WAV files\n");
+        project_Free(&project);
+        return;
+    }
+    header.data_segment_size = (uint32_t)(frames * header.block_align);
+    header.size_of_file = SIZE_OF_WAVE_HEADER + header.data_segment_size;
+
+    float* samples = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * output->channels * sizeof(float));
+    char* raw = alloc_Aligned((size_t)STREAM_BLOCK_FRAMES * header.block_align);
+    if(samples == NULL || raw == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free_Aligned(samples);
+        free_Aligned(raw);
+        project_Free(&project);
+        return;
+    }
+
+    write_WavHeader(&header);
+    for(uint64_t done = 0; done < frames;){
+        uint32_t n = frames - done < STREAM_BLOCK_FRAMES ? (uint32_t)(frames - done) : STREAM_BLOCK_FRAMES;
+        if(project_Pull(&project, project.output, first + done, n, samples)) break;
+        pcm_FromFloat(samples, raw, n * output->channels, header.wave_format, header.bits_per_sample);
+        write_Block(raw, (size_t)n * header.block_align);
+        done += n;
+        if(done == frames) *flag = 0;
+    }
+    if(frames == 0) *flag = 0;
+
+    free_Aligned(samples);
+    free_Aligned(raw);
+    project_Free(&project);
+}
+
+/**
+ * @brief Reads a WAV file from standard input and writes it to standard output as a FLAC stream
+ *
+ * Batches of frames are encoded on several threads and written in order. When STDOUT can seek, STREAMINFO is
+ * completed at the end with the sizes of the frames and the MD5 of the samples, otherwise they are left unknown.
+ *
+ * @param params The block size and how hard the encoder searches, see flac_Level()
+ * @param threads The number of threads that encode frames in parallel
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void encode_flac_command(const struct flac_params* params, int threads, short* flag){
+    struct wav_header header;
+    fread_WavHeaderChannels(IO_IN, &header, FLAC_MAX_CHANNELS, flag);
+    if(*flag) return;
+    *flag = 1;
+    if(header.wave_format != WAVE_FORMAT_PCM || header.bits_per_sample > 24){
+        fprintf(stderr, "Error! FLAC stores 8, 16 or 24 bit integer samples, convert the data first\n");
+        return;
+    }
+    if(header.sample_rate == 0 || header.sample_rate >= (1u << 20)){
+        fprintf(stderr, "Error! FLAC supports sample rates from 1 to 1048575 Hz\n");
+        return;
+    }
+    if(threads < 1) threads = 1;
+
+    const struct flac_format format = {header.sample_rate, header.mono_stereo, header.bits_per_sample};
+    const uint32_t block = params->block;
+    const uint32_t batch = FLAC_FRAMES_PER_THREAD * (uint32_t)threads;
+    const size_t capacity = flac_FrameCapacity(block, &format);
+    const size_t frame_bytes = (size_t)block * header.block_align;
+    const uint64_t total = header.data_segment_size / header.block_align;
+
+    char* raw = alloc_Aligned(batch * frame_bytes);
+    uint8_t* signed_raw = header.bits_per_sample == 8 ? malloc(batch * frame_bytes) : NULL;
+    uint8_t* frames = malloc(batch * capacity);
+    size_t* sizes = malloc(batch * sizeof(size_t));
+    pthread_t* ids = malloc(threads * sizeof(pthread_t));
+    struct flac_job* jobs = malloc(threads * sizeof(struct flac_job));
+    if(raw == NULL || (header.bits_per_sample == 8 && signed_raw == NULL) || frames == NULL || sizes == NULL ||
+       ids == NULL || jobs == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        goto cleanup;
+    }
+
+    // STREAMINFO, completed at the end when the output can seek
+    uint8_t info[42];
+    fflush(IO_OUT);
+    const off_t info_offset = ftello(IO_OUT);
+    flac_FormatStreamInfo(info, &format, block, 0, 0, total, NULL);
+    stats_Format(1, header.bits_per_sample);
+    write_Block(info, sizeof(info));
+
+    struct flac_md5 md5;
+    flac_md5_Init(&md5);
+    uint64_t number = 0;
+    uint64_t encoded = 0;
+    uint32_t min_frame = UINT32_MAX, max_frame = 0;
+    while(encoded < total){
+        const uint32_t samples = total - encoded < (uint64_t)batch * block ? (uint32_t)(total - encoded) : batch * block;
+        if(read_Block(raw, samples * header.block_align) != samples * header.block_align){
+            fprintf(stderr, "Error! insufficient data\n");
+            goto cleanup;
+        }
+        // the MD5 covers signed samples, 8 bit WAV data is unsigned
+        if(signed_raw != NULL){
+            for(uint32_t i = 0; i < samples * header.block_align; i++) signed_raw[i] = (uint8_t)raw[i] ^ 0x80;
+            flac_md5_Update(&md5, signed_raw, (size_t)samples * header.block_align);
+        } else{
+            flac_md5_Update(&md5, raw, (size_t)samples * header.block_align);
+        }
+
+        const uint32_t count = (samples + block - 1) / block;
+        const uint32_t per_thread = (count + threads - 1) / threads;
+        for(int t = 0; t < threads; t++){
+            jobs[t].params = params;
+            jobs[t].format = &format;
+            jobs[t].raw = raw;
+            jobs[t].samples = samples;
+            jobs[t].number = number;
+            jobs[t].out = frames;
+            jobs[t].sizes = sizes;
+            jobs[t].first = t * per_thread < count ? t * per_thread : count;
+            jobs[t].last = jobs[t].first + per_thread < count ? jobs[t].first + per_thread : count;
+            jobs[t].threaded = 0;
+        }
+        short failed = 0;
+        for(int t = 0; t < threads; t++){
+            if(jobs[t].first == jobs[t].last) continue;
+            // the calling thread encodes the last slice itself
+            if(t < threads - 1 && pthread_create(&ids[t], NULL, flac_Worker, &jobs[t]) == 0){
+                jobs[t].threaded = 1;
+            } else{
+                failed |= flac_Worker(&jobs[t]) != NULL;
+            }
+        }
+        for(int t = 0; t < threads; t++){
+            void* result = NULL;
+            if(jobs[t].threaded) pthread_join(ids[t], &result);
+            failed |= result != NULL;
+        }
+        if(failed){
+            fprintf(stderr, "Error! unable to allocate memory\n");
+            goto cleanup;
+        }
+
+        for(uint32_t f = 0; f < count; f++){
+            if(write_Block(frames + f * capacity, sizes[f]) != sizes[f]){
+                fprintf(stderr, "Error! unable to write the output\n");
+                goto cleanup;
+            }
+            if(sizes[f] < min_frame) min_frame = (uint32_t)sizes[f];
+            if(sizes[f] > max_frame) max_frame = (uint32_t)sizes[f];
+        }
+        number += count;
+        encoded += samples;
+    }
+
+    uint8_t digest[16];
+    flac_md5_Final(&md5, digest);
+    if(info_offset >= 0 && fflush(IO_OUT) == 0){
+        off_t end_offset = ftello(IO_OUT);
+        if(fseeko(IO_OUT, info_offset, SEEK_SET) == 0){
+            flac_FormatStreamInfo(info, &format, block, min_frame == UINT32_MAX ? 0 : min_frame, max_frame, total, digest);
+            fwrite(info, 1, sizeof(info), IO_OUT);
+            fseeko(IO_OUT, end_offset, SEEK_SET);
+        }
+    }
+    *flag = 0;
+
+cleanup:
+    free_Aligned(raw);
+    free(signed_raw);
+    free(frames);
+    free(sizes);
+    free(ids);
+    free(jobs);
+}
+
+/**
+ * @brief Reads a FLAC stream from standard input and writes it to standard output as a WAV file, see flac_Decode()
+ *
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void decode_flac_command(short* flag){
+    *flag = flac_Decode(IO_IN, IO_OUT) == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Encodes the WAV file provided through STDIN to mu-law, A-law or IMA ADPCM and writes it to STDOUT
+ *
+ * The samples are rounded to 16 bits and encoded block by block: companded samples through the tables of codec.h,
+ * ADPCM in blocks of codec_AdpcmBlockAlign() bytes whose step index carries over from one block to the next.
+ *
+ * @param format WAVE_FORMAT_MULAW, WAVE_FORMAT_ALAW or WAVE_FORMAT_IMA_ADPCM
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void encode_codec_command(uint16_t format, short* flag){
+    struct wav_header header;
+    fread_WavHeaderChannels(IO_IN, &header, CODEC_MAX_CHANNELS, flag);
+    if(*flag) return;
+    *flag = 1;
+    pthread_once(&codec_tables_once, codec_InitTables);
+
+    const uint32_t channels = header.mono_stereo;
+    const uint32_t in_frames = header.data_segment_size / header.block_align;
+    const short adpcm = format == WAVE_FORMAT_IMA_ADPCM;
+    const uint32_t align = adpcm ? codec_AdpcmBlockAlign(header.sample_rate, channels) : channels;
+    const uint32_t per_block = adpcm ? codec_AdpcmSamples(align, channels) : 1;
+    // ADPCM goes through whole blocks, the last one shorter, with its last group of 8 codes padded
+    const uint32_t rest = in_frames % per_block;
+    const uint64_t out_size = (uint64_t)(in_frames / per_block) * align +
+                              (rest == 0 ? 0 : 4 * channels * (1 + (rest - 1 + 7) / 8));
+    if(out_size > UINT32_MAX - 60){
+        fprintf(stderr, "Error! the output would be larger than the 4GB limit of WAV files\n");
+        return;
+    }
+    const uint32_t batch = adpcm ? (STREAM_BLOCK_FRAMES / per_block + 1) * per_block : STREAM_BLOCK_FRAMES;
+    char* raw = alloc_Aligned((size_t)batch * header.block_align);
+    float* samples = alloc_Aligned((size_t)batch * channels * sizeof(float));
+    int16_t* pcm = alloc_Aligned((size_t)batch * channels * sizeof(int16_t));
+    uint8_t* coded = malloc((size_t)batch * channels + align);
+    if(raw == NULL || samples == NULL || pcm == NULL || coded == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+        free_Aligned(raw);
+        free_Aligned(samples);
+        free_Aligned(pcm);
+        free(coded);
+        return;
+    }
+
+    codec_WriteHeader(format, (uint16_t)channels, header.sample_rate, in_frames, (uint32_t)out_size);
+    struct codec_adpcm_state states[CODEC_MAX_CHANNELS];
+    memset(states, 0, sizeof(states));
+    uint32_t remaining = in_frames;
+    while(remaining > 0){
+        uint32_t frames = remaining < batch ? remaining : batch;
+        if(read_Block(raw, frames * header.block_align) != frames * header.block_align){
+            fprintf(stderr, "Error! insufficient data\n");
+            break;
+        }
+        const size_t n = (size_t)frames * channels;
+        pcm_ToFloat(raw, samples, (uint32_t)n, header.wave_format, header.bits_per_sample);
+        pcm_FromFloat(samples, (char*)pcm, (uint32_t)n, WAVE_FORMAT_PCM, 16);
+        size_t size = n;
+        if(format == WAVE_FORMAT_MULAW) codec_PcmToUlaw(pcm, coded, n);
+        else if(format == WAVE_FORMAT_ALAW) codec_PcmToAlaw(pcm, coded, n);
+        else{
+            size = 0;
+            for(uint32_t done = 0; done < frames; done += per_block){
+                uint32_t count = frames - done < per_block ? frames - done : per_block;
+                size += codec_AdpcmEncodeBlock(pcm + (size_t)done * channels, channels, count, states, coded + size);
+            }
+        }
+        write_Block(coded, size);
+        remaining -= frames;
+    }
+
+    free_Aligned(raw);
+    free_Aligned(samples);
+    free_Aligned(pcm);
+    free(coded);
+    if(remaining == 0) *flag = 0;
+}
+
+/**
+ * @brief Fingerprints WAV files, or the WAV file provided through STDIN, and writes the hashes to STDOUT
+ *
+ * Every file is a line "# <name> <seconds> <hashes>" followed by one line "<hash> <frame>" per hash, the hash as 6
+ * hexadecimal digits and the frame in steps of FINGERPRINT_HOP samples at FINGERPRINT_RATE.
+ *
+ * @param inputs files and directories, STDIN when there are none
+ * @param threads the number of files fingerprinted at once
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void fingerprint_command(char* const* inputs, int input_count, int threads, short* flag){
+    *flag = 1;
+    char* stdin_name = "-";
+    char** paths = NULL;
+    int count = 1;
+    if(input_count > 0){
+        count = fingerprint_Paths(inputs, input_count, &paths);
+        if(count < 0) return;
+    }
+    struct fingerprint* results = calloc(count > 0 ? count : 1, sizeof(struct fingerprint));
+    short* failed = calloc(count > 0 ? count : 1, sizeof(short));
+    if(results == NULL || failed == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+    } else if(input_count == 0){
+        struct fft_plan* plan = fft_plan_Create(FINGERPRINT_FFT);
+        struct codec_stream stream;
+        FILE* in = plan != NULL ? flac_Open(IO_IN, &stream) : NULL;
+        failed[0] = in == NULL || fingerprint_Stream(in, plan, &results[0]) != 0;
+        if(in != NULL && codec_StreamClose(&stream) == 1) failed[0] = 1;
+        fft_plan_Destroy(plan);
+    } else{
+        if(fingerprint_Files(paths, (uint32_t)count, threads, results, failed) != 0) failed[0] = count > 0;
+    }
+
+    short any_failed = results == NULL || failed == NULL;
+    for(int f = 0; results != NULL && failed != NULL && f < count; f++){
+        if(failed[f]){
+            any_failed = 1;
+            continue;
+        }
+        const double seconds = (double)results[f].frames * FINGERPRINT_HOP / FINGERPRINT_RATE;
+        fprintf(IO_OUT, "# %s %.2f %u\n", paths != NULL ? paths[f] : stdin_name, seconds, results[f].count);
+        for(uint32_t i = 0; i < results[f].count; i++){
+            fprintf(IO_OUT, "%06" PRIx32 " %" PRIu32 "\n", results[f].hashes[i].hash, results[f].hashes[i].frame);
+        }
+    }
+    for(int f = 0; results != NULL && f < count; f++) fingerprint_Free(&results[f]);
+    for(int f = 0; paths != NULL && f < count; f++) free(paths[f]);
+    free(paths);
+    free(results);
+    free(failed);
+    if(!any_failed) *flag = 0;
+}
+
+/**
+ * @brief Fingerprints WAV files on several threads and writes the inverted index of their hashes
+ *
+ * Files that cannot be read are reported and left out of the index.
+ *
+ * @param path the index file, replaced if it exists
+ * @param inputs files and directories
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void index_build_command(const char* path, char* const* inputs, int input_count, int threads, short* flag){
+    *flag = 1;
+    char** paths = NULL;
+    int count = fingerprint_Paths(inputs, input_count, &paths);
+    if(count < 0) return;
+    struct fingerprint* results = calloc(count > 0 ? count : 1, sizeof(struct fingerprint));
+    short* failed = calloc(count > 0 ? count : 1, sizeof(short));
+    if(results == NULL || failed == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+    } else if(fingerprint_Files(paths, (uint32_t)count, threads, results, failed) == 0){
+        // the failed files are left out and the others keep their order
+        uint32_t kept = 0;
+        uint64_t hashes = 0;
+        for(int f = 0; f < count; f++){
+            if(failed[f]){
+                free(paths[f]);
+                continue;
+            }
+            paths[kept] = paths[f];
+            results[kept] = results[f];
+            hashes += results[f].count;
+            kept++;
+        }
+        if(fingerprint_IndexWrite(path, paths, results, kept) == 0){
+            fprintf(IO_OUT, "indexed %u files, %" PRIu64 " hashes, %u files failed\n", kept, hashes, (uint32_t)count - kept);
+            *flag = 0;
+        }
+        for(uint32_t f = 0; f < kept; f++){
+            fingerprint_Free(&results[f]);
+            free(paths[f]);
+        }
+        count = 0;
+    }
+    for(int f = 0; f < count; f++){
+        if(results != NULL) fingerprint_Free(&results[f]);
+        free(paths[f]);
+    }
+    free(paths);
+    free(results);
+    free(failed);
+}
+
+/**
+ * @brief Looks up WAV files, or the WAV file provided through STDIN, in an index and writes the files that share
+ * audio with them to STDOUT
+ *
+ * Every match is a line "<query> <file> <offset> <score>/<hashes>": the offset in seconds is the time of the file
+ * at the start of the query, the score is the number of hashes of the query that agree with that offset.
+ *
+ * @param path the index file
+ * @param inputs files and directories, STDIN when there are none
+ * @param top the most matches reported per query
+ * @param min_score the score a match needs
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void index_query_command(const char* path, char* const* inputs, int input_count, int threads, uint32_t top, uint32_t min_score, short* flag){
+    *flag = 1;
+    struct fingerprint_index index;
+    if(fingerprint_IndexOpen(path, &index) != 0) return;
+    char* stdin_name = "-";
+    char** paths = NULL;
+    int count = 1;
+    if(input_count > 0) count = fingerprint_Paths(inputs, input_count, &paths);
+    struct fingerprint* results = count >= 0 ? calloc(count > 0 ? count : 1, sizeof(struct fingerprint)) : NULL;
+    short* failed = count >= 0 ? calloc(count > 0 ? count : 1, sizeof(short)) : NULL;
+    struct fingerprint_match* matches = malloc((top > 0 ? top : 1) * sizeof(struct fingerprint_match));
+    short ok = results != NULL && failed != NULL && matches != NULL;
+    if(!ok && count >= 0){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+    } else if(ok && input_count == 0){
+        struct fft_plan* plan = fft_plan_Create(FINGERPRINT_FFT);
+        struct codec_stream stream;
+        FILE* in = plan != NULL ? flac_Open(IO_IN, &stream) : NULL;
+        failed[0] = in == NULL || fingerprint_Stream(in, plan, &results[0]) != 0;
+        if(in != NULL && codec_StreamClose(&stream) == 1) failed[0] = 1;
+        fft_plan_Destroy(plan);
+    } else if(ok){
+        ok = fingerprint_Files(paths, (uint32_t)count, threads, results, failed) == 0;
+    }
+
+    const double seconds_per_frame = (double)FINGERPRINT_HOP / FINGERPRINT_RATE;
+    short any_failed = 0;
+    for(int q = 0; ok && q < count; q++){
+        if(failed[q]){
+            any_failed = 1;
+            continue;
+        }
+        int found = fingerprint_Query(&index, &results[q], matches, top, min_score);
+        if(found < 0){
+            ok = 0;
+            break;
+        }
+        const char* name = paths != NULL ? paths[q] : stdin_name;
+        for(int m = 0; m < found; m++){
+            fprintf(IO_OUT, "%s %s %.2f %u/%u\n", name, fingerprint_IndexName(&index, matches[m].file),
+                    matches[m].offset * seconds_per_frame, matches[m].score, results[q].count);
+        }
+        if(found == 0) fprintf(IO_OUT, "%s - no match\n", name);
+    }
+    for(int f = 0; results != NULL && f < count; f++) fingerprint_Free(&results[f]);
+    for(int f = 0; paths != NULL && f < count; f++) free(paths[f]);
+    free(paths);
+    free(results);
+    free(failed);
+    free(matches);
+    fingerprint_IndexClose(&index);
+    if(ok && !any_failed) *flag = 0;
+}
+
+/**
+ * @brief Detects the tempo of WAV files on several threads, or of the WAV file provided through STDIN, and writes it
+ * to STDOUT
+ *
+ * Every file is a line "<file> <bpm> <first beat> <confidence>", the first beat in seconds. The result of a file is
+ * kept in <file>.bpm and used again until the file changes.
+ *
+ * @param inputs files and directories, STDIN when there are none
+ * @param refresh analyze the files even if they have a sidecar
+ * @param beats also write the time of every beat, one per line
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void tempo_detect_command(char* const* inputs, int input_count, int threads, short refresh, short beats, short* flag){
+    *flag = 1;
+    char* stdin_name = "-";
+    char** paths = NULL;
+    int count = 1;
+    if(input_count > 0){
+        count = fingerprint_Paths(inputs, input_count, &paths);
+        if(count < 0) return;
+    }
+    struct beat_result* results = calloc(count > 0 ? count : 1, sizeof(struct beat_result));
+    short* failed = calloc(count > 0 ? count : 1, sizeof(short));
+    if(results == NULL || failed == NULL){
+        fprintf(stderr, "Error! unable to allocate memory\n");
+    } else if(input_count == 0){
+        struct fft_plan* plan = fft_plan_Create(BEAT_FFT);
+        struct codec_stream stream;
+        FILE* in = plan != NULL ? flac_Open(IO_IN, &stream) : NULL;
+        failed[0] = in == NULL || beat_Stream(in, plan, &results[0]) != 0;
+        if(in != NULL && codec_StreamClose(&stream) == 1) failed[0] = 1;
+        fft_plan_Destroy(plan);
+    } else{
+        if(beat_Files(paths, (uint32_t)count, threads, refresh, results, failed) != 0) failed[0] = count > 0;
+    }
+
+    short any_failed = results == NULL || failed == NULL;
+    for(int f = 0; results != NULL && failed != NULL && f < count; f++){
+        if(failed[f]){
+            any_failed = 1;
+            continue;
+        }
+        const struct beat_result* r = &results[f];
+        fprintf(IO_OUT, "%s %.2f %.3f %.2f\n", paths != NULL ? paths[f] : stdin_name, r->bpm, r->first, r->confidence);
+        if(!beats || r->bpm <= 0.0) continue;
+        const double period = 60.0 / r->bpm;
+        for(uint64_t n = 0; r->first + n * period < r->duration; n++) fprintf(IO_OUT, "  %.3f\n", r->first + n * period);
+    }
+    for(int f = 0; paths != NULL && f < count; f++) free(paths[f]);
+    free(paths);
+    free(results);
+    free(failed);
+    if(!any_failed) *flag = 0;
+}
@@ -0,0 +1,339 @@
+/**
+ * @file stats.h
+ * @author Rafael Diolatzis
+ * @brief Per-stage timing, throughput, memory and hardware counters of a run, for the --stats option
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * The I/O functions of utils.h call stats_Begin() and stats_End() around every read and write of the data, so the
+ * time a run spends waiting for its input and output is measured where it happens. Everything before the first of
+ * these calls is the header stage and everything that is not I/O is the compute stage. While the hardware counters
+ * are open they are paused during I/O, so they describe the computation of the command.
+ *
+ * The counters are optional (--stats=counters). They come from perf_event_open() and count user space only, which
+ * most systems allow without privileges, and they include the threads the command starts. Pausing and resuming them
+ * costs two system calls per block of I/O, which is noticeable on virtual machines. When the system has no PMU or does
+ * not allow it, the counters are reported as unavailable and everything else still works.
+ *
+ * When the calling thread has no run_stats attached every hook is a single test of a thread-local pointer.
+ */
+
+#pragma once
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<inttypes.h>
+#include<string.h>
+#include<time.h>
+#include<unistd.h>
+#include<sys/ioctl.h>
+#include<sys/resource.h>
+#include<sys/syscall.h>
+#include"arena.h"
+
+#if defined(__linux__)
+#include<linux/perf_event.h>
+#endif
+
+#define STATS_HEADER 0
+#define STATS_READ 1
+#define STATS_COMPUTE 2
+#define STATS_WRITE 3
+#define STATS_STAGES 4
+
+#define STATS_COUNTERS 3
+#define STATS_WAV_HEADER 44
+
+/**
+ * @brief The measurements of one run
+ */
+struct run_stats {
+    double start;
+    double header_end;                  // 0 until the first data I/O
+    double seconds[STATS_STAGES];
+    double total;
+    uint64_t bytes_in;                  // header and trailing chunks included
+    uint64_t bytes_out;
+    uint16_t bits_in;                   // bits/sample of the input, 0 if there was none
+    uint16_t bits_out;
+    long minor_faults;
+    long major_faults;
+    long peak_rss_kb;
+    uint32_t cache_hits;                // runs answered by the --cache directory
+    uint32_t cache_misses;
+    int counter_fd[STATS_COUNTERS];     // cycles, instructions, cache misses, -1 when not open
+    uint64_t counters[STATS_COUNTERS];
+    short counters_requested;
+    short counting;
+};
+
+/*
+ * The run that the hooks of the calling thread report to, NULL when --stats was not given.
+ */
+static _Thread_local struct run_stats* io_stats = NULL;
+
+/**
+ * @brief Returns the time of a monotonic clock in seconds
+ */
+double stats_Now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Pauses or resumes the hardware counters of a run
+ */
+void stats_Count(struct run_stats* stats, short enable){
+#if defined(__linux__)
+    if(stats->counter_fd[0] < 0) return;
+    ioctl(stats->counter_fd[0], enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    stats->counting = enable;
+#else
+    (void)stats;
+    (void)enable;
+#endif
+}
+
+/**
+ * @brief Opens the hardware counters as one group that follows the threads of the process, initially paused
+ *
+ * @returns 1 if the counters are open, 0 if they are not available
+ */
+short stats_OpenCounters(struct run_stats* stats){
+    for(int i = 0; i < STATS_COUNTERS; i++) stats->counter_fd[i] = -1;
+#if defined(__linux__) && defined(__NR_perf_event_open)
+    const uint64_t configs[STATS_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+    for(int i = 0; i < STATS_COUNTERS; i++){
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.disabled = i == 0;             // the members follow the leader
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : stats->counter_fd[0], 0);
+        if(fd < 0){
+            for(int k = 0; k < i; k++){
+                close(stats->counter_fd[k]);
+                stats->counter_fd[k] = -1;
+            }
+            return 0;
+        }
+        stats->counter_fd[i] = fd;
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Starts measuring a run
+ *
+ * @param counters 1 to open the hardware counters
+ */
+void stats_Start(struct run_stats* stats, short counters){
+    memset(stats, 0, sizeof(struct run_stats));
+    for(int i = 0; i < STATS_COUNTERS; i++) stats->counter_fd[i] = -1;
+    stats->counters_requested = counters;
+    if(counters) stats_OpenCounters(stats);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    stats->minor_faults = -usage.ru_minflt;
+    stats->major_faults = -usage.ru_majflt;
+    // enabling the counters can take a while the first time, it is not part of the run
+    stats_Count(stats, 1);
+    stats->start = stats_Now();
+}
+
+/**
+ * @brief Stops measuring a run, reads the counters and closes them
+ */
+void stats_Stop(struct run_stats* stats){
+    stats_Count(stats, 0);
+    double now = stats_Now();
+    stats->total = now - stats->start;
+    if(stats->header_end == 0) stats->header_end = now;
+    stats->seconds[STATS_HEADER] = stats->header_end - stats->start;
+    double compute = stats->total - stats->seconds[STATS_HEADER] - stats->seconds[STATS_READ] - stats->seconds[STATS_WRITE];
+    stats->seconds[STATS_COMPUTE] = compute > 0 ? compute : 0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    stats->minor_faults += usage.ru_minflt;
+    stats->major_faults += usage.ru_majflt;
+    stats->peak_rss_kb = usage.ru_maxrss;
+
+    for(int i = 0; i < STATS_COUNTERS; i++){
+        if(stats->counter_fd[i] < 0) continue;
+        uint64_t value = 0;
+        if(read(stats->counter_fd[i], &value, sizeof(value)) == (ssize_t)sizeof(value)) stats->counters[i] = value;
+    }
+    for(int i = STATS_COUNTERS - 1; i >= 0; i--){
+        if(stats->counter_fd[i] >= 0) close(stats->counter_fd[i]);
+    }
+}
+
+/**
+ * @brief Ends the header stage of the run of the calling thread, unless it has already ended
+ */
+void stats_Header(void){
+    struct run_stats* stats = io_stats;
+    if(stats != NULL && stats->header_end == 0) stats->header_end = stats_Now();
+}
+
+/**
+ * @brief Marks the start of an I/O stage of the calling thread
+ *
+ * @returns the time to pass to stats_End(), 0 when the thread has no run attached
+ */
+double stats_Begin(void){
+    struct run_stats* stats = io_stats;
+    if(stats == NULL) return 0;
+    stats_Header();
+    double now = stats_Now();
+    if(stats->counting) stats_Count(stats, 0);
+    return now;
+}
+
+/**
+ * @brief Counts bytes that were read or written. The header of the input is parsed byte by byte before the first
+ * read of the data, it is counted with that read
+ *
+ * @param stage STATS_READ or STATS_WRITE
+ */
+void stats_Bytes(int stage, uint64_t bytes){
+    struct run_stats* stats = io_stats;
+    if(stats == NULL) return;
+    if(stage == STATS_READ){
+        if(stats->bytes_in == 0 && stats->bits_in != 0) stats->bytes_in = STATS_WAV_HEADER;
+        stats->bytes_in += bytes;
+    } else{
+        stats->bytes_out += bytes;
+    }
+}
+
+/**
+ * @brief Marks the end of an I/O stage started with stats_Begin()
+ *
+ * @param stage STATS_READ or STATS_WRITE
+ * @param start the value returned by stats_Begin()
+ * @param bytes the number of bytes moved
+ */
+void stats_End(int stage, double start, uint64_t bytes){
+    struct run_stats* stats = io_stats;
+    if(stats == NULL) return;
+    stats->seconds[stage] += stats_Now() - start;
+    stats_Bytes(stage, bytes);
+    if(stats->counter_fd[0] >= 0) stats_Count(stats, 1);
+}
+
+/**
+ * @brief Adds I/O that other threads did for the run of the calling thread, e.g. the ranges of chunked.h
+ *
+ * @param seconds the time of the stage, as wall time of the run
+ */
+void stats_Add(int stage, double seconds, uint64_t bytes){
+    struct run_stats* stats = io_stats;
+    if(stats == NULL) return;
+    stats_Header();
+    stats->seconds[stage] += seconds;
+    stats_Bytes(stage, bytes);
+}
+
+/**
+ * @brief Records the bits/sample of the input or the output so the sample rate can be reported
+ */
+void stats_Format(short output, uint16_t bits){
+    struct run_stats* stats = io_stats;
+    if(stats == NULL) return;
+    if(output) stats->bits_out = bits;
+    else stats->bits_in = bits;
+}
+
+/**
+ * @brief Counts a lookup of the --cache directory
+ */
+void stats_Cache(short hit){
+    struct run_stats* stats = io_stats;
+    if(stats == NULL) return;
+    if(hit) stats->cache_hits++;
+    else stats->cache_misses++;
+}
+
+/**
+ * @brief Returns the number of samples of the run, those of the input or, for commands without one, of the output.
+ * Every byte after the 44 byte header counts, chunks that follow the data are rare enough to be ignored
+ */
+uint64_t stats_Samples(const struct run_stats* stats){
+    if(stats->bits_in >= 8 && stats->bytes_in > STATS_WAV_HEADER) return (stats->bytes_in - STATS_WAV_HEADER) / (stats->bits_in / 8);
+    if(stats->bits_out >= 8 && stats->bytes_out > STATS_WAV_HEADER) return (stats->bytes_out - STATS_WAV_HEADER) / (stats->bits_out / 8);
+    return 0;
+}
+
+/**
+ * @brief Writes the measurements of a run to a stream, as text or as a single JSON line
+ *
+ * @param command the name of the command
+ * @param json 1 for JSON
+ * @param arena the sample arena of the run, NULL if it had none
+ */
+void stats_Report(FILE* stream, const struct run_stats* stats, const char* command, short json, const struct sample_arena* arena){
+    const double total = stats->total > 0 ? stats->total : 1e-9;
+    const uint64_t samples = stats_Samples(stats);
+    const double bytes_rate = (stats->bytes_in + stats->bytes_out) / total;
+    const double sample_rate = samples / total;
+    const short counters = stats->counter_fd[0] >= 0;
+
+    if(json){
+        fprintf(stream, "{\"command\":\"%s\",\"seconds\":%.6f,\"stages\":{\"header\":%.6f,\"read\":%.6f,\"compute\":%.6f,\"write\":%.6f},",
+                command, stats->total, stats->seconds[STATS_HEADER], stats->seconds[STATS_READ], stats->seconds[STATS_COMPUTE],
+                stats->seconds[STATS_WRITE]);
+        fprintf(stream, "\"bytes_in\":%" PRIu64 ",\"bytes_out\":%" PRIu64 ",\"bytes_per_sec\":%.0f,\"samples\":%" PRIu64 ",\"samples_per_sec\":%.0f,",
+                stats->bytes_in, stats->bytes_out, bytes_rate, samples, sample_rate);
+        fprintf(stream, "\"peak_rss_kb\":%ld,\"minor_faults\":%ld,\"major_faults\":%ld,", stats->peak_rss_kb, stats->minor_faults, stats->major_faults);
+        if(counters){
+            fprintf(stream, "\"cycles\":%" PRIu64 ",\"instructions\":%" PRIu64 ",\"cache_misses\":%" PRIu64,
+                    stats->counters[0], stats->counters[1], stats->counters[2]);
+        } else{
+            fprintf(stream, "\"cycles\":null,\"instructions\":null,\"cache_misses\":null");
+        }
+        if(arena != NULL){
+            fprintf(stream, ",\"arena\":{\"mapped\":%zu,\"allocations\":%" PRIu64 ",\"reuses\":%" PRIu64 ",\"huge_regions\":%" PRIu32 "}",
+                    arena->mapped, arena->allocations, arena->reuses, arena->huge_regions);
+        }
+        if(stats->cache_hits + stats->cache_misses > 0){
+            fprintf(stream, ",\"cache\":{\"hits\":%" PRIu32 ",\"misses\":%" PRIu32 "}", stats->cache_hits, stats->cache_misses);
+        }
+        fprintf(stream, "}\n");
+        return;
+    }
+
+    fprintf(stream, "stats: %s, %.3f s, %.1f MB in, %.1f MB out, %.1f MB/s, %.2f Msamples/s\n", command, stats->total,
+            stats->bytes_in / 1e6, stats->bytes_out / 1e6, bytes_rate / 1e6, sample_rate / 1e6);
+    fprintf(stream, "stats: header %.3f s, read %.3f s, compute %.3f s, write %.3f s\n", stats->seconds[STATS_HEADER],
+            stats->seconds[STATS_READ], stats->seconds[STATS_COMPUTE], stats->seconds[STATS_WRITE]);
+    fprintf(stream, "stats: peak RSS %.1f MB, %ld minor and %ld major page faults\n", stats->peak_rss_kb / 1024.0,
+            stats->minor_faults, stats->major_faults);
+    if(counters){
+        fprintf(stream, "stats: %" PRIu64 " cycles, %" PRIu64 " instructions (%.2f IPC), %" PRIu64 " cache misses, user space outside I/O\n",
+                stats->counters[0], stats->counters[1], stats->counters[0] > 0 ? (double)stats->counters[1] / stats->counters[0] : 0,
+                stats->counters[2]);
+    } else if(stats->counters_requested){
+        fprintf(stream, "stats: hardware counters unavailable\n");
+    }
+    if(arena != NULL){
+        fprintf(stream, "stats: arena %.1f MB mapped, %" PRIu64 " allocations, %" PRIu64 " reused, %" PRIu32 " huge page regions\n",
+                arena->mapped / 1048576.0, arena->allocations, arena->reuses, arena->huge_regions);
+    }
+    if(stats->cache_hits + stats->cache_misses > 0){
+        fprintf(stream, "stats: cache %" PRIu32 " hits, %" PRIu32 " misses\n", stats->cache_hits, stats->cache_misses);
+    }
+}
@@ -0,0 +1,373 @@
+/**
+ * @file synth.h
+ * @author Rafael Diolatzis
+ * @brief Wavetable oscillators with band-limited mip-mapped tables, noise generators and sweeps
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Every waveform is stored as SYNTH_LEVELS tables of one period. Level l holds the harmonics 1 to 2^l, built with
+ * one inverse FFT, so a voice that plays the table of the largest level whose harmonics stay below Nyquist never
+ * aliases. A voice reads its table with a 32 bit fixed-point phase and linear interpolation, so a sample costs a couple
+ * of loads and a multiply-add instead of libm calls. Sweeping voices move their frequency once every SYNTH_SUB_BLOCK
+ * frames, which keeps the phase continuous and allows the table to be picked per sub-block.
+ */
+
+#pragma once
+
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include"utils.h"
+#include"fft.h"
+
+#define SYNTH_TABLE_BITS 11
+#define SYNTH_TABLE_SIZE (1u << SYNTH_TABLE_BITS)
+#define SYNTH_LEVELS SYNTH_TABLE_BITS
+#define SYNTH_SUB_BLOCK 64
+#define SYNTH_MAX_CHANNELS 8
+
+#define SYNTH_SINE 0
+#define SYNTH_SAW 1
+#define SYNTH_SQUARE 2
+#define SYNTH_TRIANGLE 3
+#define SYNTH_WHITE 4
+#define SYNTH_PINK 5
+
+#define SYNTH_TABLE_WAVES 4
+
+#define SYNTH_SWEEP_LINEAR 0
+#define SYNTH_SWEEP_LOG 1
+
+/**
+ * @brief The mip-mapped tables of the periodic waveforms. They are read-only once created
+ */
+struct synth_tables {
+    float* data;    // [SYNTH_TABLE_WAVES][SYNTH_LEVELS][SYNTH_TABLE_SIZE + 1], the last value repeats the first
+};
+
+/**
+ * @brief A voice as requested by the user
+ */
+struct synth_voice_spec {
+    int wave;
+    double frequency;
+    double to;          // end frequency of a sweep, equal to frequency for a steady tone
+    double gain;
+    int channel;        // -1 for every channel
+};
+
+/**
+ * @brief The running state of a voice
+ */
+struct synth_voice {
+    struct synth_voice_spec spec;
+    uint32_t phase;
+    double increment;   // phase increment per frame, in units of 2^-32 periods
+    int sweep;          // SYNTH_SWEEP_LINEAR or SYNTH_SWEEP_LOG
+    double step;        // added to (linear) or multiplied with (log) the increment every frame
+    uint32_t rng;
+    float pink[7];
+};
+
+/**
+ * @brief A set of voices mixed into interleaved blocks
+ */
+struct synth {
+    const struct synth_tables* tables;
+    struct synth_voice* voices;
+    uint32_t count;
+    uint32_t sample_rate;
+    uint32_t channels;
+    float* mono;        // one sub-block of a single voice
+};
+
+/**
+ * @brief Parses the name of a waveform
+ *
+ * @returns one of the SYNTH_* waveforms or -1 if the name is unknown
+ */
+int synth_ParseWave(const char* name){
+    const char* names[] = {"sine", "saw", "square", "triangle", "white", "pink"};
+    for(int i = 0; i < 6; i++){
+        if(strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Parses a voice written as wave[:freq[-to][:gain[:channel]]], e.g. "saw:220", "sine:20-20000" or "pink:0:0.3"
+ *
+ * The frequency of noise voices is ignored. Channels are counted from 0.
+ *
+ * @returns 0 on success or -1 if the text is not a valid voice
+ */
+int synth_ParseVoice(const char* text, struct synth_voice_spec* spec){
+    char name[16];
+    size_t length = strcspn(text, ":");
+    if(length == 0 || length >= sizeof(name)) return -1;
+    memcpy(name, text, length);
+    name[length] = '\0';
+
+    spec->wave = synth_ParseWave(name);
+    if(spec->wave < 0) return -1;
+    spec->frequency = 440.0;
+    spec->to = 440.0;
+    spec->gain = 1.0;
+    spec->channel = -1;
+    if(text[length] == '\0') return 0;
+
+    char* end;
+    const char* ptr = text + length + 1;
+    spec->frequency = strtod(ptr, &end);
+    if(end == ptr || spec->frequency < 0) return -1;
+    spec->to = spec->frequency;
+    if(*end == '-'){
+        ptr = end + 1;
+        spec->to = strtod(ptr, &end);
+        if(end == ptr || spec->to < 0) return -1;
+    }
+    if(*end == ':'){
+        ptr = end + 1;
+        spec->gain = strtod(ptr, &end);
+        if(end == ptr) return -1;
+        if(*end == ':'){
+            ptr = end + 1;
+            long channel = strtol(ptr, &end, 10);
+            if(end == ptr || channel < 0 || channel >= SYNTH_MAX_CHANNELS) return -1;
+            spec->channel = (int)channel;
+        }
+    }
+    return *end == '\0' ? 0 : -1;
+}
+
+/**
+ * @brief Releases tables created with synth_tables_Create
+ */
+void synth_tables_Destroy(struct synth_tables* tables){
+    if(tables == NULL) return;
+    free_Aligned(tables->data);
+    free(tables);
+}
+
+/**
+ * @brief Returns the table of a waveform for a mip-map level
+ */
+const float* synth_Table(const struct synth_tables* tables, int wave, uint32_t level){
+    return tables->data + ((size_t)wave * SYNTH_LEVELS + level) * (SYNTH_TABLE_SIZE + 1);
+}
+
+/**
+ * @brief Builds the band-limited tables of every periodic waveform from their Fourier series
+ *
+ * @returns the tables or NULL on failure
+ */
+struct synth_tables* synth_tables_Create(){
+    struct synth_tables* tables = calloc(1, sizeof(struct synth_tables));
+    struct fft_plan* plan = fft_plan_Create(SYNTH_TABLE_SIZE);
+    const uint32_t bins = SYNTH_TABLE_SIZE / 2 + 1;
+    float* re = calloc(bins, sizeof(float));
+    float* im = calloc(bins, sizeof(float));
+    float* scratch = plan ? alloc_Aligned(fft_ScratchSize(plan) * sizeof(float)) : NULL;
+    if(tables != NULL){
+        tables->data = alloc_Aligned((size_t)SYNTH_TABLE_WAVES * SYNTH_LEVELS * (SYNTH_TABLE_SIZE + 1) * sizeof(float));
+    }
+    if(tables == NULL || tables->data == NULL || plan == NULL || re == NULL || im == NULL || scratch == NULL){
+        synth_tables_Destroy(tables);
+        fft_plan_Destroy(plan);
+        free(re);
+        free(im);
+        free_Aligned(scratch);
+        return NULL;
+    }
+
+    for(int wave = 0; wave < SYNTH_TABLE_WAVES; wave++){
+        for(uint32_t level = 0; level < SYNTH_LEVELS; level++){
+            const uint32_t harmonics = 1u << level;
+            memset(re, 0, bins * sizeof(float));
+            memset(im, 0, bins * sizeof(float));
+            for(uint32_t h = 1; h <= harmonics && h < bins - 1; h++){
+                double a = 0.0;
+                if(wave == SYNTH_SINE) a = h == 1 ? 1.0 : 0.0;
+                else if(wave == SYNTH_SAW) a = 2.0 / (M_PI * h);
+                else if(wave == SYNTH_SQUARE) a = h % 2 ? 4.0 / (M_PI * h) : 0.0;
+                else a = h % 2 ? ((h / 2) % 2 ? -1.0 : 1.0) * 8.0 / (M_PI * M_PI * h * h) : 0.0;
+                // a sine of amplitude a is the bin -a * N / 2 * i
+                im[h] = (float)(-a * SYNTH_TABLE_SIZE / 2.0);
+            }
+            float* table = (float*)synth_Table(tables, wave, level);
+            fft_Inverse(plan, re, im, table, scratch);
+            table[SYNTH_TABLE_SIZE] = table[0];
+        }
+    }
+
+    fft_plan_Destroy(plan);
+    free(re);
+    free(im);
+    free_Aligned(scratch);
+    return tables;
+}
+
+/**
+ * @brief Releases a synth created with synth_Create. The tables are not released
+ */
+void synth_Destroy(struct synth* synth){
+    if(synth == NULL) return;
+    free(synth->voices);
+    free_Aligned(synth->mono);
+    free(synth);
+}
+
+/**
+ * @brief Creates a set of voices
+ *
+ * @param tables the tables of the periodic waveforms
+ * @param specs the voices
+ * @param count the number of voices
+ * @param sample_rate the sample rate in Hz
+ * @param channels the number of interleaved output channels, at most SYNTH_MAX_CHANNELS
+ * @param frames the length of the output, used by sweeps to reach their end frequency on the last frame
+ * @param sweep SYNTH_SWEEP_LINEAR or SYNTH_SWEEP_LOG, how the frequency of voices with a range moves
+ *
+ * @returns the synth or NULL on failure
+ */
+struct synth* synth_Create(const struct synth_tables* tables, const struct synth_voice_spec* specs, uint32_t count,
+                           uint32_t sample_rate, uint32_t channels, uint64_t frames, int sweep){
+    struct synth* synth = calloc(1, sizeof(struct synth));
+    if(synth == NULL) return NULL;
+    synth->tables = tables;
+    synth->count = count;
+    synth->sample_rate = sample_rate;
+    synth->channels = channels;
+    synth->voices = calloc(count > 0 ? count : 1, sizeof(struct synth_voice));
+    synth->mono = alloc_Aligned(SYNTH_SUB_BLOCK * sizeof(float));
+    if(synth->voices == NULL || synth->mono == NULL){
+        synth_Destroy(synth);
+        return NULL;
+    }
+
+    const double scale = 4294967296.0 / sample_rate;
+    const double steps = frames > 1 ? (double)(frames - 1) : 1.0;
+    for(uint32_t i = 0; i < count; i++){
+        struct synth_voice* voice = &synth->voices[i];
+        voice->spec = specs[i];
+        voice->increment = specs[i].frequency * scale;
+        double to = specs[i].to * scale;
+        // a log sweep can not start or end at 0 Hz, those are swept linearly
+        voice->sweep = sweep == SYNTH_SWEEP_LOG && voice->increment > 0 && to > 0 ? SYNTH_SWEEP_LOG : SYNTH_SWEEP_LINEAR;
+        if(voice->sweep == SYNTH_SWEEP_LOG){
+            voice->step = pow(to / voice->increment, 1.0 / steps);
+        } else{
+            voice->step = (to - voice->increment) / steps;
+        }
+        voice->rng = 0x9E3779B9u * (i + 1) ^ 0x2545F491u;
+    }
+    return synth;
+}
+
+/**
+ * @brief Reads `count` samples of a table with linear interpolation, starting at `phase`
+ */
+void synth_Oscillate(const float* table, uint32_t phase, uint32_t increment, float* out, uint32_t count){
+    const uint32_t shift = 32 - SYNTH_TABLE_BITS;
+    const float to_frac = 1.0f / (float)(1u << shift);
+    // scalar: an SSE2 version that loaded the four pairs of table values one by one was a third slower
+    for(uint32_t i = 0; i < count; i++){
+        uint32_t idx = phase >> shift;
+        float f = (float)(phase & ((1u << shift) - 1)) * to_frac;
+        out[i] = table[idx] + f * (table[idx + 1] - table[idx]);
+        phase += increment;
+    }
+}
+
+/**
+ * @brief Generates `count` samples of white or pink noise in the range (-1, 1)
+ */
+void synth_Noise(struct synth_voice* voice, float* out, uint32_t count){
+    uint32_t x = voice->rng;
+    float* b = voice->pink;
+    for(uint32_t i = 0; i < count; i++){
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        float white = (float)(int32_t)x * (1.0f / 2147483648.0f);
+        if(voice->spec.wave == SYNTH_WHITE){
+            out[i] = white;
+            continue;
+        }
+        // Paul Kellet's refined pink filter, -3 dB per octave within 0.05 dB above 9 Hz at 44.1 kHz
+        b[0] = 0.99886f * b[0] + white * 0.0555179f;
+        b[1] = 0.99332f * b[1] + white * 0.0750759f;
+        b[2] = 0.96900f * b[2] + white * 0.1538520f;
+        b[3] = 0.86650f * b[3] + white * 0.3104856f;
+        b[4] = 0.55000f * b[4] + white * 0.5329522f;
+        b[5] = -0.7616f * b[5] - white * 0.0168980f;
+        out[i] = (b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + white * 0.5362f) * 0.11f;
+        b[6] = white * 0.115926f;
+    }
+    voice->rng = x;
+}
+
+/**
+ * @brief Renders the next block of the mix of every voice
+ *
+ * @param synth the synth
+ * @param out receives frames x channels interleaved samples
+ * @param frames the number of frames
+ */
+void synth_Render(struct synth* synth, float* out, uint32_t frames){
+    const uint32_t channels = synth->channels;
+    memset(out, 0, (size_t)frames * channels * sizeof(float));
+
+    for(uint32_t v = 0; v < synth->count; v++){
+        struct synth_voice* voice = &synth->voices[v];
+        const float gain = (float)voice->spec.gain;
+        const int channel = voice->spec.channel;
+        if(channel >= (int)channels) continue;
+
+        for(uint32_t done = 0; done < frames; done += SYNTH_SUB_BLOCK){
+            uint32_t n = frames - done < SYNTH_SUB_BLOCK ? frames - done : SYNTH_SUB_BLOCK;
+            float* mono = synth->mono;
+            if(voice->spec.wave >= SYNTH_TABLE_WAVES){
+                synth_Noise(voice, mono, n);
+            } else{
+                // the frequency of a sweep is held for the sub-block, at its value in the middle of the sub-block
+                double increment = voice->increment;
+                double next = increment;
+                if(voice->spec.to != voice->spec.frequency){
+                    if(voice->sweep == SYNTH_SWEEP_LOG){
+                        increment *= pow(voice->step, n / 2.0);
+                        next = voice->increment * pow(voice->step, n);
+                    } else{
+                        increment += voice->step * (n / 2.0);
+                        next = voice->increment + voice->step * n;
+                    }
+                }
+                if(increment < 0) increment = 0;
+                if(increment > 2147483647.0) increment = 2147483647.0;
+
+                // the largest level whose highest harmonic stays below Nyquist
+                double harmonics = increment > 0 ? 2147483648.0 / increment : 4294967296.0;
+                int level = harmonics >= 1.0 ? ilogb(harmonics) : 0;
+                if(level >= SYNTH_LEVELS) level = SYNTH_LEVELS - 1;
+                if(voice->spec.wave == SYNTH_SINE) level = 0;
+
+                uint32_t step = (uint32_t)increment;
+                synth_Oscillate(synth_Table(synth->tables, voice->spec.wave, (uint32_t)level), voice->phase, step, mono, n);
+                voice->phase += step * n;
+                voice->increment = next;
+            }
+
+            float* dst = out + (size_t)done * channels;
+            if(channel >= 0){
+                for(uint32_t i = 0; i < n; i++) dst[(size_t)i * channels + channel] += gain * mono[i];
+            } else if(channels == 1){
+                for(uint32_t i = 0; i < n; i++) dst[i] += gain * mono[i];
+            } else{
+                for(uint32_t i = 0; i < n; i++){
+                    for(uint32_t c = 0; c < channels; c++) dst[(size_t)i * channels + c] += gain * mono[i];
+                }
+            }
+        }
+    }
+}
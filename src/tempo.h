@@ -0,0 +1,404 @@
+/**
+ * @file tempo.h
+ * @author Rafael Diolatzis
+ * @brief Streaming time stretching at constant pitch (WSOLA and phase vocoder)
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Both modes cut the input in windowed frames read every `factor x hop` samples and overlap-add them every `hop`
+ * samples, which changes the duration by 1 / factor while keeping the pitch.
+ *  - WSOLA moves every frame by up to +-TEMPO_SEARCH_MS so that it lines up with the natural continuation of the
+ *    previous frame. The best position is the maximum of the normalized cross-correlation, computed with SSE dot products.
+ *  - The phase vocoder keeps the frame where it is and instead advances the phase of every FFT bin by its
+ *    instantaneous frequency times the synthesis hop.
+ * The stream only keeps the samples that the next frame can still reach, so the memory used is bounded by the
+ * frame length and the search range and not by the length of the file.
+ */
+
+#pragma once
+
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<math.h>
+#include"utils.h"
+#include"fft.h"
+
+#if defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+#define TEMPO_WSOLA 0
+#define TEMPO_PHASE_VOCODER 1
+
+#define TEMPO_WSOLA_HOP_MS 12.5
+#define TEMPO_SEARCH_MS 10.0
+#define TEMPO_PV_FRAME_MS 46.0
+
+/**
+ * @brief The state of a time stretching stream
+ */
+struct tempo_stream {
+    int mode;
+    uint32_t channels;
+    double factor;                  // input samples consumed per output sample
+    uint32_t frame;                 // frame length N
+    uint32_t hop;                   // synthesis hop
+    uint32_t search;                // WSOLA search range in samples on each side
+
+    float** in;                     // [channels][capacity] input samples, in[c][0] is the absolute sample in_base
+    float* mono;                    // downmix used by the WSOLA search
+    uint32_t capacity;
+    uint32_t in_count;
+    uint64_t in_base;
+
+    uint64_t frames_done;           // number of frames already overlap-added
+    int64_t prev_pos;               // absolute position of the previous analysis frame
+
+    float** out;                    // [channels][frame] overlap-add accumulators
+    float* norm;                    // sum of the window weights that reached every output sample
+    float* window;
+
+    // phase vocoder only
+    struct fft_plan* plan;
+    float* scratch;
+    float* time;
+    float* re;
+    float* im;
+    float** prev_phase;             // [channels][bins]
+    float** syn_phase;              // [channels][bins]
+};
+
+/**
+ * @brief Parses the name of a tempo mode
+ *
+ * @returns TEMPO_WSOLA, TEMPO_PHASE_VOCODER or -1 if the name is unknown
+ */
+int tempo_ParseMode(const char* name){
+    if(strcmp(name, "wsola") == 0) return TEMPO_WSOLA;
+    if(strcmp(name, "pv") == 0 || strcmp(name, "vocoder") == 0) return TEMPO_PHASE_VOCODER;
+    return -1;
+}
+
+/**
+ * @brief Releases a stream created with tempo_Create
+ */
+void tempo_Destroy(struct tempo_stream* s){
+    if(s == NULL) return;
+    for(uint32_t c = 0; c < s->channels; c++){
+        if(s->in) free_Aligned(s->in[c]);
+        if(s->out) free_Aligned(s->out[c]);
+        if(s->prev_phase) free_Aligned(s->prev_phase[c]);
+        if(s->syn_phase) free_Aligned(s->syn_phase[c]);
+    }
+    free(s->in);
+    free(s->out);
+    free(s->prev_phase);
+    free(s->syn_phase);
+    free_Aligned(s->mono);
+    free_Aligned(s->norm);
+    free_Aligned(s->window);
+    fft_plan_Destroy(s->plan);
+    free_Aligned(s->scratch);
+    free_Aligned(s->time);
+    free_Aligned(s->re);
+    free_Aligned(s->im);
+    free(s);
+}
+
+/**
+ * @brief Creates a time stretching stream
+ *
+ * @param mode TEMPO_WSOLA or TEMPO_PHASE_VOCODER
+ * @param channels the number of interleaved channels
+ * @param sample_rate the sample rate, used to size the frames
+ * @param factor the tempo factor. 1.25 plays 25% faster
+ * @param max_block the largest number of frames that will be passed to tempo_Process at once
+ *
+ * @returns the stream or NULL on failure
+ */
+struct tempo_stream* tempo_Create(int mode, uint32_t channels, uint32_t sample_rate, double factor, uint32_t max_block){
+    if(channels == 0 || factor <= 0) return NULL;
+
+    struct tempo_stream* s = calloc(1, sizeof(struct tempo_stream));
+    if(s == NULL) return NULL;
+    s->mode = mode;
+    s->channels = channels;
+    s->factor = factor;
+    s->prev_pos = -1;
+
+    if(mode == TEMPO_WSOLA){
+        s->hop = ((uint32_t)(sample_rate * TEMPO_WSOLA_HOP_MS / 1000.0) + 3) & ~3u;
+        if(s->hop < 16) s->hop = 16;
+        s->frame = 2 * s->hop;
+        s->search = (uint32_t)(sample_rate * TEMPO_SEARCH_MS / 1000.0);
+    } else{
+        s->frame = 256;
+        while(s->frame < sample_rate * TEMPO_PV_FRAME_MS / 1000.0) s->frame *= 2;
+        s->hop = s->frame / 4;
+        s->search = 0;
+    }
+
+    // the oldest sample that can still be read is the continuation of the previous frame or the search start,
+    // the newest is the end of the next frame after its search range, plus the block being appended
+    s->capacity = 2 * s->frame + 2 * s->search + (uint32_t)(s->hop * factor) + max_block + 16;
+
+    s->in = calloc(channels, sizeof(float*));
+    s->out = calloc(channels, sizeof(float*));
+    s->mono = alloc_Aligned(s->capacity * sizeof(float));
+    s->norm = alloc_Aligned(s->frame * sizeof(float));
+    s->window = alloc_Aligned(s->frame * sizeof(float));
+    if(s->in == NULL || s->out == NULL || s->mono == NULL || s->norm == NULL || s->window == NULL){
+        tempo_Destroy(s);
+        return NULL;
+    }
+    for(uint32_t c = 0; c < channels; c++){
+        s->in[c] = alloc_Aligned(s->capacity * sizeof(float));
+        s->out[c] = alloc_Aligned(s->frame * sizeof(float));
+        if(s->in[c] == NULL || s->out[c] == NULL){
+            tempo_Destroy(s);
+            return NULL;
+        }
+        memset(s->out[c], 0, s->frame * sizeof(float));
+    }
+    memset(s->norm, 0, s->frame * sizeof(float));
+
+    for(uint32_t i = 0; i < s->frame; i++){
+        s->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / s->frame));
+    }
+
+    if(mode == TEMPO_PHASE_VOCODER){
+        uint32_t bins = s->frame / 2 + 1;
+        s->plan = fft_plan_Create(s->frame);
+        s->scratch = s->plan ? alloc_Aligned(fft_ScratchSize(s->plan) * sizeof(float)) : NULL;
+        s->time = alloc_Aligned(s->frame * sizeof(float));
+        s->re = alloc_Aligned(bins * sizeof(float));
+        s->im = alloc_Aligned(bins * sizeof(float));
+        s->prev_phase = calloc(channels, sizeof(float*));
+        s->syn_phase = calloc(channels, sizeof(float*));
+        if(s->scratch == NULL || s->time == NULL || s->re == NULL || s->im == NULL || s->prev_phase == NULL || s->syn_phase == NULL){
+            tempo_Destroy(s);
+            return NULL;
+        }
+        for(uint32_t c = 0; c < channels; c++){
+            s->prev_phase[c] = alloc_Aligned(bins * sizeof(float));
+            s->syn_phase[c] = alloc_Aligned(bins * sizeof(float));
+            if(s->prev_phase[c] == NULL || s->syn_phase[c] == NULL){
+                tempo_Destroy(s);
+                return NULL;
+            }
+        }
+    }
+    return s;
+}
+
+/**
+ * @brief Returns how many output frames tempo_Process can produce at most for a block of `frames` input frames
+ */
+uint32_t tempo_MaxOutput(const struct tempo_stream* s, uint32_t frames){
+    return (uint32_t)(frames / s->factor) + 2 * s->frame + 16;
+}
+
+/**
+ * @brief Dot product of two float arrays
+ */
+float tempo_Dot(const float* a, const float* b, uint32_t count){
+    uint32_t i = 0;
+    float sum = 0.0f;
+#if defined(__SSE2__)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for(; i + 8 <= count; i += 8){
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for(; i < count; i++){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+/**
+ * @brief Finds the offset in [-search, search] around `center` whose samples best continue `ref`
+ *
+ * The normalized cross-correlation is first evaluated on every 4th offset and then refined around the best one.
+ *
+ * @param x the downmixed input, x[0] being the first sample that may be read
+ * @param center the nominal start of the frame inside x
+ * @param lo the smallest allowed offset (negative)
+ * @param hi the largest allowed offset
+ * @param ref the samples the frame should continue
+ * @param length the number of samples compared
+ */
+int32_t tempo_BestOffset(const float* x, uint32_t center, int32_t lo, int32_t hi, const float* ref, uint32_t length){
+    int32_t best = 0;
+    float best_score = -INFINITY;
+
+    for(int pass = 0; pass < 2; pass++){
+        int32_t from = pass == 0 ? lo : (best - 3 > lo ? best - 3 : lo);
+        int32_t to = pass == 0 ? hi : (best + 3 < hi ? best + 3 : hi);
+        int32_t step = pass == 0 ? 4 : 1;
+        for(int32_t d = from; d <= to; d += step){
+            const float* candidate = x + center + d;
+            float energy = tempo_Dot(candidate, candidate, length);
+            float score = tempo_Dot(candidate, ref, length) / sqrtf(energy + 1e-9f);
+            if(score > best_score){
+                best_score = score;
+                best = d;
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Overlap-adds one frame read from the input buffer at `offset`, weighting it by the window
+ */
+void tempo_AddWsolaFrame(struct tempo_stream* s, uint32_t offset){
+    for(uint32_t c = 0; c < s->channels; c++){
+        const float* x = s->in[c] + offset;
+        float* out = s->out[c];
+        for(uint32_t i = 0; i < s->frame; i++){
+            out[i] += x[i] * s->window[i];
+        }
+    }
+    for(uint32_t i = 0; i < s->frame; i++){
+        s->norm[i] += s->window[i];
+    }
+}
+
+/**
+ * @brief Analyses the frame at `offset` with the phase vocoder and overlap-adds the resynthesized frame
+ *
+ * @param advance the distance in samples to the previous analysis frame, zero for the first frame
+ */
+void tempo_AddVocoderFrame(struct tempo_stream* s, uint32_t offset, uint32_t advance){
+    const uint32_t n = s->frame;
+    const uint32_t bins = n / 2 + 1;
+
+    for(uint32_t c = 0; c < s->channels; c++){
+        const float* x = s->in[c] + offset;
+        for(uint32_t i = 0; i < n; i++){
+            s->time[i] = x[i] * s->window[i];
+        }
+        fft_Forward(s->plan, s->time, s->re, s->im, s->scratch);
+
+        float* prev = s->prev_phase[c];
+        float* syn = s->syn_phase[c];
+        for(uint32_t k = 0; k < bins; k++){
+            float magnitude = sqrtf(s->re[k] * s->re[k] + s->im[k] * s->im[k]);
+            float phase = atan2f(s->im[k], s->re[k]);
+            if(advance == 0){
+                syn[k] = phase;
+            } else{
+                float omega = (float)(2.0 * M_PI * k / n);
+                float deviation = phase - prev[k] - omega * advance;
+                deviation -= (float)(2.0 * M_PI) * rintf(deviation * (float)(0.5 / M_PI));
+                float frequency = omega + deviation / advance;
+                syn[k] += frequency * s->hop;
+                syn[k] -= (float)(2.0 * M_PI) * rintf(syn[k] * (float)(0.5 / M_PI));
+            }
+            prev[k] = phase;
+            s->re[k] = magnitude * cosf(syn[k]);
+            s->im[k] = magnitude * sinf(syn[k]);
+        }
+        fft_Inverse(s->plan, s->re, s->im, s->time, s->scratch);
+
+        float* out = s->out[c];
+        for(uint32_t i = 0; i < n; i++){
+            out[i] += s->time[i] * s->window[i];
+        }
+    }
+    for(uint32_t i = 0; i < n; i++){
+        s->norm[i] += s->window[i] * s->window[i];
+    }
+}
+
+/**
+ * @brief Appends a block of input and writes every output frame that is complete
+ *
+ * The output is delayed by the frame length. Feed silence after the end of the input until enough output has been produced.
+ *
+ * @param s the stream
+ * @param in the interleaved input samples
+ * @param frames the number of input frames. At most the max_block given to tempo_Create
+ * @param out receives interleaved output samples, room for tempo_MaxOutput(s, frames) frames is needed
+ *
+ * @returns the number of output frames written
+ */
+uint32_t tempo_Process(struct tempo_stream* s, const float* in, uint32_t frames, float* out){
+    const uint32_t channels = s->channels;
+
+    // Drop the samples that no frame can reach anymore
+    int64_t next = (int64_t)llround(s->frames_done * s->hop * s->factor);
+    int64_t keep = next - (int64_t)s->search;
+    if(s->prev_pos >= 0 && s->prev_pos + (int64_t)s->hop < keep) keep = s->prev_pos + s->hop;
+    if(keep > (int64_t)(s->in_base + s->in_count)) keep = (int64_t)(s->in_base + s->in_count);
+    if(keep > (int64_t)s->in_base){
+        uint32_t drop = (uint32_t)(keep - (int64_t)s->in_base);
+        for(uint32_t c = 0; c < channels; c++){
+            memmove(s->in[c], s->in[c] + drop, (s->in_count - drop) * sizeof(float));
+        }
+        memmove(s->mono, s->mono + drop, (s->in_count - drop) * sizeof(float));
+        s->in_count -= drop;
+        s->in_base += drop;
+    }
+
+    for(uint32_t i = 0; i < frames; i++){
+        float sum = 0.0f;
+        for(uint32_t c = 0; c < channels; c++){
+            float v = in[(size_t)i * channels + c];
+            s->in[c][s->in_count + i] = v;
+            sum += v;
+        }
+        s->mono[s->in_count + i] = sum;
+    }
+    s->in_count += frames;
+
+    uint32_t produced = 0;
+    while(1){
+        int64_t pos = (int64_t)llround(s->frames_done * s->hop * s->factor);
+        if(pos < (int64_t)s->in_base) pos = (int64_t)s->in_base;
+        // the frame and its search range must be available
+        if(pos + s->search + s->frame > (int64_t)(s->in_base + s->in_count)) break;
+
+        uint32_t offset = (uint32_t)(pos - (int64_t)s->in_base);
+        if(s->mode == TEMPO_WSOLA){
+            if(s->prev_pos >= 0){
+                uint32_t ref = (uint32_t)(s->prev_pos + s->hop - (int64_t)s->in_base);
+                int32_t lo = offset >= s->search ? -(int32_t)s->search : -(int32_t)offset;
+                int32_t d = tempo_BestOffset(s->mono, offset, lo, (int32_t)s->search, s->mono + ref, s->hop);
+                offset = (uint32_t)((int32_t)offset + d);
+            }
+            tempo_AddWsolaFrame(s, offset);
+        } else{
+            uint32_t advance = s->prev_pos >= 0 ? (uint32_t)(s->in_base + offset - s->prev_pos) : 0;
+            if(s->prev_pos >= 0 && advance == 0) advance = 1;
+            tempo_AddVocoderFrame(s, offset, advance);
+        }
+        s->prev_pos = (int64_t)(s->in_base + offset);
+        s->frames_done++;
+
+        // The first hop samples are final, write them and shift the accumulators
+        for(uint32_t i = 0; i < s->hop; i++){
+            float weight = s->norm[i] > 1e-3f ? 1.0f / s->norm[i] : 0.0f;
+            for(uint32_t c = 0; c < channels; c++){
+                out[(size_t)(produced + i) * channels + c] = s->out[c][i] * weight;
+            }
+        }
+        produced += s->hop;
+        for(uint32_t c = 0; c < channels; c++){
+            memmove(s->out[c], s->out[c] + s->hop, (s->frame - s->hop) * sizeof(float));
+            memset(s->out[c] + s->frame - s->hop, 0, s->hop * sizeof(float));
+        }
+        memmove(s->norm, s->norm + s->hop, (s->frame - s->hop) * sizeof(float));
+        memset(s->norm + s->frame - s->hop, 0, s->hop * sizeof(float));
+    }
+    return produced;
+}
@@ -0,0 +1,84 @@
+#!/bin/sh
+# The virtual sink must report the period and buffer of each latency profile and count the underruns of a stall
+# longer than the buffer only; a control file must ramp the volume and seek in the output; crossfades between decks
+# must keep their length.
+
+. tests/lib.sh
+
+"$SW" generate --dur 3 --voice sine:441 --channels 2 > "$TMP/a.wav"
+"$SW" generate --dur 3 --voice saw:220 --channels 2 > "$TMP/b.wav"
+
+# the number of frames of a 16 bit stereo WAV file with a canonical header
+frames(){
+    echo $((($(wc -c < "$1") - 44) / 4))
+}
+
+# the peak of the left channel of a 16 bit stereo WAV file in each window of 100 frames, a period of the 441 Hz sine
+peaks(){
+    od -An -td2 -v -j44 -w4 "$1" | awk '{ a = $1 < 0 ? -$1 : $1; w = int((NR - 1) / 100); if(a > m[w]) m[w] = a }
+                                        END { for(i = 0; i <= w; i++) print m[i] + 0 }'
+}
+
+latency(){
+    profile=$1
+    expected=$2
+    stall=$3
+    underruns=$4
+    "$SW" dj --sink virtual --latency $profile $stall < "$TMP/a.wav" > "$TMP/out.wav" 2> "$TMP/log"
+    counted=$(sed -n 's/^dj: \([0-9]*\) underruns$/\1/p' "$TMP/log")
+    if ! grep -q "period $expected frames" "$TMP/log"; then
+        fail "$profile: expected period $expected frames, got $(head -n 1 "$TMP/log")"
+    elif [ "$counted" != $underruns ]; then
+        fail "$profile${stall:+ $stall}: expected $underruns underruns, got ${counted:-none}"
+    elif [ $(frames "$TMP/out.wav") -ne $(frames "$TMP/a.wav") ]; then
+        fail "$profile${stall:+ $stall}: played $(frames "$TMP/out.wav") of $(frames "$TMP/a.wav") frames"
+    else
+        pass "$profile${stall:+ $stall}: period $expected frames, $underruns underruns"
+    fi
+}
+
+latency low "256 frames, buffer 512" "" 0
+latency normal "1024 frames, buffer 4096" "" 0
+latency safe "2048 frames, buffer 8192" "" 0
+# a stall of 50 ms empties the 11.6 ms buffer of low once, but not the 185.8 ms one of safe
+latency low "256 frames, buffer 512" "--stall 0.05@1" 1
+latency safe "2048 frames, buffer 8192" "--stall 0.05@1" 0
+
+# the waits of a control file are in real time, so it drives the simulated sink
+printf 'wait 1\nvolume 0.5\nwait 0.8\nseek +1\n' > "$TMP/control"
+"$SW" dj --sink sim --control "$TMP/control" < "$TMP/a.wav" > "$TMP/out.wav" 2> /dev/null
+peaks "$TMP/a.wav" > "$TMP/peaks-in"
+peaks "$TMP/out.wav" > "$TMP/peaks-out"
+full=$(sort -n "$TMP/peaks-in" | tail -n 1)
+half=$((full / 2))
+# 441 windows are a second: the first 0.8 s are before the volume change, 1.3 s to 1.7 s after it and before the
+# seek, and from 1.3 s on the volume stays at 0.5 whatever the seek plays
+before=$(sed -n '1,352p' "$TMP/peaks-out" | sort -n | head -n 1)
+after=$(sed -n '574,749p' "$TMP/peaks-out" | sort -n | head -n 1)
+highest=$(sed -n '574,$p' "$TMP/peaks-out" | sort -n | tail -n 1)
+ramp=$(awk -v low=$((half + half / 10)) -v high=$((full - full / 10)) '$1 > low && $1 < high' "$TMP/peaks-out" | wc -l)
+if [ $before -lt $((full - 2)) ]; then
+    fail "control: the volume changed before the first wait ended (peak $before of $full)"
+elif [ $after -lt $((half - 2)) ] || [ $highest -gt $((half + 2)) ]; then
+    fail "control: the volume 0.5 line gave peaks up to $highest, expected $half"
+elif [ $ramp -lt 1 ]; then
+    fail "control: the volume changed as a step instead of a ramp"
+elif [ $(frames "$TMP/out.wav") -lt 83790 ] || [ $(frames "$TMP/out.wav") -gt 92610 ]; then
+    fail "control: seek +1 played $(frames "$TMP/out.wav") frames, expected about 88200"
+else
+    pass "control: volume ramp to $half and seek +1"
+fi
+
+# two decks of 3 s with a crossfade of 1 s play for 5 s, the crossfade whole even on the virtual clock
+"$SW" dj "$TMP/a.wav" "$TMP/b.wav" --xfade 1 --sink virtual > "$TMP/out.wav" 2> "$TMP/log"
+if ! grep -q "from 2.000 s of .*, crossfade 1.000 s" "$TMP/log"; then
+    fail "decks: expected a crossfade of 1.000 s from 2.000 s, got $(grep from "$TMP/log")"
+elif ! grep -q " 0 late, 0 deck underflows, 0 shortened crossfades" "$TMP/log"; then
+    fail "decks: $(grep periods "$TMP/log")"
+elif [ $(frames "$TMP/out.wav") -ne 220500 ]; then
+    fail "decks: played $(frames "$TMP/out.wav") frames, expected 220500"
+else
+    pass "decks: crossfade of 1.000 s, no late periods"
+fi
+
+finish
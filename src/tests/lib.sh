@@ -0,0 +1,46 @@
+#!/bin/sh
+# Helpers shared by the checks. Each check runs from src/ with the soundwave binary built, and exits non-zero on the
+# first failure after printing what differed.
+
+SW=${SW:-./soundwave}
+TMP=$(mktemp -d "${TMPDIR:-/tmp}/soundwave-check.XXXXXX")
+trap 'rm -rf "$TMP"' EXIT
+failures=0
+
+fail(){
+    echo "FAIL: $*" >&2
+    failures=$((failures + 1))
+}
+
+pass(){
+    echo "ok: $*"
+}
+
+# writes a 32 bit little-endian integer
+le32(){
+    printf "$(printf '\\%03o\\%03o\\%03o\\%03o' $(($1 & 255)) $(($1 >> 8 & 255)) $(($1 >> 16 & 255)) $(($1 >> 24 & 255)))"
+}
+
+# appends a 16 byte LIST chunk after the data chunk of a WAV file and fixes its RIFF size
+add_list(){
+    printf 'LIST\010\000\000\000INFOabcd' >> "$1"
+    size=$(($(wc -c < "$1") - 8))
+    le32 $size | dd of="$1" bs=1 seek=4 conv=notrunc 2> /dev/null
+}
+
+# the RIFF size of a WAV file
+riff_size(){
+    od -An -tu4 -j4 -N4 "$1" | tr -d ' '
+}
+
+# the value of a "name value" line or of a "name: value" field in a file
+field(){
+    sed -n "s/.*$1[: ]*\([0-9.]*\).*/\1/p" "$2" | head -n 1
+}
+
+finish(){
+    if [ $failures -gt 0 ]; then
+        echo "$failures checks failed" >&2
+        exit 1
+    fi
+}
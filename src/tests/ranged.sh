@@ -0,0 +1,44 @@
+#!/bin/sh
+# The commands that process a regular file in ranges with pread/pwrite (chunked.h) must write the same file as when
+# they stream the same input from a pipe, including the chunks after the data chunk.
+
+. tests/lib.sh
+
+"$SW" generate --dur 1 --voice sine:440 --channels 2 --bits 8 > "$TMP/s8.wav"
+"$SW" generate --dur 1 --voice saw:220 --channels 2 --bits 16 > "$TMP/s16.wav"
+"$SW" generate --dur 1 --voice triangle:330 --channels 1 --bits 16 > "$TMP/m16.wav"
+for f in s8 s16 m16; do
+    cp "$TMP/$f.wav" "$TMP/$f-list.wav"
+    add_list "$TMP/$f-list.wav"
+done
+
+check(){
+    name=$1
+    input=$2
+    shift 2
+    "$SW" "$@" --threads 3 < "$input" > "$TMP/ranged.wav" 2> /dev/null
+    cat "$input" | "$SW" "$@" > "$TMP/streamed.wav" 2> /dev/null
+    if ! cmp -s "$TMP/ranged.wav" "$TMP/streamed.wav"; then
+        fail "$name: $* differs between a file and a pipe"
+    elif [ $(($(riff_size "$TMP/ranged.wav") + 8)) -ne $(wc -c < "$TMP/ranged.wav") ]; then
+        fail "$name: $* has a RIFF size that does not cover the file"
+    else
+        pass "$name: $*"
+    fi
+}
+
+for f in s8 s16 m16 s8-list s16-list m16-list; do
+    check $f "$TMP/$f.wav" volume 0.5
+    check $f "$TMP/$f.wav" rate 1.5
+    check $f "$TMP/$f.wav" convert --bits 24
+    check $f "$TMP/$f.wav" convert --bits 32f
+done
+for f in s8 s16 s8-list s16-list; do
+    check $f "$TMP/$f.wav" channel left
+    check $f "$TMP/$f.wav" channel right
+done
+"$SW" convert --bits 24 < "$TMP/s16-list.wav" > "$TMP/s24-list.wav"
+check s24-list "$TMP/s24-list.wav" convert --bits 16
+check s24-list "$TMP/s24-list.wav" convert --bits 8
+
+finish
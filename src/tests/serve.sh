@@ -0,0 +1,58 @@
+#!/bin/sh
+# A server started on a temporary socket must write, for jobs that pass the client's descriptors and for jobs that
+# name files, the same bytes as running the command directly, and its stats must count every job.
+
+. tests/lib.sh
+
+SOCKET="$TMP/sock"
+"$SW" generate --dur 1 --voice saw:220 --channels 2 --bits 16 > "$TMP/in.wav"
+"$SW" serve --socket "$SOCKET" --workers 2 2> "$TMP/serve.log" &
+server=$!
+trap 'kill $server 2> /dev/null; rm -rf "$TMP"' EXIT
+tries=0
+while [ ! -S "$SOCKET" ] && [ $tries -lt 50 ]; do
+    sleep 0.1
+    tries=$((tries + 1))
+done
+[ -S "$SOCKET" ] || { fail "serve did not create $SOCKET"; finish; }
+
+jobs=0
+check(){
+    how=$1
+    shift
+    "$SW" "$@" < "$TMP/in.wav" > "$TMP/direct.wav" 2> /dev/null
+    rm -f "$TMP/served.wav"
+    if [ "$how" = fd ]; then
+        "$SW" client --socket "$SOCKET" "$@" < "$TMP/in.wav" > "$TMP/served.wav" 2> /dev/null
+    else
+        "$SW" client --socket "$SOCKET" --in "$TMP/in.wav" --out "$TMP/served.wav" "$@" 2> /dev/null
+    fi
+    jobs=$((jobs + 1))
+    if cmp -s "$TMP/direct.wav" "$TMP/served.wav"; then
+        pass "$how: $*"
+    else
+        fail "$how: $* differs from the direct run"
+    fi
+}
+
+for how in fd path; do
+    check $how volume 0.5
+    check $how rate 1.5
+    check $how channel left
+    check $how convert --bits 24
+done
+
+# a job whose command fails is completed and counted as failed
+"$SW" client --socket "$SOCKET" volume < /dev/null > /dev/null 2>&1
+jobs=$((jobs + 1))
+
+"$SW" client --socket "$SOCKET" stats > "$TMP/stats" 2> /dev/null
+for counter in "completed $jobs" "failed 1" "rejected 0" "busy 0" "queue_depth 0"; do
+    if [ "$(field "${counter% *}" "$TMP/stats")" = "${counter#* }" ]; then
+        pass "stats: $counter"
+    else
+        fail "stats: expected $counter, got $(grep "^${counter% *} " "$TMP/stats")"
+    fi
+done
+
+finish
@@ -15,8 +15,57 @@
 #include<inttypes.h>
 #include<string.h>
 #include<errno.h>
+#include<math.h>
+#include<unistd.h>
+#include"arena.h"
+#include"stats.h"
+
+#if defined(__SSE2__)
+#include<immintrin.h>
+#endif
 
 #define SIZE_OF_WAVE_HEADER 36
+#define STREAM_BLOCK_FRAMES 4096
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+
+/*
+ * The streams that the commands read and write and the arena that they allocate from. They default to STDIN,
+ * STDOUT and plain aligned_alloc(), and are replaced by a library context for the duration of a call. They are
+ * thread-local, so contexts can be used from several threads at once.
+ */
+static _Thread_local FILE* io_input = NULL;
+static _Thread_local FILE* io_output = NULL;
+static _Thread_local struct sample_arena* io_arena = NULL;
+
+#define IO_IN (io_input != NULL ? io_input : stdin)
+#define IO_OUT (io_output != NULL ? io_output : stdout)
+
+/**
+ * @brief Allocates a buffer whose address is aligned to a 64 byte boundary so SIMD loads never split a cache line
+ * 
+ * While a library context is active the buffer comes from its arena, see arena.h.
+ * 
+ * @param size the size of the buffer in bytes
+ * 
+ * @returns the buffer, to be released with free_Aligned(), or NULL on failure
+ */
+void* alloc_Aligned(size_t size){
+    if(io_arena != NULL) return arena_Alloc(io_arena, size);
+    size = (size + 63) & ~(size_t)63;
+    if(size == 0) size = 64;
+    return aligned_alloc(64, size);
+}
+
+/**
+ * @brief Releases a buffer allocated with alloc_Aligned(). Buffers of the active arena are kept for reuse
+ */
+void free_Aligned(void* data){
+    if(data == NULL) return;
+    if(io_arena != NULL && arena_Free(io_arena, data)) return;
+    free(data);
+}
 
 /**
  * @brief Writes characters to STDOUT untill null terminator is found
@@ -26,9 +75,10 @@
 void write_ch(char* value){
     char* ptr = value;
     while(*ptr){
-        putchar(*ptr);
+        putc(*ptr, IO_OUT);
         ptr++;
     }
+    stats_Bytes(STATS_WRITE, (uint64_t)(ptr - value));
 }
 
 /**
@@ -38,11 +88,13 @@ void write_ch(char* value){
  * @param lenght how many characters to write
  */
 void swrite_ch(char* value, uint32_t lenght){
+    double start = stats_Begin();
     char* ptr = value;
     for(uint32_t i = 0; i < lenght; i++){
-        putchar(*ptr);
+        putc(*ptr, IO_OUT);
         ptr++;
     }
+    stats_End(STATS_WRITE, start, lenght);
 }
 
 /**
@@ -51,10 +103,11 @@ void swrite_ch(char* value, uint32_t lenght){
  * @param value
  */
 void write_u32(uint32_t value){
-    putchar((value)  & 0xFF);
-    putchar((value >> 8)  & 0xFF);
-    putchar((value >> 16) & 0xFF);
-    putchar((value >> 24) & 0xFF);
+    putc((value)  & 0xFF, IO_OUT);
+    putc((value >> 8)  & 0xFF, IO_OUT);
+    putc((value >> 16) & 0xFF, IO_OUT);
+    putc((value >> 24) & 0xFF, IO_OUT);
+    stats_Bytes(STATS_WRITE, 4);
 }
 
 /**
@@ -63,8 +116,9 @@ void write_u32(uint32_t value){
  * @param value
  */
 void write_u16(uint16_t value){
-    putchar((value)  & 0xFF);
-    putchar((value >> 8)  & 0xFF);
+    putc((value)  & 0xFF, IO_OUT);
+    putc((value >> 8)  & 0xFF, IO_OUT);
+    stats_Bytes(STATS_WRITE, 2);
 }
 
 /**
@@ -88,7 +142,7 @@ char* get_RIFF(){
     if(RIFF == NULL) return NULL;
 
     for(int i = 0; i < 4; i++){
-        RIFF[i] = getchar();
+        RIFF[i] = getc(IO_IN);
     }
     return RIFF;
 }
@@ -102,7 +156,7 @@ char* get_RIFF(){
 uint32_t get_SizeOfFile(){
     uint32_t field;
 
-    field = (getchar()) + (getchar() << 8) + (getchar() << 16) + (getchar() << 24);
+    field = (getc(IO_IN)) + (getc(IO_IN) << 8) + (getc(IO_IN) << 16) + (getc(IO_IN) << 24);
     return field;
 }
 
@@ -143,7 +197,7 @@ uint32_t get_FormatChunk(){
 uint16_t get_WaveFormat(){
     uint16_t field;
 
-    field = (getchar()) + (getchar() << 8);
+    field = (getc(IO_IN)) + (getc(IO_IN) << 8);
     return field;
 }
 
@@ -194,7 +248,9 @@ uint16_t get_BlockAlign(){
  * It reads in little endian order and from that constructs the uint16_t
  */
 uint16_t get_BitsPerSample(){
-    return get_WaveFormat();
+    uint16_t bits_per_sample = get_WaveFormat();
+    stats_Format(0, bits_per_sample);
+    return bits_per_sample;
 }
 
 /**
@@ -228,16 +284,18 @@ uint32_t get_DataSegmentSize(){
  */
 char* read_DataSegment(uint32_t size, short* eof){
     *eof = 0;
-    char* buffer = malloc(size * sizeof(char));
+    char* buffer = alloc_Aligned(size);
     if(buffer == NULL) return NULL;
 
+    double start = stats_Begin();
     for(uint32_t i = 0; i < size; i++){
-        int c = getchar();
+        int c = getc(IO_IN);
         if(c == EOF){
             *eof = 1;
         }
         buffer[i] = c;
     }
+    stats_End(STATS_READ, start, size);
     return buffer;
 }
 
@@ -252,13 +310,13 @@ char* read_DataSegment(uint32_t size, short* eof){
  */
 void* read_Channel_8bit(char* data, uint32_t size, short channel){
     size = size / 2; // size of buffer is half the original data
-    char* buffer = malloc(size * sizeof(char));
+    char* buffer = alloc_Aligned(size);
     if(buffer == NULL) return NULL;
 
-    uint32_t i = channel == 0 ? 0 : 1; // 0 is left channel, 1 is right channel
+    uint32_t c = channel == 0 ? 0 : 1; // 0 is left channel, 1 is right channel
 
-    for(; i < size; i += 2){
-        buffer[i] = data[i];
+    for(uint32_t i = 0; i < size; i++){
+        buffer[i] = data[2*i + c];
     }
     return buffer;
 }
@@ -274,14 +332,14 @@ void* read_Channel_8bit(char* data, uint32_t size, short channel){
  */
 void* read_Channel_16bit(char* data, uint32_t size, short channel){
     size = size / 2; // size of buffer is half the original data
-    char* buffer = malloc(size * sizeof(char));
+    char* buffer = alloc_Aligned(size);
     if(buffer == NULL) return NULL;
 
-    uint32_t i = channel == 0 ? 0 : 1; // 0 is left channel, 1 is right channel
+    uint32_t c = channel == 0 ? 0 : 2; // 0 is left channel, 1 is right channel
 
-    for(; i < size; i += 2){
-        buffer[i] = data[i];
-        buffer[i+1] = data[i+1];
+    for(uint32_t i = 0; i + 1 < size; i += 2){
+        buffer[i] = data[2*i + c];
+        buffer[i+1] = data[2*i + c + 1];
     }
     return buffer;
 }
@@ -311,28 +369,114 @@ int16_t clamp_16bit(int32_t value){
     return (int16_t)value;
 }
 
+/**
+ * @brief Multiplies 4 signed 32 bit integers by 4 gains in double precision, clamps the products to
+ * [INT16_MIN, INT16_MAX] and truncates them towards zero
+ *
+ * Without the clamp a product out of the int32 range would convert to INT32_MIN and saturate to the wrong end.
+ */
+#if defined(__SSE2__)
+__m128i gain_Multiply4(__m128i values, const double* gains){
+    const __m128d min = _mm_set1_pd(-32768.0), max = _mm_set1_pd(32767.0);
+    __m128d lo = _mm_mul_pd(_mm_cvtepi32_pd(values), _mm_loadu_pd(gains));
+    __m128d hi = _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(values, _MM_SHUFFLE(1, 0, 3, 2))), _mm_loadu_pd(gains + 2));
+    lo = _mm_min_pd(_mm_max_pd(lo, min), max);
+    hi = _mm_min_pd(_mm_max_pd(hi, min), max);
+    return _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+}
+#endif
+
+/**
+ * @brief Multiplies 16 bit samples by a per-sample gain, truncating towards zero and saturating to [INT16_MIN, INT16_MAX]
+ * 
+ * This is the multiply/saturate kernel shared by the volume, fade and envelope commands. The products are computed in
+ * double precision so the result is the same as `clamp_16bit((int32_t)(sample * volume))`.
+ * 
+ * @param in the little-endian samples
+ * @param out receives the scaled samples. May be the same buffer as `in`
+ * @param samples the number of samples
+ * @param gains one gain per sample
+ */
+void gain_Apply16bit(const char* in, char* out, uint32_t samples, const double* gains){
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    for(; i + 8 <= samples; i += 8){
+        __m128i s = _mm_loadu_si128((const __m128i*)(in + 2*i));
+        __m128i lo = gain_Multiply4(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16), gains + i);
+        __m128i hi = gain_Multiply4(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16), gains + i + 4);
+        _mm_storeu_si128((__m128i*)(out + 2*i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for(; i < samples; i++){
+        int32_t tmp = (int16_t)((uint8_t)in[2*i] | ((uint8_t)in[2*i + 1] << 8));
+        double scaled = tmp * gains[i];
+        int16_t s = scaled >= 32767.0 ? INT16_MAX : (scaled <= -32768.0 ? INT16_MIN : (int16_t)scaled);
+        out[2*i] = (char)(s & 0xFF);
+        out[2*i + 1] = (char)((s >> 8) & 0xFF);
+    }
+}
+
+/**
+ * @brief Multiplies unsigned 8 bit samples (silence at 128) by a per-sample gain, truncating towards zero and saturating to [0, 255]
+ * 
+ * @param in the samples
+ * @param out receives the scaled samples. May be the same buffer as `in`
+ * @param samples the number of samples
+ * @param gains one gain per sample
+ */
+void gain_Apply8bit(const char* in, char* out, uint32_t samples, const double* gains){
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    for(; i + 16 <= samples; i += 16){
+        // flipping the top bit turns unsigned samples centered at 128 into signed ones centered at 0
+        __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i)), bias);
+        __m128i w0 = _mm_srai_epi16(_mm_unpacklo_epi8(s, s), 8);
+        __m128i w1 = _mm_srai_epi16(_mm_unpackhi_epi8(s, s), 8);
+        __m128i d0 = gain_Multiply4(_mm_srai_epi32(_mm_unpacklo_epi16(w0, w0), 16), gains + i);
+        __m128i d1 = gain_Multiply4(_mm_srai_epi32(_mm_unpackhi_epi16(w0, w0), 16), gains + i + 4);
+        __m128i d2 = gain_Multiply4(_mm_srai_epi32(_mm_unpacklo_epi16(w1, w1), 16), gains + i + 8);
+        __m128i d3 = gain_Multiply4(_mm_srai_epi32(_mm_unpackhi_epi16(w1, w1), 16), gains + i + 12);
+        __m128i r = _mm_packs_epi16(_mm_packs_epi32(d0, d1), _mm_packs_epi32(d2, d3));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_xor_si128(r, bias));
+    }
+#endif
+    for(; i < samples; i++){
+        double scaled = ((int32_t)(uint8_t)in[i] - 128) * gains[i];
+        int32_t s = scaled >= 127.0 ? 127 : (scaled <= -128.0 ? -128 : (int32_t)scaled);
+        out[i] = (char)(uint8_t)(s + 128);
+    }
+}
+
 char* set_Volume16bit(char* data, uint32_t size, double volume){
-    char* buffer = malloc(size * sizeof(char));
+    char* buffer = alloc_Aligned(size);
     if(buffer == NULL) return NULL;
-    
-    for(uint32_t i = 0; i < size; i += 2){
-        int32_t tmp = (int16_t)((uint8_t)data[i] | ((uint8_t)data[i+1] << 8));
-        tmp = (int32_t)(tmp * volume);
-        int16_t out = (int16_t)clamp_16bit(tmp);
 
-        buffer[i] = (char)(out & 0xFF);
-        buffer[i + 1] = (char)((out >> 8) & 0xFF);
+    double gains[1024];
+    for(uint32_t i = 0; i < 1024; i++){
+        gains[i] = volume;
+    }
+
+    uint32_t samples = size / 2;
+    for(uint32_t i = 0; i < samples; i += 1024){
+        uint32_t n = samples - i < 1024 ? samples - i : 1024;
+        gain_Apply16bit(data + 2*i, buffer + 2*i, n, gains);
     }
     return buffer;
 }
 
 char* set_Volume8bit(char* data, uint32_t size, double volume){
-    char* buffer = malloc(size * sizeof(char));
+    char* buffer = alloc_Aligned(size);
     if(buffer == NULL) return NULL;
-    
-    for(uint32_t i = 0; i < size; i++){
-        uint32_t tmp = (uint32_t)(data[i] * volume);
-        buffer[i] = (uint8_t)clamp_8bit(tmp);
+
+    double gains[1024];
+    for(uint32_t i = 0; i < 1024; i++){
+        gains[i] = volume;
+    }
+
+    for(uint32_t i = 0; i < size; i += 1024){
+        uint32_t n = size - i < 1024 ? size - i : 1024;
+        gain_Apply8bit(data + i, buffer + i, n, gains);
     }
     return buffer;
 }
@@ -349,12 +493,14 @@ char* get_OtherData(uint32_t total_size, uint32_t data_segment_size){
     uint32_t total_bytes_traversed = SIZE_OF_WAVE_HEADER + data_segment_size;
     uint32_t remaining = total_size - total_bytes_traversed;
 
-    char* buffer = malloc(remaining * sizeof(char));
+    char* buffer = alloc_Aligned(remaining);
     if(buffer == NULL) return NULL;
 
+    double start = stats_Begin();
     for(uint32_t i = 0; i < remaining; i++){
-        buffer[i] = getchar();
+        buffer[i] = getc(IO_IN);
     }
+    stats_End(STATS_READ, start, remaining);
     return buffer;
 }
 
@@ -373,4 +519,367 @@ double fsafe_StrToint(char* str, short* flag){
 double safe_StrToDouble(char* str){
     short flag;
     return fsafe_StrToint(str, &flag);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief The fields of a canonical 44 byte WAV header
+ */
+struct wav_header {
+    uint32_t size_of_file;
+    uint32_t format_chunk;
+    uint16_t wave_format;
+    uint16_t mono_stereo;
+    uint32_t sample_rate;
+    uint32_t bytes_per_sec;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    uint32_t data_segment_size;
+};
+
+/**
+ * @brief Returns a uint32_t read in little-endian order from a stream
+ */
+uint32_t fget_u32(FILE* stream){
+    uint8_t b[4] = {0};
+    if(fread(b, 1, 4, stream) != 4) return 0;
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+/**
+ * @brief Returns a uint16_t read in little-endian order from a stream
+ */
+uint16_t fget_u16(FILE* stream){
+    uint8_t b[2] = {0};
+    if(fread(b, 1, 2, stream) != 2) return 0;
+    return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+/**
+ * @brief Reads and validates the header of a WAV file from a stream
+ * 
+ * The same checks as the ones performed by the info command are applied. On failure an error message is printed to STDERR.
+ * 
+ * @param stream the stream positioned at the start of the file
+ * @param header the structure that receives the header fields
+ * @param max_channels the largest number of channels the caller supports, the commands that predate remix support 2
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void fread_WavHeaderChannels(FILE* stream, struct wav_header* header, uint16_t max_channels, short* flag){
+    *flag = 1;
+
+    char tag[4];
+    if(fread(tag, 1, 4, stream) != 4 || memcmp(tag, "RIFF", 4) != 0){
+        fprintf(stderr, "Error! \"RIFF\" not found\n");
+        return;
+    }
+    header->size_of_file = fget_u32(stream);
+
+    if(fread(tag, 1, 4, stream) != 4 || memcmp(tag, "WAVE", 4) != 0){
+        fprintf(stderr, "Error! \"WAVE\" not found\n");
+        return;
+    }
+    if(fread(tag, 1, 4, stream) != 4 || memcmp(tag, "fmt ", 4) != 0){
+        fprintf(stderr, "Error! \"fmt \" not found\n");
+        return;
+    }
+
+    header->format_chunk = fget_u32(stream);
+    if(header->format_chunk != 16){
+        fprintf(stderr, "Error! size of format chunk should be 16\n");
+        return;
+    }
+
+    header->wave_format = fget_u16(stream);
+    if(header->wave_format != WAVE_FORMAT_PCM && header->wave_format != WAVE_FORMAT_IEEE_FLOAT){
+        fprintf(stderr, "Error! WAVE type format should be 1 (PCM) or 3 (float)\n");
+        return;
+    }
+
+    header->mono_stereo = fget_u16(stream);
+    if(header->mono_stereo < 1 || header->mono_stereo > max_channels){
+        if(max_channels == 2) fprintf(stderr, "Error! mono/stereo should be 1 or 2\n");
+        else fprintf(stderr, "Error! the number of channels should be between 1 and %d\n", max_channels);
+        return;
+    }
+
+    header->sample_rate = fget_u32(stream);
+    header->bytes_per_sec = fget_u32(stream);
+    header->block_align = fget_u16(stream);
+    if(header->bytes_per_sec != header->sample_rate * header->block_align){
+        fprintf(stderr, "Error! bytes/second should be sample rate x block alignment\n");
+        return;
+    }
+
+    header->bits_per_sample = fget_u16(stream);
+    if(header->wave_format == WAVE_FORMAT_IEEE_FLOAT && header->bits_per_sample != 32){
+        fprintf(stderr, "Error! bits/sample of float data should be 32\n");
+        return;
+    }
+    if(header->bits_per_sample != 8 && header->bits_per_sample != 16 && header->bits_per_sample != 24 && header->bits_per_sample != 32){
+        fprintf(stderr, "Error! bits/sample should be 8, 16, 24 or 32\n");
+        return;
+    }
+    if(header->block_align != (header->bits_per_sample / 8) * header->mono_stereo){
+        fprintf(stderr, "Error! block alignment should be bits per sample / 8 x mono/stereo\n");
+        return;
+    }
+
+    if(fread(tag, 1, 4, stream) != 4 || memcmp(tag, "data", 4) != 0){
+        fprintf(stderr, "Error! \"data\" not found\n");
+        return;
+    }
+    header->data_segment_size = fget_u32(stream);
+
+    if(stream == IO_IN) stats_Format(0, header->bits_per_sample);
+    *flag = 0;
+}
+
+/**
+ * @brief Reads and validates the header of a mono or stereo WAV file from a stream, see fread_WavHeaderChannels
+ */
+void fread_WavHeader(FILE* stream, struct wav_header* header, short* flag){
+    fread_WavHeaderChannels(stream, header, 2, flag);
+}
+
+/**
+ * @brief Reads and validates the header of a WAV file from STDIN
+ * 
+ * @param header the structure that receives the header fields
+ * @param flag Upon successfull completion the value is set to 0. Otherwise a non-zero value is stored
+ */
+void read_WavHeader(struct wav_header* header, short* flag){
+    fread_WavHeader(IO_IN, header, flag);
+}
+
+/**
+ * @brief Formats a canonical 44 byte WAV header
+ * 
+ * @param header the header fields
+ * @param b receives the SIZE_OF_WAVE_HEADER + 8 bytes of the header
+ */
+void format_WavHeader(const struct wav_header* header, uint8_t* b){
+    const uint32_t u32[5] = {header->size_of_file, header->format_chunk, header->sample_rate, header->bytes_per_sec, header->data_segment_size};
+    const uint32_t u32_at[5] = {4, 16, 24, 28, 40};
+    const uint16_t u16[4] = {header->wave_format, header->mono_stereo, header->block_align, header->bits_per_sample};
+    const uint32_t u16_at[4] = {20, 22, 32, 34};
+
+    memcpy(b, "RIFF", 4);
+    memcpy(b + 8, "WAVEfmt ", 8);
+    memcpy(b + 36, "data", 4);
+    for(uint32_t i = 0; i < 5; i++){
+        for(uint32_t k = 0; k < 4; k++) b[u32_at[i] + k] = (uint8_t)(u32[i] >> (8 * k));
+    }
+    for(uint32_t i = 0; i < 4; i++){
+        for(uint32_t k = 0; k < 2; k++) b[u16_at[i] + k] = (uint8_t)(u16[i] >> (8 * k));
+    }
+}
+
+/**
+ * @brief Writes a canonical 44 byte WAV header to a stream
+ * 
+ * @param stream the stream
+ * @param header the header fields to write
+ */
+void fwrite_WavHeader(FILE* stream, const struct wav_header* header){
+    uint8_t b[SIZE_OF_WAVE_HEADER + 8];
+    format_WavHeader(header, b);
+    if(stream != IO_OUT){
+        fwrite(b, 1, sizeof(b), stream);
+        return;
+    }
+    double start = stats_Begin();
+    stats_Format(1, header->bits_per_sample);
+    fwrite(b, 1, sizeof(b), stream);
+    stats_End(STATS_WRITE, start, sizeof(b));
+}
+
+/**
+ * @brief Writes a canonical 44 byte WAV header to STDOUT
+ * 
+ * @param header the header fields to write
+ */
+void write_WavHeader(const struct wav_header* header){
+    fwrite_WavHeader(IO_OUT, header);
+}
+
+/**
+ * @brief Reads up to `size` bytes of the data segment from STDIN in one call
+ * 
+ * @param buffer where the bytes are stored
+ * @param size how many bytes to read
+ * 
+ * @returns the number of bytes actually read. A value smaller than `size` means that EOF was reached.
+ */
+uint32_t read_Block(char* buffer, uint32_t size){
+    double start = stats_Begin();
+    uint32_t got = (uint32_t)fread(buffer, 1, size, IO_IN);
+    stats_End(STATS_READ, start, got);
+    return got;
+}
+
+/**
+ * @brief Writes a block of output data to STDOUT in one call
+ * 
+ * @param buffer the bytes to write
+ * @param size how many bytes to write
+ * 
+ * @returns the number of bytes actually written
+ */
+size_t write_Block(const void* buffer, size_t size){
+    double start = stats_Begin();
+    size_t written = fwrite(buffer, 1, size, IO_OUT);
+    stats_End(STATS_WRITE, start, written);
+    return written;
+}
+
+/**
+ * @brief Copies the bytes that follow the data segment from STDIN to STDOUT
+ * 
+ * @param total_size the size of file field of the header
+ * @param data_segment_size the size of the data segment
+ */
+void copy_OtherData(uint32_t total_size, uint32_t data_segment_size){
+    uint32_t total_bytes_traversed = SIZE_OF_WAVE_HEADER + data_segment_size;
+    if(total_size <= total_bytes_traversed) return;
+
+    char buffer[4096];
+    uint32_t remaining = total_size - total_bytes_traversed;
+    while(remaining > 0){
+        uint32_t n = remaining < sizeof(buffer) ? remaining : (uint32_t)sizeof(buffer);
+        uint32_t got = read_Block(buffer, n);
+        write_Block(buffer, got);
+        if(got < n) return;
+        remaining -= got;
+    }
+}
+
+/**
+ * @brief Converts interleaved samples to floats in the range [-1, 1)
+ * 
+ * @param data the raw sample bytes
+ * @param out receives `samples` floats
+ * @param samples how many samples (not frames) to convert
+ * @param wave_format WAVE_FORMAT_PCM or WAVE_FORMAT_IEEE_FLOAT
+ * @param bits_per_sample 8, 16, 24 or 32
+ */
+void pcm_ToFloat(const char* data, float* out, uint32_t samples, uint16_t wave_format, uint16_t bits_per_sample){
+    const uint8_t* in = (const uint8_t*)data;
+    if(wave_format == WAVE_FORMAT_IEEE_FLOAT){
+        memcpy(out, data, (size_t)samples * sizeof(float));
+    } else if(bits_per_sample == 8){
+        for(uint32_t i = 0; i < samples; i++){
+            out[i] = ((int32_t)in[i] - 128) * (1.0f / 128.0f);
+        }
+    } else if(bits_per_sample == 16){
+        for(uint32_t i = 0; i < samples; i++){
+            int16_t s = (int16_t)(in[2*i] | (in[2*i + 1] << 8));
+            out[i] = s * (1.0f / 32768.0f);
+        }
+    } else if(bits_per_sample == 24){
+        for(uint32_t i = 0; i < samples; i++){
+            int32_t s = (int32_t)((uint32_t)in[3*i] << 8 | (uint32_t)in[3*i + 1] << 16 | (uint32_t)in[3*i + 2] << 24) >> 8;
+            out[i] = s * (1.0f / 8388608.0f);
+        }
+    } else{
+        for(uint32_t i = 0; i < samples; i++){
+            int32_t s = (int32_t)((uint32_t)in[4*i] | (uint32_t)in[4*i + 1] << 8 | (uint32_t)in[4*i + 2] << 16 | (uint32_t)in[4*i + 3] << 24);
+            out[i] = s * (1.0f / 2147483648.0f);
+        }
+    }
+}
+
+/**
+ * @brief Converts floats in the range [-1, 1) back to interleaved samples, clamping integer samples that are out of range
+ * 
+ * @param in the float samples
+ * @param data receives the raw sample bytes
+ * @param samples how many samples (not frames) to convert
+ * @param wave_format WAVE_FORMAT_PCM or WAVE_FORMAT_IEEE_FLOAT
+ * @param bits_per_sample 8, 16, 24 or 32
+ */
+void pcm_FromFloat(const float* in, char* data, uint32_t samples, uint16_t wave_format, uint16_t bits_per_sample){
+    uint8_t* out = (uint8_t*)data;
+    if(wave_format == WAVE_FORMAT_IEEE_FLOAT){
+        memcpy(data, in, (size_t)samples * sizeof(float));
+    } else if(bits_per_sample == 8){
+        for(uint32_t i = 0; i < samples; i++){
+            int32_t s = (int32_t)lrintf(in[i] * 128.0f) + 128;
+            out[i] = clamp_8bit(s < 0 ? 0 : (uint32_t)s);
+        }
+    } else if(bits_per_sample == 16){
+        for(uint32_t i = 0; i < samples; i++){
+            int16_t s = clamp_16bit((int32_t)lrintf(in[i] * 32768.0f));
+            out[2*i] = (uint8_t)(s & 0xFF);
+            out[2*i + 1] = (uint8_t)((s >> 8) & 0xFF);
+        }
+    } else if(bits_per_sample == 24){
+        for(uint32_t i = 0; i < samples; i++){
+            float v = in[i] * 8388608.0f;
+            int32_t s = v >= 8388607.0f ? 8388607 : (v <= -8388608.0f ? -8388608 : (int32_t)lrintf(v));
+            out[3*i] = (uint8_t)(s & 0xFF);
+            out[3*i + 1] = (uint8_t)((s >> 8) & 0xFF);
+            out[3*i + 2] = (uint8_t)((s >> 16) & 0xFF);
+        }
+    } else{
+        for(uint32_t i = 0; i < samples; i++){
+            double v = (double)in[i] * 2147483648.0;
+            int32_t s = v >= 2147483647.0 ? INT32_MAX : (v <= -2147483648.0 ? INT32_MIN : (int32_t)lrint(v));
+            out[4*i] = (uint8_t)(s & 0xFF);
+            out[4*i + 1] = (uint8_t)((s >> 8) & 0xFF);
+            out[4*i + 2] = (uint8_t)((s >> 16) & 0xFF);
+            out[4*i + 3] = (uint8_t)((s >> 24) & 0xFF);
+        }
+    }
+}
+
+/**
+ * @brief Returns how many worker threads to use when the user did not ask for a specific number
+ */
+int get_ThreadCount(){
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (int)n;
+}
+
+/**
+ * @brief Parses a duration such as "2s", "500ms" or "1.5" (seconds)
+ * 
+ * @param str the text to parse
+ * @param flag set to 1 if the text is not a valid non-negative duration, left unchanged otherwise
+ * 
+ * @returns the duration in seconds
+ */
+double parse_Seconds(const char* str, short* flag){
+    char* endptr;
+    double value = strtod(str, &endptr);
+    if(endptr == str || value < 0){
+        *flag = 1;
+        return 0.0;
+    }
+    if(strcmp(endptr, "ms") == 0) return value / 1000.0;
+    if(strcmp(endptr, "s") == 0 || *endptr == '\0') return value;
+    *flag = 1;
+    return 0.0;
+}
+
+/**
+ * @brief Parses a gain written either as a linear factor ("0.5") or in decibels ("-6dB")
+ * 
+ * @param str the text to parse
+ * @param flag set to 1 if the text is not a valid gain, left unchanged otherwise
+ * 
+ * @returns the linear gain
+ */
+double parse_Gain(const char* str, short* flag){
+    char* endptr;
+    double value = strtod(str, &endptr);
+    if(endptr == str){
+        *flag = 1;
+        return 0.0;
+    }
+    if(strcmp(endptr, "dB") == 0 || strcmp(endptr, "db") == 0) return pow(10.0, value / 20.0);
+    if(*endptr != '\0'){
+        *flag = 1;
+        return 0.0;
+    }
+    return value;
+}